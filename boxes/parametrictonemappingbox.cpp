@@ -65,7 +65,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "io/memorystream.hpp"
 #include "io/decoderstream.hpp"
 #include "tools/numerics.hpp"
+#include "tools/tablecache.hpp"
 #include "std/math.hpp"
+#include "std/string.hpp"
 ///
 
 /// ParametricToneMappingBox::~ParametricToneMappingBox
@@ -76,14 +78,15 @@ ParametricToneMappingBox::~ParametricToneMappingBox(void)
   while ((impl = m_pImpls)) {
     m_pImpls = impl->m_pNext;
     
-    if (impl->m_plTable)
-      m_pEnviron->FreeMem(impl->m_plTable,impl->m_ulTableEntries * sizeof(LONG)); 
+    if (impl->m_plTable && (impl->m_ucShared & ScaledTable) == 0)
+      m_pEnviron->FreeMem(const_cast<LONG *>(impl->m_plTable),impl->m_ulTableEntries * sizeof(LONG)); 
 
-    if (impl->m_pfTable)
-      m_pEnviron->FreeMem(impl->m_pfTable,impl->m_ulTableEntries * sizeof(FLOAT));
+    if (impl->m_pfTable && (impl->m_ucShared & FloatTable) == 0)
+      m_pEnviron->FreeMem(const_cast<FLOAT *>(impl->m_pfTable),impl->m_ulTableEntries * sizeof(FLOAT));
 
-    if (impl->m_plInverseTable)
-      m_pEnviron->FreeMem(impl->m_plInverseTable,impl->m_ulInverseTableEntries * sizeof(LONG));
+    if (impl->m_plInverseTable && (impl->m_ucShared & InverseTable) == 0)
+      m_pEnviron->FreeMem(const_cast<LONG *>(impl->m_plInverseTable),
+                          impl->m_ulInverseTableEntries * sizeof(LONG));
 
     delete impl;
   }
@@ -365,6 +368,287 @@ DOUBLE ParametricToneMappingBox::InverseTableValue(DOUBLE v) const
 }
 ///
 
+/// Approximations
+// The following approximations of the logarithm and the exponential
+// function are used to build the tables in batches. They are accurate to
+// a couple of units in the last place, do not branch and use only
+// operations the compiler can vectorize, in particular no conversions
+// between 64-bit integers and floating point. They rely on the IEEE
+// double format with 52 mantissa bits and an exponent bias of 1023.
+#define APPROX_LN2_HI  6.93147180369123816490e-01
+#define APPROX_LN2_LO  1.90821492927058770002e-10
+#define APPROX_INV_LN2 1.44269504088896338700e+00
+#define APPROX_SQRT2   1.41421356237309504880
+// 2^52 and 1.5 * 2^52. Adding the latter to a small number rounds it to
+// an integer that appears in the low-order mantissa bits.
+#define APPROX_2P52    4503599627370496.0
+#define APPROX_ROUND   6755399441055744.0
+//
+// The natural logarithm of a positive, normalized number.
+static inline DOUBLE ApproxLog(DOUBLE x)
+{
+  UQUAD u,e;
+  DOUBLE ex,f,big,s,z,p;
+
+  memcpy(&u,&x,sizeof(u));
+  // The biased exponent, as the mantissa of 2^52 + exponent.
+  e       = (u >> 52) | (UQUAD(0x433) << 52);
+  memcpy(&ex,&e,sizeof(ex));
+  ex     -= APPROX_2P52 + 1023.0;
+  u       = (u & ((UQUAD(1) << 52) - 1)) | (UQUAD(1023) << 52);
+  memcpy(&f,&u,sizeof(f)); // now in [1,2)
+  // Move the mantissa into [sqrt(1/2),sqrt(2)).
+  big     = (f > APPROX_SQRT2)?(1.0):(0.0);
+  f      *= 1.0 - 0.5 * big;
+  ex     += big;
+  // log(f) = 2 atanh(s) with |s| < 0.1716.
+  s       = (f - 1.0) / (f + 1.0);
+  z       = s * s;
+  p       = 1.0 / 19.0;
+  p       = p * z + 1.0 / 17.0;
+  p       = p * z + 1.0 / 15.0;
+  p       = p * z + 1.0 / 13.0;
+  p       = p * z + 1.0 / 11.0;
+  p       = p * z + 1.0 /  9.0;
+  p       = p * z + 1.0 /  7.0;
+  p       = p * z + 1.0 /  5.0;
+  p       = p * z + 1.0 /  3.0;
+  p       = p * z + 1.0;
+
+  return ex * APPROX_LN2_HI + (2.0 * s * p + ex * APPROX_LN2_LO);
+}
+//
+// The exponential function of an argument whose absolute value is
+// below 700.
+static inline DOUBLE ApproxExp(DOUBLE t)
+{
+  UQUAD u;
+  DOUBLE k,r,p,s;
+  
+  // t = k ln 2 + r with |r| <= ln 2 / 2. The low-order 32 bits of the
+  // rounded number are k in two's complement.
+  k       = t * APPROX_INV_LN2 + APPROX_ROUND;
+  memcpy(&u,&k,sizeof(u));
+  k       = DOUBLE(LONG(u & 0xffffffffUL));
+  r       = (t - k * APPROX_LN2_HI) - k * APPROX_LN2_LO;
+  p       = 1.0 / 6227020800.0;
+  p       = p * r + 1.0 / 479001600.0;
+  p       = p * r + 1.0 / 39916800.0;
+  p       = p * r + 1.0 / 3628800.0;
+  p       = p * r + 1.0 / 362880.0;
+  p       = p * r + 1.0 / 40320.0;
+  p       = p * r + 1.0 / 5040.0;
+  p       = p * r + 1.0 / 720.0;
+  p       = p * r + 1.0 / 120.0;
+  p       = p * r + 1.0 / 24.0;
+  p       = p * r + 1.0 / 6.0;
+  p       = p * r + 0.5;
+  p       = p * r + 1.0;
+  p       = p * r + 1.0;
+  // 2^k, the exponent bits are the low-order bits of k + 1023.
+  u       = (u + 1023) << 52;
+  memcpy(&s,&u,sizeof(s));
+  
+  return p * s;
+}
+//
+// Approximate the power a^b, and return the exponent b log a in t. The
+// approximation is only valid if a is between 1e-300 and 1e300, and the
+// absolute value of t is below 700.
+static inline DOUBLE ApproxPow(DOUBLE a,DOUBLE b,DOUBLE &t)
+{
+  t = b * ApproxLog(fmin(fmax(a,1e-300),1e300));
+  
+  return ApproxExp(fmin(fmax(t,-700.0),700.0));
+}
+///
+
+/// ParametricToneMappingBox::ApproximateTableValues
+// Approximate the table values, or the inverse table values, of count
+// arguments (first + i) * scale in one go. For each entry, error receives
+// a bound on the absolute error of the approximation, or a negative value
+// if the entry has to be computed exactly. Returns false if there is
+// no approximation for the curve type.
+// The error bounds are very conservative. The curve parameters enter the
+// scalar computation partially in single precision, possibly with excess
+// precision, which is accounted for by a larger relative error where
+// that happens.
+bool ParametricToneMappingBox::ApproximateTableValues(bool inverse,LONG first,DOUBLE scale,ULONG count,
+                                                      DOUBLE *value,DOUBLE *error) const
+{
+  ULONG i;
+  
+  switch(m_Type) {
+  case Gamma:
+    if (inverse) {
+      // The threshold between the linear and the power segment.
+      DOUBLE thres = pow(double(m_fP1 + m_fP3) / (1.0 + m_fP3),double(m_fP2));
+      DOUBLE gamma = 1.0 / m_fP2;
+      DOUBLE p3    = m_fP3;
+      for(i = 0;i < count;i++) {
+        DOUBLE v   = DOUBLE(first + LONG(i)) * scale;
+        DOUBLE t;
+        DOUBLE p   = ApproxPow(v,gamma,t) * (1.0 + p3);
+        value[i]   = p - p3;
+        // Close to the threshold, and in the linear segment, compute exactly.
+        error[i]   = (v - thres > 1e-6 * thres && v <= 1e300 && fabs(t) < 700.0)?(1e-10 * (fabs(p) + fabs(p3))):(-1.0);
+      }
+    } else {
+      DOUBLE p1    = m_fP1;
+      DOUBLE p3    = m_fP3;
+      DOUBLE gamma = m_fP2;
+      for(i = 0;i < count;i++) {
+        DOUBLE v   = DOUBLE(first + LONG(i)) * scale;
+        DOUBLE a   = (v + p3) / (1.0 + p3);
+        DOUBLE t;
+        DOUBLE p   = ApproxPow(a,gamma,t);
+        value[i]   = p;
+        // The linear segment is computed exactly.
+        error[i]   = (v >= p1 && a >= 1e-300 && a <= 1e300 && fabs(t) < 700.0)?(1e-10 * fabs(p)):(-1.0);
+      }
+    }
+    return true;
+  case GammaOffset:
+    if (inverse) {
+      DOUBLE p1    = m_fP1;
+      DOUBLE range = m_fP2 - m_fP1;
+      DOUBLE gamma = 1.0 / m_fP3;
+      DOUBLE tol   = 1e-6 * (1.0 + fabs(gamma));
+      for(i = 0;i < count;i++) {
+        DOUBLE v   = DOUBLE(first + LONG(i)) * scale;
+        DOUBLE a   = (v - p1) / range;
+        DOUBLE t;
+        DOUBLE p   = ApproxPow(a,gamma,t);
+        value[i]   = p;
+        error[i]   = (v > p1 && a >= 1e-300 && a <= 1e300 && fabs(t) < 700.0)?(tol * fabs(p)):(-1.0);
+      }
+    } else {
+      DOUBLE p1    = m_fP1;
+      DOUBLE range = m_fP2 - m_fP1;
+      DOUBLE gamma = m_fP3;
+      for(i = 0;i < count;i++) {
+        DOUBLE v   = DOUBLE(first + LONG(i)) * scale;
+        DOUBLE t;
+        DOUBLE p   = range * ApproxPow(v,gamma,t);
+        value[i]   = p + p1;
+        error[i]   = (v >= 1e-300 && v <= 1e300 && fabs(t) < 700.0)?(1e-6 * (fabs(p) + fabs(p1))):(-1.0);
+      }
+    }
+    return true;
+  default:
+    // All other curves are either cheap to evaluate or are not
+    // approximated.
+    return false;
+  }
+}
+///
+
+/// ParametricToneMappingBox::ComputeTable
+// Fill count entries of an integer table, or an inverse table, for the
+// arguments (first + i) * inscale, scaled by outscale and rounded. This
+// generates exactly the same values as evaluating the curve entry by entry:
+// Entries whose approximation is too close to a rounding boundary are
+// computed exactly. If the library is build with checks enabled, all
+// approximated entries are verified against the exact computation.
+void ParametricToneMappingBox::ComputeTable(LONG *table,ULONG count,LONG first,
+                                            DOUBLE inscale,DOUBLE outscale,bool inverse) const
+{
+  DOUBLE value[256];
+  DOUBLE error[256];
+  ULONG i,j,cnt;
+
+  for(i = 0;i < count;i += cnt) {
+    cnt = count - i;
+    if (cnt > sizeof(value) / sizeof(DOUBLE))
+      cnt = sizeof(value) / sizeof(DOUBLE);
+    if (ApproximateTableValues(inverse,first + LONG(i),inscale,cnt,value,error)) {
+      for(j = 0;j < cnt;j++) {
+        DOUBLE w = outscale * value[j] + 0.5;
+        DOUBLE f = floor(w);
+        DOUBLE m = outscale * error[j] + 1e-12 * fabs(w) + 1e-9;
+        // Is the approximation safely away from the rounding boundaries?
+        if (error[j] >= 0.0 && w - f > m && f + 1.0 - w > m && fabs(w) < 2147483647.0) {
+          table[i + j] = LONG(f);
+#if CHECK_LEVEL > 0
+          {
+            LONG x     = first + LONG(i + j);
+            DOUBLE v   = (inverse)?(InverseTableValue(x * inscale)):(TableValue(x * inscale));
+            assert(table[i + j] == LONG(floor(outscale * v + 0.5)));
+          }
+#endif
+        } else {
+          LONG x       = first + LONG(i + j);
+          DOUBLE v     = (inverse)?(InverseTableValue(x * inscale)):(TableValue(x * inscale));
+          table[i + j] = LONG(floor(outscale * v + 0.5));
+        }
+      }
+    } else {
+      for(j = 0;j < cnt;j++) {
+        LONG x         = first + LONG(i + j);
+        DOUBLE v       = (inverse)?(InverseTableValue(x * inscale)):(TableValue(x * inscale));
+        table[i + j]   = LONG(floor(outscale * v + 0.5));
+      }
+    }
+  }
+}
+///
+
+/// ParametricToneMappingBox::ComputeTable
+// Fill count entries of a floating point table for the arguments
+// i * inscale, scaled by outscale. As above, this generates exactly
+// the same values as evaluating the curve entry by entry.
+void ParametricToneMappingBox::ComputeTable(FLOAT *table,ULONG count,DOUBLE inscale,DOUBLE outscale) const
+{
+  DOUBLE value[256];
+  DOUBLE error[256];
+  ULONG i,j,cnt;
+
+  for(i = 0;i < count;i += cnt) {
+    cnt = count - i;
+    if (cnt > sizeof(value) / sizeof(DOUBLE))
+      cnt = sizeof(value) / sizeof(DOUBLE);
+    if (ApproximateTableValues(false,LONG(i),inscale,cnt,value,error)) {
+      for(j = 0;j < cnt;j++) {
+        DOUBLE w = outscale * value[j];
+        FLOAT  f = FLOAT(w);
+        DOUBLE m = outscale * error[j] + 1e-15 * fabs(w);
+        DOUBLE ulp,lo,d;
+        ULONG  bits;
+        UQUAD  ulpbits;
+        LONG   exp;
+        // Is the approximation safely away from the midpoints to the
+        // neighbouring floats? The unit in the last place follows from
+        // the float exponent, the spacing below a power of two is only
+        // half the spacing above.
+        memcpy(&bits,&f,sizeof(bits));
+        exp     = LONG((bits >> 23) & 0xff);
+        ulpbits = UQUAD(exp - 150 + 1023) << 52;
+        memcpy(&ulp,&ulpbits,sizeof(ulp));
+        lo      = (bits & ((1UL << 23) - 1))?(0.5 * ulp):(0.25 * ulp);
+        d       = fabs(w) - fabs(f);
+        if (error[j] >= 0.0 && exp > 1 && exp < 254 && (w > 0.0) == (f > 0.0) &&
+            d < 0.5 * ulp - m && -d < lo - m) {
+          table[i + j] = f;
+#if CHECK_LEVEL > 0
+          {
+            // Compare through memory, the float may carry excess precision.
+            FLOAT v = outscale * TableValue((i + j) * inscale);
+            assert(memcmp(&v,table + i + j,sizeof(FLOAT)) == 0);
+          }
+#endif
+        } else {
+          table[i + j] = outscale * TableValue((i + j) * inscale);
+        }
+      }
+    } else {
+      for(j = 0;j < cnt;j++) {
+        table[i + j]   = outscale * TableValue((i + j) * inscale);
+      }
+    }
+  }
+}
+///
+
 /// ParametricToneMappingBox::FindImpl
 // Find the table for the given number of dct, spatial and fractional bits and return
 // the table implementation, or NULL in case it does not (yet) exist.
@@ -392,6 +676,63 @@ struct ParametricToneMappingBox::TableImpl *ParametricToneMappingBox::FindImpl(U
 }
 ///
 
+/// ParametricToneMappingBox::CacheKeyOf
+// Fill in the key of the table of the given kind for the given
+// implementation.
+void ParametricToneMappingBox::CacheKeyOf(struct CacheKey &key,TableKind kind,const struct TableImpl *impl) const
+{
+  // Clear the padding, the key is compared bytewise.
+  memset(&key,0,sizeof(key));
+  key.m_fP1            = m_fP1;
+  key.m_fP2            = m_fP2;
+  key.m_fP3            = m_fP3;
+  key.m_fP4            = m_fP4;
+  key.m_ulInputOffset  = impl->m_ulInputOffset;
+  key.m_ucKind         = kind;
+  key.m_ucType         = m_Type;
+  key.m_ucE            = m_ucE;
+  key.m_ucInputBits    = impl->m_ucInputBits;
+  key.m_ucOutputBits   = impl->m_ucOutputBits;
+  key.m_ucInputFracts  = impl->m_ucInputFracts;
+  key.m_ucOutputFracts = impl->m_ucOutputFracts;
+  key.m_ucTableBits    = impl->m_ucTableBits;
+}
+///
+
+/// ParametricToneMappingBox::FindCachedTable
+// Return the table of the given kind for the given implementation
+// from the table cache, or NULL if it has not been computed yet.
+const void *ParametricToneMappingBox::FindCachedTable(TableKind kind,const struct TableImpl *impl) const
+{
+  struct CacheKey key;
+
+  CacheKeyOf(key,kind,impl);
+
+  return TableCache::Find(&key,sizeof(key));
+}
+///
+
+/// ParametricToneMappingBox::ShareTable
+// Offer a table of the given kind and size in bytes to the table
+// cache. If the cache takes it, the given table is released and the
+// cached copy is returned. Otherwise, the table is returned as is.
+const void *ParametricToneMappingBox::ShareTable(TableKind kind,struct TableImpl *impl,void *table,ULONG size)
+{
+  struct CacheKey key;
+  const void *shared;
+
+  CacheKeyOf(key,kind,impl);
+
+  shared = TableCache::Insert(&key,sizeof(key),table,size);
+  if (shared) {
+    m_pEnviron->FreeMem(table,size);
+    impl->m_ucShared |= kind;
+    return shared;
+  }
+
+  return table;
+}
+///
 
 /// ParametricToneMappingBox::ScaleTableOf
 // Same as above, but this is the scaled version with
@@ -407,31 +748,34 @@ const LONG *ParametricToneMappingBox::ScaledTableOf(UBYTE inputbits,UBYTE output
   }
 
   if (impl->m_plTable == NULL) {
-    ULONG i    = 0;
     ULONG max  = 1UL << (inputbits  + inputfract);
     //LONG omax  = 1UL << (outputbits + outputfract);
     double inscale  = (inputbits  > 1)?(1.0 / (((1UL <<  inputbits) - m_ucE) <<  inputfract)):(1.0 / (1 <<  inputfract));
     double outscale = (outputbits > 1)?(1.0 * (((1UL << outputbits) - m_ucE) << outputfract)):(1.0 * (1 << outputfract));
     
+    LONG *table;
+    
     assert(inputbits  <= 16);
     assert(outputbits <= 16);
     assert(impl->m_ulTableEntries == 0 || impl->m_ulTableEntries == max);
     
     impl->m_ulTableEntries = max;
-    impl->m_plTable        = (LONG *)m_pEnviron->AllocMem(max * sizeof(LONG));
-
-    do {
-      LONG out = LONG(floor(outscale * TableValue(i * inscale)+0.5));
-      /*
-      ** The standard does not say anything about clamping, so
-      ** don't clamp. Previous versions (1.40 and above) did clamp,
-      ** but profile 2, R2-tables require full range.
-      if (out < 0)     out = 0;
-      if (out >= omax) out = omax - 1;
-      **
-      */
-      impl->m_plTable[i]   = out;
-    } while(++i < max);
+    impl->m_plTable        = (const LONG *)FindCachedTable(ScaledTable,impl);
+    if (impl->m_plTable) {
+      impl->m_ucShared    |= ScaledTable;
+      return impl->m_plTable;
+    }
+    
+    table = (LONG *)m_pEnviron->AllocMem(max * sizeof(LONG));
+    impl->m_plTable        = table;
+    /*
+    ** The standard does not say anything about clamping, so
+    ** don't clamp. Previous versions (1.40 and above) did clamp,
+    ** but profile 2, R2-tables require full range.
+    */
+    ComputeTable(table,max,0,inscale,outscale,false);
+    
+    impl->m_plTable        = (const LONG *)ShareTable(ScaledTable,impl,table,max * sizeof(LONG));
   } 
   
   return impl->m_plTable;
@@ -451,29 +795,33 @@ const FLOAT *ParametricToneMappingBox::FloatTableOf(UBYTE inputbits,UBYTE output
   }
 
   if (impl->m_pfTable == NULL) {
-    ULONG i    = 0;
     ULONG max  = 1UL << (inputbits  + inputfract);
     //LONG omax  = 1UL << (outputbits + outputfract);
     //FLOAT fmax = FLOAT(omax - 1);
     double inscale  = (inputbits  > 1)?(1.0 / (((1UL <<  inputbits) - m_ucE) <<  inputfract)):(1.0 / (1 <<  inputfract));
     double outscale = (outputbits > 1)?(1.0 * (((1UL << outputbits) - m_ucE) << outputfract)):(1.0 * (1 << outputfract));
     
+    FLOAT *table;
+    
     assert(inputbits  <= 16);
     assert(outputbits <= 16);
     assert(impl->m_ulTableEntries == 0 || impl->m_ulTableEntries == max);
     
     impl->m_ulTableEntries = max;
-    impl->m_pfTable        = (FLOAT *)m_pEnviron->AllocMem(max * sizeof(FLOAT));
-
-    do {
-      FLOAT out = outscale * TableValue(i * inscale);
-      /*
-      ** The specs do not say a word about clamping, so we don't.
-      if (out < 0.0)   out = 0.0;
-      if (out > fmax)  out = fmax;
-      */
-      impl->m_pfTable[i]   = out;
-    } while(++i < max);
+    impl->m_pfTable        = (const FLOAT *)FindCachedTable(FloatTable,impl);
+    if (impl->m_pfTable) {
+      impl->m_ucShared    |= FloatTable;
+      return impl->m_pfTable;
+    }
+    
+    table = (FLOAT *)m_pEnviron->AllocMem(max * sizeof(FLOAT));
+    impl->m_pfTable        = table;
+    /*
+    ** The specs do not say a word about clamping, so we don't.
+    */
+    ComputeTable(table,max,inscale,outscale);
+    
+    impl->m_pfTable        = (const FLOAT *)ShareTable(FloatTable,impl,table,max * sizeof(FLOAT));
   } 
   
   return impl->m_pfTable;
@@ -507,18 +855,27 @@ const LONG *ParametricToneMappingBox::ExtendedInverseScaledTableOf(UBYTE dctbits
     double inscale  = (spatialbits > 1)?(1.0 / (((1UL << spatialbits) - m_ucE) << spatialfract)):(1.0 / (1 << spatialfract));
     double outscale = (dctbits     > 1)?(1.0 * (((1UL << dctbits    ) - m_ucE) << dctfract    )):(1.0 * (1 << dctfract));
 
+    LONG *table;
+
     assert(dctbits <= 16);
     assert(spatialbits <= 16);
 
     impl->m_ulInverseTableEntries = max;
-    impl->m_plInverseTable        = (LONG *)m_pEnviron->AllocMem(max * sizeof(LONG));
+    impl->m_plInverseTable        = (const LONG *)FindCachedTable(InverseTable,impl);
+    if (impl->m_plInverseTable) {
+      impl->m_ucShared           |= InverseTable;
+      return impl->m_plInverseTable;
+    }
 
+    table = (LONG *)m_pEnviron->AllocMem(max * sizeof(LONG));
+    impl->m_plInverseTable        = table;
+    ComputeTable(table,max,-LONG(offset),inscale,outscale,true);
     do {
-      LONG out = LONG(floor(outscale * InverseTableValue((i - LONG(offset)) * inscale)+0.5));
-      if (out < 0)     out = 0;
-      if (out >= omax) out = omax - 1;
-      impl->m_plInverseTable[i] = out;
+      if (table[i] < 0)     table[i] = 0;
+      if (table[i] >= omax) table[i] = omax - 1;
     } while(++i < max);
+
+    impl->m_plInverseTable        = (const LONG *)ShareTable(InverseTable,impl,table,max * sizeof(LONG));
   }
 
   return impl->m_plInverseTable;
@@ -80,13 +80,13 @@ class ParametricToneMappingBox : public ToneMapperBox {
     struct TableImpl *m_pNext;
     //
     // The integer scaled version of the table.
-    LONG  *m_plTable;
+    const LONG  *m_plTable;
     //
     // The inverse integer scaled version of the table.
-    LONG  *m_plInverseTable;
+    const LONG  *m_plInverseTable;
     //
     // Floating point version of the table if required.
-    FLOAT *m_pfTable;
+    const FLOAT *m_pfTable;
     //
     // Size of the table in entries.
     ULONG  m_ulTableEntries;
@@ -102,13 +102,17 @@ class ParametricToneMappingBox : public ToneMapperBox {
     ULONG  m_ulInputOffset; // additional offset to be added to the input before applying the LUT
     UBYTE  m_ucTableBits;   // 1<<m_cuTableBits gives the size of the table.
     //
+    // A bitmask of the tables above that are owned by the table cache
+    // and must not be released here, bits are the TableKind values.
+    UBYTE  m_ucShared;
+    //
     TableImpl(UBYTE inbits,UBYTE outbits,UBYTE infract,UBYTE outfract,
               ULONG offset,UBYTE tablebits)
       : m_pNext(NULL), m_plTable(NULL), m_plInverseTable(NULL), m_pfTable(NULL), 
         m_ulTableEntries(0), m_ulInverseTableEntries(0),
         m_ucInputBits(inbits), m_ucOutputBits(outbits), 
         m_ucInputFracts(infract), m_ucOutputFracts(outfract),
-        m_ulInputOffset(offset), m_ucTableBits(tablebits)
+        m_ulInputOffset(offset), m_ucTableBits(tablebits), m_ucShared(0)
     { } 
     //
     // For non-extended tables, this is the simpler constructor.
@@ -117,10 +121,32 @@ class ParametricToneMappingBox : public ToneMapperBox {
         m_ulTableEntries(0), m_ulInverseTableEntries(0),
         m_ucInputBits(inbits), m_ucOutputBits(outbits), 
         m_ucInputFracts(infract), m_ucOutputFracts(outfract),
-        m_ulInputOffset(0), m_ucTableBits(outbits)
+        m_ulInputOffset(0), m_ucTableBits(outbits), m_ucShared(0)
     { }
   }        *m_pImpls;
   //
+  // The tables a TableImpl may hold, used as bits of m_ucShared.
+  enum TableKind {
+    ScaledTable  = 1,
+    FloatTable   = 2,
+    InverseTable = 4
+  };
+  //
+  // The key under which the tables are kept in the process-wide table
+  // cache: All parameters the table entries depend on.
+  struct CacheKey {
+    FLOAT  m_fP1,m_fP2,m_fP3,m_fP4;
+    ULONG  m_ulInputOffset;
+    UBYTE  m_ucKind;
+    UBYTE  m_ucType;
+    UBYTE  m_ucE;
+    UBYTE  m_ucInputBits;
+    UBYTE  m_ucOutputBits;
+    UBYTE  m_ucInputFracts;
+    UBYTE  m_ucOutputFracts;
+    UBYTE  m_ucTableBits;
+  };
+  //
   // The curve type.
 public:
   enum CurveType {
@@ -161,6 +187,23 @@ private:
   // Return the table value of the inverse table. If it exists.
   DOUBLE InverseTableValue(DOUBLE v) const;
   //
+  // Approximate the table values, or the inverse table values, of count
+  // arguments (first + i) * scale in one go. For each entry, error receives
+  // a bound on the absolute error of the approximation, or a negative value
+  // if the entry has to be computed exactly. Returns false if there is
+  // no approximation for the curve type.
+  bool ApproximateTableValues(bool inverse,LONG first,DOUBLE scale,ULONG count,
+                              DOUBLE *value,DOUBLE *error) const;
+  //
+  // Fill count entries of an integer table, or an inverse table, for the
+  // arguments (first + i) * inscale, scaled by outscale and rounded. This
+  // generates exactly the same values as evaluating the curve entry by entry.
+  void ComputeTable(LONG *table,ULONG count,LONG first,DOUBLE inscale,DOUBLE outscale,bool inverse) const;
+  //
+  // Fill count entries of a floating point table for the arguments
+  // i * inscale, scaled by outscale.
+  void ComputeTable(FLOAT *table,ULONG count,DOUBLE inscale,DOUBLE outscale) const;
+  //
   // Find the table for the given number of dct, spatial and fractional bits and return
   // the table implementation, or NULL in case it does not (yet) exist.
   struct TableImpl *FindImpl(UBYTE dctbits,UBYTE spatialbits,UBYTE dctfract,UBYTE spatialfract)
@@ -172,6 +215,19 @@ private:
   struct TableImpl *FindImpl(UBYTE dctbits,UBYTE spatialbits,UBYTE dctfract,UBYTE spatialfract,
                              ULONG offset,UBYTE tablebits) const;
   //
+  // Fill in the key of the table of the given kind for the given
+  // implementation.
+  void CacheKeyOf(struct CacheKey &key,TableKind kind,const struct TableImpl *impl) const;
+  //
+  // Return the table of the given kind for the given implementation
+  // from the table cache, or NULL if it has not been computed yet.
+  const void *FindCachedTable(TableKind kind,const struct TableImpl *impl) const;
+  //
+  // Offer a table of the given kind and size in bytes to the table
+  // cache. If the cache takes it, the given table is released and the
+  // cached copy is returned. Otherwise, the table is returned as is.
+  const void *ShareTable(TableKind kind,struct TableImpl *impl,void *table,ULONG size);
+  //
 public:
   enum {
     Type = MAKE_ID('C','U','R','V')
@@ -0,0 +1,363 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This module implements the batch mode of the command line tool.
+** It reads a manifest of jobs, one per line, and runs them in a
+** single process, optionally on a pool of worker threads.
+**
+** Each job is parsed exactly like a command line by ProcessCommandLine,
+** and constructs its own JPEG object. Jobs do not share any state
+** except for the process, hence they can run concurrently.
+**
+*/
+
+/// Includes
+#include "cmd/batch.hpp"
+#include "cmd/main.hpp"
+#include "std/stdio.hpp"
+#include "std/stdlib.hpp"
+#include "std/string.hpp"
+#include "std/ctype.hpp"
+#if defined(USE_MULTITHREADING) && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define BATCH_THREADS 1
+#endif
+///
+
+/// Defines
+// Maximum number of arguments per manifest line.
+#define MAX_JOB_ARGS 256
+///
+
+/// struct BatchJob
+// A single line of the manifest, broken up into arguments.
+struct BatchJob {
+  // The line this job came from, for error reporting.
+  int    bj_iLine;
+  // Number of arguments including the dummy program name.
+  int    bj_iArgc;
+  // The arguments, NULL terminated as argv is.
+  char **bj_ppArgv;
+  // The return code of the job.
+  int    bj_iResult;
+};
+///
+
+/// struct BatchQueue
+// The shared state of all workers: The list of jobs and the index
+// of the next job to pick up.
+struct BatchQueue {
+  struct BatchJob *bq_pJobs;
+  int              bq_iJobs;
+  int              bq_iNext;
+#ifdef BATCH_THREADS
+  pthread_mutex_t  bq_Lock;
+#endif
+};
+///
+
+/// ReadManifest
+// Read the complete manifest into memory. Returns NULL on failure.
+static char *ReadManifest(const char *manifest)
+{
+  FILE *in = fopen(manifest,"rb");
+  char *buffer = NULL;
+
+  if (in) {
+    long size;
+    if (fseek(in,0,SEEK_END) == 0 && (size = ftell(in)) >= 0 && fseek(in,0,SEEK_SET) == 0) {
+      buffer = (char *)malloc(size + 1);
+      if (buffer) {
+        if (fread(buffer,1,size,in) == size_t(size)) {
+          buffer[size] = 0;
+        } else {
+          fprintf(stderr,"failed to read the manifest file %s\n",manifest);
+          free(buffer);
+          buffer = NULL;
+        }
+      } else {
+        fprintf(stderr,"unable to allocate memory for the manifest file\n");
+      }
+    } else {
+      perror("unable to determine the size of the manifest file");
+    }
+    fclose(in);
+  } else {
+    perror("unable to open the manifest file");
+  }
+
+  return buffer;
+}
+///
+
+/// SplitLine
+// Split a single line into arguments in place. The line is modified
+// and NUL-terminated. Returns the number of arguments found, or -1
+// if there are too many arguments.
+static int SplitLine(char *line,char **args,int max)
+{
+  int count = 0;
+
+  for(;;) {
+    while(*line && isspace(UBYTE(*line)))
+      line++;
+    if (*line == 0)
+      break;
+    if (count >= max)
+      return -1;
+    if (*line == '"') {
+      // A quoted argument, runs up to the closing quote.
+      args[count++] = ++line;
+      while(*line && *line != '"')
+        line++;
+    } else {
+      args[count++] = line;
+      while(*line && !isspace(UBYTE(*line)))
+        line++;
+    }
+    if (*line == 0)
+      break;
+    *line++ = 0;
+  }
+
+  return count;
+}
+///
+
+/// ParseManifest
+// Break the manifest up into jobs. Returns the number of jobs, or -1
+// on an error. The jobs reference the manifest buffer.
+static int ParseManifest(char *buffer,struct BatchJob *&jobs)
+{
+  static char progname[] = "jpeg";
+  char *args[MAX_JOB_ARGS];
+  char *line;
+  int lines = 1;
+  int count = 0;
+  int lineno;
+
+  // Count the lines first to get an upper bound for the jobs.
+  for(line = buffer;*line;line++) {
+    if (*line == '\n')
+      lines++;
+  }
+
+  jobs = (struct BatchJob *)malloc(sizeof(struct BatchJob) * lines);
+  if (jobs == NULL) {
+    fprintf(stderr,"unable to allocate memory for the batch jobs\n");
+    return -1;
+  }
+
+  line = buffer;
+  for(lineno = 1;line;lineno++) {
+    char *next = strchr(line,'\n');
+    int argc;
+    if (next)
+      *next++ = 0;
+    // Remove a trailing carriage return from DOS line ends.
+    if (*line && line[strlen(line) - 1] == '\r')
+      line[strlen(line) - 1] = 0;
+    //
+    // Skip leading blanks and comments.
+    while(*line && isspace(UBYTE(*line)))
+      line++;
+    if (*line && *line != '#') {
+      // The first argument is reserved for the program name.
+      argc = SplitLine(line,args + 1,MAX_JOB_ARGS - 2);
+      if (argc < 0) {
+        fprintf(stderr,"too many arguments in line %d of the manifest\n",lineno);
+        break;
+      }
+      if (argc < 2) {
+        fprintf(stderr,"line %d of the manifest requires at least a source and a target\n",lineno);
+        break;
+      }
+      argc++;
+      jobs[count].bj_iLine   = lineno;
+      jobs[count].bj_iArgc   = argc;
+      jobs[count].bj_iResult = 0;
+      jobs[count].bj_ppArgv  = (char **)malloc(sizeof(char *) * (argc + 1));
+      if (jobs[count].bj_ppArgv == NULL) {
+        fprintf(stderr,"unable to allocate memory for the batch jobs\n");
+        break;
+      }
+      args[0]    = progname;
+      args[argc] = NULL;
+      memcpy(jobs[count].bj_ppArgv,args,sizeof(char *) * (argc + 1));
+      count++;
+    }
+    line = next;
+  }
+
+  if (line) {
+    // Aborted with an error.
+    while(count) {
+      free(jobs[--count].bj_ppArgv);
+    }
+    free(jobs);
+    jobs = NULL;
+    return -1;
+  }
+  
+  return count;
+}
+///
+
+/// NextJob
+// Return the next job to be run, or NULL if all jobs are taken.
+static struct BatchJob *NextJob(struct BatchQueue *queue)
+{
+  struct BatchJob *job = NULL;
+
+#ifdef BATCH_THREADS
+  pthread_mutex_lock(&queue->bq_Lock);
+#endif
+  if (queue->bq_iNext < queue->bq_iJobs)
+    job = queue->bq_pJobs + queue->bq_iNext++;
+#ifdef BATCH_THREADS
+  pthread_mutex_unlock(&queue->bq_Lock);
+#endif
+
+  return job;
+}
+///
+
+/// BatchWorker
+// The worker: Picks jobs from the queue until it runs dry.
+static void *BatchWorker(void *data)
+{
+  struct BatchQueue *queue = (struct BatchQueue *)data;
+  struct BatchJob   *job;
+
+  while((job = NextJob(queue))) {
+    job->bj_iResult = ProcessCommandLine(job->bj_iArgc,job->bj_ppArgv);
+  }
+
+  return NULL;
+}
+///
+
+/// RunBatch
+// Run all jobs in the given manifest file on the given number of
+// threads. Returns zero if all jobs ran successfully, otherwise the
+// return code of the first failing job.
+int RunBatch(const char *manifest,int threads)
+{
+  struct BatchQueue queue;
+  char *buffer = ReadManifest(manifest);
+  int result   = 20;
+  int failed   = 0;
+  int i;
+
+  if (buffer == NULL)
+    return result;
+
+  queue.bq_iJobs = ParseManifest(buffer,queue.bq_pJobs);
+  queue.bq_iNext = 0;
+  
+  if (queue.bq_iJobs >= 0) {
+    if (threads > queue.bq_iJobs)
+      threads = queue.bq_iJobs;
+#ifdef BATCH_THREADS
+    if (threads > 1) {
+      pthread_t *workers = (pthread_t *)malloc(sizeof(pthread_t) * threads);
+      int started = 0;
+      pthread_mutex_init(&queue.bq_Lock,NULL);
+      if (workers) {
+        for(started = 0;started < threads;started++) {
+          if (pthread_create(workers + started,NULL,&BatchWorker,&queue))
+            break;
+        }
+      }
+      if (started < threads)
+        fprintf(stderr,"could only start %d out of %d worker threads\n",started,threads);
+      // The main thread helps out, in particular if no workers could be started.
+      BatchWorker(&queue);
+      for(i = 0;i < started;i++) {
+        pthread_join(workers[i],NULL);
+      }
+      pthread_mutex_destroy(&queue.bq_Lock);
+      free(workers);
+    } else {
+      pthread_mutex_init(&queue.bq_Lock,NULL);
+      BatchWorker(&queue);
+      pthread_mutex_destroy(&queue.bq_Lock);
+    }
+#else
+    if (threads > 1)
+      fprintf(stderr,"multithreading is not available in this build, running the jobs sequentially\n");
+    BatchWorker(&queue);
+#endif
+    //
+    // Report failures in the order of the manifest.
+    result = 0;
+    for(i = 0;i < queue.bq_iJobs;i++) {
+      if (queue.bq_pJobs[i].bj_iResult) {
+        fprintf(stderr,"job in line %d of the manifest failed with code %d\n",
+                queue.bq_pJobs[i].bj_iLine,queue.bq_pJobs[i].bj_iResult);
+        if (result == 0)
+          result = queue.bq_pJobs[i].bj_iResult;
+        failed++;
+      }
+      free(queue.bq_pJobs[i].bj_ppArgv);
+    }
+    if (failed)
+      fprintf(stderr,"%d out of %d jobs failed\n",failed,queue.bq_iJobs);
+    free(queue.bq_pJobs);
+  }
+  
+  free(buffer);
+
+  return result;
+}
+///
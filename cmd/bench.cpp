@@ -0,0 +1,889 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This module implements the benchmark mode of the command line tool.
+** It runs encoding and decoding over a matrix of coding options on
+** synthetic and user supplied images and reports the throughput.
+**
+** All images are loaded into memory before the measurement starts,
+** and each run calls the library directly with a bitmap hook and an
+** IO hook operating on memory. The timings thus do not include any
+** file I/O. The time spent in the individual processing stages is
+** taken from the instrumentation of the library.
+**
+*/
+
+/// Includes
+#include "cmd/bench.hpp"
+#include "cmd/iohelpers.hpp"
+#include "cmd/tmo.hpp"
+#include "interface/types.hpp"
+#include "interface/hooks.hpp"
+#include "interface/tagitem.hpp"
+#include "interface/parameters.hpp"
+#include "interface/jpeg.hpp"
+#include "tools/traits.hpp"
+#include "std/stdio.hpp"
+#include "std/stdlib.hpp"
+#include "std/string.hpp"
+#include "std/math.hpp"
+#if defined(HAVE_GETTIMEOFDAY) && defined(HAVE_SYS_TIME_H)
+#include <sys/time.h>
+#define BENCH_GETTIMEOFDAY 1
+#else
+#include <time.h>
+#endif
+///
+
+/// Defines
+// Maximum number of user supplied images.
+#define MAX_BENCH_IMAGES 64
+// The gamma of the inverse tone mapping used for all HDR cases.
+#define BENCH_GAMMA 2.4
+///
+
+/// Image classes
+// The coding options that are applicable to an image depend on its
+// sample type.
+enum BenchClass {
+  Bench_LDR     = 1, // eight bits per sample
+  Bench_HighBit = 2, // more than eight bits per sample, integer
+  Bench_Float   = 4  // floating point samples
+};
+///
+
+/// struct BenchCase
+// One entry of the benchmark matrix. The entries mirror the command
+// line options given in the comments.
+struct BenchCase {
+  // Name of the case as printed in the report.
+  const char *bc_pcName;
+  // The image classes this case applies to.
+  int         bc_iClass;
+  // The frame types of the legacy and the residual image.
+  LONG        bc_lFrameType;
+  LONG        bc_lResidualType;
+  // Quality of the legacy and the residual image, the latter is
+  // negative if there is no residual image.
+  int         bc_iQuality;
+  int         bc_iHDRQuality;
+  // Number of refinement bits.
+  int         bc_iHiddenBits;
+  // The restart interval in MCUs, or zero.
+  int         bc_iRestart;
+  // If set, the chroma components are subsampled 2x2.
+  bool        bc_bSubsampled;
+};
+///
+
+/// BenchMatrix
+// The coding options that are run on all images of the matching class.
+static const struct BenchCase BenchMatrix[] = {
+  // -q 85
+  {"baseline 444",          Bench_LDR,
+   JPGFLAG_SEQUENTIAL,JPGFLAG_SEQUENTIAL,85,-1,0,0,false},
+  // -q 85 -s 1x1,2x2,2x2
+  {"baseline 420",          Bench_LDR,
+   JPGFLAG_SEQUENTIAL,JPGFLAG_SEQUENTIAL,85,-1,0,0,true},
+  // -q 85 -h -s 1x1,2x2,2x2
+  {"baseline 420 opt",      Bench_LDR,
+   JPGFLAG_SEQUENTIAL | JPGFLAG_OPTIMIZE_HUFFMAN,JPGFLAG_SEQUENTIAL,85,-1,0,0,true},
+  // -q 85 -z 4 -s 1x1,2x2,2x2
+  {"baseline 420 rst",      Bench_LDR,
+   JPGFLAG_SEQUENTIAL,JPGFLAG_SEQUENTIAL,85,-1,0,4,true},
+  // -q 85 -h -z 4 -s 1x1,2x2,2x2
+  {"baseline 420 opt rst",  Bench_LDR,
+   JPGFLAG_SEQUENTIAL | JPGFLAG_OPTIMIZE_HUFFMAN,JPGFLAG_SEQUENTIAL,85,-1,0,4,true},
+  // -q 85 -v -h
+  {"progressive 444",       Bench_LDR,
+   JPGFLAG_PROGRESSIVE | JPGFLAG_OPTIMIZE_HUFFMAN,JPGFLAG_SEQUENTIAL,85,-1,0,0,false},
+  // -q 85 -v -h -s 1x1,2x2,2x2
+  {"progressive 420",       Bench_LDR,
+   JPGFLAG_PROGRESSIVE | JPGFLAG_OPTIMIZE_HUFFMAN,JPGFLAG_SEQUENTIAL,85,-1,0,0,true},
+  // -q 85 -R 4 -h
+  {"refinement 444",        Bench_HighBit,
+   JPGFLAG_SEQUENTIAL | JPGFLAG_OPTIMIZE_HUFFMAN,JPGFLAG_SEQUENTIAL,85,-1,4,0,false},
+  // -q 85 -Q 90 -r -h
+  {"residual 444",          Bench_HighBit,
+   JPGFLAG_SEQUENTIAL | JPGFLAG_OPTIMIZE_HUFFMAN | JPGFLAG_RESIDUAL_CODING,JPGFLAG_SEQUENTIAL,
+   85,90,0,0,false},
+  // -q 85 -Q 90 -r -h -s 1x1,2x2,2x2 -sr 1x1,2x2,2x2
+  {"residual 420",          Bench_HighBit,
+   JPGFLAG_SEQUENTIAL | JPGFLAG_OPTIMIZE_HUFFMAN | JPGFLAG_RESIDUAL_CODING,JPGFLAG_SEQUENTIAL,
+   85,90,0,0,true},
+#if ISO_CODE
+  // -q 85 -Q 90 -profile c -r
+  {"profile C 444",         Bench_Float,
+   JPGFLAG_SEQUENTIAL | JPGFLAG_RESIDUAL_CODING,JPGFLAG_SEQUENTIAL,85,90,0,0,false},
+  // -q 85 -Q 90 -profile c -r -s 1x1,2x2,2x2 -sr 1x1,2x2,2x2
+  {"profile C 420",         Bench_Float,
+   JPGFLAG_SEQUENTIAL | JPGFLAG_RESIDUAL_CODING,JPGFLAG_SEQUENTIAL,85,90,0,0,true},
+  // -q 85 -Q 90 -profile c -r -h -z 4
+  {"profile C 444 opt rst", Bench_Float,
+   JPGFLAG_SEQUENTIAL | JPGFLAG_OPTIMIZE_HUFFMAN | JPGFLAG_RESIDUAL_CODING,JPGFLAG_SEQUENTIAL,
+   85,90,0,4,false},
+  // -q 85 -Q 90 -profile c -r -v -h
+  {"profile C progressive", Bench_Float,
+   JPGFLAG_PROGRESSIVE | JPGFLAG_OPTIMIZE_HUFFMAN | JPGFLAG_RESIDUAL_CODING,JPGFLAG_SEQUENTIAL,
+   85,90,0,0,false},
+#endif
+  {NULL,0,0,0,0,0,0,0,false}
+};
+///
+
+/// Stage names
+// Names of the stages measured by the instrumentation.
+static const char *StageNames[JPGFLAG_STATS_STAGES] = {
+  "entropy decoding",
+  "entropy encoding",
+  "forward DCT",
+  "inverse DCT",
+  "upsampling",
+  "downsampling",
+  "color transformation",
+  "bitmap hook"
+};
+///
+
+/// struct BenchImage
+// A source image of the benchmark, held in memory.
+struct BenchImage {
+  // The name of the image as printed in the report.
+  char   bi_cName[32];
+  // Dimensions and sample layout.
+  int    bi_iWidth;
+  int    bi_iHeight;
+  int    bi_iDepth;
+  int    bi_iPrecision;
+  bool   bi_bFloat;
+  // The class of the image.
+  int    bi_iClass;
+  // The interleaved samples. These are UBYTEs for eight bit images,
+  // and UWORDs otherwise. Floating point samples are kept as half
+  // floats.
+  APTR   bi_pData;
+};
+///
+
+/// struct BenchStream
+// The memory the codestream is written to and read from.
+struct BenchStream {
+  UBYTE *bs_pucBuffer;
+  ULONG  bs_ulSize;
+  ULONG  bs_ulAllocated;
+  ULONG  bs_ulPos;
+};
+///
+
+/// struct BenchBitmap
+// The image a bitmap hook operates on.
+struct BenchBitmap {
+  APTR   bb_pData;
+  ULONG  bb_ulWidth;
+  ULONG  bb_ulHeight;
+  UWORD  bb_usDepth;
+  UBYTE  bb_ucPixelType;
+};
+///
+
+/// struct BenchResult
+// The time of the fastest run of a job, and the per-stage times in
+// microseconds as reported by the instrumentation for this run.
+struct BenchResult {
+  double   br_dTime;
+  JPG_LONG br_lStageTime[JPGFLAG_STATS_STAGES];
+};
+///
+
+/// Now
+// Return a time stamp in seconds.
+static double Now(void)
+{
+#ifdef BENCH_GETTIMEOFDAY
+  struct timeval tv;
+
+  gettimeofday(&tv,NULL);
+
+  return double(tv.tv_sec) + double(tv.tv_usec) * 1e-6;
+#else
+  return double(clock()) / CLOCKS_PER_SEC;
+#endif
+}
+///
+
+/// BenchStreamHook
+// The IO hook operating on the memory stream.
+static JPG_LONG BenchStreamHook(struct JPG_Hook *hook,struct JPG_TagItem *tags)
+{
+  struct BenchStream *stream = (struct BenchStream *)(hook->hk_pData);
+  UBYTE *buffer              = (UBYTE *)tags->GetTagPtr(JPGTAG_FIO_BUFFER);
+  ULONG  size                = (ULONG  )tags->GetTagData(JPGTAG_FIO_SIZE);
+
+  switch(tags->GetTagData(JPGTAG_FIO_ACTION)) {
+  case JPGFLAG_ACTION_READ:
+    if (stream->bs_ulPos >= stream->bs_ulSize)
+      return 0;
+    if (size > stream->bs_ulSize - stream->bs_ulPos)
+      size = stream->bs_ulSize - stream->bs_ulPos;
+    memcpy(buffer,stream->bs_pucBuffer + stream->bs_ulPos,size);
+    stream->bs_ulPos += size;
+    return size;
+  case JPGFLAG_ACTION_WRITE:
+    if (stream->bs_ulPos + size > stream->bs_ulAllocated) {
+      ULONG  allocated = (stream->bs_ulAllocated)?(stream->bs_ulAllocated):(65536);
+      UBYTE *grown;
+      while(stream->bs_ulPos + size > allocated)
+        allocated <<= 1;
+      grown = (UBYTE *)realloc(stream->bs_pucBuffer,allocated);
+      if (grown == NULL)
+        return -1;
+      stream->bs_pucBuffer   = grown;
+      stream->bs_ulAllocated = allocated;
+    }
+    memcpy(stream->bs_pucBuffer + stream->bs_ulPos,buffer,size);
+    stream->bs_ulPos += size;
+    if (stream->bs_ulPos > stream->bs_ulSize)
+      stream->bs_ulSize = stream->bs_ulPos;
+    return size;
+  case JPGFLAG_ACTION_SEEK:
+    {
+      LONG offset = tags->GetTagData(JPGTAG_FIO_OFFSET);
+      LONG base;
+      switch(tags->GetTagData(JPGTAG_FIO_SEEKMODE)) {
+      case JPGFLAG_OFFSET_CURRENT:
+        base = stream->bs_ulPos;
+        break;
+      case JPGFLAG_OFFSET_BEGINNING:
+        base = 0;
+        break;
+      case JPGFLAG_OFFSET_END:
+        base = stream->bs_ulSize;
+        break;
+      default:
+        return -1;
+      }
+      if (base + offset < 0 || ULONG(base + offset) > stream->bs_ulSize)
+        return -1;
+      stream->bs_ulPos = base + offset;
+      return 0;
+    }
+  case JPGFLAG_ACTION_QUERY:
+    return 0;
+  }
+  return -1;
+}
+///
+
+/// BenchBitmapHook
+// The bitmap hook for images in memory. As in the regular bitmap hook,
+// the data is made available in stripes of eight lines.
+static JPG_LONG BenchBitmapHook(struct JPG_Hook *hook,struct JPG_TagItem *tags)
+{
+  struct BenchBitmap *bmp = (struct BenchBitmap *)(hook->hk_pData);
+  UWORD comp              = tags->GetTagData(JPGTAG_BIO_COMPONENT);
+  ULONG miny              = tags->GetTagData(JPGTAG_BIO_MINY);
+  ULONG sample            = bmp->bb_ucPixelType & CTYP_SIZE_MASK;
+
+  if (tags->GetTagData(JPGTAG_BIO_ACTION) == JPGFLAG_BIO_REQUEST) {
+    tags->SetTagPtr(JPGTAG_BIO_MEMORY        ,(UBYTE *)(bmp->bb_pData) + comp * sample);
+    tags->SetTagData(JPGTAG_BIO_WIDTH        ,bmp->bb_ulWidth);
+    tags->SetTagData(JPGTAG_BIO_HEIGHT       ,(miny + 8 < bmp->bb_ulHeight)?(miny + 8):(bmp->bb_ulHeight));
+    tags->SetTagData(JPGTAG_BIO_BYTESPERROW  ,bmp->bb_ulWidth * bmp->bb_usDepth * sample);
+    tags->SetTagData(JPGTAG_BIO_BYTESPERPIXEL,bmp->bb_usDepth * sample);
+    tags->SetTagData(JPGTAG_BIO_PIXELTYPE    ,bmp->bb_ucPixelType);
+  }
+
+  return 0;
+}
+///
+
+/// CreateSynthetic
+// Generate a synthetic test image: Smooth gradients with some noise
+// and hard edges on top, such that neither the DCT nor the entropy
+// coder see a trivial input. The image is deterministic.
+static bool CreateSynthetic(struct BenchImage *image,const char *name,
+                            int width,int height,int precision,bool isfloat)
+{
+  ULONG seed = 0x2545f491UL;
+  int max    = (1 << precision) - 1;
+  int x,y,c;
+
+  image->bi_iWidth     = width;
+  image->bi_iHeight    = height;
+  image->bi_iDepth     = 3;
+  image->bi_iPrecision = precision;
+  image->bi_bFloat     = isfloat;
+  image->bi_iClass     = (isfloat)?(Bench_Float):((precision > 8)?(Bench_HighBit):(Bench_LDR));
+  image->bi_pData      = malloc(size_t(width) * height * 3 * ((precision > 8)?(2):(1)));
+  strcpy(image->bi_cName,name);
+
+  if (image->bi_pData == NULL) {
+    fprintf(stderr,"unable to allocate memory for the synthetic benchmark image\n");
+    return false;
+  }
+
+  for(y = 0;y < height;y++) {
+    double fy = double(y) / height;
+    for(x = 0;x < width;x++) {
+      double fx   = double(x) / width;
+      bool   tile = (((x << 3) / width) ^ ((y << 3) / height)) & 1;
+      for(c = 0;c < 3;c++) {
+        size_t i = (size_t(y) * width + x) * 3 + c;
+        double v;
+        seed = seed * 1103515245UL + 12345UL;
+        v    = 0.5 + 0.35 * sin(6.2831853 * (fx * (c + 1) + fy * (3 - c)));
+        v   += 0.08 * (double((seed >> 16) & 0xff) / 255.0 - 0.5);
+        if (tile)
+          v  = 0.25 + 0.5 * v;
+        if (v < 0.0) v = 0.0;
+        if (v > 1.0) v = 1.0;
+        if (isfloat) {
+          // Cover a dynamic range of about 16 stops.
+          ((UWORD *)image->bi_pData)[i] = DoubleToHalf(pow(2.0,16.0 * v - 8.0));
+        } else if (precision > 8) {
+          ((UWORD *)image->bi_pData)[i] = UWORD(v * max + 0.5);
+        } else {
+          ((UBYTE *)image->bi_pData)[i] = UBYTE(v * max + 0.5);
+        }
+      }
+    }
+  }
+
+  return true;
+}
+///
+
+/// LoadImage
+// Load the given image into memory.
+static bool LoadImage(struct BenchImage *image,const char *file)
+{
+  const char *name = strrchr(file,'/');
+  bool big;
+  size_t count;
+  FILE *in;
+  bool ok;
+
+  in = OpenPNMFile(file,image->bi_iWidth,image->bi_iHeight,image->bi_iDepth,
+                   image->bi_iPrecision,image->bi_bFloat,big);
+  if (in == NULL) {
+    fprintf(stderr,"%s is not a PPM, PGM or PFM image, skipping it\n",file);
+    return false;
+  }
+
+  name = (name)?(name + 1):(file);
+  strncpy(image->bi_cName,name,sizeof(image->bi_cName) - 1);
+  image->bi_cName[sizeof(image->bi_cName) - 1] = 0;
+
+  if (image->bi_bFloat) {
+    image->bi_iClass = Bench_Float;
+  } else if (image->bi_iPrecision > 8) {
+    image->bi_iClass = Bench_HighBit;
+  } else {
+    image->bi_iClass = Bench_LDR;
+  }
+
+  count           = size_t(image->bi_iWidth) * image->bi_iHeight * image->bi_iDepth;
+  image->bi_pData = malloc(count * ((image->bi_bFloat || image->bi_iPrecision > 8)?(2):(1)));
+  if (image->bi_pData == NULL) {
+    fprintf(stderr,"unable to allocate memory for %s, skipping it\n",file);
+    fclose(in);
+    return false;
+  }
+
+  if (image->bi_bFloat) {
+    UWORD *data = (UWORD *)image->bi_pData;
+    size_t i;
+    ok = ReadHalfSamples(in,data,count,big);
+    // Clamp negative values to zero as the encoder does by default.
+    for(i = 0;i < count;i++) {
+      if (data[i] & 0x8000)
+        data[i] = 0;
+    }
+  } else if (image->bi_iPrecision > 8) {
+    ok = fread(image->bi_pData,sizeof(UWORD),count,in) == count;
+#ifdef JPG_LIL_ENDIAN
+    SwapWordSamples((UWORD *)image->bi_pData,count);
+#endif
+  } else {
+    ok = fread(image->bi_pData,sizeof(UBYTE),count,in) == count;
+  }
+  fclose(in);
+
+  if (!ok) {
+    fprintf(stderr,"%s is truncated, skipping it\n",file);
+    free(image->bi_pData);
+    image->bi_pData = NULL;
+  }
+
+  return ok;
+}
+///
+
+/// PrintError
+// Print the last error of the library.
+static void PrintError(class JPEG *jpeg)
+{
+  const char *error;
+  int code = jpeg->LastError(error);
+
+  printf("  error %d - %s\n",code,error);
+}
+///
+
+/// CollectStages
+// Retrieve the per-stage times from the instrumentation.
+static void CollectStages(class JPEG *jpeg,struct BenchResult &result)
+{
+  struct JPG_TagItem tags[JPGFLAG_STATS_STAGES + 1];
+  int i;
+
+  for(i = 0;i < JPGFLAG_STATS_STAGES;i++)
+    tags[i] = JPG_ValueTag(JPGTAG_STATS_TIME(i),0);
+  tags[i] = JPG_EndTag;
+
+  jpeg->GetInformation(tags);
+
+  for(i = 0;i < JPGFLAG_STATS_STAGES;i++)
+    result.br_lStageTime[i] = tags->GetTagData(JPGTAG_STATS_TIME(i));
+}
+///
+
+/// RunEncoder
+// Encode the image with the given case repeatedly into the stream, and
+// keep the fastest run in result. The ldrtohdr table is the inverse
+// tone mapping for the HDR cases. Returns false if encoding failed.
+static bool RunEncoder(const struct BenchImage *image,const struct BenchCase *bc,
+                       const UWORD *ldrtohdr,struct BenchStream *stream,
+                       int repeats,struct BenchResult &result)
+{
+  static UBYTE sub444[4] = {1,1,1,1};
+  static UBYTE sub420[4] = {1,2,2,2};
+  UBYTE *sub    = (bc->bc_bSubsampled)?(sub420):(sub444);
+  bool residual = (bc->bc_lFrameType & JPGFLAG_RESIDUAL_CODING)?true:false;
+  bool tonemap  = residual || bc->bc_iHiddenBits;
+  bool prog     = (bc->bc_lFrameType & 7) == JPGFLAG_PROGRESSIVE;
+  struct BenchBitmap bmp;
+  struct JPG_Hook bmhook(BenchBitmapHook,&bmp);
+  struct JPG_Hook iohook(BenchStreamHook,stream);
+  struct JPG_TagItem pscan1[] = { // standard progressive scan, first scan.
+    JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_START,0),
+    JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_STOP,0),
+    JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_LO,1),
+    JPG_EndTag
+  };
+  struct JPG_TagItem pscan2[] = {
+    JPG_ValueTag(JPGTAG_SCAN_COMPONENT0,0),
+    JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_START,1),
+    JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_STOP,5),
+    JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_LO,2), 
+    JPG_EndTag
+  };
+  struct JPG_TagItem pscan3[] = {
+    JPG_ValueTag(JPGTAG_SCAN_COMPONENTS_CHROMA,0),
+    JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_START,1),
+    JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_STOP,63),
+    JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_LO,1),
+    JPG_EndTag
+  };
+  struct JPG_TagItem pscan4[] = {
+    JPG_ValueTag(JPGTAG_SCAN_COMPONENT0,0), 
+    JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_START,6),
+    JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_STOP,63),
+    JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_LO,2),
+    JPG_EndTag
+  }; 
+  struct JPG_TagItem pscan5[] = {
+    JPG_ValueTag(JPGTAG_SCAN_COMPONENT0,0), 
+    JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_START,1),
+    JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_STOP,63),
+    JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_LO,1),
+    JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_HI,2),
+    JPG_EndTag
+  };  
+  struct JPG_TagItem pscan6[] = {
+    JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_START,0),
+    JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_STOP,0),
+    JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_LO,0),
+    JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_HI,1),
+    JPG_EndTag
+  };
+  struct JPG_TagItem pscan7[] = {
+    JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_START,1),
+    JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_STOP,63),
+    JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_LO,0),
+    JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_HI,1),
+    JPG_EndTag
+  };
+  struct JPG_TagItem tags[] = {
+    JPG_PointerTag(JPGTAG_BIH_HOOK,&bmhook),
+    JPG_ValueTag(JPGTAG_ENCODER_LOOP_ON_INCOMPLETE,true),
+    JPG_ValueTag(JPGTAG_IMAGE_WIDTH,image->bi_iWidth), 
+    JPG_ValueTag(JPGTAG_IMAGE_HEIGHT,image->bi_iHeight), 
+    JPG_ValueTag(JPGTAG_IMAGE_DEPTH,image->bi_iDepth),      
+    JPG_ValueTag(JPGTAG_IMAGE_PRECISION,image->bi_iPrecision),
+    JPG_ValueTag(JPGTAG_IMAGE_FRAMETYPE,bc->bc_lFrameType),
+    JPG_ValueTag(JPGTAG_RESIDUAL_FRAMETYPE,bc->bc_lResidualType),
+    JPG_ValueTag(JPGTAG_IMAGE_QUALITY,bc->bc_iQuality),
+    JPG_ValueTag((residual)?JPGTAG_RESIDUAL_QUALITY:JPGTAG_TAG_IGNORE,bc->bc_iHDRQuality),
+    JPG_ValueTag(JPGTAG_IMAGE_RESTART_INTERVAL,bc->bc_iRestart),
+    JPG_ValueTag(JPGTAG_IMAGE_HIDDEN_DCTBITS,bc->bc_iHiddenBits),
+    JPG_PointerTag(JPGTAG_IMAGE_SUBX,sub),
+    JPG_PointerTag(JPGTAG_IMAGE_SUBY,sub),
+    JPG_PointerTag(JPGTAG_RESIDUAL_SUBX,sub),
+    JPG_PointerTag(JPGTAG_RESIDUAL_SUBY,sub),
+    JPG_PointerTag((tonemap)?(JPGTAG_TONEMAPPING_L_LUT(0)):JPGTAG_TAG_IGNORE,
+                   const_cast<UWORD *>(ldrtohdr)),
+    JPG_PointerTag((tonemap && image->bi_iDepth > 1)?(JPGTAG_TONEMAPPING_L_LUT(1)):JPGTAG_TAG_IGNORE,
+                   const_cast<UWORD *>(ldrtohdr)),
+    JPG_PointerTag((tonemap && image->bi_iDepth > 2)?(JPGTAG_TONEMAPPING_L_LUT(2)):JPGTAG_TAG_IGNORE,
+                   const_cast<UWORD *>(ldrtohdr)),
+    JPG_ValueTag((tonemap)?(JPGTAG_TONEMAPPING_L_TYPE(0)):JPGTAG_TAG_IGNORE,
+                 JPGFLAG_TONEMAPPING_LUT),
+    JPG_ValueTag((tonemap && image->bi_iDepth > 1)?(JPGTAG_TONEMAPPING_L_TYPE(1)):JPGTAG_TAG_IGNORE,
+                 JPGFLAG_TONEMAPPING_LUT),
+    JPG_ValueTag((tonemap && image->bi_iDepth > 2)?(JPGTAG_TONEMAPPING_L_TYPE(2)):JPGTAG_TAG_IGNORE,
+                 JPGFLAG_TONEMAPPING_LUT),
+    JPG_PointerTag((prog)?JPGTAG_IMAGE_SCAN:JPGTAG_TAG_IGNORE,pscan1),
+    JPG_PointerTag((prog)?JPGTAG_IMAGE_SCAN:JPGTAG_TAG_IGNORE,pscan2),
+    JPG_PointerTag((prog)?JPGTAG_IMAGE_SCAN:JPGTAG_TAG_IGNORE,pscan3),
+    JPG_PointerTag((prog)?JPGTAG_IMAGE_SCAN:JPGTAG_TAG_IGNORE,pscan4),
+    JPG_PointerTag((prog)?JPGTAG_IMAGE_SCAN:JPGTAG_TAG_IGNORE,pscan5),
+    JPG_PointerTag((prog)?JPGTAG_IMAGE_SCAN:JPGTAG_TAG_IGNORE,pscan6),
+    JPG_PointerTag((prog)?JPGTAG_IMAGE_SCAN:JPGTAG_TAG_IGNORE,pscan7),
+    JPG_ValueTag(JPGTAG_IMAGE_IS_FLOAT,image->bi_bFloat),
+    JPG_ValueTag(JPGTAG_IMAGE_OUTPUT_CONVERSION,image->bi_bFloat),
+    JPG_EndTag
+  };
+  struct JPG_TagItem iotags[] = {
+    JPG_PointerTag(JPGTAG_HOOK_IOHOOK,&iohook),
+    JPG_PointerTag(JPGTAG_HOOK_IOSTREAM,stream),
+    JPG_EndTag
+  };
+  struct JPG_TagItem ctags[] = {
+    JPG_ValueTag(JPGTAG_STATS_ENABLE,true),
+    JPG_EndTag
+  };
+  int i;
+
+  bmp.bb_pData       = image->bi_pData;
+  bmp.bb_ulWidth     = image->bi_iWidth;
+  bmp.bb_ulHeight    = image->bi_iHeight;
+  bmp.bb_usDepth     = image->bi_iDepth;
+  bmp.bb_ucPixelType = (image->bi_bFloat || image->bi_iPrecision > 8)?(CTYP_UWORD):(CTYP_UBYTE);
+
+  result.br_dTime = HUGE_VAL;
+  for(i = 0;i < repeats;i++) {
+    class JPEG *jpeg = JPEG::Construct(ctags);
+    double start;
+    bool ok;
+
+    if (jpeg == NULL)
+      return false;
+
+    stream->bs_ulSize = 0;
+    stream->bs_ulPos  = 0;
+
+    start = Now();
+    ok    = jpeg->ProvideImage(tags) && jpeg->Write(iotags);
+    start = Now() - start;
+
+    if (!ok) {
+      PrintError(jpeg);
+    } else if (start < result.br_dTime) {
+      result.br_dTime = start;
+      CollectStages(jpeg,result);
+    }
+    JPEG::Destruct(jpeg);
+    
+    if (!ok)
+      return false;
+  }
+
+  return true;
+}
+///
+
+/// RunDecoder
+// Decode the stream repeatedly into the given buffer, which must be
+// large enough to hold the image in 16 bits per sample, and keep the
+// fastest run in result. Returns false if decoding failed.
+static bool RunDecoder(struct BenchStream *stream,APTR buffer,
+                       int repeats,struct BenchResult &result)
+{
+  struct BenchBitmap bmp;
+  struct JPG_Hook bmhook(BenchBitmapHook,&bmp);
+  struct JPG_Hook iohook(BenchStreamHook,stream);
+  struct JPG_TagItem iotags[] = {
+    JPG_PointerTag(JPGTAG_HOOK_IOHOOK,&iohook),
+    JPG_PointerTag(JPGTAG_HOOK_IOSTREAM,stream),
+    JPG_EndTag
+  };
+  struct JPG_TagItem ctags[] = {
+    JPG_ValueTag(JPGTAG_STATS_ENABLE,true),
+    JPG_EndTag
+  };
+  int i;
+
+  result.br_dTime = HUGE_VAL;
+  for(i = 0;i < repeats;i++) {
+    class JPEG *jpeg = JPEG::Construct(ctags);
+    double start;
+    bool ok;
+
+    if (jpeg == NULL)
+      return false;
+
+    stream->bs_ulPos = 0;
+
+    start = Now();
+    ok    = jpeg->Read(iotags);
+    if (ok) {
+      struct JPG_TagItem itags[] = {
+        JPG_ValueTag(JPGTAG_IMAGE_WIDTH,0),
+        JPG_ValueTag(JPGTAG_IMAGE_HEIGHT,0),
+        JPG_ValueTag(JPGTAG_IMAGE_DEPTH,0),
+        JPG_ValueTag(JPGTAG_IMAGE_PRECISION,0),
+        JPG_EndTag
+      };
+      ok = jpeg->GetInformation(itags);
+      if (ok) {
+        ULONG y;
+        bmp.bb_pData       = buffer;
+        bmp.bb_ulWidth     = itags->GetTagData(JPGTAG_IMAGE_WIDTH);
+        bmp.bb_ulHeight    = itags->GetTagData(JPGTAG_IMAGE_HEIGHT);
+        bmp.bb_usDepth     = itags->GetTagData(JPGTAG_IMAGE_DEPTH);
+        bmp.bb_ucPixelType = (itags->GetTagData(JPGTAG_IMAGE_PRECISION) > 8)?(CTYP_UWORD):(CTYP_UBYTE);
+        // Reconstruct in stripes of eight lines as the command line
+        // tool does.
+        for(y = 0;y < bmp.bb_ulHeight && ok;y += 8) {
+          struct JPG_TagItem tags[] = {
+            JPG_PointerTag(JPGTAG_BIH_HOOK,&bmhook),
+            JPG_ValueTag(JPGTAG_DECODER_MINY,y),
+            JPG_ValueTag(JPGTAG_DECODER_MAXY,y + 7),
+            JPG_EndTag
+          };
+          ok = jpeg->DisplayRectangle(tags);
+        }
+      }
+    }
+    start = Now() - start;
+
+    if (!ok) {
+      PrintError(jpeg);
+    } else if (start < result.br_dTime) {
+      result.br_dTime = start;
+      CollectStages(jpeg,result);
+    }
+    JPEG::Destruct(jpeg);
+
+    if (!ok)
+      return false;
+  }
+
+  return true;
+}
+///
+
+/// PrintStages
+// Print the time and the throughput of all stages that took part in
+// the fastest run.
+static void PrintStages(const char *what,const struct BenchResult &result,
+                        double pixels,double bytes)
+{
+  int i;
+
+  for(i = 0;i < JPGFLAG_STATS_STAGES;i++) {
+    double t = result.br_lStageTime[i] * 1e-6;
+    if (t > 0.0) {
+      printf("%-24s %-10s %-22s %9s %6s %8.2f %7.2f %7.2f\n",
+             "",what,StageNames[i],"","",
+             t * 1000.0,pixels / t * 1e-6,bytes / t * 1e-6);
+    }
+  }
+}
+///
+
+/// RunBenchmark
+// Run the benchmark. The arguments are the remaining command line
+// arguments starting at the -bench switch. Returns zero if all runs
+// succeeded.
+int RunBenchmark(int argc,char **argv)
+{
+  struct BenchImage *images;
+  UWORD *ldrtohdr;
+  int count       = 0;
+  int repeats     = 3;
+  int width       = 1280;
+  int height      = 720;
+  int failures    = 0;
+  int runs        = 0;
+  int i;
+
+  // Skip the -bench switch itself.
+  argc--,argv++;
+  while(argc > 0 && argv[0][0] == '-') {
+    if (!strcmp(argv[0],"-n") && argc > 1) {
+      repeats = atoi(argv[1]);
+      if (repeats < 1) {
+        fprintf(stderr,"-n requires at least one repetition\n");
+        return 20;
+      }
+    } else if (!strcmp(argv[0],"-size") && argc > 1) {
+      if (sscanf(argv[1],"%dx%d",&width,&height) != 2 || width < 1 || height < 1) {
+        fprintf(stderr,"-size expects the image dimensions as widthxheight\n");
+        return 20;
+      }
+    } else {
+      fprintf(stderr,"unsupported benchmark option %s\n",argv[0]);
+      return 20;
+    }
+    argc -= 2,argv += 2;
+  }
+
+  if (argc > MAX_BENCH_IMAGES) {
+    fprintf(stderr,"at most %d images can be benchmarked at once\n",MAX_BENCH_IMAGES);
+    return 20;
+  }
+
+  images   = (struct BenchImage *)malloc(sizeof(struct BenchImage) * (MAX_BENCH_IMAGES + 3));
+  ldrtohdr = (UWORD *)malloc(sizeof(UWORD) * 65536);
+  if (images == NULL || ldrtohdr == NULL) {
+    fprintf(stderr,"unable to allocate memory for the benchmark\n");
+    free(images);
+    free(ldrtohdr);
+    return 20;
+  }
+
+  // The synthetic images come first, one for each image class.
+  if (CreateSynthetic(images + count,"synthetic 8 bit",width,height,8,false))
+    count++;
+  if (CreateSynthetic(images + count,"synthetic 12 bit",width,height,12,false))
+    count++;
+#if ISO_CODE
+  if (CreateSynthetic(images + count,"synthetic float",width,height,16,true))
+    count++;
+#endif
+  // Then the user supplied images.
+  for(i = 0;i < argc;i++) {
+    if (LoadImage(images + count,argv[i]))
+      count++;
+  }
+
+  printf("\nBest of %d runs, throughput relative to the uncompressed image.\n"
+         "Stage lines list the time spent in each stage of the fastest run.\n\n"
+         "%-24s %-10s %-22s %9s %6s %8s %7s %7s %8s %7s %7s\n",
+         repeats,
+         "image","size","case","bytes","bpp",
+         "enc ms","MP/s","MB/s","dec ms","MP/s","MB/s");
+
+  for(i = 0;i < count;i++) {
+    const struct BenchImage *image = images + i;
+    double pixels     = double(image->bi_iWidth) * image->bi_iHeight;
+    double bytes      = pixels * image->bi_iDepth *
+      ((image->bi_bFloat)?(4):((image->bi_iPrecision > 8)?(2):(1)));
+    APTR buffer       = malloc(size_t(pixels) * image->bi_iDepth * sizeof(UWORD));
+    const struct BenchCase *bc;
+    char size[32];
+
+    sprintf(size,"%dx%d",image->bi_iWidth,image->bi_iHeight);
+
+    if (buffer == NULL) {
+      printf("%-24.24s %-10s unable to allocate the output buffer\n",image->bi_cName,size);
+      failures++;
+      continue;
+    }
+
+    for(bc = BenchMatrix;bc->bc_pcName;bc++) {
+      struct BenchStream stream;
+      struct BenchResult enc,dec;
+
+      if ((bc->bc_iClass & image->bi_iClass) == 0)
+        continue;
+
+      // The inverse tone mapping is not part of the measurement.
+      BuildGammaMapping(BENCH_GAMMA,1.0,ldrtohdr,image->bi_bFloat,
+                        (1L << image->bi_iPrecision) - 1,bc->bc_iHiddenBits);
+
+      memset(&stream,0,sizeof(stream));
+      runs++;
+      fflush(stdout);
+      if (!RunEncoder(image,bc,ldrtohdr,&stream,repeats,enc)) {
+        printf("%-24.24s %-10s %-22s encoding failed\n",image->bi_cName,size,bc->bc_pcName);
+        failures++;
+      } else if (!RunDecoder(&stream,buffer,repeats,dec)) {
+        printf("%-24.24s %-10s %-22s decoding failed\n",image->bi_cName,size,bc->bc_pcName);
+        failures++;
+      } else {
+        printf("%-24.24s %-10s %-22s %9lu %6.3f %8.2f %7.2f %7.2f %8.2f %7.2f %7.2f\n",
+               image->bi_cName,size,bc->bc_pcName,(unsigned long)stream.bs_ulSize,
+               8.0 * stream.bs_ulSize / pixels,
+               enc.br_dTime * 1000.0,pixels / enc.br_dTime * 1e-6,bytes / enc.br_dTime * 1e-6,
+               dec.br_dTime * 1000.0,pixels / dec.br_dTime * 1e-6,bytes / dec.br_dTime * 1e-6);
+        PrintStages("encoding",enc,pixels,bytes);
+        PrintStages("decoding",dec,pixels,bytes);
+      }
+      free(stream.bs_pucBuffer);
+    }
+    free(buffer);
+  }
+
+  for(i = 0;i < count;i++)
+    free(images[i].bi_pData);
+  free(images);
+  free(ldrtohdr);
+
+  printf("\n%d runs, %d failed.\n",runs,failures);
+
+  return (failures)?(10):(0);
+}
+///
@@ -113,7 +113,6 @@ JPG_LONG LDRBitmapHook(struct JPG_Hook *hook, struct JPG_TagItem *tags)
 // The Bitmap hook function
 JPG_LONG BitmapHook(struct JPG_Hook *hook, struct JPG_TagItem *tags)
 {
-  static ULONG OpenComponents = 0;
   struct BitmapMemory *bmm  = (struct BitmapMemory *)(hook->hk_pData);
   UWORD comp = tags->GetTagData(JPGTAG_BIO_COMPONENT);
   ULONG miny = tags->GetTagData(JPGTAG_BIO_MINY);
@@ -177,41 +176,43 @@ JPG_LONG BitmapHook(struct JPG_Hook *hook, struct JPG_TagItem *tags)
           //
           if (bmm->bmm_pSource) {
             if (bmm->bmm_bFloat) {
+              // Read the entire stripe in one go, then convert it in place.
+              ULONG count  = bmm->bmm_ulWidth * height * bmm->bmm_usDepth;
+              bool tonemap = bmm->bmm_pLDRMemPtr && bmm->bmm_pLDRSource == NULL;
+              UBYTE *ldr   = (UBYTE *)bmm->bmm_pLDRMemPtr;
+              ULONG i;
               if (bmm->bmm_bNoOutputConversion) {
-                ULONG count = bmm->bmm_ulWidth * height * bmm->bmm_usDepth;
                 FLOAT *data = (FLOAT *)bmm->bmm_pMemPtr;
-                UBYTE *ldr  = (UBYTE *)bmm->bmm_pLDRMemPtr;
-                do {
-                  double in = readFloat(bmm->bmm_pSource,bmm->bmm_bBigEndian);
-                  UWORD half;
-                  if (bmm->bmm_bClamp && in < 0.0)
-                    in = 0.0; 
-                  half = DoubleToHalf(in);
-                  // Tone-map the input unless there is an LDR source.
-                  if (bmm->bmm_pLDRMemPtr && bmm->bmm_pLDRSource == NULL)
-                    *ldr  = bmm->bmm_HDR2LDR[half];
-                  *data = FLOAT(in);
-                  data++,ldr++;
-                } while(--count);
+                ReadFloatSamples(bmm->bmm_pSource,data,count,bmm->bmm_bBigEndian);
+                if (bmm->bmm_bClamp) {
+                  for(i = 0;i < count;i++) {
+                    if (data[i] < 0.0f)
+                      data[i] = 0.0f;
+                  }
+                }
+                // Tone-map the input unless there is an LDR source.
+                if (tonemap) {
+                  for(i = 0;i < count;i++) {
+                    ldr[i] = bmm->bmm_HDR2LDR[FloatToHalf(data[i])];
+                  }
+                }
               } else {
-                ULONG count = bmm->bmm_ulWidth * height * bmm->bmm_usDepth;
                 UWORD *data = (UWORD *)bmm->bmm_pMemPtr;
-                UBYTE *ldr  = (UBYTE *)bmm->bmm_pLDRMemPtr;
-                do {
-                  double in = readFloat(bmm->bmm_pSource,bmm->bmm_bBigEndian);
-                  if (bmm->bmm_bClamp && in < 0.0)
-                    in = 0.0;
-                  *data = DoubleToHalf(in);
-                  // Tone-map the input unless there is an LDR source.
-                  if (bmm->bmm_pLDRMemPtr && bmm->bmm_pLDRSource == NULL) {
-                    if (in >= 0.0) {
-                      *ldr  = bmm->bmm_HDR2LDR[*data];
-                    } else {
-                      *ldr  = 0;
-                    }
+                ReadHalfSamples(bmm->bmm_pSource,data,count,bmm->bmm_bBigEndian);
+                // Clamping can be performed on the bit patterns: Negative
+                // numbers have the sign bit set.
+                if (bmm->bmm_bClamp) {
+                  for(i = 0;i < count;i++) {
+                    if (data[i] & 0x8000)
+                      data[i] = 0;
+                  }
+                }
+                // Tone-map the input unless there is an LDR source.
+                if (tonemap) {
+                  for(i = 0;i < count;i++) {
+                    ldr[i] = (data[i] & 0x8000)?(0):(bmm->bmm_HDR2LDR[data[i]]);
                   }
-                  data++,ldr++;
-                } while(--count);
+                }
               }
             } else {
               fread(bmm->bmm_pMemPtr,bmm->bmm_ucPixelType & CTYP_SIZE_MASK,
@@ -220,12 +221,7 @@ JPG_LONG BitmapHook(struct JPG_Hook *hook, struct JPG_TagItem *tags)
               // On those bloddy little endian machines, an endian swap is necessary
               // as PNM is big-endian.
               if (bmm->bmm_ucPixelType == CTYP_UWORD) {
-                ULONG count = bmm->bmm_ulWidth * height * bmm->bmm_usDepth;
-                UWORD *data = (UWORD *)bmm->bmm_pMemPtr;
-                do {
-                  *data = (*data >> 8) | ((*data & 0xff) << 8);
-                  data++;
-                } while(--count);
+                SwapWordSamples((UWORD *)bmm->bmm_pMemPtr,bmm->bmm_ulWidth * height * bmm->bmm_usDepth);
               }
 #endif
               // Construct the tone-mapped LDR version of the image
@@ -251,13 +247,13 @@ JPG_LONG BitmapHook(struct JPG_Hook *hook, struct JPG_TagItem *tags)
           }
         }
       }
-      assert((OpenComponents & (1UL << comp)) == 0);
-      OpenComponents |= 1UL << comp;
+      assert((bmm->bmm_ulOpenComponents & (1UL << comp)) == 0);
+      bmm->bmm_ulOpenComponents |= 1UL << comp;
     }
     break;
   case JPGFLAG_BIO_RELEASE:
     {
-      assert(OpenComponents & (1UL << comp));
+      assert(bmm->bmm_ulOpenComponents & (1UL << comp));
       if (comp == bmm->bmm_usDepth - 1) {
         ULONG height = maxy + 1 - miny;
         if (bmm->bmm_ucPixelType == CTYP_UBYTE || 
@@ -265,44 +261,17 @@ JPG_LONG BitmapHook(struct JPG_Hook *hook, struct JPG_TagItem *tags)
             bmm->bmm_ucPixelType == CTYP_FLOAT) {
           if (bmm->bmm_pTarget) {
             if (bmm->bmm_bFloat) {
-              if (bmm->bmm_bNoOutputConversion) {
-                ULONG count = bmm->bmm_ulWidth * height;
-                FLOAT *data = (FLOAT *)bmm->bmm_pMemPtr;
-                double r = 0.0,g = 0.0,b = 0.0; // shut up the compiler.
-                do {
-                  switch(bmm->bmm_usDepth) {
-                  case 1:
-                    writeFloat(bmm->bmm_pTarget,*data++,bmm->bmm_bBigEndian);
-                    break;
-                  case 3:
-                    r = *data++;
-                    g = *data++;
-                    b = *data++;
-                    writeFloat(bmm->bmm_pTarget,r,bmm->bmm_bBigEndian);
-                    writeFloat(bmm->bmm_pTarget,g,bmm->bmm_bBigEndian);
-                    writeFloat(bmm->bmm_pTarget,b,bmm->bmm_bBigEndian);
-                    break;
-                  }
-                } while(--count);
-              } else {
-                ULONG count = bmm->bmm_ulWidth * height;
-                UWORD *data = (UWORD *)bmm->bmm_pMemPtr;
-                double r = 0.0,g = 0.0,b = 0.0; // shut up the compiler.
-                do {
-                  switch(bmm->bmm_usDepth) {
-                  case 1:
-                    writeFloat(bmm->bmm_pTarget,HalfToDouble(*data++),bmm->bmm_bBigEndian);
-                    break;
-                  case 3:
-                    r = HalfToDouble(*data++);
-                    g = HalfToDouble(*data++);
-                    b = HalfToDouble(*data++);
-                    writeFloat(bmm->bmm_pTarget,r,bmm->bmm_bBigEndian);
-                    writeFloat(bmm->bmm_pTarget,g,bmm->bmm_bBigEndian);
-                    writeFloat(bmm->bmm_pTarget,b,bmm->bmm_bBigEndian);
-                    break;
-                  }
-                } while(--count);
+              if (bmm->bmm_usDepth == 1 || bmm->bmm_usDepth == 3) {
+                // Components are interleaved in the buffer as in the file,
+                // so the stripe can be written in bulk.
+                ULONG count = bmm->bmm_ulWidth * height * bmm->bmm_usDepth;
+                if (bmm->bmm_bNoOutputConversion) {
+                  WriteFloatSamples(bmm->bmm_pTarget,(const FLOAT *)bmm->bmm_pMemPtr,count,
+                                    bmm->bmm_bBigEndian);
+                } else {
+                  WriteHalfSamples(bmm->bmm_pTarget,(const UWORD *)bmm->bmm_pMemPtr,count,
+                                   bmm->bmm_bBigEndian);
+                }
               }
             } else {
               switch(bmm->bmm_usDepth) {
@@ -312,12 +281,7 @@ JPG_LONG BitmapHook(struct JPG_Hook *hook, struct JPG_TagItem *tags)
                 // On those bloddy little endian machines, an endian swap is necessary
                 // as PNM is big-endian.
                 if (bmm->bmm_ucPixelType == CTYP_UWORD) {
-                  ULONG count = bmm->bmm_ulWidth * height * bmm->bmm_usDepth;
-                  UWORD *data = (UWORD *)bmm->bmm_pMemPtr;
-                  do {
-                    *data = (*data >> 8) | ((*data & 0xff) << 8);
-                    data++;
-                  } while(--count);
+                  SwapWordSamples((UWORD *)bmm->bmm_pMemPtr,bmm->bmm_ulWidth * height * bmm->bmm_usDepth);
                 }
 #endif
                 fwrite(bmm->bmm_pMemPtr,bmm->bmm_ucPixelType & CTYP_SIZE_MASK,
@@ -328,7 +292,7 @@ JPG_LONG BitmapHook(struct JPG_Hook *hook, struct JPG_TagItem *tags)
           }
         }
       }
-      OpenComponents &= ~(1UL << comp);
+      bmm->bmm_ulOpenComponents &= ~(1UL << comp);
     }
     break;
   }
@@ -341,7 +305,6 @@ JPG_LONG BitmapHook(struct JPG_Hook *hook, struct JPG_TagItem *tags)
 // There is only one component here, and there is never LDR data.
 JPG_LONG AlphaHook(struct JPG_Hook *hook, struct JPG_TagItem *tags)
 {
-  static ULONG OpenComponents = 0;
   struct BitmapMemory *bmm  = (struct BitmapMemory *)(hook->hk_pData);
   ULONG miny = tags->GetTagData(JPGTAG_BIO_MINY);
   ULONG maxy = tags->GetTagData(JPGTAG_BIO_MAXY);
@@ -392,36 +355,33 @@ JPG_LONG AlphaHook(struct JPG_Hook *hook, struct JPG_TagItem *tags)
             bmm->bmm_ucAlphaType == CTYP_FLOAT) {
           if (bmm->bmm_pAlphaSource) {
             if (bmm->bmm_bAlphaFloat) {
+              ULONG count = bmm->bmm_ulWidth * height;
+              ULONG i;
+              // No LDR mapping and no TMO here.
               if (bmm->bmm_bNoAlphaOutputConversion) {
-                ULONG count = bmm->bmm_ulWidth * height;
                 FLOAT *data = (FLOAT *)bmm->bmm_pAlphaPtr;
-                do {
-                  double in = readFloat(bmm->bmm_pAlphaSource,bmm->bmm_bAlphaBigEndian);
-                  if (bmm->bmm_bAlphaClamp) {
-                    if (in < 0.0)
-                      in = 0.0; 
-                    if (in > 1.0)
-                      in = 1.0;
+                ReadFloatSamples(bmm->bmm_pAlphaSource,data,count,bmm->bmm_bAlphaBigEndian);
+                if (bmm->bmm_bAlphaClamp) {
+                  for(i = 0;i < count;i++) {
+                    if (data[i] < 0.0f)
+                      data[i] = 0.0f;
+                    if (data[i] > 1.0f)
+                      data[i] = 1.0f;
                   }
-                  // No LDR mapping here.
-                  *data = FLOAT(in);
-                  data++;
-                } while(--count);
+                }
               } else {
-                ULONG count = bmm->bmm_ulWidth * height;
                 UWORD *data = (UWORD *)bmm->bmm_pAlphaPtr;
-                do {
-                  double in = readFloat(bmm->bmm_pAlphaSource,bmm->bmm_bAlphaBigEndian);
-                  if (bmm->bmm_bAlphaClamp) {
-                    if (in < 0.0)
-                      in = 0.0;
-                    if (in > 1.0)
-                      in = 1.0;
+                ReadHalfSamples(bmm->bmm_pAlphaSource,data,count,bmm->bmm_bAlphaBigEndian);
+                // Half-floats of the same sign are ordered as their bit patterns,
+                // so clamping to [0,1] works on the patterns directly.
+                if (bmm->bmm_bAlphaClamp) {
+                  for(i = 0;i < count;i++) {
+                    if (data[i] & 0x8000)
+                      data[i] = 0;
+                    if (data[i] > 0x3c00) // this is 1.0
+                      data[i] = 0x3c00;
                   }
-                  *data = DoubleToHalf(in);
-                  // No TMO here.
-                  data++;
-                } while(--count);
+                }
               }
             } else {
               fread(bmm->bmm_pAlphaPtr,bmm->bmm_ucAlphaType & CTYP_SIZE_MASK,
@@ -430,25 +390,20 @@ JPG_LONG AlphaHook(struct JPG_Hook *hook, struct JPG_TagItem *tags)
               // On those bloddy little endian machines, an endian swap is necessary
               // as PNM is big-endian.
               if (bmm->bmm_ucAlphaType == CTYP_UWORD) {
-                ULONG count = bmm->bmm_ulWidth * height;
-                UWORD *data = (UWORD *)bmm->bmm_pAlphaPtr;
-                do {
-                  *data = (*data >> 8) | ((*data & 0xff) << 8);
-                  data++;
-                } while(--count);
+                SwapWordSamples((UWORD *)bmm->bmm_pAlphaPtr,bmm->bmm_ulWidth * height);
               }
 #endif
             }
           }
         }
       }
-      assert((OpenComponents & (1UL << 4)) == 0);
-      OpenComponents |= 1UL << 4;
+      assert(bmm->bmm_bAlphaOpen == false);
+      bmm->bmm_bAlphaOpen = true;
     }
     break;
   case JPGFLAG_BIO_RELEASE:
     {
-      assert(OpenComponents & (1UL << 4));
+      assert(bmm->bmm_bAlphaOpen);
       {
         ULONG height = maxy + 1 - miny;
         if (bmm->bmm_ucAlphaType == CTYP_UBYTE || 
@@ -456,30 +411,20 @@ JPG_LONG AlphaHook(struct JPG_Hook *hook, struct JPG_TagItem *tags)
             bmm->bmm_ucAlphaType == CTYP_FLOAT) {
           if (bmm->bmm_pAlphaTarget) {
             if (bmm->bmm_bAlphaFloat) {
+              ULONG count = bmm->bmm_ulWidth * height;
               if (bmm->bmm_bNoAlphaOutputConversion) {
-                ULONG count = bmm->bmm_ulWidth * height;
-                FLOAT *data = (FLOAT *)bmm->bmm_pAlphaPtr;
-                do {
-                  writeFloat(bmm->bmm_pAlphaTarget,*data++,bmm->bmm_bAlphaBigEndian);
-                } while(--count);
+                WriteFloatSamples(bmm->bmm_pAlphaTarget,(const FLOAT *)bmm->bmm_pAlphaPtr,count,
+                                  bmm->bmm_bAlphaBigEndian);
               } else {
-                ULONG count = bmm->bmm_ulWidth * height;
-                UWORD *data = (UWORD *)bmm->bmm_pAlphaPtr;
-                do {
-                  writeFloat(bmm->bmm_pAlphaTarget,HalfToDouble(*data++),bmm->bmm_bAlphaBigEndian);
-                } while(--count);
+                WriteHalfSamples(bmm->bmm_pAlphaTarget,(const UWORD *)bmm->bmm_pAlphaPtr,count,
+                                 bmm->bmm_bAlphaBigEndian);
               }
             } else {
 #ifdef JPG_LIL_ENDIAN
               // On those bloddy little endian machines, an endian swap is necessary
               // as PNM is big-endian.
               if (bmm->bmm_ucAlphaType == CTYP_UWORD) {
-                ULONG count = bmm->bmm_ulWidth * height;
-                UWORD *data = (UWORD *)bmm->bmm_pAlphaPtr;
-                do {
-                  *data = (*data >> 8) | ((*data & 0xff) << 8);
-                  data++;
-                } while(--count);
+                SwapWordSamples((UWORD *)bmm->bmm_pAlphaPtr,bmm->bmm_ulWidth * height);
               }
 #endif
               fwrite(bmm->bmm_pAlphaPtr,bmm->bmm_ucAlphaType & CTYP_SIZE_MASK,
@@ -488,7 +433,7 @@ JPG_LONG AlphaHook(struct JPG_Hook *hook, struct JPG_TagItem *tags)
           }
         }
       }
-      OpenComponents &= ~(1UL << 4);
+      bmm->bmm_bAlphaOpen = false;
     }
     break;
   }
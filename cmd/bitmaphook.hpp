@@ -78,6 +78,7 @@ struct BitmapMemory {
   APTR         bmm_pAlphaPtr;   // memory for the alpha channel
   ULONG        bmm_ulWidth;     // width in pixels.
   ULONG        bmm_ulHeight;    // height in pixels; this is only one block in our application.
+  ULONG        bmm_ulOpenComponents; // bitmask of components currently requested, for consistency checks
   UWORD        bmm_usDepth;     // number of components.
   UBYTE        bmm_ucPixelType; // precision etc.
   UBYTE        bmm_ucAlphaType; // pixel type of the alpha channel
@@ -95,6 +96,7 @@ struct BitmapMemory {
   bool         bmm_bNoAlphaOutputConversion; // ditto for alpha
   bool         bmm_bClamp;      // if set, clamp negative values to zero.
   bool         bmm_bAlphaClamp; // if set, alpha values outside [0,1] will be clamped to range
+  bool         bmm_bAlphaOpen;  // set while the alpha channel is requested, for consistency checks
 };
 ///
 
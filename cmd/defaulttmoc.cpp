@@ -78,7 +78,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // Erik Reinhard and Kate Devlin. Dynamic Range Reduction Inspired by
 // Photoreceptor Physiology.  IEEE Transactions on Visualization and
 // Computer Graphics (2004).
-void BuildToneMapping_C(FILE *in,int w,int h,int depth,int count,UWORD tonemapping[65536],
+// Returns false if the image could not be read.
+bool BuildToneMapping_C(FILE *in,int w,int h,int depth,int count,UWORD tonemapping[65536],
                         bool flt,bool bigendian,bool xyz,int hiddenbits)
 {
   long pos    = ftell(in);
@@ -93,13 +94,15 @@ void BuildToneMapping_C(FILE *in,int w,int h,int depth,int count,UWORD tonemappi
   double maxy =-HUGE_VAL;
   double m;
   long cnt = 0;
+  bool warn = false;
 
   for(y = 0;y < h;y++) {
     for(x = 0;x < w;x++) {
       int r,g,b;
       double y;
 
-      ReadRGBTriple(in,r,g,b,y,depth,count,flt,bigendian,xyz);
+      if (!ReadRGBTriple(in,r,g,b,y,depth,count,flt,bigendian,xyz,warn))
+        return false;
 
       if (y > 0.0) {
         double logy = log(y);
@@ -149,5 +152,7 @@ void BuildToneMapping_C(FILE *in,int w,int h,int depth,int count,UWORD tonemappi
       tonemapping[i] = in;
     }
   }
+
+  return true;
 }
 ///
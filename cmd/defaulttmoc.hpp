@@ -72,7 +72,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ///
 
 /// Prototypes
-extern void BuildToneMapping_C(FILE *in,int w,int h,int depth,int count,UWORD tonemapping[65536],
+// Build a tone mapping from the HDR image. Returns false if the image
+// could not be read.
+extern bool BuildToneMapping_C(FILE *in,int w,int h,int depth,int count,UWORD tonemapping[65536],
                                bool flt,bool bigendian,bool xyz,int hiddenbits);
 ///
 
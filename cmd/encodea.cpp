@@ -87,7 +87,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // goes over the source image (again - not very efficient) to compute these
 // parameters. The arguments osp1...ocr2 are the output parameters for
 // the configuration of the R and S lut's as they are used by the proposal.
-static void FindEncodingParametersA(FILE *hdrin,FILE *ldrin,
+// Returns false if the images could not be read.
+static bool FindEncodingParametersA(FILE *hdrin,FILE *ldrin,
                                     const UWORD *hdrtoldrmap,
                                     int w,int h,int count,
                                     bool bigendian,int riddenbits,
@@ -154,9 +155,9 @@ static void FindEncodingParametersA(FILE *hdrin,FILE *ldrin,
         bldr = gldr;
       }
       // 
-      if (bldr < 0 || isnan(bf)) {
+      if (bldr < 0 || feof(hdrin)) {
         fprintf(stderr,"Error reading the image");
-        exit(20);
+        return false;
       }
         
       // Get the output mapping of the LDR map, i.e. after application
@@ -236,9 +237,9 @@ static void FindEncodingParametersA(FILE *hdrin,FILE *ldrin,
         rldr = gldr;
       }  
       //
-      if (bldr < 0 || isnan(bf)) {
+      if (bldr < 0 || feof(hdrin)) {
         fprintf(stderr,"Error reading the image");
-        exit(20);
+        return false;
       }
       //
       // If the ldr values got clipped, ignore.
@@ -320,25 +321,28 @@ static void FindEncodingParametersA(FILE *hdrin,FILE *ldrin,
   ocb2 = cbp2;
   ocr1 = crp1;
   ocr2 = crp2;
+
+  return true;
 }
 ///
 
 /// EncodeA
 // Encode an image in profile A, filling in all the parameters the codec needs.
-void EncodeA(const char *source,const char *ldrsource,const char *target,
-             int quality,int hdrquality,
-             int tabletype,int residualtt,int colortrafo,
-             bool progressive,bool rprogressive,
-             int hiddenbits,int residualhiddenbits,bool optimize,
-             bool openloop,bool deadzone,bool lagrangian,bool dering,
-             bool noclamp,double gamma,bool median,int smooth,
-             const char *sub,const char *resub,
-             const char *alpha,int alphamode,int matte_r,int matte_g,int matte_b,
-             bool alpharesiduals,int alphaquality,int alphahdrquality,
-             int alphatt,int residualalphatt,
-             int ahiddenbits,int ariddenbits,int aresprec,
-             bool aopenloop,bool adeadzone,bool alagrangian,bool adering,
-             bool aserms,bool abypass)
+// Returns zero on success, or an error code for the command line.
+int EncodeA(const char *source,const char *ldrsource,const char *target,
+            int quality,int hdrquality,
+            int tabletype,int residualtt,int colortrafo,
+            bool progressive,bool rprogressive,
+            int hiddenbits,int residualhiddenbits,bool optimize,
+            bool openloop,bool deadzone,bool lagrangian,bool dering,
+            bool noclamp,double gamma,bool median,int smooth,
+            const char *sub,const char *resub,
+            const char *alpha,int alphamode,int matte_r,int matte_g,int matte_b,
+            bool alpharesiduals,int alphaquality,int alphahdrquality,
+            int alphatt,int residualalphatt,
+            int ahiddenbits,int ariddenbits,int aresprec,
+            bool aopenloop,bool adeadzone,bool alagrangian,bool adering,
+            bool aserms,bool abypass)
 {
   struct JPG_TagItem pscan1[] = { // standard progressive scan, first scan.
     JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_START,0),
@@ -399,6 +403,7 @@ void EncodeA(const char *source,const char *ldrsource,const char *target,
   UWORD alphaldrtohdr[65536];  // the TMO for alpha (if required)
   FLOAT tonemapping[256];      // in case we do not simply use the gamma map to generate the inverse TMO
   FLOAT *invtmo = NULL;        // the parameter to be pushed into the core code. NULL for traditional gamma.
+  int result    = 20;
 
   if (sub) {
     ParseSubsamplingFactors(subx,suby,sub,4);
@@ -411,7 +416,7 @@ void EncodeA(const char *source,const char *ldrsource,const char *target,
     fprintf(stderr,
             "*** hidden bits in the LDR domain are currently not supported\n"
             "*** by this encoder with profile A configuration.\n");
-    exit(20);
+    return 20;
   }
   //
   // Fill the TMO with the default value. This is the sRGB 2.4 gamma
@@ -440,10 +445,11 @@ void EncodeA(const char *source,const char *ldrsource,const char *target,
     //
     FILE *in    = OpenPNMFile(source,width,height,depth,prec,flt,big);
     if (in) {
+      bool ready = true; // set to false if the source cannot be used.
       if (!flt) {
         fprintf(stderr,"Profile A only handles floating point images, cannot encode integer images.\n");
         fclose(in);
-        exit(20);
+        return 20;
       }
       // Now one of the following can happen: Either we have an LDR image and use that,
       // or we compute an automatic TMO similar to what profile C does.
@@ -484,27 +490,30 @@ void EncodeA(const char *source,const char *ldrsource,const char *target,
       // Check whether we can create a Reinhard TMO if we have no LDR source.
       if (ldrin == NULL) {
         UWORD ldrtohdr[65536];
-        BuildToneMapping_C(in,width,height,prec,depth,ldrtohdr,flt,big,false,0);
+        ready = BuildToneMapping_C(in,width,height,prec,depth,ldrtohdr,flt,big,false,0);
         InvertTable(ldrtohdr,hdrtoldr,8,16);
       } else if (gamma == 0.0) {
         // Here the user requested to build a custom TMO instead of the
         // default LDR to HDR gamma map.
-        BuildToneMappingFromLDR(in,ldrin,width,height,depth,tonemapping,big,median,noclamp,smooth);
+        ready  = BuildToneMappingFromLDR(in,ldrin,width,height,depth,tonemapping,big,median,noclamp,smooth);
         invtmo = tonemapping;
       }
       //
       // Check for the alpha channel.
-      if (alpha) {
+      if (alpha && ready) {
         alphain = PrepareAlphaForRead(alpha,width,height,alphaprec,alphaflt,alphabig,
                                       alpharesiduals,ahiddenbits,alphaldrtohdr);
+        if (alphain == NULL)
+          ready = false;
       }
       //
       // Get now the scaling parameters for the Q tables and the S-table.
       {
-        double osp1,osp2,ocb1,ocb2,ocr1,ocr2;
-        FILE *out;
-        FindEncodingParametersA(in,ldrin,hdrtoldr,width,height,depth,big,residualhiddenbits,
-                                osp1,osp2,ocb1,ocb2,ocr1,ocr2,tonemapping);
+        double osp1 = 0.0,osp2 = 0.0,ocb1 = 0.0,ocb2 = 0.0,ocr1 = 0.0,ocr2 = 0.0;
+        FILE *out   = NULL;
+        if (ready)
+          ready = FindEncodingParametersA(in,ldrin,hdrtoldr,width,height,depth,big,residualhiddenbits,
+                                          osp1,osp2,ocb1,ocb2,ocr1,ocr2,tonemapping);
         //
         // Convert to the proper range. Use the simplified formulas from
         // Annex F.
@@ -516,7 +525,8 @@ void EncodeA(const char *source,const char *ldrsource,const char *target,
         double spmin = osp1;
         double spmax = osp2;
         //
-        out = fopen(target,"wb");
+        if (ready)
+          out = fopen(target,"wb");
         if (out) {
           int frametype    = JPGFLAG_SEQUENTIAL;
           int aframetype;
@@ -719,6 +729,8 @@ void EncodeA(const char *source,const char *ldrsource,const char *target,
             UBYTE *alphamem     = NULL;
             if (mem) {
               bmm.bmm_pMemPtr      = mem + width * 8 * depth;
+              bmm.bmm_ulOpenComponents = 0;
+              bmm.bmm_bAlphaOpen       = false;
               bmm.bmm_pAlphaPtr    = NULL;
               bmm.bmm_pAlphaSource = NULL;
               bmm.bmm_pLDRMemPtr   = mem;
@@ -781,6 +793,8 @@ void EncodeA(const char *source,const char *ldrsource,const char *target,
                 const char *error;
                 int code = jpeg->LastError(error);
                 fprintf(stderr,"writing a JPEG file failed - error %d - %s\n",code,error);
+              } else {
+                result = 0;
               }
               if (alphamem)
                 free(alphamem);
@@ -796,15 +810,19 @@ void EncodeA(const char *source,const char *ldrsource,const char *target,
           fprintf(stderr,"failed to create a JPEG object");
           }
           fclose(out);
-        } else {
+        } else if (ready) {
           perror("unable to open the output file");
         }
         fclose(in);
         if (ldrin)
           fclose(ldrin);
+        if (alphain)
+          fclose(alphain);
       }
     }
   }
+
+  return result;
 }         
 ///
 
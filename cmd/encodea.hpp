@@ -68,20 +68,21 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 /// Prototypes
 // Encode an image in profile A, filling in all the parameters the codec needs.
-extern void EncodeA(const char *source,const char *ldrsource,const char *target,
-                    int quality,int hdrquality,
-                    int tabletype,int residualtt,int colortrafo,
-                    bool progressive,bool rprogressive,
-                    int hiddenbits,int residualhiddenbits,bool optimize,
-                    bool openloop,bool deadzone,bool lagrangian,bool dering,
-                    bool noclamp,double gamma,bool median,int smooth,
-                    const char *sub,const char *resub,
-                    const char *alpha,int alphamode,int matte_r,int matte_g,int matte_b,
-                    bool alpharesiduals,int alphaquality,int alphahdrquality,
-                    int alphatt,int residualalphatt,
-                    int ahiddenbits,int ariddenbits,int aresprec,
-                    bool aoopenloop,bool adeadzone,bool alagrangian,bool adering,
-                    bool aserms,bool abypass);
+// Returns zero on success, or an error code for the command line.
+extern int EncodeA(const char *source,const char *ldrsource,const char *target,
+                   int quality,int hdrquality,
+                   int tabletype,int residualtt,int colortrafo,
+                   bool progressive,bool rprogressive,
+                   int hiddenbits,int residualhiddenbits,bool optimize,
+                   bool openloop,bool deadzone,bool lagrangian,bool dering,
+                   bool noclamp,double gamma,bool median,int smooth,
+                   const char *sub,const char *resub,
+                   const char *alpha,int alphamode,int matte_r,int matte_g,int matte_b,
+                   bool alpharesiduals,int alphaquality,int alphahdrquality,
+                   int alphatt,int residualalphatt,
+                   int ahiddenbits,int ariddenbits,int aresprec,
+                   bool aoopenloop,bool adeadzone,bool alagrangian,bool adering,
+                   bool aserms,bool abypass);
 //
 // Provide a useful default for splitting the quality between LDR and HDR.
 extern void SplitQualityA(int splitquality,int &quality,int &hdrquality);
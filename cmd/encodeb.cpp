@@ -79,7 +79,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /// FindEncodingParametersB
 // This call here finds the encoding parameters for the mult2 aka Trellis XDepth proposal
 // It computes a suitable HDR gamma from the input file and the exposure value.
-static void FindEncodingParametersB(FILE *in,FILE *ldrin,int w,int h,int count,
+// Returns false if the images could not be read.
+static bool FindEncodingParametersB(FILE *in,FILE *ldrin,int w,int h,int count,
                                     bool flt,bool bigendian,double &exposure,double efac,
                                     double &gamma_hdr,double epsnum,double epsdenum,
                                     double &minr,double &maxr,
@@ -95,10 +96,11 @@ static void FindEncodingParametersB(FILE *in,FILE *ldrin,int w,int h,int count,
   double gamma_out;
   const double scale   = 1.0 / 65535.0;
   const double ptfive  = 32768.0 / 65535.0; // the offset the code adds. Almost 0.5.
+  bool ok              = true;
   
   if (!flt) {
     fprintf(stderr,"the mult2 code works only for floating point input samples\n"); 
-    exit(20);
+    return false;
   }
 
   if (exposure <= 0.0) {
@@ -112,9 +114,9 @@ static void FindEncodingParametersB(FILE *in,FILE *ldrin,int w,int h,int count,
       }
     }
 
-    if (isnan(av)) {
+    if (feof(in)) {
       fprintf(stderr,"Error reading the source image.\n");
-      exit(20);
+      return false;
     }
     
     av      /= double(count) * w * h;
@@ -171,9 +173,9 @@ static void FindEncodingParametersB(FILE *in,FILE *ldrin,int w,int h,int count,
       for(x = 0;x < w;x++) {
         for(i = 0;i < count;i++) {
           float px = readFloat(in,bigendian) * factor;
-          if (isnan(px)) {
+          if (feof(in)) {
             fprintf(stderr,"Error reading the source image.\n");
-            exit(20);
+            return false;
           }
           if (px > 0.00001) {
             double curval = 1.0 / px;
@@ -273,8 +275,10 @@ static void FindEncodingParametersB(FILE *in,FILE *ldrin,int w,int h,int count,
     // Test for errors.
     if (ferror(ldrin) || ferror(in)) {
       perror("unable to read source images");
+      ok = false;
     } else if (feof(ldrin) || feof(in)) {
       fprintf(stderr,"Unexpected end of file when reading source images\n");
+      ok = false;
     } else {
       if (r1 > r0) {
         minr = r0 - epsdenum;
@@ -294,25 +298,28 @@ static void FindEncodingParametersB(FILE *in,FILE *ldrin,int w,int h,int count,
   //
   // Rewind to the file where we started.
   fseek(in,pos,SEEK_SET);
+
+  return ok;
 }
 ///
 
 /// EncodeB
 // Encode an image in profile A, filling in all the parameters the codec needs.
-void EncodeB(const char *source,const char *ldr,const char *target,
-             double exposure,double autoexposure,double gamma,
-             double epsnum,double epsdenum,bool median,int smooth,bool linearres,
-             int quality,int hdrquality,int tabletype,int residualtt,
-             int colortrafo,bool progressive,bool rprogressive,
-             int hiddenbits,int residualhiddenbits,bool optimize,
-             bool openloop,bool deadzone,bool lagrangian,bool dering,
-             bool noclamp,const char *sub,const char *resub,
-             const char *alpha,int alphamode,int matte_r,int matte_g,int matte_b,
-             bool alpharesiduals,int alphaquality,int alphahdrquality,
-             int alphatt,int residualalphatt,
-             int ahiddenbits,int ariddenbits,int aresprec,
-             bool aopenloop,bool adeadzone,bool alagrangian,bool adering,
-             bool aserms,bool abypass)
+// Returns zero on success, or an error code for the command line.
+int EncodeB(const char *source,const char *ldr,const char *target,
+            double exposure,double autoexposure,double gamma,
+            double epsnum,double epsdenum,bool median,int smooth,bool linearres,
+            int quality,int hdrquality,int tabletype,int residualtt,
+            int colortrafo,bool progressive,bool rprogressive,
+            int hiddenbits,int residualhiddenbits,bool optimize,
+            bool openloop,bool deadzone,bool lagrangian,bool dering,
+            bool noclamp,const char *sub,const char *resub,
+            const char *alpha,int alphamode,int matte_r,int matte_g,int matte_b,
+            bool alpharesiduals,int alphaquality,int alphahdrquality,
+            int alphatt,int residualalphatt,
+            int ahiddenbits,int ariddenbits,int aresprec,
+            bool aopenloop,bool adeadzone,bool alagrangian,bool adering,
+            bool aserms,bool abypass)
 {  
   struct JPG_TagItem pscan1[] = { // standard progressive scan, first scan.
     JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_START,0),
@@ -373,6 +380,7 @@ void EncodeB(const char *source,const char *ldr,const char *target,
   UWORD alphaldrtohdr[65536]; // the TMO for alpha (if required)
   FLOAT tonemapping[256];
   FLOAT *invtmo = NULL;
+  int result    = 20;
 
   if (sub) {
     ParseSubsamplingFactors(subx,suby,sub,4);
@@ -385,7 +393,7 @@ void EncodeB(const char *source,const char *ldr,const char *target,
     fprintf(stderr,
             "*** hidden bits in the LDR domain are currently not supported\n"
             "*** by this encoder with profile B configuration.\n");
-    exit(20);
+    return 20;
   }
   //
   // Fill the TMO with the default value. This is 2.4 gamma with
@@ -423,10 +431,11 @@ void EncodeB(const char *source,const char *ldr,const char *target,
     // Get the source file.
     FILE *in    = OpenPNMFile(source,width,height,depth,prec,flt,big);
     if (in) {
+      bool ready = true; // set to false if the source cannot be used.
       if (!flt) {
         fprintf(stderr,"Profile B only handles floating point images, cannot encode integer images.\n");
         fclose(in);
-        exit(20);
+        return 20;
       }
       //
       // Profile B supports now LDR images as input. If none is available, it falls back to the old
@@ -468,24 +477,27 @@ void EncodeB(const char *source,const char *ldr,const char *target,
       } else if (ldrin && gamma == 0.0) {
         // This is a new mode that is outside of profile B. It uses a profile-C
         // type of inverse TMO instead of gamma.
-        BuildToneMappingFromLDR(in,ldrin,width,height,depth,tonemapping,big,median,noclamp,smooth);
+        ready  = BuildToneMappingFromLDR(in,ldrin,width,height,depth,tonemapping,big,median,noclamp,smooth);
         invtmo = tonemapping;
       }
       //
       // Check for the alpha channel.
-      if (alpha) {
+      if (alpha && ready) {
         alphain = PrepareAlphaForRead(alpha,width,height,alphaprec,alphaflt,alphabig,
                                       alpharesiduals,ahiddenbits,alphaldrtohdr);
+        if (alphain == NULL)
+          ready = false;
       }
       //
       // Only if we know the width, height depth and scale of the image.
       // Note that profile B does not (yet?) handle the case of an LDR image.
-      FindEncodingParametersB(in,ldrin,width,height,depth,true,big,exposure,autoexposure,gamma_hdr,
-                              epsnum,epsdenum,
-                              minr,maxr,ming,maxg,minb,maxb,tonemapping,linearres);
+      if (ready)
+        ready = FindEncodingParametersB(in,ldrin,width,height,depth,true,big,exposure,autoexposure,gamma_hdr,
+                                        epsnum,epsdenum,
+                                        minr,maxr,ming,maxg,minb,maxb,tonemapping,linearres);
       //
       // Create the output file.
-      FILE *out = fopen(target,"wb");
+      FILE *out = (ready)?(fopen(target,"wb")):(NULL);
       if (out) {
         int frametype    = JPGFLAG_SEQUENTIAL;
         int aframetype;
@@ -718,6 +730,8 @@ void EncodeB(const char *source,const char *ldr,const char *target,
           UBYTE *alphamem     = NULL;
           if (mem) {
             bmm.bmm_pMemPtr      = mem + width * 8 * depth;
+            bmm.bmm_ulOpenComponents = 0;
+            bmm.bmm_bAlphaOpen       = false;
             bmm.bmm_pAlphaPtr    = NULL;
             bmm.bmm_pAlphaSource = NULL;
             bmm.bmm_pLDRMemPtr   = (ldrin)?(mem):(NULL);
@@ -780,6 +794,8 @@ void EncodeB(const char *source,const char *ldr,const char *target,
                 const char *error;
                 int code = jpeg->LastError(error);
                 fprintf(stderr,"writing a JPEG file failed - error %d - %s\n",code,error);
+              } else {
+                result = 0;
               }
               if (alphamem)
                 free(alphamem);
@@ -795,14 +811,18 @@ void EncodeB(const char *source,const char *ldr,const char *target,
           fprintf(stderr,"failed to create a JPEG object");
         }
         fclose(out);
-      } else {
+      } else if (ready) {
           perror("unable to open the output file");
       }
+      if (alphain)
+        fclose(alphain);
       if (ldrin)
         fclose(ldrin);
       fclose(in);
     }
   }
+
+  return result;
 }
 ///
 
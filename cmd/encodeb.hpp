@@ -67,22 +67,24 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ///
 
 /// Prototypes
-extern void EncodeB(const char *source,const char *ldr,const char *target,
-                    double exposure,double autoexposure,double gamma,
-                    double epsnum,double epsdenum,bool median,int smooth,
-                    bool linearres,
-                    int quality,int hdrquality,
-                    int tabletype,int residualtt,
-                    int colortrafo,bool progressive,bool rprogressive,
-                    int hiddenbits,int residualhiddenbits,bool optimize,
-                    bool openloop,bool deadzone,bool lagrangian,bool dering,
-                    bool noclamp,const char *sub,const char *resub,
-                    const char *alpha,int alphamode,int matte_r,int matte_g,int matte_b,
-                    bool alpharesiduals,int alphaquality,int alphahdrquality,
-                    int alphatt,int residualalphatt,
-                    int ahiddenbits,int ariddenbits,int aresprec,
-                    bool aopenloop,bool adeadzone,bool alagrangian,bool adering,
-                    bool aserms,bool abypass);
+// Encode an image in profile B. Returns zero on success, or an error
+// code for the command line.
+extern int EncodeB(const char *source,const char *ldr,const char *target,
+                   double exposure,double autoexposure,double gamma,
+                   double epsnum,double epsdenum,bool median,int smooth,
+                   bool linearres,
+                   int quality,int hdrquality,
+                   int tabletype,int residualtt,
+                   int colortrafo,bool progressive,bool rprogressive,
+                   int hiddenbits,int residualhiddenbits,bool optimize,
+                   bool openloop,bool deadzone,bool lagrangian,bool dering,
+                   bool noclamp,const char *sub,const char *resub,
+                   const char *alpha,int alphamode,int matte_r,int matte_g,int matte_b,
+                   bool alpharesiduals,int alphaquality,int alphahdrquality,
+                   int alphatt,int residualalphatt,
+                   int ahiddenbits,int ariddenbits,int aresprec,
+                   bool aopenloop,bool adeadzone,bool alagrangian,bool adering,
+                   bool aserms,bool abypass);
 //
 extern void SplitQualityB(int splitquality,int &quality,int &hdrquality);
 ///
@@ -82,26 +82,28 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ///
 
 /// EncodeC
-void EncodeC(const char *source,const char *ldrsource,const char *target,const char *ltable,
-             int quality,int hdrquality,
-             int tabletype,int residualtt,int maxerror,
-             int colortrafo,bool lossless,bool progressive,
-             bool residual,bool optimize,bool accoding,
-             bool rsequential,bool rprogressive,bool raccoding,
-             bool qscan,UBYTE levels,bool pyramidal,bool writednl,UWORD restart,double gamma,
-             int lsmode,bool noiseshaping,bool serms,bool losslessdct,
-             bool openloop,bool deadzone,bool lagrangian,bool dering,
-             bool xyz,bool cxyz,
-             int hiddenbits,int riddenbits,int resprec,bool separate,
-             bool median,bool noclamp,int smooth,
-             bool dctbypass,
-             const char *sub,const char *ressub,
-             const char *alpha,int alphamode,int matte_r,int matte_g,int matte_b,
-             bool alpharesiduals,int alphaquality,int alphahdrquality,
-             int alphatt,int residualalphatt,
-             int ahiddenbits,int ariddenbits,int aresprec,
-             bool aopenloop,bool adeadzone,bool alagrangian,bool adering,
-             bool aserms,bool abypass)
+// Encode an image in profile C. Returns zero on success, or an error
+// code for the command line.
+int EncodeC(const char *source,const char *ldrsource,const char *target,const char *ltable,
+            int quality,int hdrquality,
+            int tabletype,int residualtt,int maxerror,
+            int colortrafo,bool lossless,bool progressive,
+            bool residual,bool optimize,bool accoding,
+            bool rsequential,bool rprogressive,bool raccoding,
+            bool qscan,UBYTE levels,bool pyramidal,bool writednl,UWORD restart,double gamma,
+            int lsmode,bool noiseshaping,bool serms,bool losslessdct,
+            bool openloop,bool deadzone,bool lagrangian,bool dering,
+            bool xyz,bool cxyz,
+            int hiddenbits,int riddenbits,int resprec,bool separate,
+            bool median,bool noclamp,int smooth,
+            bool dctbypass,
+            const char *sub,const char *ressub,
+            const char *alpha,int alphamode,int matte_r,int matte_g,int matte_b,
+            bool alpharesiduals,int alphaquality,int alphahdrquality,
+            int alphatt,int residualalphatt,
+            int ahiddenbits,int ariddenbits,int aresprec,
+            bool aopenloop,bool adeadzone,bool alagrangian,bool adering,
+            bool aserms,bool abypass,bool stream,int threads)
 { 
   struct JPG_TagItem pscan1[] = { // standard progressive scan, first scan.
     JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_START,0),
@@ -213,6 +215,7 @@ void EncodeC(const char *source,const char *ldrsource,const char *target,const c
   UWORD hdrtoldr[65536]; // Its inverse. This table is used to construct the legacy image.
   UWORD alphaldrtohdr[65536]; // the TMO for alpha (if required)
   const UWORD *tonemapping = NULL; // points to the above if used.
+  int result = 20;
   UBYTE subx[4],suby[4];
   UBYTE ressubx[4],ressuby[4];
   memset(subx,1,sizeof(subx));
@@ -239,6 +242,7 @@ void EncodeC(const char *source,const char *ldrsource,const char *target,const c
     FILE *alphain  = NULL;
     FILE *in       = OpenPNMFile(source,width,height,depth,prec,flt,big);
     if (in) {
+      bool ready   = true; // set to false if the source cannot be used.
       if (ldrsource) {
         int ldrdepth  = 0;
         int ldrwidth  = 0;
@@ -288,13 +292,13 @@ void EncodeC(const char *source,const char *ldrsource,const char *target,const c
           if (gamma <= 0.0) {
             if (ldrin != NULL) {
               if (separate) {
-                BuildRGBToneMappingFromLDR(in,ldrin,width,height,prec,depth,
-                                           red,green,blue,flt,big,xyz || cxyz,hiddenbits,
-                                           median,fullrange,smooth);
+                ready = BuildRGBToneMappingFromLDR(in,ldrin,width,height,prec,depth,
+                                                   red,green,blue,flt,big,xyz || cxyz,hiddenbits,
+                                                   median,fullrange,smooth);
               } else {
-                BuildToneMappingFromLDR(in,ldrin,width,height,prec,depth,
-                                        ldrtohdr,flt,big,xyz || cxyz,hiddenbits,
-                                        median,fullrange,smooth);
+                ready = BuildToneMappingFromLDR(in,ldrin,width,height,prec,depth,
+                                                ldrtohdr,flt,big,xyz || cxyz,hiddenbits,
+                                                median,fullrange,smooth);
               }
               if (hiddenbits)
                 printf("\n"
@@ -305,7 +309,7 @@ void EncodeC(const char *source,const char *ldrsource,const char *target,const c
               if (separate)
                 printf("Warning: -sp switch ignored, only one TMO will be used");
               separate = false; // Still to be done.
-              BuildToneMapping_C(in,width,height,prec,depth,ldrtohdr,flt,big,xyz || cxyz,hiddenbits);
+              ready = BuildToneMapping_C(in,width,height,prec,depth,ldrtohdr,flt,big,xyz || cxyz,hiddenbits);
             }
           } else {
             BuildGammaMapping(gamma,1.0,ldrtohdr,flt,(1L << prec) - 1,hiddenbits);
@@ -330,9 +334,11 @@ void EncodeC(const char *source,const char *ldrsource,const char *target,const c
         noclamp = true;
       //
       // Check for the alpha channel.
-      if (alpha) { 
+      if (alpha && ready) { 
         alphain = PrepareAlphaForRead(alpha,width,height,alphaprec,alphaflt,alphabig,
                                       alpharesiduals,ahiddenbits,alphaldrtohdr);
+        if (alphain == NULL)
+          ready = false;
       }
       // Construct the forwards tonemapping curve from inverting the
       // inverse. (-: But first check whether there is an inverse table.
@@ -352,7 +358,7 @@ void EncodeC(const char *source,const char *ldrsource,const char *target,const c
         InvertTable(ldrtohdr,hdrtoldr,8 + hiddenbits,prec);
       }
       //
-      FILE *out = fopen(target,"wb");
+      FILE *out = (ready)?(fopen(target,"wb")):(NULL);
       if (out) { 
         int frametype = JPGFLAG_SEQUENTIAL;
         int residualtype = JPGFLAG_RESIDUAL;
@@ -488,6 +494,8 @@ void EncodeC(const char *source,const char *ldrsource,const char *target,const c
             JPG_PointerTag((alpha)?JPGTAG_BIH_ALPHAHOOK:JPGTAG_TAG_IGNORE,&alphahook),
             JPG_PointerTag((residual && hiddenbits == 0 && ldrin)?JPGTAG_BIH_LDRHOOK:JPGTAG_TAG_IGNORE,&ldrhook),
             JPG_ValueTag(JPGTAG_ENCODER_LOOP_ON_INCOMPLETE,true),
+            JPG_ValueTag(JPGTAG_ENCODER_STREAM,stream),
+            JPG_ValueTag(JPGTAG_ENCODER_THREADS,threads),
             JPG_ValueTag(JPGTAG_IMAGE_WIDTH,width), 
             JPG_ValueTag(JPGTAG_IMAGE_HEIGHT,height), 
             JPG_ValueTag(JPGTAG_IMAGE_DEPTH,depth),      
@@ -622,6 +630,8 @@ void EncodeC(const char *source,const char *ldrsource,const char *target,const c
             UBYTE *alphamem = NULL;
             if (mem) {
               bmm.bmm_pMemPtr      = mem + width * 8 * depth;
+              bmm.bmm_ulOpenComponents = 0;
+              bmm.bmm_bAlphaOpen       = false;
             /* PhuNM fix issue of -ldr option affected to Q - 20190328 - Start*/
              // bmm.bmm_pLDRMemPtr   = ldrin?mem:NULL;
 			  bmm.bmm_pLDRMemPtr = mem;
@@ -677,6 +687,7 @@ void EncodeC(const char *source,const char *ldrsource,const char *target,const c
                   struct JPG_TagItem iotags[] = {
                     JPG_PointerTag(JPGTAG_HOOK_IOHOOK,&filehook),
                     JPG_PointerTag(JPGTAG_HOOK_IOSTREAM,out),
+                    JPG_ValueTag(JPGTAG_ENCODER_THREADS,threads),
 #ifdef TEST_MARKER_INJECTION                
                     // Stop after the image header...
                     JPG_ValueTag(JPGTAG_ENCODER_STOP,JPGFLAG_ENCODER_STOP_FRAME),
@@ -712,6 +723,8 @@ void EncodeC(const char *source,const char *ldrsource,const char *target,const c
                   const char *error;
                   int code = jpeg->LastError(error);
                   fprintf(stderr,"writing a JPEG file failed - error %d - %s\n",code,error);
+                } else {
+                  result = 0;
                 }
                 if (alphamem)
                   free(alphamem);
@@ -728,7 +741,7 @@ void EncodeC(const char *source,const char *ldrsource,const char *target,const c
           }
         }
         fclose(out);
-      } else {
+      } else if (ready) {
         perror("unable to open the output file");
       }
       if (alphain)
@@ -738,6 +751,8 @@ void EncodeC(const char *source,const char *ldrsource,const char *target,const c
       fclose(in);
     }
   }
+
+  return result;
 }
 ///
 
@@ -65,28 +65,30 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /// 
 
 /// Prototypes
-extern void EncodeC(const char *source,const char *ldrsource,
-                    const char *target,const char *ltable,
-                    int quality,int hdrquality,
-                    int tabletype,int residualtt,int maxerror,
-                    int colortrafo,bool lossless,bool progressive,
-                    bool residual,bool optimize,bool accoding,
-                    bool rsequential,bool rprogressive,bool raccoding,
-                    bool qscan,UBYTE levels,bool pyramidal,bool writednl,UWORD restart,
-                    double gamma,
-                    int lsmode,bool noiseshaping,bool serms,bool losslessdct,
-                    bool openloop,bool deadzone,bool lagrangian,bool dering,
-                    bool xyz,bool cxyz,
-                    int hiddenbits,int riddenbits,int resprec,bool separate,
-                    bool median,bool noclamp,int smooth,
-                    bool dctbypass,
-                    const char *sub,const char *ressub,
-                    const char *alpha,int alphamode,int matte_r,int matte_g,int matte_b,
-                    bool alpharesiduals,int alphaquality,int alphahdrquality,
-                    int alphatt,int residualalphatt,
-                    int ahiddenbits,int ariddenbits,int aresprec,
-                    bool aopenloop,bool adeadzone,bool alagrangian,bool adering,
-                    bool aserms,bool abypass);
+// Encode an image in profile C. Returns zero on success, or an error
+// code for the command line.
+extern int EncodeC(const char *source,const char *ldrsource,
+                   const char *target,const char *ltable,
+                   int quality,int hdrquality,
+                   int tabletype,int residualtt,int maxerror,
+                   int colortrafo,bool lossless,bool progressive,
+                   bool residual,bool optimize,bool accoding,
+                   bool rsequential,bool rprogressive,bool raccoding,
+                   bool qscan,UBYTE levels,bool pyramidal,bool writednl,UWORD restart,
+                   double gamma,
+                   int lsmode,bool noiseshaping,bool serms,bool losslessdct,
+                   bool openloop,bool deadzone,bool lagrangian,bool dering,
+                   bool xyz,bool cxyz,
+                   int hiddenbits,int riddenbits,int resprec,bool separate,
+                   bool median,bool noclamp,int smooth,
+                   bool dctbypass,
+                   const char *sub,const char *ressub,
+                   const char *alpha,int alphamode,int matte_r,int matte_g,int matte_b,
+                   bool alpharesiduals,int alphaquality,int alphahdrquality,
+                   int alphatt,int residualalphatt,
+                   int ahiddenbits,int ariddenbits,int aresprec,
+                   bool aopenloop,bool adeadzone,bool alagrangian,bool adering,
+                   bool aserms,bool abypass,bool stream,int threads);
 //
 // Provide a useful default for splitting the quality between LDR and HDR.
 extern void SplitQualityC(int totalquality,bool residuals,int &ldrquality,int &hdrquality);
@@ -63,50 +63,187 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "std/stdio.hpp"
 #include "std/math.hpp"
 #include "std/stdlib.hpp"
+#include "std/string.hpp"
+///
+
+/// Defines
+// Number of samples converted in one go when writing floating point
+// data. This bounds the stack buffer used for endian conversion.
+#define SAMPLE_CHUNK 1024
+///
+
+/// NeedsSwap
+// Return true if data in the indicated file endianness requires a byte swap
+// on the host.
+static inline bool NeedsSwap(bool bigendian)
+{
+#ifdef JPG_LIL_ENDIAN
+  return bigendian;
+#else
+  return !bigendian;
+#endif
+}
+///
+
+/// SwapLongSamples
+// Swap the bytes of count 32-bit samples in place. The loop is simple
+// enough to be vectorized by the compiler.
+static void SwapLongSamples(ULONG_ALIASED *data,ULONG count)
+{
+  ULONG i;
+
+  for(i = 0;i < count;i++) {
+    ULONG v = data[i];
+    data[i] = (v >> 24) | ((v >> 8) & 0xff00UL) | ((v << 8) & 0xff0000UL) | (v << 24);
+  }
+}
+///
+
+/// SwapWordSamples
+// Swap the bytes of count 16-bit samples in place.
+void SwapWordSamples(UWORD *data,ULONG count)
+{
+  ULONG i;
+  
+  for(i = 0;i < count;i++) {
+    data[i] = UWORD((data[i] >> 8) | (data[i] << 8));
+  }
+}
+///
+
+/// ReadFloatSamples
+// Read count IEEE floating point samples from a PFM file in one go
+// into the given buffer, converting from the file endianness to the
+// native endianness. Returns false if the file ended prematurely. Then
+// the missing samples are filled with NaNs as readFloat would do.
+bool ReadFloatSamples(FILE *in,FLOAT *data,ULONG count,bool bigendian)
+{
+  ULONG avail = fread(data,sizeof(FLOAT),count,in);
+
+  if (NeedsSwap(bigendian))
+    SwapLongSamples((ULONG_ALIASED *)data,avail);
+
+  if (avail < count) {
+    FLOAT nan = FLOAT(::nan(""));
+    do {
+      data[avail] = nan;
+    } while(++avail < count);
+    return false;
+  }
+
+  return true;
+}
+///
+
+/// ReadHalfSamples
+// Read count IEEE floating point samples from a PFM file and convert
+// them to half-float bit patterns. Returns false if the file ended
+// prematurely.
+bool ReadHalfSamples(FILE *in,UWORD *data,ULONG count,bool bigendian)
+{
+  FLOAT buffer[SAMPLE_CHUNK];
+  bool ok = true;
+
+  while(count) {
+    ULONG chunk = (count > SAMPLE_CHUNK)?(SAMPLE_CHUNK):(count);
+    ULONG i;
+    ok &= ReadFloatSamples(in,buffer,chunk,bigendian);
+    for(i = 0;i < chunk;i++) {
+      data[i] = FloatToHalf(buffer[i]);
+    }
+    data  += chunk;
+    count -= chunk;
+  }
+
+  return ok;
+}
+///
+
+/// WriteFloatSamples
+// Write count floating point samples to a PFM file in the requested
+// endianness. The source buffer is not altered.
+void WriteFloatSamples(FILE *out,const FLOAT *data,ULONG count,bool bigendian)
+{
+  if (!NeedsSwap(bigendian)) {
+    fwrite(data,sizeof(FLOAT),count,out);
+  } else {
+    FLOAT buffer[SAMPLE_CHUNK];
+    while(count) {
+      ULONG chunk = (count > SAMPLE_CHUNK)?(SAMPLE_CHUNK):(count);
+      memcpy(buffer,data,chunk * sizeof(FLOAT));
+      SwapLongSamples((ULONG_ALIASED *)buffer,chunk);
+      fwrite(buffer,sizeof(FLOAT),chunk,out);
+      data  += chunk;
+      count -= chunk;
+    }
+  }
+}
+///
+
+/// WriteHalfSamples
+// Write count half-float samples as IEEE single precision floating point
+// samples to a PFM file in the requested endianness.
+void WriteHalfSamples(FILE *out,const UWORD *data,ULONG count,bool bigendian)
+{
+  FLOAT buffer[SAMPLE_CHUNK];
+  bool swap = NeedsSwap(bigendian);
+  
+  while(count) {
+    ULONG chunk = (count > SAMPLE_CHUNK)?(SAMPLE_CHUNK):(count);
+    ULONG i;
+    for(i = 0;i < chunk;i++) {
+      buffer[i] = HalfToFloat(data[i]);
+    }
+    if (swap)
+      SwapLongSamples((ULONG_ALIASED *)buffer,chunk);
+    fwrite(buffer,sizeof(FLOAT),chunk,out);
+    data  += chunk;
+    count -= chunk;
+  }
+}
 ///
 
 /// ReadRGBTriple
-// Read an RGB triple from the stream, convert properly.
+// Read an RGB triple from the stream, convert properly. Sets warn if
+// out of gamut samples were clamped. Returns false and prints an error
+// if the stream could not be read.
 bool ReadRGBTriple(FILE *in,int &r,int &g,int &b,double &y,int depth,int count,
-                   bool flt,bool bigendian,bool xyz)
+                   bool flt,bool bigendian,bool xyz,bool &warn)
 { 
-  bool warn = false;
-  
   // Read the HDR image parameters.
   if (count == 3) {
     if (flt) { 
       double rf,gf,bf;
+      FLOAT v[3];
+      // Read all three samples at once, this is considerably faster
+      // than going through stdio sample by sample. Check the result
+      // rather than testing for NaNs, which -ffast-math folds away.
+      if (!ReadFloatSamples(in,v,3,bigendian)) {
+        fprintf(stderr,"Error reading the source file\n");
+        return false;
+      }
       if (xyz) {
         double xf,yf,zf;
         // Convert from XYZ to RGB (the same colorspace as the LDR)
-        xf = readFloat(in,bigendian);
-        yf = readFloat(in,bigendian);
-        zf = readFloat(in,bigendian); 
+        xf = v[0];
+        yf = v[1];
+        zf = v[2];
         if (xf < 0.0) xf = 0.0, warn = true;
         if (yf < 0.0) yf = 0.0, warn = true;
         if (zf < 0.0) zf = 0.0, warn = true;
         //
-        if (isnan(zf)) {
-          fprintf(stderr,"Error reading the source file\n");
-          exit(20);
-        }
-        //
         // Convert from XYZ to RGB (the same colorspace as the LDR)
         rf = xf *  3.2404542 + yf * -1.5371385 + zf * -0.4985314;
         gf = xf * -0.9692660 + yf *  1.8760108 + zf *  0.0415560;
         bf = xf *  0.0556434 + yf * -0.2040259 + zf *  1.0570000;
       } else { 
-        rf = readFloat(in,bigendian);
-        gf = readFloat(in,bigendian);
-        bf = readFloat(in,bigendian);
+        rf = v[0];
+        gf = v[1];
+        bf = v[2];
         //
         if (rf < 0.0) rf = 0.0, warn = true;
         if (gf < 0.0) gf = 0.0, warn = true;
         if (bf < 0.0) bf = 0.0, warn = true;
-        if (isnan(bf)) {
-          fprintf(stderr,"Error reading the source file\n");
-          exit(20);
-        }
       }
 	/* PhuNM fix from ITU 709 to 601 - 20190328 - Start*/
 	#if 0
@@ -120,22 +257,28 @@ bool ReadRGBTriple(FILE *in,int &r,int &g,int &b,double &y,int depth,int count,
       b  = DoubleToHalf(bf);
     } else {
       int max = (1l << depth) - 1;
-      // Integer samples, three components
+      UBYTE raw[3 * sizeof(UWORD)];
+      // Integer samples, three components, read in one go.
       if (depth <= 8) {
-        r = getc(in);
-        g = getc(in);
-        b = getc(in);
+        if (fread(raw,sizeof(UBYTE),3,in) == 3) {
+          r = raw[0];
+          g = raw[1];
+          b = raw[2];
+        } else {
+          b = -1;
+        }
       } else {
-        r  = getc(in) << 8;
-        r |= getc(in);
-        g  = getc(in) << 8;
-        g |= getc(in);
-        b  = getc(in) << 8;
-        b |= getc(in);
+        if (fread(raw,sizeof(UWORD),3,in) == 3) {
+          r = (raw[0] << 8) | raw[1];
+          g = (raw[2] << 8) | raw[3];
+          b = (raw[4] << 8) | raw[5];
+        } else {
+          b = -1;
+        }
       }
       if (b < 0) {
         fprintf(stderr,"Error reading the source file\n");
-        exit(20);
+        return false;
       }
 	  /* PhuNM fix from ITU 709 to 601 - 20190328 - Start*/
 #if 0
@@ -170,7 +313,12 @@ bool ReadRGBTriple(FILE *in,int &r,int &g,int &b,double &y,int depth,int count,
   } else {
     if (flt) {
       double gf;
-      gf = readFloat(in,bigendian);
+      FLOAT v;
+      if (!ReadFloatSamples(in,&v,1,bigendian)) {
+        fprintf(stderr,"Error reading the source file\n");
+        return false;
+      }
+      gf = v;
       if (gf < 0.0) gf = 0.0, warn = true;
       g  = DoubleToHalf(gf);
       y  = gf;
@@ -181,13 +329,17 @@ bool ReadRGBTriple(FILE *in,int &r,int &g,int &b,double &y,int depth,int count,
         g  = getc(in) << 8;
         g |= getc(in);
       }
+      if (feof(in)) {
+        fprintf(stderr,"Error reading the source file\n");
+        return false;
+      }
       y = double(g) / ((1L << depth) - 1);
     }
     r = g;
     b = g;
   } 
 
-  return warn;
+  return true;
 }
 ///
 
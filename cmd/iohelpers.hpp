@@ -183,8 +183,98 @@ void inline writeFloat(FILE *out,FLOAT f,bool bigendian)
 }
 ///
 
-// Read an RGB triple from the stream, convert properly.
-extern bool ReadRGBTriple(FILE *in,int &r,int &g,int &b,double &y,int depth,int count,bool flt,bool bigendian,bool xyz);
+/// FloatToHalf
+// Convert a single precision float to half-precision IEEE by bit
+// manipulation. This truncates exactly as DoubleToHalf does, hence
+// generates the same bit-pattern, but does not require frexp and can
+// be used in tight conversion loops.
+UWORD inline FloatToHalf(FLOAT f)
+{
+  union {
+    ULONG long_buf;
+    FLOAT float_buf;
+  } u;
+  ULONG sign,mant;
+  LONG  exponent;
+
+  u.float_buf = f;
+  // Negative zero is mapped to positive zero by DoubleToHalf.
+  if ((u.long_buf & 0x7fffffffUL) == 0)
+    return 0;
+  
+  sign     = (u.long_buf >> 16) & 0x8000;
+  exponent = LONG((u.long_buf >> 23) & 0xff) - 127 + 15;
+  mant     = u.long_buf & ((1UL << 23) - 1);
+
+  if (exponent >= 31) // Includes INF. Everything that is too large becomes INF.
+    return sign | (31 << 10);
+  if (exponent <= 0) {
+    // Denormalized half, or even zero. Truncate the mantissa with the
+    // implicit one bit.
+    if (exponent < -10)
+      return sign;
+    return sign | ((mant | (1UL << 23)) >> (14 - exponent));
+  }
+
+  return sign | (exponent << 10) | (mant >> 13);
+}
+///
+
+/// HalfToFloat
+// Convert a half-float bit pattern to single precision, generating
+// the same result as HalfToDouble, but without ldexp.
+FLOAT inline HalfToFloat(UWORD h)
+{
+  union {
+    ULONG long_buf;
+    FLOAT float_buf;
+  } u;
+  ULONG exponent = (h >> 10) & ((1 << 5) - 1);
+  ULONG mantissa = h & ((1 << 10) - 1);
+
+  if (exponent == 0) {
+    // Denormalized: This is exactly representable as float.
+    FLOAT v = FLOAT(mantissa) * (1.0f / FLOAT(1UL << 24));
+    return (h & 0x8000)?(-v):(v);
+  } else if (exponent == 31) {
+    // HalfToDouble maps NaNs to INF as well.
+    u.long_buf = 0xffUL << 23;
+  } else {
+    u.long_buf = ((exponent - 15 + 127) << 23) | (mantissa << 13);
+  }
+  u.long_buf |= ULONG(h & 0x8000) << 16;
+
+  return u.float_buf;
+}
+///
+
+// Read count IEEE floating point samples from a PFM file in one go
+// into the given buffer, converting from the file endianness to the
+// native endianness. Returns false if the file ended prematurely. Then
+// the missing samples are filled with NaNs as readFloat would do.
+extern bool ReadFloatSamples(FILE *in,FLOAT *data,ULONG count,bool bigendian);
+//
+// Read count IEEE floating point samples from a PFM file and convert
+// them to half-float bit patterns. Returns false if the file ended
+// prematurely.
+extern bool ReadHalfSamples(FILE *in,UWORD *data,ULONG count,bool bigendian);
+//
+// Write count floating point samples to a PFM file in the requested
+// endianness. The source buffer is not altered.
+extern void WriteFloatSamples(FILE *out,const FLOAT *data,ULONG count,bool bigendian);
+//
+// Write count half-float samples as IEEE single precision floating point
+// samples to a PFM file in the requested endianness.
+extern void WriteHalfSamples(FILE *out,const UWORD *data,ULONG count,bool bigendian);
+//
+// Swap the bytes of count 16-bit samples in place.
+extern void SwapWordSamples(UWORD *data,ULONG count);
+//
+// Read an RGB triple from the stream, convert properly. Sets warn if
+// out of gamut samples were clamped. Returns false and prints an error
+// if the stream could not be read.
+extern bool ReadRGBTriple(FILE *in,int &r,int &g,int &b,double &y,int depth,int count,bool flt,bool bigendian,bool xyz,
+                          bool &warn);
 //
 // Open a PPM/PFM file and return its dimensions and properties.
 extern FILE *OpenPNMFile(const char *file,int &width,int &height,int &depth,int &precision,bool &isfloat,bool &bigendian);
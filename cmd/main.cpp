@@ -82,10 +82,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "cmd/encodeb.hpp"
 #include "cmd/encodea.hpp"
 #include "cmd/reconstruct.hpp"
+#include "cmd/batch.hpp"
+#include "cmd/bench.hpp"
 ///
 
-bool oznew = false;
-
 /// Defines
 #define FIX_BITS 13
 ///
@@ -111,66 +111,67 @@ void ParseSubsamplingFactors(UBYTE *sx,UBYTE *sy,const char *sub,int cnt)
 ///
 
 /// ParseDouble
-// Parse off a floating point value, or print an error
-double ParseDouble(int &argc,char **&argv)
+// Parse off a floating point value into v. Returns false and prints
+// an error if the argument is missing or not numeric. The caller
+// then aborts the job, this must not exit as jobs may run on the
+// worker threads of the batch mode.
+bool ParseDouble(int &argc,char **&argv,double &v)
 {
-  double v;
   char *endptr;
   
   if (argv[2] == NULL) {
     fprintf(stderr,"%s expected a numeric argument.\n",argv[1]);
-    exit(25);
+    return false;
   }
 
   v = strtod(argv[2],&endptr);
 
   if (*endptr) {
     fprintf(stderr,"%s expected a numeric argument, not %s.\n",argv[1],argv[2]);
-    exit(25);
+    return false;
   }
 
   argc -= 2;
   argv += 2;
 
-  return v;
+  return true;
 }
 ///
 
 /// ParseInt
-// Parse off an integer, return it, or print an error.
-int ParseInt(int &argc,char **&argv)
+// Parse off an integer into v. Returns false and prints an error
+// if the argument is missing or not numeric.
+bool ParseInt(int &argc,char **&argv,int &v)
 {
-  long int v;
   char *endptr;
   
   if (argv[2] == NULL) {
     fprintf(stderr,"%s expected a numeric argument.\n",argv[1]);
-    exit(25);
+    return false;
   }
 
   v = strtol(argv[2],&endptr,0);
 
   if (*endptr) {
     fprintf(stderr,"%s expected a numeric argument, not %s.\n",argv[1],argv[2]);
-    exit(25);
+    return false;
   }
 
   argc -= 2;
   argv += 2;
 
-  return v;
+  return true;
 }
 ///
 
 /// ParseString
-// Parse of a string argument, return it, or print an error
-const char *ParseString(int &argc,char **&argv)
+// Parse off a string argument into v. Returns false and prints an
+// error if the argument is missing.
+bool ParseString(int &argc,char **&argv,const char *&v)
 {
-  const char *v;
-  
   if (argv[2] == NULL) {
     fprintf(stderr,"%s expects a string argument.\n",argv[1]);
-    exit(25);
+    return false;
   }
 
   v = argv[2];
@@ -178,7 +179,7 @@ const char *ParseString(int &argc,char **&argv)
   argc -= 2;
   argv += 2;
 
-  return v;
+  return true;
 }
 ///
 
@@ -291,6 +292,10 @@ void PrintUsage(const char *progname)
           "-ncl       : disable clamping of out-of-gamut colors.\n"
           "             this is automatically enabled for lossless.\n"
           "-h         : optimize the Huffman tables\n"
+          "-stream    : write the image while it is read, keeping only a few\n"
+          "             block rows of the image in memory. Profile C only, other\n"
+          "             profiles are rejected. Requires a residual image coded in a\n"
+          "             single sequential scan, and cannot be combined with -h\n"
           "-v         : use progressive instead of sequential encoding\n"
           "             available for all coding schemes (-r,-a,-l and default)\n"
           "-qv        : use a simplified scan pattern for progressive that only\n"
@@ -320,6 +325,10 @@ void PrintUsage(const char *progname)
           "             in total, where h is the number of refinement bits. Each line contains\n"
           "             an (integer) output value the corresponding input is mapped to.\n"
           "-z mcus    : define the restart interval size, zero disables it\n"
+          "-zt threads: run the forward DCT and quantization of images without\n"
+          "             subsampling, and the entropy coding of the restart intervals\n"
+          "             if -z is given, concurrently on the given number of threads.\n"
+          "             Requires a build with multithreading support. Profile C only\n"
           "-s WxH,... : define subsampling factors for all components\n"
           "             note that these are NOT MCU sizes\n"
           "             Default is 1x1,1x1,1x1 (444 subsampling)\n"
@@ -350,6 +359,10 @@ void PrintUsage(const char *progname)
           "             This demo code DOES NOT implement compositing of alpha and background\n"
           "-am mode   : specifes the mode of the alpha: 1 (regular) 2 (premultiplied) 3 (matte-removal)\n"
           "-ab r,g,b  : specifies the matte (background) color for mode 3 as RGB triple\n"
+          "-stats     : on decoding, print the time spent in the individual stages\n"
+          "             of the decoder, the number of bytes read and memory allocations.\n"
+          "-legacy    : on decoding, only reconstruct the legacy 8 bit image and skip\n"
+          "             all extension layers\n"
           "-ar        : enable residual coding for the alpha channel, required if the\n"
           "             alpha channel is larger than 8bpp\n"
           "-ar12      : use a 12 bit residual for the alpha channel\n"
@@ -364,12 +377,33 @@ void PrintUsage(const char *progname)
           "-aqt n     : specify the quantization table for the alpha channel\n"
           "-arqt n    : specify the quantization table for residual alpha\n"
           "-aquality q: specify a combined quality for both\n"
-          ,progname);
+          "\n"
+          "Batch mode: %s [-j threads] -batch manifest\n"
+          "-batch file: run all jobs listed in the given manifest file, one job per\n"
+          "             line, each consisting of the options, the source and the target\n"
+          "             as they would be given on the command line. Empty lines and lines\n"
+          "             starting with # are ignored, and file names containing blanks\n"
+          "             can be put in double quotes.\n"
+          "-j threads : run the jobs of the manifest concurrently on the given number of\n"
+          "             threads, each using its own codec instance. This requires a\n"
+          "             build with multithreading support.\n"
+          "\n"
+          "Benchmark mode: %s -bench [-n runs] [-size wxh] [images...]\n"
+          "-bench     : run encoding and decoding over a matrix of coding options on\n"
+          "             synthetic images and the given PPM, PGM or PFM images and report\n"
+          "             the throughput and the time spent in each processing stage.\n"
+          "             Images are held in memory, file I/O is not measured.\n"
+          "-n runs    : number of runs per case, the fastest run is reported.\n"
+          "-size wxh  : dimensions of the synthetic images, default is 1280x720.\n"
+          ,progname,progname,progname);
 }
 ///
 
-/// main
-int main(int argc,char **argv)
+/// ProcessCommandLine
+// Parse the options of a single encoding or decoding job and run it.
+// This is shared by the main entry point and the batch mode, which
+// runs one job per line of a manifest file.
+int ProcessCommandLine(int argc,char **argv)
 {
   int quality       = -1;
   int hdrquality    = -1;
@@ -404,7 +438,11 @@ int main(int argc,char **argv)
   bool raccoding    = false;
   bool serms        = false;
   bool aserms       = false;
+  bool stats        = false;
+  bool legacy       = false;
   bool abypass      = false;
+  bool stream       = false;
+  int  threads      = 1;
   bool losslessdct  = false;
   bool dctbypass    = false;
   bool openloop     = false;
@@ -446,19 +484,22 @@ int main(int argc,char **argv)
   int alphatt           = 0;
   int residualalphatt   = 0;
   int smooth            = 0; // histogram smoothing
-
-  PrintLicense();
-  fflush(stdout);
+  int result            = 20;
 
   while(argc > 3 && argv[1][0] == '-') {
     if (!strcmp(argv[1],"-q")) {
-      quality = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,quality))
+        return 25;
     } else if (!strcmp(argv[1],"-Q")) {
-      hdrquality = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,hdrquality))
+        return 25;
     } else if (!strcmp(argv[1],"-quality")) {
-      splitquality = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,splitquality))
+        return 25;
     } else if (!strcmp(argv[1],"-profile")) {
-      const char *s = ParseString(argc,argv);
+      const char *s;
+      if (!ParseString(argc,argv,s))
+        return 25;
       setprofile    = true;
       if (!strcmp(s,"a") || !strcmp(s,"A")) {
         profile = 0;
@@ -474,7 +515,8 @@ int main(int argc,char **argv)
         return 20;
       }
     } else if (!strcmp(argv[1],"-m")) {
-      maxerror = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,maxerror))
+        return 25;
     } else if (!strcmp(argv[1],"-md")) {
       median = true;
       argv++;
@@ -484,21 +526,32 @@ int main(int argc,char **argv)
       argv++;
       argc--;
     } else if (!strcmp(argv[1],"-sm")) {
-      smooth = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,smooth))
+        return 25;
     } else if (!strcmp(argv[1],"-z")) {
-      restart = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,restart))
+        return 25;
+    } else if (!strcmp(argv[1],"-zt")) {
+      if (!ParseInt(argc,argv,threads))
+        return 25;
+      if (threads < 1) {
+        fprintf(stderr,"-zt requires at least one thread.\n");
+        return 20;
+      }
     } else if (!strcmp(argv[1],"-r")) {
       residuals = true;
       argv++;
       argc--;
     } else if (!strcmp(argv[1],"-R")) {
-      hiddenbits = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,hiddenbits))
+        return 25;
       if (hiddenbits < 0 || hiddenbits > 4) {
         fprintf(stderr,"JPEG XT allows only between 0 and 4 refinement bits.\n");
         return 20;
       }
     } else if (!strcmp(argv[1],"-rR")) {
-      riddenbits = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,riddenbits))
+        return 25;
     } else if (!strcmp(argv[1],"-n")) {
       writednl   = true;
       argv++;
@@ -506,10 +559,12 @@ int main(int argc,char **argv)
     } 
 #if ISO_CODE
     else if (!strcmp(argv[1],"-ae")) {
-      factor = ParseDouble(argc,argv);
+      if (!ParseDouble(argc,argv,factor))
+        return 25;
       profile = 1; // take this as an indicator of profile B.
     } else if (!strcmp(argv[1],"-e")) {
-      exposure = ParseDouble(argc,argv);
+      if (!ParseDouble(argc,argv,exposure))
+        return 25;
       profile = 1; // take this as an indicator of profile B
     } 
 #endif
@@ -526,23 +581,29 @@ int main(int argc,char **argv)
       argv++;
       argc--;
     } else if (!strcmp(argv[1],"-s")) {
-      sub    = ParseString(argc,argv);
+      if (!ParseString(argc,argv,sub))
+        return 25;
     } else if (!strcmp(argv[1],"-sr")) {
-      ressub = ParseString(argc,argv);
+      if (!ParseString(argc,argv,ressub))
+        return 25;
     } else if (!strcmp(argv[1],"-ncl")) {
       noclamp = true;
       argv++;
       argc--;
     } else if (!strcmp(argv[1],"-al")) {
-      alpha   = ParseString(argc,argv);
+      if (!ParseString(argc,argv,alpha))
+        return 25;
     } else if (!strcmp(argv[1],"-am")) {
-      alphamode = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,alphamode))
+        return 25;
       if (alphamode < 0 || alphamode > 3) {
         fprintf(stderr,"the alpha mode specified with -am must be between 0 and 3\n");
         return 20;
       }
     } else if (!strcmp(argv[1],"-ab")) {
-      const char *matte = ParseString(argc,argv);
+      const char *matte;
+      if (!ParseString(argc,argv,matte))
+        return 25;
       if (sscanf(matte,"%d,%d,%d",&matte_r,&matte_g,&matte_b) != 3) {
         fprintf(stderr,"-ab expects three numeric arguments separated comma, i.e. r,g,b\n");
         return 20;
@@ -560,7 +621,11 @@ int main(int argc,char **argv)
       optimize = true;
       argv++;
       argc--;
-    } 
+    } else if (!strcmp(argv[1],"-stream")) {
+      stream   = true;
+      argv++;
+      argc--;
+    }
     else if (!strcmp(argv[1],"-qv")) {
       qscan       = true;
       argv++;
@@ -611,13 +676,17 @@ int main(int argc,char **argv)
       argv++;
       argc--;
     } else if (!strcmp(argv[1],"-qt")) {
-      tabletype = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,tabletype))
+        return 25;
     } else if (!strcmp(argv[1],"-rqt")) {
-      residualtt = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,residualtt))
+        return 25;
     } else if (!strcmp(argv[1],"-aqt")) {
-      alphatt = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,alphatt))
+        return 25;
     } else if (!strcmp(argv[1],"-arqt")) {
-      residualalphatt = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,residualalphatt))
+        return 25;
     } else if (!strcmp(argv[1],"-aol")) {
       aopenloop = true;
       argv++;
@@ -627,34 +696,50 @@ int main(int argc,char **argv)
       argv++;
       argc--;
     } else if (!strcmp(argv[1],"-ldr")) {
-      ldrsource = ParseString(argc,argv);
+      if (!ParseString(argc,argv,ldrsource))
+        return 25;
     } else if (!strcmp(argv[1],"-l")) {
       serms = true;
       argv++;
       argc--;
+    } else if (!strcmp(argv[1],"-stats")) {
+      stats = true;
+      argv++;
+      argc--;
+    } else if (!strcmp(argv[1],"-legacy")) {
+      legacy = true;
+      argv++;
+      argc--;
     } else if (!strcmp(argv[1],"-g")) {
-      gamma = ParseDouble(argc,argv);
+      if (!ParseDouble(argc,argv,gamma))
+        return 25;
 #if ISO_CODE
       gammaspecd = true;
 #endif
     } else if (!strcmp(argv[1],"-gf")) {
-      lsource = ParseString(argc,argv);
+      if (!ParseString(argc,argv,lsource))
+        return 25;
 #if ISO_CODE   
     } else if (!strcmp(argv[1],"-epsd")) {
-      epsilond = ParseDouble(argc,argv);
+      if (!ParseDouble(argc,argv,epsilond))
+        return 25;
     } else if (!strcmp(argv[1],"-epsn")) {
-      epsilonn = ParseDouble(argc,argv);
+      if (!ParseDouble(argc,argv,epsilonn))
+        return 25;
     } else if (!strcmp(argv[1],"-lr")) {
       linearres = true;
       argv++;
       argc--;
 #endif      
     } else if (!strcmp(argv[1],"-aq")) {
-      alphaquality = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,alphaquality))
+        return 25;
     } else if (!strcmp(argv[1],"-aQ")) {
-      alphahdrquality = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,alphahdrquality))
+        return 25;
     } else if (!strcmp(argv[1],"-aquality")) {
-      alphasplitquality = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,alphasplitquality))
+        return 25;
     } else if (!strcmp(argv[1],"-ar")) {
       alpharesiduals = true;
       argv++;
@@ -665,12 +750,15 @@ int main(int argc,char **argv)
       argv++;
       argc--;
     } else if (!strcmp(argv[1],"-aR")) {
-      ahiddenbits = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,ahiddenbits))
+        return 25;
     } else if (!strcmp(argv[1],"-arR")) {
-      ariddenbits = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,ariddenbits))
+        return 25;
     }
     else if (!strcmp(argv[1],"-ls")) {
-      lsmode = ParseInt(argc,argv);
+      if (!ParseInt(argc,argv,lsmode))
+        return 25;
     } else {
       fprintf(stderr,"unsupported command line switch %s\n",argv[1]);
       return 20;
@@ -709,7 +797,7 @@ int main(int argc,char **argv)
       fprintf(stderr,"Error in argument parsing, argument %s not understood or parsed correctly.\n"
               "Run without arguments for a list of command line options.\n\n",
               argv[1]);
-      exit(20);
+      return 20;
     }
 
     PrintUsage(argv[0]);
@@ -717,19 +805,28 @@ int main(int argc,char **argv)
     return 5;
   }
 
+  //
+  // The result of the job is returned to the caller, which is either
+  // main() or a worker of the batch mode.
   if (quality < 0 && lossless == false && lsmode < 0) {
-    Reconstruct(argv[1],argv[2],colortrafo,alpha,serms);
+    result = Reconstruct(argv[1],argv[2],colortrafo,alpha,serms,stats,legacy);
   } else {
+    //
+    // Only the profile C encoder writes the image while it is read.
+    if (stream && profile != 2 && profile != 4) {
+      fprintf(stderr,"**** -stream is only supported for profile C. ****\n");
+      return 20;
+    }
     switch(profile) {
     case 0:
 #if ISO_CODE
       if (xyz || cxyz) {
         fprintf(stderr,"**** XYZ color input currently not yet supported for profile A, sorry. ****\n");
-        exit(20);
+        return 20;
       }
       if (serms) {
         fprintf(stderr,"**** Profile A does not support lossless coding. ****\n");
-        exit(20);
+        return 20;
       }
       if (!openloop) {
         fprintf(stderr,
@@ -738,20 +835,20 @@ int main(int argc,char **argv)
                 "**** switch to open loop coding.                     ****\n"
                 );
       }
-      EncodeA(argv[1],ldrsource,argv[2],quality,hdrquality,
-              tabletype,residualtt,colortrafo,
-              progressive,rprogressive,
-              hiddenbits,riddenbits,optimize,
-              openloop,deadzone,lagrangian,dering,
-              noclamp,gammaspecd?gamma:-1.0, // make 2.4 the default gamma, unless specified otherwise
-              median,smooth,
-              sub,ressub,
-              alpha,alphamode,matte_r,matte_g,matte_b,
-              alpharesiduals,alphaquality,alphahdrquality,
-              alphatt,residualalphatt,
-              ahiddenbits,ariddenbits,aresprec,
-              aopenloop,adeadzone,alagrangian,adering,
-              aserms,abypass);
+      result = EncodeA(argv[1],ldrsource,argv[2],quality,hdrquality,
+                       tabletype,residualtt,colortrafo,
+                       progressive,rprogressive,
+                       hiddenbits,riddenbits,optimize,
+                       openloop,deadzone,lagrangian,dering,
+                       noclamp,gammaspecd?gamma:-1.0, // make 2.4 the default gamma, unless specified otherwise
+                       median,smooth,
+                       sub,ressub,
+                       alpha,alphamode,matte_r,matte_g,matte_b,
+                       alpharesiduals,alphaquality,alphahdrquality,
+                       alphatt,residualalphatt,
+                       ahiddenbits,ariddenbits,aresprec,
+                       aopenloop,adeadzone,alagrangian,adering,
+                       aserms,abypass);
 #else
       fprintf(stderr,"**** Profile A encoding not supported due to patented IPRs.\n");
 #endif
@@ -760,11 +857,11 @@ int main(int argc,char **argv)
 #if ISO_CODE
       if (xyz || cxyz) {
         fprintf(stderr,"**** XYZ color input currently not yet supported for profile A, sorry. ****\n");
-        exit(20);
+        return 20;
       }
       if (serms) {
         fprintf(stderr,"**** Profile B does not support lossless coding. ****\n");
-        exit(20);
+        return 20;
       }
       if (!openloop) {
         fprintf(stderr,
@@ -773,19 +870,19 @@ int main(int argc,char **argv)
                 "**** switch to open loop coding.                     ****\n"
                 );
       }
-      EncodeB(argv[1],ldrsource,argv[2],exposure,factor,
-              gammaspecd?gamma:-1.0,
-              epsilonn,epsilond,median,smooth,linearres,
-              quality,hdrquality,
-              tabletype,residualtt,colortrafo,
-              progressive,rprogressive,hiddenbits,riddenbits,
-              optimize,openloop,deadzone,lagrangian,dering,noclamp,sub,ressub,
-              alpha,alphamode,matte_r,matte_g,matte_b,
-              alpharesiduals,alphaquality,alphahdrquality,
-              alphatt,residualalphatt,
-              ahiddenbits,ariddenbits,aresprec,
-              aopenloop,adeadzone,alagrangian,adering,
-              aserms,abypass);
+      result = EncodeB(argv[1],ldrsource,argv[2],exposure,factor,
+                       gammaspecd?gamma:-1.0,
+                       epsilonn,epsilond,median,smooth,linearres,
+                       quality,hdrquality,
+                       tabletype,residualtt,colortrafo,
+                       progressive,rprogressive,hiddenbits,riddenbits,
+                       optimize,openloop,deadzone,lagrangian,dering,noclamp,sub,ressub,
+                       alpha,alphamode,matte_r,matte_g,matte_b,
+                       alpharesiduals,alphaquality,alphahdrquality,
+                       alphatt,residualalphatt,
+                       ahiddenbits,ariddenbits,aresprec,
+                       aopenloop,adeadzone,alagrangian,adering,
+                       aserms,abypass);
 #else
       fprintf(stderr,"**** Profile B encoding not supported due to patented IPRs.\n");
 #endif
@@ -794,30 +891,73 @@ int main(int argc,char **argv)
     case 4:
       if (setprofile && ((residuals == false && hiddenbits == false && profile != 4) || profile == 2))
         residuals = true;
-      EncodeC(argv[1],ldrsource,argv[2],lsource,quality,hdrquality,
-              tabletype,residualtt,maxerror,
-              colortrafo,lossless,progressive,
-              residuals,optimize,accoding,
-              rsequential,rprogressive,raccoding,
-              qscan,levels,pyramidal,writednl,restart,
-              gamma,
-              lsmode,noiseshaping,serms,losslessdct,
-              openloop,deadzone,lagrangian,dering,
-              xyz,cxyz,
-              hiddenbits,riddenbits,resprec,separate,
-              median,noclamp,smooth,dctbypass,
-              sub,ressub,
-              alpha,alphamode,matte_r,matte_g,matte_b,
-              alpharesiduals,alphaquality,alphahdrquality,
-              alphatt,residualalphatt,
-              ahiddenbits,ariddenbits,aresprec,
-              aopenloop,adeadzone,alagrangian,adering,
-              aserms,abypass);
+      result = EncodeC(argv[1],ldrsource,argv[2],lsource,quality,hdrquality,
+                       tabletype,residualtt,maxerror,
+                       colortrafo,lossless,progressive,
+                       residuals,optimize,accoding,
+                       rsequential,rprogressive,raccoding,
+                       qscan,levels,pyramidal,writednl,restart,
+                       gamma,
+                       lsmode,noiseshaping,serms,losslessdct,
+                       openloop,deadzone,lagrangian,dering,
+                       xyz,cxyz,
+                       hiddenbits,riddenbits,resprec,separate,
+                       median,noclamp,smooth,dctbypass,
+                       sub,ressub,
+                       alpha,alphamode,matte_r,matte_g,matte_b,
+                       alpharesiduals,alphaquality,alphahdrquality,
+                       alphatt,residualalphatt,
+                       ahiddenbits,ariddenbits,aresprec,
+                       aopenloop,adeadzone,alagrangian,adering,
+                       aserms,abypass,stream,threads);
       break;
     }
   }
   
-  return 0;
+  return result;
 }
 ///
 
+/// main
+int main(int argc,char **argv)
+{
+  const char *manifest = NULL;
+  int threads          = 1;
+  
+  PrintLicense();
+  fflush(stdout);
+
+  // The benchmark takes its own options.
+  if (argc > 1 && !strcmp(argv[1],"-bench"))
+    return RunBenchmark(argc - 1,argv + 1);
+
+  // Options that select the batch mode have to come first.
+  while(argc > 2 && argv[1][0] == '-') {
+    if (!strcmp(argv[1],"-batch")) {
+      if (!ParseString(argc,argv,manifest))
+        return 25;
+    } else if (!strcmp(argv[1],"-j")) {
+      if (!ParseInt(argc,argv,threads))
+        return 25;
+      if (threads < 1) {
+        fprintf(stderr,"-j requires at least one thread.\n");
+        return 20;
+      }
+    } else break;
+  }
+
+  if (manifest) {
+    if (argc != 1) {
+      fprintf(stderr,"-batch does not take any further arguments, options and files\n"
+              "are specified per line in the manifest file.\n");
+      return 20;
+    }
+    return RunBatch(manifest,threads);
+  } else if (threads != 1) {
+    fprintf(stderr,"-j is only available in combination with -batch.\n");
+    return 20;
+  }
+  
+  return ProcessCommandLine(argc,argv);
+}
+///
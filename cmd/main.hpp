@@ -69,6 +69,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 /// Prototypes
 extern int main(int argc,char **argv);
+extern int ProcessCommandLine(int argc,char **argv);
 extern void ParseSubsamplingFactors(UBYTE *sx,UBYTE *sy,const char *sub,int cnt);
 ///
 
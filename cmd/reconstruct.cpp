@@ -73,16 +73,65 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "interface/jpeg.hpp"
 ///
 
+/// PrintStatistics
+// Print the per-stage timings collected by the instrumentation.
+static void PrintStatistics(class JPEG *jpeg)
+{
+  static const char *stages[JPGFLAG_STATS_STAGES] = {
+    "entropy decoding",
+    "entropy encoding",
+    "forward DCT",
+    "inverse DCT",
+    "upsampling",
+    "downsampling",
+    "color transformation",
+    "bitmap hook"
+  };
+  struct JPG_TagItem tags[3 * JPGFLAG_STATS_STAGES + 4];
+  int i;
+
+  for(i = 0;i < JPGFLAG_STATS_STAGES;i++) {
+    tags[3 * i + 0] = JPG_ValueTag(JPGTAG_STATS_TIME(i),0);
+    tags[3 * i + 1] = JPG_ValueTag(JPGTAG_STATS_COUNT(i),0);
+    tags[3 * i + 2] = JPG_ValueTag(JPGTAG_STATS_ALLOCATIONS_IN(i),0);
+  }
+  tags[3 * i + 0] = JPG_ValueTag(JPGTAG_STATS_BYTES_READ,0);
+  tags[3 * i + 1] = JPG_ValueTag(JPGTAG_STATS_BYTES_WRITTEN,0);
+  tags[3 * i + 2] = JPG_ValueTag(JPGTAG_STATS_ALLOCATIONS,0);
+  tags[3 * i + 3] = JPG_EndTag;
+
+  jpeg->GetInformation(tags);
+
+  printf("\n%-22s %12s %12s %12s\n","stage","time [ms]","calls","allocations");
+  for(i = 0;i < JPGFLAG_STATS_STAGES;i++) {
+    if (tags->GetTagData(JPGTAG_STATS_COUNT(i))) {
+      printf("%-22s %12.3f %12ld %12ld\n",stages[i],
+             tags->GetTagData(JPGTAG_STATS_TIME(i)) * 1e-3,
+             long(tags->GetTagData(JPGTAG_STATS_COUNT(i))),
+             long(tags->GetTagData(JPGTAG_STATS_ALLOCATIONS_IN(i))));
+    }
+  }
+  printf("%-22s %12ld\n","bytes read",long(tags->GetTagData(JPGTAG_STATS_BYTES_READ)));
+  printf("%-22s %12ld\n","allocations",long(tags->GetTagData(JPGTAG_STATS_ALLOCATIONS)));
+}
+///
+
 /// Reconstruct
 // This reconstructs an image from the given input file
-// and writes the output ppm.
-void Reconstruct(const char *infile,const char *outfile,
-                 int colortrafo,const char *alpha,bool serms)
+// and writes the output ppm. Returns zero on success, or
+// an error code for the command line.
+int Reconstruct(const char *infile,const char *outfile,
+                int colortrafo,const char *alpha,bool serms,bool stats,bool legacy)
 {  
-  FILE *in = fopen(infile,"rb");
+  FILE *in   = fopen(infile,"rb");
+  int result = 20;
   if (in) {
     struct JPG_Hook filehook(FileHook,in);
-    class JPEG *jpeg = JPEG::Construct(NULL);
+    struct JPG_TagItem ctags[] = {
+      JPG_ValueTag(JPGTAG_STATS_ENABLE,stats),
+      JPG_EndTag
+    };
+    class JPEG *jpeg = JPEG::Construct(ctags);
     if (jpeg) {
       int ok = 1;
       struct JPG_TagItem tags[] = {
@@ -94,6 +143,7 @@ void Reconstruct(const char *infile,const char *outfile,
         JPG_ValueTag(JPGTAG_DECODER_STOP,JPGFLAG_DECODER_STOP_FRAME),
 #endif  
         JPG_ValueTag((serms)?(JPGTAG_IMAGE_LOSSLESSDCT):(JPGTAG_TAG_IGNORE),serms),
+        JPG_ValueTag(JPGTAG_DECODER_LEGACY_ONLY,legacy),
         JPG_EndTag
       };
       //
@@ -199,6 +249,8 @@ void Reconstruct(const char *infile,const char *outfile,
           if (mem) {
             struct BitmapMemory bmm;
             bmm.bmm_pMemPtr      = mem;
+            bmm.bmm_ulOpenComponents = 0;
+            bmm.bmm_bAlphaOpen       = false;
             bmm.bmm_pAlphaPtr    = amem;
             bmm.bmm_ulWidth      = width;
             bmm.bmm_ulHeight     = height;
@@ -252,6 +304,8 @@ void Reconstruct(const char *infile,const char *outfile,
                 y  = lastline;
               } while(y < height && ok);
 
+              if (ok)
+                result = 0;
               fclose(bmm.bmm_pTarget);
             } else {
               perror("failed to open the output file");
@@ -274,6 +328,8 @@ void Reconstruct(const char *infile,const char *outfile,
         const char *error;
         int code = jpeg->LastError(error);
         fprintf(stderr,"reading a JPEG file failed - error %d - %s\n",code,error);
+      } else if (stats) {
+        PrintStatistics(jpeg);
       }
       JPEG::Destruct(jpeg);
     } else {
@@ -283,5 +339,7 @@ void Reconstruct(const char *infile,const char *outfile,
   } else {
     perror("failed to open the input file");
   }
+
+  return result;
 }
 ///
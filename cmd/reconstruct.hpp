@@ -63,7 +63,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define CMD_RECONSTRUCT_HPP
 
 /// Prototypes
-extern void Reconstruct(const char *infile,const char *outfile,int colortrafo,const char *alpha,bool serms);
+extern int Reconstruct(const char *infile,const char *outfile,int colortrafo,const char *alpha,bool serms,
+                       bool stats,bool legacy);
 ///
 
 ///
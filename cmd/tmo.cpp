@@ -392,8 +392,9 @@ void BuildIntermediateTable(int **hists,int offs,int hdrcnt,
 
 /// BuildToneMappingFromLDR (for FLOAT)
 // Build an inverse tone mapping from a hdr/ldr image pair, though generate it as
-// a floating point table. This requires floating point input.
-void BuildToneMappingFromLDR(FILE *in,FILE *ldrin,int w,int h,int count,
+// a floating point table. This requires floating point input. Returns false
+// if the images could not be read.
+bool BuildToneMappingFromLDR(FILE *in,FILE *ldrin,int w,int h,int count,
                              FLOAT ldrtohdr[256],
                              bool bigendian,bool median,bool fullrange,
                              int smooth)
@@ -403,7 +404,8 @@ void BuildToneMappingFromLDR(FILE *in,FILE *ldrin,int w,int h,int count,
   DOUBLE scale;
   //
   // Call the generic function. This returns half-float values we still have to cast to float.
-  BuildToneMappingFromLDR(in,ldrin,w,h,16,count,tmp,true,bigendian,false,0,median,fullrange,smooth);
+  if (!BuildToneMappingFromLDR(in,ldrin,w,h,16,count,tmp,true,bigendian,false,0,median,fullrange,smooth))
+    return false;
   //
   // Potentially scale the map so we avoid clamping. This is necessary because the output
   // of this map goes into the 2nd base trafo, which implies input clamping. Profile A can
@@ -416,12 +418,15 @@ void BuildToneMappingFromLDR(FILE *in,FILE *ldrin,int w,int h,int count,
   for(i = 0;i < 256;i++) {
     ldrtohdr[i] = HalfToDouble(tmp[i]) * scale; // This is the output transformation.
   }
+
+  return true;
 }
 ///
 
 /// BuildToneMappingFromLDR
-// Build an inverse tone mapping from a hdr/ldr image pair
-void BuildToneMappingFromLDR(FILE *in,FILE *ldrin,int w,int h,int depth,int count,
+// Build an inverse tone mapping from a hdr/ldr image pair. Returns false
+// if the images could not be read.
+bool BuildToneMappingFromLDR(FILE *in,FILE *ldrin,int w,int h,int depth,int count,
                              UWORD ldrtohdr[65536],bool flt,
                              bool bigendian,bool xyz,int hiddenbits,bool median,bool &fullrange,
                              int smooth)
@@ -433,6 +438,7 @@ void BuildToneMappingFromLDR(FILE *in,FILE *ldrin,int w,int h,int depth,int coun
   int hdrcnt = (flt)?(65536):(1 << depth);
   int x,y;
   bool warn = false;
+  bool ok   = true;
 
   hists     = (int **)malloc(sizeof(int *) * 256);
   fullrange = false;
@@ -445,14 +451,14 @@ void BuildToneMappingFromLDR(FILE *in,FILE *ldrin,int w,int h,int depth,int coun
       memset(hists[i],0,sizeof(int) * hdrcnt);
     }
     if (i == 256) {
-      for(y = 0;y < h;y++) {
-        for(x = 0;x < w;x++) {
+      for(y = 0;y < h && ok;y++) {
+        for(x = 0;x < w && ok;x++) {
           // Read the HDR image parameters.
           int r,g,b;
           int rl,gl,bl;
           double y;
           //
-          warn |= ReadRGBTriple(in,r,g,b,y,depth,count,flt,bigendian,xyz);
+          ok = ReadRGBTriple(in,r,g,b,y,depth,count,flt,bigendian,xyz,warn);
           /*
           r     = y * (hdrcnt - 1) + 0.5;
           if (r < 0)       r = 0;
@@ -460,12 +466,15 @@ void BuildToneMappingFromLDR(FILE *in,FILE *ldrin,int w,int h,int depth,int coun
           */
           //
           // Read the LDR parameters.
-          ReadRGBTriple(ldrin,rl,gl,bl,y,8,count,false,false,false);
+          if (ok)
+            ok = ReadRGBTriple(ldrin,rl,gl,bl,y,8,count,false,false,false,warn);
           /*
           rl    = y * 255 + 0.5;
           if (rl < 0)   rl = 0;
           if (rl > 255) rl = 255;
           */
+          if (!ok)
+            break;
           // Update the histogram.
           // Actually, here it might make sense to collect
           // three histograms, not one. The coding core
@@ -478,7 +487,8 @@ void BuildToneMappingFromLDR(FILE *in,FILE *ldrin,int w,int h,int depth,int coun
       }
       //
       // Build tables for each component.
-      BuildIntermediateTable(hists,0,hdrcnt,ldrtohdr,hiddenbits,median,fullrange,flt,smooth);
+      if (ok)
+        BuildIntermediateTable(hists,0,hdrcnt,ldrtohdr,hiddenbits,median,fullrange,flt,smooth);
       //
       // Release the temporary storage for the histogram.
       for(i = 0;i < 256;i++) {
@@ -493,12 +503,15 @@ void BuildToneMappingFromLDR(FILE *in,FILE *ldrin,int w,int h,int depth,int coun
 
   if (warn)
     fprintf(stderr,"Warning: Input image contains out of gamut values, clamping it.\n");
+
+  return ok;
 }
 ///
 
 /// BuildRGBToneMappingFromLDR
-// Build an inverse tone mapping from a hdr/ldr image pair
-void BuildRGBToneMappingFromLDR(FILE *in,FILE *ldrin,int w,int h,int depth,int count,
+// Build an inverse tone mapping from a hdr/ldr image pair. Returns false
+// if the images could not be read.
+bool BuildRGBToneMappingFromLDR(FILE *in,FILE *ldrin,int w,int h,int depth,int count,
                                 UWORD red[65536],UWORD green[65536],UWORD blue[65536],
                                 bool flt,bool bigendian,bool xyz,int hiddenbits,
                                 bool median,bool &fullrange,int smooth)
@@ -510,6 +523,7 @@ void BuildRGBToneMappingFromLDR(FILE *in,FILE *ldrin,int w,int h,int depth,int c
   int hdrcnt = (flt)?(65536):(1 << depth);
   int x,y;
   bool warn = false;
+  bool ok   = true;
 
   fullrange = false;
   hists     = (int **)malloc(sizeof(int *) * 256 * 3);
@@ -522,17 +536,20 @@ void BuildRGBToneMappingFromLDR(FILE *in,FILE *ldrin,int w,int h,int depth,int c
       memset(hists[i],0,sizeof(int) * hdrcnt);
     }
     if (i == 256 * 3) {
-      for(y = 0;y < h;y++) {
-        for(x = 0;x < w;x++) {
+      for(y = 0;y < h && ok;y++) {
+        for(x = 0;x < w && ok;x++) {
           // Read the HDR image parameters.
           int r,g,b;
           int rl,gl,bl;
           double y;
           //
-          warn |= ReadRGBTriple(in,r,g,b,y,depth,count,flt,bigendian,xyz);
+          ok = ReadRGBTriple(in,r,g,b,y,depth,count,flt,bigendian,xyz,warn);
           //
           // Read the LDR parameters.
-          ReadRGBTriple(ldrin,rl,gl,bl,y,8,count,false,false,false);
+          if (ok)
+            ok = ReadRGBTriple(ldrin,rl,gl,bl,y,8,count,false,false,false,warn);
+          if (!ok)
+            break;
           // Update the histogram.
           // Actually, here it might make sense to collect
           // three histograms, not one. The coding core
@@ -545,9 +562,11 @@ void BuildRGBToneMappingFromLDR(FILE *in,FILE *ldrin,int w,int h,int depth,int c
       }
       //
       // Build tables for each component.
-      BuildIntermediateTable(hists,0 << 8,hdrcnt,red  ,hiddenbits,median,fullrange,flt,smooth);
-      BuildIntermediateTable(hists,1 << 8,hdrcnt,green,hiddenbits,median,fullrange,flt,smooth);
-      BuildIntermediateTable(hists,2 << 8,hdrcnt,blue ,hiddenbits,median,fullrange,flt,smooth);
+      if (ok) {
+        BuildIntermediateTable(hists,0 << 8,hdrcnt,red  ,hiddenbits,median,fullrange,flt,smooth);
+        BuildIntermediateTable(hists,1 << 8,hdrcnt,green,hiddenbits,median,fullrange,flt,smooth);
+        BuildIntermediateTable(hists,2 << 8,hdrcnt,blue ,hiddenbits,median,fullrange,flt,smooth);
+      }
       //
       // Release the temporary storage for the histogram.
       for(i = 0;i < 256;i++) {
@@ -562,6 +581,8 @@ void BuildRGBToneMappingFromLDR(FILE *in,FILE *ldrin,int w,int h,int depth,int c
 
   if (warn)
     fprintf(stderr,"Warning: Input image contains out of gamut values, clamping it.\n");
+
+  return ok;
 }
 ///
 
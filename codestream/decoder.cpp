@@ -60,6 +60,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /// Include
 #include "codestream/decoder.hpp"
 #include "io/bytestream.hpp"
+#include "io/iostream.hpp"
 #include "std/assert.hpp"
 #include "codestream/tables.hpp"
 #include "marker/frame.hpp"
@@ -70,7 +71,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /// Decoder::Decoder
 // Construct the decoder
 Decoder::Decoder(class Environ *env)
-  : JKeeper(env), m_pImage(NULL)
+  : JKeeper(env), m_pImage(NULL), m_bLegacyOnly(false)
 {
 }
 ///
@@ -106,6 +107,8 @@ class Image *Decoder::ParseHeaderIncremental(class ByteStream *io)
                 "stream does not contain a JPEG file, SOI marker missing");
 
     m_pImage  = new(m_pEnviron) class Image(m_pEnviron);
+    if (m_bLegacyOnly)
+      m_pImage->TablesOf()->ForceLegacyOnly();
     //
     // The checksum is not going over the headers but starts at the SOF.
     m_pImage->TablesOf()->ParseTablesIncrementalInit();
@@ -119,6 +122,10 @@ class Image *Decoder::ParseHeaderIncremental(class ByteStream *io)
 // Accept decoder options.
 void Decoder::ParseTags(const struct JPG_TagItem *tags)
 {
+  if (m_pImage == NULL) {
+    // This must be known before the header is parsed.
+    m_bLegacyOnly = tags->GetTagData(JPGTAG_DECODER_LEGACY_ONLY,false)?true:false;
+  }
   if (tags->GetTagData(JPGTAG_MATRIX_LTRAFO,JPGFLAG_MATRIX_COLORTRANSFORMATION_YCBCR) == 
       JPGFLAG_MATRIX_COLORTRANSFORMATION_NONE) {
     if (m_pImage) {
@@ -132,3 +139,57 @@ void Decoder::ParseTags(const struct JPG_TagItem *tags)
   }
 }
 ///
+
+/// Decoder::PrefetchMarkerSegments
+// For a suspending decoder: Check whether all marker segments up to
+// and including the next SOS or EOI marker are available in the
+// stream, and read them ahead if possible. Returns false if the
+// data is still pending and the decoder has to suspend.
+bool Decoder::PrefetchMarkerSegments(class IOStream *io)
+{
+  ULONG offset = 0;
+
+  do {
+    LONG b0,b1;
+    //
+    if (!io->Prefetch(offset + 2))
+      return false;
+    b0 = io->PeekAt(offset);
+    b1 = io->PeekAt(offset + 1);
+    //
+    // At the end of the stream, leave the error handling to the parser.
+    if (b0 == ByteStream::EOF || b1 == ByteStream::EOF)
+      return true;
+    //
+    if (b0 != 0xff) {
+      // Left-over entropy coded data at the end of a scan.
+      offset++;
+    } else if (b1 == 0xff) {
+      // A filler byte.
+      offset++;
+    } else if (b1 == 0x00 || b1 == 0x01 || (b1 >= 0xd0 && b1 <= 0xd8)) {
+      // Stuffed zero byte, TEM, RSTn and SOI do not have a length field.
+      offset += 2;
+    } else if (b1 == 0xd9) {
+      // EOI, nothing else is required.
+      return true;
+    } else {
+      LONG hi,lo;
+      //
+      if (!io->Prefetch(offset + 4))
+        return false;
+      hi = io->PeekAt(offset + 2);
+      lo = io->PeekAt(offset + 3);
+      if (hi == ByteStream::EOF || lo == ByteStream::EOF)
+        return true;
+      offset += 2 + ((hi << 8) | lo);
+      //
+      if (b1 == 0xda || b1 == 0xf7) {
+        // SOS or JPEG LS SOS. Starting the scan may already pull a
+        // couple of bytes of the entropy coded segment.
+        return io->Prefetch(offset + 8);
+      }
+    }
+  } while(true);
+}
+///
@@ -67,6 +67,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 /// Forwards
 class ByteStream;
+class IOStream;
 class Quantization;
 class HuffmanTable;
 class Frame;
@@ -80,6 +81,10 @@ class Decoder : public JKeeper {
   // The image object
   class Image        *m_pImage;
   //
+  // If set, only the legacy codestream is decoded and all boxes
+  // are skipped.
+  bool                m_bLegacyOnly;
+  //
 public:
   Decoder(class Environ *env);
   //
@@ -96,6 +101,12 @@ public:
   //
   // Parse off decoder parameters.
   void ParseTags(const struct JPG_TagItem *tags);
+  //
+  // For a suspending decoder: Check whether all marker segments up to
+  // and including the next SOS or EOI marker are available in the
+  // stream, and read them ahead if possible. Returns false if the
+  // data is still pending and the decoder has to suspend.
+  bool PrefetchMarkerSegments(class IOStream *io);
 };
 ///
 
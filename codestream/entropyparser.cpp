@@ -120,6 +120,21 @@ void EntropyParser::WriteRestartMarker(class ByteStream *io)
 }
 ///
 
+/// EntropyParser::BeginRestartInterval
+// Account for a restart interval of the given number of MCUs whose
+// entropy coded data is written by the caller. Unless this is the first
+// interval of the scan, the restart marker in front of it is emitted.
+void EntropyParser::BeginRestartInterval(class ByteStream *io,UWORD mcus,bool first)
+{
+  if (!first) {
+    io->PutWord(m_usNextRestartMarker);
+    m_usNextRestartMarker = (m_usNextRestartMarker + 1) & 0xfff7;
+  }
+  assert(mcus <= m_usRestartInterval);
+  m_usMCUsToGo            = m_usRestartInterval - mcus;
+}
+///
+
 /// EntropyParser::ParseRestartMarker
 // Parse the restart marker or resync at the restart marker.
 void EntropyParser::ParseRestartMarker(class ByteStream *io)
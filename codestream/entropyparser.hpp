@@ -152,6 +152,17 @@ protected:
     }
   }
   //
+  // Return the restart interval in MCUs, or zero if there is none.
+  UWORD RestartIntervalOf(void) const
+  {
+    return m_usRestartInterval;
+  }
+  //
+  // Account for a restart interval of the given number of MCUs whose
+  // entropy coded data is written by the caller. Unless this is the first
+  // interval of the scan, the restart marker in front of it is emitted.
+  void BeginRestartInterval(class ByteStream *io,UWORD mcus,bool first);
+  //
   // Start parsing/reading a MCU. Might expect a restart marker.
   // If so, Restart() (below) is called. Returns true if the next MCU
   // is valid, or false if the parser should replace the next MCU with
@@ -222,9 +233,24 @@ public:
   // Parse a single MCU in this scan.
   virtual bool ParseMCU(void) = 0;
   //
+  // Parse all remaining MCUs of the current row. Parsers may
+  // override this to avoid the dispatch per MCU.
+  virtual void ParseMCURow(void)
+  {
+    while(ParseMCU()) {
+    }
+  }
+  //
   // Write a single MCU in this scan.
   virtual bool WriteMCU(void) = 0; 
   //
+  // Write all MCUs of the scan at once, coding its restart intervals
+  // on the given number of threads. Parsers that cannot do this
+  // leave the scan untouched, it is then written MCU by MCU.
+  virtual void WriteRestartIntervals(ULONG)
+  {
+  }
+  //
   // Make an R/D optimization for the given scan by potentially pushing
   // coefficients into other bins. This runs an optimization for a single
   // block and requires external control to run over the blocks.
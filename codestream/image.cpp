@@ -75,6 +75,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "control/bufferctrl.hpp"
 #include "control/residualbuffer.hpp"
 #include "control/hierarchicalbitmaprequester.hpp"
+#include "control/blockbitmaprequester.hpp"
+#include "marker/scan.hpp"
 #include "boxes/checksumbox.hpp"
 ///
 
@@ -95,7 +97,8 @@ Image::Image(class Environ *env)
     m_pLast(NULL), m_pCurrent(NULL), m_pImageBuffer(NULL), 
     m_pResidualImage(NULL), m_pChecksum(NULL), 
     m_pLegacyStream(NULL), m_pAdapter(NULL), m_pBoxList(NULL),
-    m_bReceivedFrameHeader(false)
+    m_bReceivedFrameHeader(false), m_pStreamScan(NULL), m_pResidualStreamScan(NULL),
+    m_bStreaming(false)
 {
 }
 ///
@@ -909,8 +912,10 @@ void Image::ResetToFirstFrame(void)
 
 /// Image::ReconstructRegion
 // Control interface - direct forwarding to the bitmap control
-// Reconstruct a rectangle of coefficients.
-void Image::ReconstructRegion(class BitMapHook *bmh,const struct RectangleRequest *rr)
+// Reconstruct a rectangle of coefficients. The lines actually written
+// into the bitmap are returned in updated.
+void Image::ReconstructRegion(class BitMapHook *bmh,const struct RectangleRequest *rr,
+                              RectAngle<LONG> &updated)
 {
   struct RectangleRequest rralpha = *rr;
   bool doalpha = m_pAlphaChannel && rr->rr_bIncludeAlpha;
@@ -938,10 +943,25 @@ void Image::ReconstructRegion(class BitMapHook *bmh,const struct RectangleReques
   m_pImageBuffer->RequestUserDataForDecoding(bmh,region,rr,false);
   if (doalpha)
     m_pAlphaChannel->m_pImageBuffer->RequestUserDataForDecoding(bmh,region,&rralpha,true);
+  updated        = region;
+  updated.ra_MaxY = region.ra_MinY - 1;
   if (!region.IsEmpty()) {
     m_pImageBuffer->ReconstructRegion(region,rr);
-    if (doalpha)
+    updated = region;
+    m_pImageBuffer->UpdatedRegionOf(updated);
+    if (doalpha) {
+      RectAngle<LONG> alpha = region;
       m_pAlphaChannel->m_pImageBuffer->ReconstructRegion(region,&rralpha);
+      m_pAlphaChannel->m_pImageBuffer->UpdatedRegionOf(alpha);
+      if (alpha.ra_MinY <= alpha.ra_MaxY) {
+        if (updated.ra_MinY > updated.ra_MaxY) {
+          updated = alpha;
+        } else {
+          if (alpha.ra_MinY < updated.ra_MinY) updated.ra_MinY = alpha.ra_MinY;
+          if (alpha.ra_MaxY > updated.ra_MaxY) updated.ra_MaxY = alpha.ra_MaxY;
+        }
+      }
+    }
   }
   if (doalpha)
     m_pAlphaChannel->m_pImageBuffer->ReleaseUserDataFromDecoding(bmh,&rralpha,true);
@@ -1084,6 +1104,148 @@ void Image::WriteTrailer(class ByteStream *io)
 }
 ///
 
+/// Image::isStreamableFrame
+// Check whether the given frame can be written in a single pass,
+// i.e. consists of a single sequential scan of known height.
+bool Image::isStreamableFrame(class Frame *frame)
+{
+  class Scan *scan;
+  
+  switch(frame->ScanTypeOf()) {
+  case Baseline:
+  case Sequential:
+  case ACSequential:
+  case Residual:
+  case ACResidual:
+  case ResidualDCT:
+  case ACResidualDCT:
+    break;
+  default:
+    return false;
+  }
+  //
+  // Refinement scans would require the complete image, and so does
+  // the DNL marker.
+  scan = frame->FirstScanOf();
+  if (scan == NULL || scan->NextOf() || scan->isHidden())
+    return false;
+  
+  return frame->HeightOf() > 0;
+}
+///
+
+/// Image::StartStreaming
+// Prepare the image to be written while it is provided. This opens
+// the scans of the legacy and the residual frame, which are then
+// written MCU row by MCU row as soon as the rows are complete.
+void Image::StartStreaming(void)
+{
+  class Frame *residual;
+  class ByteStream *target;
+  //
+  // This must be called from the master image.
+  assert(m_pParent == NULL && m_pMaster == NULL);
+  //
+  if (m_pDimensions == NULL || m_pImageBuffer == NULL)
+    JPG_THROW(OBJECT_DOESNT_EXIST,"Image::StartStreaming","no image constructed that could be streamed");
+  
+  if (m_pResidual == NULL || m_pAlphaChannel || m_pSmallest || 
+      dynamic_cast<class BlockBitmapRequester *>(m_pImageBuffer) == NULL)
+    JPG_THROW(NOT_IMPLEMENTED,"Image::StartStreaming",
+              "streaming is only available for flat DCT based images with a residual image "
+              "and without an alpha channel");
+
+  residual = m_pResidual->m_pDimensions;
+  if (!isStreamableFrame(m_pDimensions) || !isStreamableFrame(residual))
+    JPG_THROW(NOT_IMPLEMENTED,"Image::StartStreaming",
+              "streaming requires a single sequential scan in the base and the residual image, "
+              "and cannot be combined with refinement scans or the DNL marker");
+  //
+  // The checksum is only computed over the scan data, and the stream
+  // layout below depends on that.
+  assert(!TablesOf()->ChecksumTables());
+  assert(m_pChecksum == NULL && m_pLegacyStream == NULL);
+  //
+  // The residual goes into its data box, headed by its own
+  // frame header.
+  target = m_pResidual->OutputBufferOf()->EncoderBufferOf();
+  m_pResidual->WriteImageAndFrameHeader(residual,target);
+  m_pResidualStreamScan = residual->StartWriteScan(target,NULL);
+  //
+  // The legacy scan goes into the buffer that keeps the legacy
+  // codestream until the checksum is known. Its frame header
+  // follows once the residual data is complete.
+  m_pChecksum     = new(m_pEnviron) class Checksum();
+  m_pLegacyStream = new(m_pEnviron) class MemoryStream(m_pEnviron,MAX_UWORD);
+  m_pDimensions->ResetToFirstScan();
+  m_pStreamScan   = m_pDimensions->StartWriteScan(m_pLegacyStream,m_pChecksum);
+  m_bStreaming    = true;
+}
+///
+
+/// Image::StreamScan
+// Write all MCU rows of a streamed scan that are complete in the
+// image buffer, and complete the scan once it is written. Returns
+// the scan if there is more to write, or NULL.
+class Scan *Image::StreamScan(class Frame *frame,class Scan *scan,class ByteStream *target,
+                              bool residual)
+{
+  class BlockBitmapRequester *bbr = (class BlockBitmapRequester *)m_pImageBuffer;
+
+  while(bbr->isNextMCURowComplete(scan,residual)) {
+    if (scan->StartMCURow()) {
+      while(scan->WriteMCU()) {
+        ;
+      }
+    } else {
+      frame->EndWriteScan();
+      frame->WriteTrailer(target);
+      return NULL;
+    }
+  }
+
+  return scan;
+}
+///
+
+/// Image::StreamCompletedRows
+// Write all MCU rows that are complete in the image buffer and
+// release their quantized data.
+void Image::StreamCompletedRows(void)
+{
+  class BlockBitmapRequester *bbr = (class BlockBitmapRequester *)m_pImageBuffer;
+  
+  assert(m_bStreaming);
+
+  if (m_pResidualStreamScan)
+    m_pResidualStreamScan = StreamScan(m_pResidual->m_pDimensions,m_pResidualStreamScan,
+                                       m_pResidual->OutputBufferOf()->EncoderBufferOf(),true);
+  if (m_pStreamScan)
+    m_pStreamScan         = StreamScan(m_pDimensions,m_pStreamScan,m_pLegacyStream,false);
+  
+  bbr->ReleaseCodedRows();
+}
+///
+
+/// Image::WriteStreamedImage
+// Write the frame header, the residual data and the buffered legacy
+// codestream of a streamed image, followed by the trailer.
+void Image::WriteStreamedImage(class ByteStream *io)
+{
+  assert(m_bStreaming);
+
+  if (m_pStreamScan || m_pResidualStreamScan)
+    JPG_THROW(OBJECT_DOESNT_EXIST,"Image::WriteStreamedImage",
+              "the image has not yet been provided completely");
+  //
+  // This writes the legacy frame header and flushes the residual
+  // data out. The legacy scan is already in the legacy stream.
+  m_pCurrent = m_pDimensions;
+  StartWriteFrame(io);
+  WriteTrailer(io);
+}
+///
+
 /// Image::ParseResidualStream
 // Parse off the residual stream. Returns the residual frame if it exists, or NULL
 // in case it does not or there are no more scans in the file.
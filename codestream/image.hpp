@@ -64,6 +64,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 /// Includes
 #include "tools/environment.hpp"
+#include "tools/rectangle.hpp"
 #include "marker/scantypes.hpp"
 #include "marker/frame.hpp"
 ///
@@ -151,6 +152,15 @@ class Image : public JKeeper {
   // whether there is another frame.
   bool                   m_bReceivedFrameHeader;
   //
+  // If the image is written while it is provided, these are the
+  // scans of the legacy and the residual frame that are currently
+  // written, or NULL once they are complete.
+  class Scan            *m_pStreamScan;
+  class Scan            *m_pResidualStreamScan;
+  //
+  // Set if the image is written while it is provided.
+  bool                   m_bStreaming;
+  //
   // Create the buffer providing an access path to the residuals, if available.
   // This works only for block based modes, line based modes do not create 
   // residuals.
@@ -193,6 +203,16 @@ class Image : public JKeeper {
   // indicate the frame expansion for hierarchical JPEG.
   class Frame *CreateFrameBuffer(class ByteStream *io,ScanType type);
   //
+  // Check whether the given frame can be written in a single pass,
+  // i.e. consists of a single sequential scan of known height.
+  static bool isStreamableFrame(class Frame *frame);
+  //
+  // Write all MCU rows of a streamed scan that are complete in the
+  // image buffer, and complete the scan once it is written. Returns
+  // the scan if there is more to write, or NULL.
+  class Scan *StreamScan(class Frame *frame,class Scan *scan,class ByteStream *target,
+                         bool residual);
+  //
 public:
   //
   Image(class Environ *env);
@@ -334,8 +354,10 @@ public:
   void WriteHeader(class ByteStream *io) const;
   //
   // Control interface - direct forwarding to the bitmap control
-  // Reconstruct a rectangle of coefficients.
-  void ReconstructRegion(class BitMapHook *bmh,const struct RectangleRequest *rr);
+  // Reconstruct a rectangle of coefficients. The lines actually written
+  // into the bitmap are returned in updated.
+  void ReconstructRegion(class BitMapHook *bmh,const struct RectangleRequest *rr,
+                         RectAngle<LONG> &updated);
   //
   // Encode the next region in the scan from the user bitmap. The requested region
   // is indicated in the tags going to the user bitmap hook.
@@ -355,6 +377,25 @@ public:
   // Write the trailing data of the trailer, namely the EOI
   void WriteTrailer(class ByteStream *io);
   //
+  // Return an indicator whether the image is written while it is provided.
+  bool isStreaming(void) const
+  {
+    return m_bStreaming;
+  }
+  //
+  // Prepare the image to be written while it is provided. This opens
+  // the scans of the legacy and the residual frame, which are then
+  // written MCU row by MCU row as soon as the rows are complete.
+  void StartStreaming(void);
+  //
+  // Write all MCU rows that are complete in the image buffer and
+  // release their quantized data.
+  void StreamCompletedRows(void);
+  //
+  // Write the frame header, the residual data and the buffered legacy
+  // codestream of a streamed image, followed by the trailer.
+  void WriteStreamedImage(class ByteStream *io);
+  //
   // Parse off the EOI marker at the end of the image. Return false
   // if there are no more scans in the file, true otherwise.
   bool ParseTrailer(class ByteStream *io);
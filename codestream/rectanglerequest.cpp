@@ -97,6 +97,9 @@ void RectangleRequest::ParseTags(const struct JPG_TagItem *tags,const class Imag
   rr_ucUpsampling       = 0;
   */
   rr_bIncludeAlpha      = true;
+  rr_bUpdate            = false;
+  rr_bRetain            = false;
+  rr_usThreads          = 1;
   //
   // Changed a bit the reaction on coordinates: We no longer throw
   // errors, but rather clip into the valid coordinates. This goes
@@ -157,6 +160,18 @@ void RectangleRequest::ParseTags(const struct JPG_TagItem *tags,const class Imag
     case JPGTAG_DECODER_INCLUDE_ALPHA:
       rr_bIncludeAlpha = (coord != 0)?true:false;
       break;
+    case JPGTAG_DECODER_UPDATE:
+      rr_bUpdate       = (coord != 0)?true:false;
+      break;
+    case JPGTAG_DECODER_RETAIN:
+      rr_bRetain       = (coord != 0)?true:false;
+      break;
+    case JPGTAG_ENCODER_THREADS:
+      if (coord < 1 || coord > MAX_UWORD)
+        JPG_THROW(OVERFLOW_PARAMETER,"RectangleRequest::ParseFromTagList",
+                  "number of encoder threads must be >= 1 && < 65536");
+      rr_usThreads     = coord;
+      break;
     }
     tags = tags->NextTagItem();
   }
@@ -106,6 +106,9 @@ struct RectangleRequest : public JObject, private Explicit {
   UWORD                    rr_usLastComponent;  // inclusive end component
   BYTE                     rr_cPriority;        // order of rectangles
   bool                     rr_bIncludeAlpha;    // include the alpha channel in the request
+  bool                     rr_bUpdate;          // only reconstruct blocks altered since the last update
+  bool                     rr_bRetain;          // keep the input of the color transformation
+  UWORD                    rr_usThreads;        // threads transforming the blocks on encoding
   //
   RectangleRequest(void)
     : rr_pNext(NULL)
@@ -269,7 +269,7 @@ bool RefinementScan::WriteMCU(void)
       for(x = xmin;x < xmax;x++) {
         LONG *block,dummy[64];
         if (q && x < q->WidthOf()) {
-          block  = q->BlockAt(x)->m_Data;
+          block  = q->FetchBlock(x,dummy);
         } else {
           block  = dummy;
           memset(dummy ,0,sizeof(dummy) );
@@ -317,13 +317,20 @@ bool RefinementScan::ParseMCU(void)
     for(y = 0;y < mcuy;y++) {
       for(x = xmin;x < xmax;x++) {
         LONG *block,dummy[64];
+        bool store = false;
         if (q && x < q->WidthOf()) {
-          block  = q->BlockAt(x)->m_Data;
+          block  = q->FetchBlock(x,dummy);
+          store  = true;
         } else {
           block  = dummy;
         }
         if (valid) {
-          DecodeBlock(block,ac,skip);
+          bool changed = DecodeBlock(block,ac,skip);
+          if (store) {
+            q->StoreBlock(x,block);
+            if (changed)
+              q->MarkChanged(x);
+          }
         } 
         // Do not modify the data in here otherwise, keep the data unrefined...
         // actually, all further refinement scans should better be skipped as the
@@ -544,9 +551,8 @@ void RefinementScan::EncodeBlock(const LONG *block,class HuffmanCoder *ac,UWORD
           // Now we have a non-zero coefficient that just became non-zero.
           // Since we're coding bitplanes, the coefficent can now only be +1 or -1.
           // Since we store the magnitude, it is +1.
-          ac->Put(&m_Stream,1 | (run << 4));
-          // Store the sign of the coefficient. Zero for negative.
-          m_Stream.Put<1>((data >= 0)?1:0);
+          // Store the sign of the coefficient along with the symbol. Zero for negative.
+          ac->Put(&m_Stream,1 | (run << 4),1,(data >= 0)?1:0);
           // And send the last refinement bits ("correction bits") that are
           // part of the run in front of the coefficient. If there are any.
           // If the last run was longer than 16, there aren't.
@@ -588,15 +594,20 @@ void RefinementScan::EncodeBlock(const LONG *block,class HuffmanCoder *ac,UWORD
 ///
 
 /// RefinementScan::DecodeBlock
-// Decode a single huffman block.
-void RefinementScan::DecodeBlock(LONG *block,
+// Decode a single huffman block. Returns true if any coefficient
+// of the block was refined.
+bool RefinementScan::DecodeBlock(LONG *block,
                                  class HuffmanDecoder *ac,
                                  UWORD &skip)
 {
+  bool changed = false;
+  
   if (m_ucScanStart == 0 && m_bResidual == false) {
     UBYTE correction = m_Stream.Get<1>();
     // Simply append the bits from the scan, no further coding.
     block[0] |= correction << m_ucLowBit;
+    if (correction)
+      changed = true;
   }
 
   if (m_ucScanStop || m_bResidual) {
@@ -626,6 +637,7 @@ void RefinementScan::DecodeBlock(LONG *block,
         if (correction) {
           // Correction necessary. The direction depends on the
           // sign. We always correct "away from the origin".
+          changed = true;
           if (data > 0) {
             block[DCT::ScanOrder[k]] += 1L << m_ucLowBit;
           } else {
@@ -641,6 +653,8 @@ void RefinementScan::DecodeBlock(LONG *block,
         // also covers the case of the last element of a ZRL run.
         // Then s is simply zero.
         block[DCT::ScanOrder[k]] = s << m_ucLowBit; 
+        if (s)
+          changed = true;
         //
         // If this is the last coefficent, then there is nothing more to do
         // on this block.
@@ -695,6 +709,8 @@ void RefinementScan::DecodeBlock(LONG *block,
       }
     } while(++k <= m_ucScanStop);
   }
+
+  return changed;
 }
 ///
 
@@ -134,8 +134,9 @@ protected:
                    class HuffmanCoder *ac,
                    UWORD &skip);
   //
-  // Decode a single huffman block.
-  void DecodeBlock(LONG *block,
+  // Decode a single huffman block. Returns true if any coefficient
+  // of the block was refined.
+  bool DecodeBlock(LONG *block,
                    class HuffmanDecoder *ac,
                    UWORD &skip);
   //
@@ -76,9 +76,118 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "interface/imagebitmap.hpp"
 #include "colortrafo/colortrafo.hpp"
 #include "tools/traits.hpp"
+#include "tools/numerics.hpp"
 #include "control/blockbuffer.hpp"
 #include "control/blockbitmaprequester.hpp"
 #include "control/blocklineadapter.hpp"
+#include "io/memorystream.hpp"
+#if defined(USE_MULTITHREADING) && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define RESTART_THREADS 1
+#endif
+///
+
+/// class RestartQueue
+#ifdef RESTART_THREADS
+// The state shared by all threads coding the restart intervals of a
+// scan: the quantized data and the coded intervals, along with the
+// index of the next interval to pick up.
+class RestartQueue : public JKeeper {
+public:
+  //
+  // A single thread coding restart intervals. Each keeps its own
+  // environment such that errors remain local to the thread.
+  struct Worker : public JObject {
+    class Environ        w_Environ;
+    class RestartQueue  *w_pQueue;
+    pthread_t            w_Thread;
+    bool                 w_bFailed;
+    //
+    Worker(class Environ *env,class RestartQueue *queue)
+      : w_Environ(env), w_pQueue(queue), w_bFailed(false)
+    { }
+  };
+  //
+  // The scan whose intervals are coded.
+  class SequentialScan  *m_pScan;
+  //
+  // For each MCU row, the top quantized rows of all components, and
+  // the number of entries allocated for them.
+  class QuantizedRow   **m_ppRows;
+  ULONG                  m_ulRows;
+  //
+  // The coded restart intervals.
+  class MemoryStream   **m_ppIntervals;
+  ULONG                  m_ulIntervals;
+  //
+  // The threads, the last one is the calling thread.
+  struct Worker        **m_ppWorkers;
+  ULONG                  m_ulWorkers;
+  //
+  // The layout of the scan.
+  ULONG                  m_ulMCUsPerRow;
+  ULONG                  m_ulMCUs;
+  ULONG                  m_ulInterval;
+  //
+  // The next interval to code, and set if a thread failed and
+  // the remaining intervals need not to be coded.
+  ULONG                  m_ulNext;
+  bool                   m_bAbort;
+  pthread_mutex_t        m_Lock;
+  //
+  RestartQueue(class Environ *env,class SequentialScan *scan)
+    : JKeeper(env), m_pScan(scan), m_ppRows(NULL), m_ulRows(0), 
+      m_ppIntervals(NULL), m_ulIntervals(0), m_ppWorkers(NULL), m_ulWorkers(0),
+      m_ulNext(0), m_bAbort(false)
+  {
+    pthread_mutex_init(&m_Lock,NULL);
+  }
+  //
+  ~RestartQueue(void)
+  {
+    ULONG i;
+    //
+    // The intervals are allocated from the environments of the
+    // workers, hence have to go first.
+    if (m_ppIntervals) {
+      for(i = 0;i < m_ulIntervals;i++)
+        delete m_ppIntervals[i];
+      m_pEnviron->FreeMem(m_ppIntervals,m_ulIntervals * sizeof(class MemoryStream *));
+    }
+    if (m_ppWorkers) {
+      for(i = 0;i < m_ulWorkers;i++)
+        delete m_ppWorkers[i];
+      m_pEnviron->FreeMem(m_ppWorkers,m_ulWorkers * sizeof(struct Worker *));
+    }
+    if (m_ppRows)
+      m_pEnviron->FreeMem(m_ppRows,m_ulRows * sizeof(class QuantizedRow *));
+    pthread_mutex_destroy(&m_Lock);
+  }
+  //
+  // Return the index of the next interval to code, or the number of
+  // intervals if none is left.
+  ULONG NextInterval(void)
+  {
+    ULONG next;
+    
+    pthread_mutex_lock(&m_Lock);
+    next = (m_bAbort)?(m_ulIntervals):(m_ulNext);
+    if (next < m_ulIntervals)
+      m_ulNext++;
+    pthread_mutex_unlock(&m_Lock);
+
+    return next;
+  }
+  //
+  // Stop all threads after the intervals they are currently coding.
+  void Abort(void)
+  {
+    pthread_mutex_lock(&m_Lock);
+    m_bAbort = true;
+    pthread_mutex_unlock(&m_Lock);
+  }
+};
+#endif
 ///
 
 /// SequentialScan::SequentialScan
@@ -87,7 +196,8 @@ SequentialScan::SequentialScan(class Frame *frame,class Scan *scan,
                                bool differential,bool residual,bool large)
   : EntropyParser(frame,scan), m_pBlockCtrl(NULL), 
     m_ucScanStart(start), m_ucScanStop(stop), m_ucLowBit(lowbit),
-    m_bDifferential(differential), m_bResidual(residual), m_bLargeRange(large)
+    m_bDifferential(differential), m_bResidual(residual), m_bLargeRange(large),
+    m_Mode(Generic)
 {  
   UBYTE hidden = m_pFrame->TablesOf()->HiddenDCTBitsOf();
   m_ucCount    = scan->ComponentsInScan();
@@ -106,6 +216,8 @@ SequentialScan::SequentialScan(class Frame *frame,class Scan *scan,
     m_pACStatistics[i] = NULL;
     m_plDCBuffer[i]    = NULL;
   }
+  
+  m_pRestartQueue = NULL;
 }
 ///
 
@@ -116,6 +228,9 @@ SequentialScan::~SequentialScan(void)
     if (m_plDCBuffer[i])
       m_pEnviron->FreeMem(m_plDCBuffer[i],sizeof(LONG) * m_ulBlockWidth[i] * m_ulBlockHeight[i]);
   }
+#ifdef RESTART_THREADS
+  delete m_pRestartQueue;
+#endif
 }
 ///
 
@@ -140,6 +255,20 @@ void SequentialScan::StartParseScan(class ByteStream *io,class Checksum *chk,cla
     m_usSkip[i]        = 0;
   }
 
+  //
+  // Find the scan type the decoder is specialized for.
+  if (m_bResidual || m_bDifferential || m_bLargeRange) {
+    m_Mode = Generic;
+  } else if (!m_bProgressive) {
+    m_Mode = Sequential;
+  } else if (m_ucScanStart == 0 && m_ucScanStop == 0) {
+    m_Mode = DCFirst;
+  } else if (m_ucScanStart > 0) {
+    m_Mode = ACFirst;
+  } else {
+    m_Mode = Generic;
+  }
+
   assert(!ctrl->isLineBased());
   m_pBlockCtrl = dynamic_cast<BlockCtrl *>(ctrl);
   m_pBlockCtrl->ResetToStartOfScan(m_pScan);
@@ -299,7 +428,7 @@ void SequentialScan::Flush(bool)
         m_pACStatistics[0]->Put((symbol - 1) << 4);
         m_usSkip[0] = 0;
       } else {
-        CodeBlockSkip(m_pACCoder[0],m_usSkip[0]);
+        CodeBlockSkip(m_Stream,m_pACCoder[0],m_usSkip[0]);
       }
     }
   }
@@ -345,7 +474,7 @@ bool SequentialScan::WriteMCU(void)
       for(x = xmin;x < xmax;x++) {
         LONG *block,dummy[64];
         if (q && x < q->WidthOf()) {
-          block  = q->BlockAt(x)->m_Data;
+          block  = q->FetchBlock(x,dummy);
         } else {
           block  = dummy;
           memset(dummy ,0,sizeof(dummy) );
@@ -364,12 +493,14 @@ bool SequentialScan::WriteMCU(void)
               }
             }
           }
+          if (q && x < q->WidthOf())
+            q->StoreBlock(x,block);
         }
 #endif
         if (m_bMeasure) {
           MeasureBlock(block,dcstat,acstat,prevdc,skip);
         } else {
-          EncodeBlock(block,dc,ac,prevdc,skip);
+          EncodeBlock(m_Stream,block,dc,ac,prevdc,skip);
         }
       }
       if (q) q = q->NextOf();
@@ -382,9 +513,247 @@ bool SequentialScan::WriteMCU(void)
 }
 ///
 
+/// SequentialScan::EncodeRestartInterval
+// Encode the MCUs from first up to but excluding last, which form one
+// restart interval, into the given stream and flush it. Rows contains
+// for each MCU row the top quantized rows of the components in the scan.
+void SequentialScan::EncodeRestartInterval(BitStream<false> &stream,class QuantizedRow *const *rows,
+                                           ULONG mcusperrow,ULONG first,ULONG last)
+{
+  LONG  prevdc[4];
+  UWORD skip[4];
+  ULONG mcu;
+  int c;
+
+  //
+  // The prediction starts from scratch in each interval.
+  for(c = 0;c < m_ucCount;c++) {
+    prevdc[c] = 0;
+    skip[c]   = 0;
+  }
+
+  for(mcu = first;mcu < last;mcu++) {
+    class QuantizedRow *const *row = rows + (mcu / mcusperrow) * m_ucCount;
+    for(c = 0;c < m_ucCount;c++) {
+      class Component *comp           = m_pComponent[c];
+      class QuantizedRow *q           = row[c];
+      class HuffmanCoder *dc          = m_pDCCoder[c];
+      class HuffmanCoder *ac          = m_pACCoder[c];
+      UBYTE mcux                      = (m_ucCount > 1)?(comp->MCUWidthOf() ):(1);
+      UBYTE mcuy                      = (m_ucCount > 1)?(comp->MCUHeightOf()):(1);
+      ULONG xmin                      = (mcu % mcusperrow) * mcux;
+      ULONG xmax                      = xmin + mcux;
+      ULONG x,y;
+      for(y = 0;y < mcuy;y++) {
+        for(x = xmin;x < xmax;x++) {
+          LONG *block,dummy[64];
+          if (q && x < q->WidthOf()) {
+            block  = q->FetchBlock(x,dummy);
+          } else {
+            block  = dummy;
+            memset(dummy ,0,sizeof(dummy) );
+            block[0] = prevdc[c];
+          }
+          EncodeBlock(stream,block,dc,ac,prevdc[c],skip[c]);
+        }
+        if (q) q = q->NextOf();
+      }
+    }
+  }
+  //
+  // Terminate the interval as a restart marker would.
+  if (m_ucScanStop && m_bProgressive)
+    CodeBlockSkip(stream,m_pACCoder[0],skip[0]);
+  stream.Flush();
+}
+///
+
+/// SequentialScan::RestartIntervalWorker
+#ifdef RESTART_THREADS
+// The thread entry point that codes restart intervals from the
+// given queue until none is left.
+void *SequentialScan::RestartIntervalWorker(void *data)
+{
+  struct RestartQueue::Worker *worker = (struct RestartQueue::Worker *)data;
+  class RestartQueue *queue           = worker->w_pQueue;
+  class Environ *m_pEnviron           = &worker->w_Environ;
+
+  JPG_TRY {
+    BitStream<false> stream;
+    ULONG i;
+    
+    while((i = queue->NextInterval()) < queue->m_ulIntervals) {
+      ULONG first = i * queue->m_ulInterval;
+      ULONG last  = first + queue->m_ulInterval;
+      if (last > queue->m_ulMCUs)
+        last = queue->m_ulMCUs;
+      queue->m_ppIntervals[i] = new(m_pEnviron) class MemoryStream(m_pEnviron);
+      stream.OpenForWrite(queue->m_ppIntervals[i],NULL);
+      queue->m_pScan->EncodeRestartInterval(stream,queue->m_ppRows,queue->m_ulMCUsPerRow,first,last);
+    }
+  } JPG_CATCH {
+    worker->w_bFailed = true;
+    queue->Abort();
+  } JPG_ENDTRY;
+
+  return NULL;
+}
+#endif
+///
+
+/// SequentialScan::WriteRestartIntervals
+// Write all MCUs of the scan, coding its restart intervals on the given
+// number of threads. This requires that all the quantized data is
+// available, and that the dimensions of the frame are known.
+void SequentialScan::WriteRestartIntervals(ULONG threads)
+{
+#ifdef RESTART_THREADS
+  class ByteStream *io = m_Stream.ByteStreamOf();
+  class Checksum *chk  = m_Stream.ChecksumOf();
+  class RestartQueue *queue;
+  ULONG height         = m_pFrame->HeightOf();
+  ULONG interval       = RestartIntervalOf();
+  ULONG rows           = 0;
+  ULONG i,started;
+  int c;
+
+  if (threads < 2 || interval == 0 || height == 0 || m_bMeasure)
+    return;
+
+  assert(m_pRestartQueue == NULL);
+  m_pRestartQueue = queue = new(m_pEnviron) class RestartQueue(m_pEnviron,this);
+  //
+  // Collect the quantized rows of all MCU rows. Each of them covers
+  // at least eight lines of the frame.
+  queue->m_ulRows       = ((height + 7) >> 3) * m_ucCount;
+  queue->m_ppRows       = (class QuantizedRow **)m_pEnviron->AllocMem(queue->m_ulRows * 
+                                                                      sizeof(class QuantizedRow *));
+  queue->m_ulMCUsPerRow = MAX_ULONG;
+  while(StartMCURow()) {
+    assert((rows + 1) * m_ucCount <= queue->m_ulRows);
+    for(c = 0;c < m_ucCount;c++) {
+      class Component *comp = m_pComponent[c];
+      class QuantizedRow *q = m_pBlockCtrl->CurrentQuantizedRow(comp->IndexOf());
+      UBYTE mcux            = (m_ucCount > 1)?(comp->MCUWidthOf()):(1);
+      ULONG mcus            = (q->WidthOf() + mcux - 1) / mcux;
+      if (mcus < queue->m_ulMCUsPerRow)
+        queue->m_ulMCUsPerRow = mcus;
+      queue->m_ppRows[rows * m_ucCount + c] = q;
+    }
+    rows++;
+  }
+  queue->m_ulMCUs       = rows * queue->m_ulMCUsPerRow;
+  queue->m_ulInterval   = interval;
+  queue->m_ulIntervals  = (queue->m_ulMCUs + interval - 1) / interval;
+  queue->m_ppIntervals  = (class MemoryStream **)m_pEnviron->AllocMem(queue->m_ulIntervals *
+                                                                      sizeof(class MemoryStream *));
+  memset(queue->m_ppIntervals,0,queue->m_ulIntervals * sizeof(class MemoryStream *));
+  //
+  // There is no point in running more threads than intervals.
+  if (threads > queue->m_ulIntervals)
+    threads = queue->m_ulIntervals;
+  queue->m_ppWorkers    = (struct RestartQueue::Worker **)m_pEnviron->AllocMem(threads *
+                                                                               sizeof(struct RestartQueue::Worker *));
+  memset(queue->m_ppWorkers,0,threads * sizeof(struct RestartQueue::Worker *));
+  queue->m_ulWorkers    = threads;
+  for(i = 0;i < threads;i++) {
+    queue->m_ppWorkers[i] = new(m_pEnviron) struct RestartQueue::Worker(m_pEnviron,queue);
+  }
+  //
+  // Start all but the last worker on threads of their own, the
+  // calling thread runs the last one. If a thread cannot be started,
+  // the remaining workers pick up its intervals.
+  for(started = 0;started < threads - 1;started++) {
+    if (pthread_create(&queue->m_ppWorkers[started]->w_Thread,NULL,
+                       &RestartIntervalWorker,queue->m_ppWorkers[started]))
+      break;
+  }
+  RestartIntervalWorker(queue->m_ppWorkers[threads - 1]);
+  for(i = 0;i < started;i++) {
+    pthread_join(queue->m_ppWorkers[i]->w_Thread,NULL);
+  }
+  //
+  // Forward the error of a failed worker.
+  for(i = 0;i < threads;i++) {
+    if (queue->m_ppWorkers[i]->w_bFailed) {
+      class Exception exc = queue->m_ppWorkers[i]->w_Environ.LastException();
+      delete queue;
+      m_pRestartQueue = NULL;
+      m_pEnviron->Throw(exc);
+    }
+  }
+  //
+  // Concatenate the intervals, separated by the restart markers.
+  for(i = 0;i < queue->m_ulIntervals;i++) {
+    class MemoryStream readback(m_pEnviron,queue->m_ppIntervals[i],JPGFLAG_OFFSET_BEGINNING);
+    UBYTE buffer[256];
+    LONG  bytes;
+    ULONG mcus = queue->m_ulMCUs - i * interval;
+    
+    BeginRestartInterval(io,UWORD((mcus > interval)?(interval):(mcus)),i == 0);
+    while((bytes = readback.Read(buffer,sizeof(buffer))) > 0) {
+      if (chk)
+        chk->Update(buffer,bytes);
+      io->Write(buffer,bytes);
+    }
+  }
+  
+  delete queue;
+  m_pRestartQueue = NULL;
+#else
+  NOREF(threads);
+#endif
+}
+///
+
 /// SequentialScan::ParseMCU
 // Parse a single MCU in this scan. Return true if there are more blocks in this row.
 bool SequentialScan::ParseMCU(void)
+{
+  switch(m_Mode) {
+  case Sequential:
+    return DecodeMCU<Sequential>();
+  case DCFirst:
+    return DecodeMCU<DCFirst>();
+  case ACFirst:
+    return DecodeMCU<ACFirst>();
+  default:
+    return DecodeMCU<Generic>();
+  }
+}
+///
+
+/// SequentialScan::ParseMCURow
+// Parse all remaining MCUs of the current row. The scan type is
+// dispatched once for the row, not for each MCU.
+void SequentialScan::ParseMCURow(void)
+{
+  switch(m_Mode) {
+  case Sequential:
+    while(DecodeMCU<Sequential>()) {
+    }
+    break;
+  case DCFirst:
+    while(DecodeMCU<DCFirst>()) {
+    }
+    break;
+  case ACFirst:
+    while(DecodeMCU<ACFirst>()) {
+    }
+    break;
+  default:
+    while(DecodeMCU<Generic>()) {
+    }
+    break;
+  }
+}
+///
+
+/// SequentialScan::DecodeMCU
+// Parse a single MCU of a scan of the given type. Return true if
+// there are more MCUs in this row.
+template<SequentialScan::DecodeMode mode>
+bool SequentialScan::DecodeMCU(void)
 {
   bool more = true;
   int c;
@@ -411,18 +780,26 @@ bool SequentialScan::ParseMCU(void)
     for(y = 0;y < mcuy;y++) {
       for(x = xmin;x < xmax;x++) {
         LONG *block,dummy[64];
+        bool store   = false;
+        bool changed = true;
         if (q && x < q->WidthOf()) {
-          block  = q->BlockAt(x)->m_Data;
+          block  = q->FetchBlock(x,dummy);
+          store  = true;
         } else {
           block  = dummy;
         }
         if (valid) {
-          DecodeBlock(block,dc,ac,prevdc,skip);
+          changed = DecodeBlock<mode>(block,dc,ac,prevdc,skip);
         } else { 
           for(UBYTE i = m_ucScanStart;i <= m_ucScanStop;i++) {
             block[i] = 0;
           }
         }
+        if (store) {
+          q->StoreBlock(x,block);
+          if (changed)
+            q->MarkChanged(x);
+        }
       }
       if (q) q = q->NextOf();
     }
@@ -434,6 +811,27 @@ bool SequentialScan::ParseMCU(void)
 }
 ///
 
+/// SequentialScan::ZigZagBlock
+// Reorder the AC coefficients of the scan into zigzag order, apply the
+// point transformation and return a bitmask of the non-zero ones. Bit k
+// of the mask is set if zz[k] is non-zero.
+UQUAD SequentialScan::ZigZagBlock(const LONG *block,LONG *zz,int k) const
+{
+  UQUAD nz = 0;
+
+  do {
+    LONG data = block[DCT::ScanOrder[k]];
+    // Implement the point transformation. This is here a division, not
+    // a shift (rounding is different for negative numbers).
+    data  = (data >= 0)?(data >> m_ucLowBit):(-((-data) >> m_ucLowBit));
+    zz[k] = data;
+    nz   |= UQUAD(data != 0) << k;
+  } while(++k <= m_ucScanStop);
+
+  return nz;
+}
+///
+
 /// SequentialScan::MeasureBlock
 // Make a block statistics measurement on the source data.
 void SequentialScan::MeasureBlock(const LONG *block,
@@ -468,61 +866,51 @@ void SequentialScan::MeasureBlock(const LONG *block,
   
   // AC coding
   if (m_ucScanStop) {
-    UBYTE symbol,run = 0;
-    int k = (m_ucScanStart)?(m_ucScanStart):((m_bResidual)?0:1);
+    LONG zz[64];
+    UBYTE symbol,run;
+    int k    = (m_ucScanStart)?(m_ucScanStart):((m_bResidual)?0:1);
+    int last = k - 1; // position of the last non-zero coefficient
+    UQUAD nz = ZigZagBlock(block,zz,k);
     
-    do {
-      LONG data = block[DCT::ScanOrder[k]]; 
-      // Implement the point transformation. This is here a division, not
-      // a shift (rounding is different for negative numbers).
-      data = (data >= 0)?(data >> m_ucLowBit):(-((-data) >> m_ucLowBit));
-      if (data == 0) {
-        run++;
+    while(nz) {
+      LONG data;
+      k    = LowestBit(nz);
+      nz  &= nz - 1;
+      run  = k - last - 1;
+      last = k;
+      data = zz[k];
+      // Code (or compute the length of) any missing zero run.
+      if (skip) {
+        ac->Put((BitLength(skip) - 1) << 4);
+        skip = 0;
+      }
+      // First ensure that the run is at most 15, the largest cathegory.
+      while(run > 15) {
+        ac->Put(0xf0); // r = 15 and s = 0
+        run -= 16;
+      }
+      if (data == -0x8000 && !m_bProgressive && m_bResidual) {
+        ac->Put(0x10);
       } else {
-        // Code (or compute the length of) any missing zero run.
-        if (skip) {
-          UBYTE sksymbol = 0;
-          while(skip >= (1L << sksymbol))
-            sksymbol++;
-          ac->Put((sksymbol - 1) << 4);
-          skip = 0;
-        }
-        // First ensure that the run is at most 15, the largest cathegory.
-        while(run > 15) {
-          ac->Put(0xf0); // r = 15 and s = 0
-          run -= 16;
-        }
-        if (data == -0x8000 && !m_bProgressive && m_bResidual) {
-          ac->Put(0x10);
+        symbol = BitLength((data >= 0)?(data):(-data));
+        if (symbol >= (m_bLargeRange?22:16))
+          JPG_THROW(OVERFLOW_PARAMETER,"SequentialScan::MeasureBlock",
+                    "Symbol is too large to be encoded in scan, enable refinement coding to avoid the problem");
+        // Cathegory symbol, run length run
+        if (symbol >= 16) {
+          // This is the large-range DCT coding required for part 8 if the DCT
+          // remains enabled.
+          // This map converts symbol=16 into 16, symbol=17 into 32 and so on.
+          ac->Put((symbol - 15) << 4);
         } else {
-          symbol = 0;
-          do {
-            symbol++;
-            if (symbol >= (m_bLargeRange?22:16))
-              JPG_THROW(OVERFLOW_PARAMETER,"SequentialScan::MeasureBlock",
-                        "Symbol is too large to be encoded in scan, enable refinement coding to avoid the problem");
-            if (data > -(1L << symbol) && data < (1L << symbol)) {
-              // Cathegory symbol, run length run
-              if (symbol >= 16) {
-                // This is the large-range DCT coding required for part 8 if the DCT
-                // remains enabled.
-                // This map converts symbol=16 into 16, symbol=17 into 32 and so on.
-                ac->Put((symbol - 15) << 4);
-              } else {
-                ac->Put(symbol | (run << 4));
-              }
-              break;
-            }
-          } while(true);
-          //
-          // Run is over.
-          run = 0;
+          ac->Put(symbol | (run << 4));
         }
       }
-    } while(++k <= m_ucScanStop);
+    }
     //
-    // Is there still an open run? If so, code an EOB.
-    if (run) {
+    // Is there still an open run? If so, code an EOB. This is the case
+    // if the last non-zero coefficient is not the last of the scan.
+    if (last < m_ucScanStop) {
       // In the progressive mode, absorb into the skip
       if (m_bProgressive) {
         skip++;
@@ -541,7 +929,7 @@ void SequentialScan::MeasureBlock(const LONG *block,
 /// SequentialScan::CodeBlockSkip
 // Code any run of zero blocks here. This is only valid in
 // the progressive mode.
-void SequentialScan::CodeBlockSkip(class HuffmanCoder *ac,UWORD &skip)
+void SequentialScan::CodeBlockSkip(BitStream<false> &stream,class HuffmanCoder *ac,UWORD &skip)
 {  
   if (skip) {
     UBYTE symbol = 0;
@@ -550,9 +938,9 @@ void SequentialScan::CodeBlockSkip(class HuffmanCoder *ac,UWORD &skip)
       if (skip < (1L << symbol)) {
         symbol--;
         assert(symbol <= 14);
-        ac->Put(&m_Stream,symbol << 4);
+        ac->Put(&stream,symbol << 4);
         if (symbol)
-          m_Stream.Put(symbol,skip);
+          stream.Put(symbol,skip);
         skip = 0;
         return;
       }
@@ -563,7 +951,7 @@ void SequentialScan::CodeBlockSkip(class HuffmanCoder *ac,UWORD &skip)
 
 /// SequentialScan::EncodeBlock
 // Encode a single huffman block
-void SequentialScan::EncodeBlock(const LONG *block,
+void SequentialScan::EncodeBlock(BitStream<false> &stream,const LONG *block,
                                  class HuffmanCoder *dc,class HuffmanCoder *ac,
                                  LONG &prevdc,UWORD &skip)
 {
@@ -585,94 +973,92 @@ void SequentialScan::EncodeBlock(const LONG *block,
       do {
         symbol++;
         if (diff > -(1L << symbol) && diff < (1L << symbol)) {
-          dc->Put(&m_Stream,symbol);
           if (diff >= 0) {
-            m_Stream.Put(symbol,diff);
+            dc->Put(&stream,symbol,symbol,diff);
           } else {
-            m_Stream.Put(symbol,diff - 1);
+            dc->Put(&stream,symbol,symbol,diff - 1);
           }
           break;
         }
       } while(true);
     } else {
-      dc->Put(&m_Stream,0);
+      dc->Put(&stream,0);
     }
   }
   
   // AC coding
   if (m_ucScanStop) {
-    UBYTE symbol,run = 0;
-    int k = (m_ucScanStart)?(m_ucScanStart):((m_bResidual)?0:1);
-
-    do {
-      LONG data = block[DCT::ScanOrder[k]];
-      // Implement the point transformation. This is here a division, not
-      // a shift (rounding is different for negative numbers).
-      data = (data >= 0)?(data >> m_ucLowBit):(-((-data) >> m_ucLowBit));
-      if (data == 0) {
-        run++;
+    LONG zz[64];
+    UBYTE symbol,run;
+    int k    = (m_ucScanStart)?(m_ucScanStart):((m_bResidual)?0:1);
+    int last = k - 1; // position of the last non-zero coefficient
+    UQUAD nz = ZigZagBlock(block,zz,k);
+    //
+    // Only the non-zero coefficients are visited, the runs in between
+    // follow from their positions.
+    while(nz) {
+      LONG data;
+      k    = LowestBit(nz);
+      nz  &= nz - 1;
+      run  = k - last - 1;
+      last = k;
+      data = zz[k];
+      // Are there any skipped blocks we still need to code? Since this
+      // block is none of them.
+      if (skip)
+        CodeBlockSkip(stream,ac,skip);
+      //
+      // First ensure that the run is at most 15, the largest cathegory.
+      while(run > 15) {
+        ac->Put(&stream,0xf0); // r = 15 and s = 0
+        run -= 16;
+      }
+      // This is a special case that can only happen in sequential mode, namely coding of the -0x8000
+      // symbol.
+      if (data == -0x8000 && !m_bProgressive && m_bResidual) {
+        ac->Put(&stream,0x10);
+        stream.Put(4,run);
       } else {
-        // Are there any skipped blocks we still need to code? Since this
-        // block is none of them.
-        if (skip)
-          CodeBlockSkip(ac,skip);
-        //
-        // First ensure that the run is at most 15, the largest cathegory.
-        while(run > 15) {
-          ac->Put(&m_Stream,0xf0); // r = 15 and s = 0
-          run -= 16;
+        symbol = BitLength((data >= 0)?(data):(-data));
+        if (symbol >= (m_bLargeRange?22:16)) {
+          // The stream may run on a side thread, report the error there.
+          class Environ *m_pEnviron = stream.EnvironOf();
+          JPG_THROW(OVERFLOW_PARAMETER,"SequentialScan::EncodeBlock",
+                    "Symbol is too large to be encoded in scan, enable refinement coding to avoid the problem");
         }
-        // This is a special case that can only happen in sequential mode, namely coding of the -0x8000
-        // symbol.
-        if (data == -0x8000 && !m_bProgressive && m_bResidual) {
-          ac->Put(&m_Stream,0x10);
-          m_Stream.Put(4,run);
+        //
+        // Cathegory symbol, run length run
+        // If this is above the limit 16, use the huge DCT model. Note that the above
+        // error already excluded the regular case.
+        if (symbol >= 16) {
+          // This map converts symbol=16 into 16, symbol=17 into 32 and so on.
+          ac->Put(&stream,((symbol - 15) << 4));
+          stream.Put(4,run);
+          if (data >= 0) {
+            stream.Put(symbol,data);
+          } else {
+            stream.Put(symbol,data - 1);
+          }
+        } else if (data >= 0) {
+          ac->Put(&stream,symbol | (run << 4),symbol,data);
         } else {
-          symbol = 0;
-          do {
-            symbol++;
-            if (symbol >= (m_bLargeRange?22:16))
-              JPG_THROW(OVERFLOW_PARAMETER,"SequentialScan::EncodeBlock",
-                        "Symbol is too large to be encoded in scan, enable refinement coding to avoid the problem");
-            //
-            if (data > -(1L << symbol) && data < (1L << symbol)) {
-              // Cathegory symbol, run length run
-              // If this is above the limit 16, use the huge DCT model. Note that the above
-              // error already excluded the regular case.
-              if (symbol >= 16) {
-                // This map converts symbol=16 into 16, symbol=17 into 32 and so on.
-                ac->Put(&m_Stream,((symbol - 15) << 4));
-                m_Stream.Put(4,run);
-              } else {
-                ac->Put(&m_Stream,symbol | (run << 4));
-              }
-              if (data >= 0) {
-                m_Stream.Put(symbol,data);
-              } else {
-                m_Stream.Put(symbol,data - 1);
-              }
-              break;
-            }
-          } while(true);
-          //
-          // Run is over.
-          run = 0;
+          ac->Put(&stream,symbol | (run << 4),symbol,data - 1);
         }
       }
-    } while(++k <= m_ucScanStop);
+    }
     // Is there still an open run? If so, code an EOB in the regular mode.
     // If this is part of the (isolated) AC scan of the progressive JPEG,
     // check whether we could potentially accumulate this into a run of
     // zero blocks.
-    if (run) {
+    if (last < m_ucScanStop) {
       // Include in a block skip (or try to, rather).
       if (m_bProgressive) {
         skip++;
         if (skip == MAX_WORD) // avoid an overflow, code now
-          CodeBlockSkip(ac,skip);
+          CodeBlockSkip(stream,ac,skip);
       } else {
         // In sequential mode, encode as EOB.
-        ac->Put(&m_Stream,0x00);
+        ac->Put(&stream,0x00);
       }
     }
   }
@@ -680,12 +1066,23 @@ void SequentialScan::EncodeBlock(const LONG *block,
 ///
 
 /// SequentialScan::DecodeBlock
-// Decode a single huffman block.
-void SequentialScan::DecodeBlock(LONG *block,
+// Decode a single huffman block of a scan of the given type. Returns
+// true if the block was altered, false if it is covered by an EOB run.
+// The tests on the scan parameters fold into constants for all but the
+// generic scan type.
+template<SequentialScan::DecodeMode mode>
+bool SequentialScan::DecodeBlock(LONG *block,
                                  class HuffmanDecoder *dc,class HuffmanDecoder *ac,
                                  LONG &prevdc,UWORD &skip)
 {
-  if (m_ucScanStart == 0 && m_bResidual == false) {
+  bool  generic     = (mode == Generic);
+  bool  dcscan      = (generic)?(m_ucScanStart == 0 && m_bResidual == false):(mode != ACFirst);
+  bool  acscan      = (generic)?(m_ucScanStop != 0):(mode != DCFirst);
+  bool  progressive = (generic)?(m_bProgressive):(mode == ACFirst);
+  bool  residual    = generic && m_bResidual;
+  UBYTE stop        = (mode == Sequential)?(63):(m_ucScanStop);
+  
+  if (dcscan) {
     // First DC level coding. If it is in the spectral selection.
     LONG diff   = 0;
     UBYTE value = dc->Get(&m_Stream);
@@ -693,23 +1090,25 @@ void SequentialScan::DecodeBlock(LONG *block,
       LONG v = 1 << (value - 1);
       diff   = m_Stream.Get(value);
       if (diff < v) {
-        diff += (-1L << value) + 1;
+        diff += 1 - (1L << value);
       }
     }
-    if (m_bDifferential) {
+    if (generic && m_bDifferential) {
       prevdc   = diff;
     } else {
       prevdc  += diff;
     }
-    block[0] = prevdc << m_ucLowBit; // point transformation
+    block[0] = prevdc * (1 << m_ucLowBit); // point transformation
   }
 
-  if (m_ucScanStop) {
+  if (acscan) {
     // AC coding. 
     if (skip > 0) {
       skip--; // Still blocks to skip
+      // The block is only altered if the DC coefficient is part of this scan.
+      return dcscan;
     } else {
-      int k = (m_ucScanStart)?(m_ucScanStart):((m_bResidual)?0:1);
+      int k = (mode == Sequential)?(1):((m_ucScanStart)?(m_ucScanStart):((residual)?0:1));
 
       do {
         UBYTE rs = ac->Get(&m_Stream);
@@ -722,22 +1121,22 @@ void SequentialScan::DecodeBlock(LONG *block,
             continue;
           } else {
             // A progressive EOB run.
-            if (r == 0 || m_bProgressive) {
+            if (r == 0 || progressive) {
               skip  = 1 << r;
               if (r) skip |= m_Stream.Get(r);
               skip--; // this block is included in the count.
               break;
-            } else if (m_bResidual && rs == 0x10) {
+            } else if (residual && rs == 0x10) {
               // The symbol 0x8000
               r  = m_Stream.Get(4); // 4 bits for the run.
               k += r;
               if (k >= 64)
                 JPG_THROW(MALFORMED_STREAM,"SequentialScan::DecodeBlock",
                           "AC coefficient decoding out of sync");
-              block[DCT::ScanOrder[k]] = -0x8000 << m_ucLowBit; // Point transformation.
+              block[DCT::ScanOrder[k]] = -0x8000 * (1 << m_ucLowBit); // Point transformation.
               k++;
               continue; //...with the iteration, skipping over zeros.
-            } else if (m_bLargeRange) {
+            } else if (generic && m_bLargeRange) {
               // Large range coding coding codes the magnitude category and the run
               // separately. First extract the category from the bits that usually
               // take up the run.
@@ -757,17 +1156,19 @@ void SequentialScan::DecodeBlock(LONG *block,
           k     += r;
           diff   = m_Stream.Get(s);
           if (diff < v) {
-            diff += (-1L << s) + 1;
+            diff += 1 - (1L << s);
           }
           if (k >= 64)
             JPG_THROW(MALFORMED_STREAM,"SequentialScan::DecodeBlock",
                       "AC coefficient decoding out of sync");
-          block[DCT::ScanOrder[k]] = diff << m_ucLowBit; // Point transformation.
+          block[DCT::ScanOrder[k]] = diff * (1 << m_ucLowBit); // Point transformation.
           k++;
         }
-      } while(k <= m_ucScanStop);
+      } while(k <= stop);
     }
   }
+
+  return true;
 }
 ///
 
@@ -83,12 +83,23 @@ class BlockCtrl;
 class BufferCtrl;
 class LineAdapter;
 class BitmapCtrl;
+class MemoryStream;
+class RestartQueue;
 ///
 
 /// class SequentialScan
 // A sequential scan, also the first scan of a progressive scan,
 // Huffman coded.
 class SequentialScan : public EntropyParser {
+  //
+  // The scan types the decoder loops are specialized for. The type of
+  // a scan is found once as the scan starts.
+  enum DecodeMode {
+    Generic    = 0, // residual, differential and large range scans
+    Sequential = 1, // a sequential scan covering DC and AC
+    DCFirst    = 2, // the first DC scan of a progressive frame
+    ACFirst    = 3  // the first scan of an AC band of a progressive frame
+  };
   //
   // Last DC value, required for the DPCM coder.
   LONG                     m_lDC[4];
@@ -121,6 +132,10 @@ class SequentialScan : public EntropyParser {
   // Scan positions.
   ULONG                    m_ulX[4];
   //
+  // The quantized data and the coded restart intervals while the
+  // intervals are coded concurrently.
+  class RestartQueue      *m_pRestartQueue;
+  //
   // The huffman DC tables
   class HuffmanDecoder    *m_pDCDecoder[4];
   //
@@ -154,16 +169,31 @@ class SequentialScan : public EntropyParser {
   // Large range DCT mode?
   bool                     m_bLargeRange;
   //
-  // Encode a single huffman block
-  void EncodeBlock(const LONG *block,
+  // The type of the scan on decoding.
+  DecodeMode               m_Mode;
+  //
+  // Reorder the AC coefficients of the scan into zigzag order, apply the
+  // point transformation and return a bitmask of the non-zero ones. Bit k
+  // of the mask is set if zz[k] is non-zero.
+  UQUAD ZigZagBlock(const LONG *block,LONG *zz,int k) const;
+  //
+  // Encode a single huffman block into the given stream.
+  void EncodeBlock(BitStream<false> &stream,const LONG *block,
                    class HuffmanCoder *dc,class HuffmanCoder *ac,
                    LONG &prevdc,UWORD &skip);
   //
-  // Decode a single huffman block.
-  void DecodeBlock(LONG *block,
+  // Decode a single huffman block of a scan of the given type. Returns
+  // true if the block was altered, false if it is covered by an EOB run.
+  template<DecodeMode mode>
+  bool DecodeBlock(LONG *block,
                    class HuffmanDecoder *dc,class HuffmanDecoder *ac,
                    LONG &prevdc,UWORD &skip);
   //
+  // Parse a single MCU of a scan of the given type. Return true if
+  // there are more MCUs in this row.
+  template<DecodeMode mode>
+  bool DecodeMCU(void);
+  //
   // Flush the remaining bits out to the stream on writing.
   virtual void Flush(bool final);
   //
@@ -180,7 +210,17 @@ class SequentialScan : public EntropyParser {
   //
   // Code any run of zero blocks here. This is only valid in
   // the progressive mode.
-  void CodeBlockSkip(class HuffmanCoder *ac,UWORD &skip);
+  void CodeBlockSkip(BitStream<false> &stream,class HuffmanCoder *ac,UWORD &skip);
+  //
+  // Encode the MCUs from first up to but excluding last, which form one
+  // restart interval, into the given stream and flush it. Rows contains
+  // for each MCU row the top quantized rows of the components in the scan.
+  void EncodeRestartInterval(BitStream<false> &stream,class QuantizedRow *const *rows,
+                             ULONG mcusperrow,ULONG first,ULONG last);
+  //
+  // The thread entry point that codes restart intervals from the
+  // given queue until none is left.
+  static void *RestartIntervalWorker(void *queue);
   // 
   //
 public:
@@ -211,9 +251,16 @@ public:
   // MCUs in this row.
   virtual bool ParseMCU(void);  
   //
+  // Parse all remaining MCUs of the current row.
+  virtual void ParseMCURow(void);
+  //
   // Write a single MCU in this scan.
   virtual bool WriteMCU(void);
   //
+  // Write all MCUs of the scan, coding its restart intervals on the given
+  // number of threads.
+  virtual void WriteRestartIntervals(ULONG threads);
+  //
   // Make an R/D optimization for the given scan by potentially pushing
   // coefficients into other bins. This runs an optimization for a single
   // block and requires external control to run over the blocks.
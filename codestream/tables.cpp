@@ -110,13 +110,13 @@ Tables::Tables(class Environ *env)
     m_pQuant(NULL), m_pHuffman(NULL), m_pConditioner(NULL),
     m_pRestart(NULL), m_pColorInfo(NULL), m_pResolutionInfo(NULL), m_pCameraInfo(NULL), 
     m_pBoxList(NULL), m_NameSpace(env), m_AlphaNameSpace(env), m_pColorFactory(NULL),
-    m_pAlphaData(NULL), m_pResidualData(NULL), m_pRefinementData(NULL), m_pColorTrafo(NULL), 
+    m_pAlphaData(NULL), m_pResidualData(NULL), m_pRefinementData(NULL), m_pColorTrafo(NULL), m_ucColorTrafoType(0),
     m_pThresholds(NULL), m_pLSColorTrafo(NULL), m_pResidualSpecs(NULL), m_pAlphaSpecs(NULL),
     m_pIdentityMapping(NULL), m_pChecksumBox(NULL),
     m_ucMaxError(0), m_bDisableColor(false), m_bTruncateColor(false), m_bRefinement(false), 
     m_bOpenLoop(false), m_bDeadZone(false), m_bOptimize(false), m_bDeRing(false),
     m_bFoundExp(false), m_bHorizontalExpansion(false), m_bVerticalExpansion(false),
-    m_bEnforceLosslessDCT(false)
+    m_bEnforceLosslessDCT(false), m_bIgnoreBoxes(false)
 
 {
   m_NameSpace.DefineSecondaryLookup(&m_pBoxList);
@@ -1726,7 +1726,7 @@ bool Tables::ParseTablesIncremental(class ByteStream *io,class Checksum *chk,boo
      { // APPx markers are not checksummed.
        io->GetWord();
        LONG len = io->GetWord();
-       if (len >= 2 + 2 + 2 + 4 + 4 + 4) { // At least the box header must be present.
+       if (len >= 2 + 2 + 2 + 4 + 4 + 4 && !m_bIgnoreBoxes) { // At least the box header must be present.
          LONG ci = io->PeekWord();
          if (ci == 0x4a50) { 
            class Box *box;
@@ -2035,6 +2035,14 @@ class QuantizationTable *Tables::FindQuantizationTable(UBYTE idx) const
 // Return the color transformer.
 class ColorTrafo *Tables::ColorTrafoOf(class Frame *frame,class Frame *residualframe,UBYTE type,bool encoding)
 {
+  if (m_pColorTrafo && !encoding && type != m_ucColorTrafoType) {
+    // The image is displayed again into a bitmap of a different type,
+    // build a new transformer for it.
+    delete m_pColorFactory; // also deletes the transformation
+    m_pColorFactory = NULL;
+    m_pColorTrafo   = NULL;
+  }
+  
   if (m_pColorTrafo == NULL) {
     UBYTE dctbits,spatialbits;
     UBYTE bpp = frame->PrecisionOf();
@@ -2067,6 +2075,7 @@ class ColorTrafo *Tables::ColorTrafoOf(class Frame *frame,class Frame *residualf
     m_pColorTrafo = m_pColorFactory->BuildColorTransformer(frame,residualframe,
                                                            specs,dctbits,spatialbits,
                                                            type,encoding);
+    m_ucColorTrafoType = type;
   }
   
   return m_pColorTrafo;
@@ -2182,6 +2191,15 @@ void Tables::ForceColorTrafoOff(void)
 }
 ///
 
+/// Tables::ForceLegacyOnly
+// Skip all boxes in APP11 markers on parsing, thus decode only the
+// legacy codestream, ignoring all extension layers.
+void Tables::ForceLegacyOnly(void)
+{
+  m_bIgnoreBoxes = true;
+}
+///
+
 /// Tables::ForceIntegerDCT
 // Enforce the usage of the integer DCT regardless of what the markers
 // tell. This is for testing the precision of the integer vs. fixed point
@@ -162,6 +162,9 @@ class Tables: public JKeeper {
   // The color transformer
   class ColorTrafo              *m_pColorTrafo;
   //
+  // The external pixel type the color transformer was built for.
+  UBYTE                          m_ucColorTrafoType;
+  //
   // The thresholds for JPEG LS
   class Thresholds              *m_pThresholds;
   //
@@ -224,6 +227,10 @@ class Tables: public JKeeper {
   // regardless what.
   bool                           m_bEnforceLosslessDCT;
   //
+  // If this is set, APP11 marker segments are skipped on parsing such that
+  // only the legacy codestream is decoded.
+  bool                           m_bIgnoreBoxes;
+  //
   // Build a tone mapping for the type (base-tag) and the given tag list
   // The base tag is the tag-id for the type of the box. All others are offsets.
   class ToneMapperBox *BuildToneMapping(const struct JPG_TagItem *tags,
@@ -432,6 +439,10 @@ public:
   // DCT.
   void ForceIntegerDCT(void);
   //
+  // Skip all boxes in APP11 markers on parsing, thus decode only the
+  // legacy codestream, ignoring all extension layers.
+  void ForceLegacyOnly(void);
+  //
   // Test whether this setup has designated chroma components. For the
   // legacy codestream, this tests whether there is an L transformation in
   // the path. For the residual codestream, this tests for an R-transformation.
@@ -79,7 +79,7 @@ public:
     T m_Data[64];
   };
   //
-private:
+protected:
   //
   // The block array itself.
   struct Block       *m_pBlocks;
@@ -87,6 +87,8 @@ private:
   // The extend in number of blocks.
   ULONG               m_ulWidth;
   //
+private:
+  //
   // The next row in a row stack.
   class QuantizedRow *m_pNext;
   //
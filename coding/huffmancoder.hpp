@@ -99,6 +99,27 @@ public:
     io->Put(m_ucBits[symbol],m_usCode[symbol]);
   }
   //
+  // Encode the given symbol followed by the n least significant bits
+  // of the additional bits. Both go into the stream with a single call
+  // if the total fits.
+  void Put(BitStream<false> *io,UBYTE symbol,UBYTE n,ULONG bits) const
+  {
+    UBYTE len = m_ucBits[symbol];
+    
+    if (len == 0) {
+      class Environ *m_pEnviron = io->EnvironOf();
+      JPG_THROW(INVALID_HUFFMAN,"HuffmanCoder::Put",
+                "Huffman table is unsuitable for selected coding mode - "
+                "try to build an optimized Huffman table");
+    }
+    if (len + n <= 32) {
+      io->Put(len + n,(ULONG(m_usCode[symbol]) << n) | (bits & ((1UL << n) - 1)));
+    } else {
+      io->Put(len,m_usCode[symbol]);
+      io->Put(n,bits);
+    }
+  }
+  //
   // Return the length of the given symbol.
   UBYTE Length(UBYTE symbol) const
   { 
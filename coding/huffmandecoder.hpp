@@ -85,10 +85,22 @@ class HuffmanDecoder : public JKeeper {
   // And ditto for the length.
   UBYTE *m_pucLength[256];
   //
+  // All second level tables are carved out of this single block, first
+  // all symbol tables, then all length tables.
+  UBYTE *m_pucExtensions;
+  //
+  // Number of second level tables in the above block.
+  ULONG  m_ulExtensions;
+  //
 public:
-  HuffmanDecoder(class Environ *env,
-                 UBYTE *&symbols,UBYTE *&sizes,UBYTE **&lsbsymb,UBYTE **&lsbsize)
-    : JKeeper(env)
+  // Construct the decoder for the given number of second level tables,
+  // all of which are allocated here in one go. The extension pointer
+  // is set to the first of the symbol tables, the length tables follow
+  // the symbol tables and are pre-filled with invalid sizes.
+  HuffmanDecoder(class Environ *env,ULONG extensions,
+                 UBYTE *&symbols,UBYTE *&sizes,UBYTE **&lsbsymb,UBYTE **&lsbsize,
+                 UBYTE *&extension)
+    : JKeeper(env), m_pucExtensions(NULL), m_ulExtensions(extensions)
   {
     symbols = m_ucSymbol;
     sizes   = m_ucLength;
@@ -99,16 +111,18 @@ public:
     memset(m_ucLength ,0xff,sizeof(m_ucLength));
     memset(m_pucSymbol,0   ,sizeof(m_pucSymbol));
     memset(m_pucLength,0   ,sizeof(m_pucLength));
+
+    if (extensions) {
+      m_pucExtensions = (UBYTE *)m_pEnviron->AllocMem(2 * 256 * sizeof(UBYTE) * extensions);
+      memset(m_pucExtensions + 256 * extensions,0xff,256 * sizeof(UBYTE) * extensions);
+    }
+    extension = m_pucExtensions;
   }
   //
   ~HuffmanDecoder(void)
   { 
-    int i;
-
-    for(i = 0;i < 256;i++) {
-      if (m_pucSymbol[i]) m_pEnviron->FreeMem(m_pucSymbol[i],256 * sizeof(UBYTE));      
-      if (m_pucLength[i]) m_pEnviron->FreeMem(m_pucLength[i],256 * sizeof(UBYTE));
-    }
+    if (m_pucExtensions)
+      m_pEnviron->FreeMem(m_pucExtensions,2 * 256 * sizeof(UBYTE) * m_ulExtensions);
   }
   //
   // Decode the next symbol.
@@ -596,14 +596,34 @@ void HuffmanTemplate::BuildDecoder(void)
   UBYTE *sizptr;
   UBYTE **lsbsym;
   UBYTE **lsbsiz;
+  UBYTE *extension;
+  ULONG extensions = 0;
 
   assert(m_pDecoder == NULL);
 
   if (m_pucValues) {
+    ULONG prefix = MAX_ULONG;
     assert(m_ucLengths);
+    //
+    // Count the number of second level tables required for codes longer than
+    // eight bits such that they can be allocated in a single block. As codes
+    // are assigned in increasing order, all codes sharing the same eight bit
+    // prefix are consecutive. Corrupt tables are detected below.
+    for(i = 0;i < 16U && code <= MAX_UWORD + 1;i++) {
+      for(UBYTE j = 0;j < m_ucLengths[i] && code <= MAX_UWORD;j++) {
+        if (i >= 8 && (code >> 8) != prefix) {
+          prefix = code >> 8;
+          extensions++;
+        }
+        code += 1 << (15 - i);
+      }
+    }
+    code = 0;
+    //
     // If the decoder is not used, do not build it.
-    m_pDecoder = new(m_pEnviron) class HuffmanDecoder(m_pEnviron,
-                                                      symptr,sizptr,lsbsym,lsbsiz);
+    m_pDecoder = new(m_pEnviron) class HuffmanDecoder(m_pEnviron,extensions,
+                                                      symptr,sizptr,lsbsym,lsbsiz,
+                                                      extension);
     //
     // Now fill the decoder tables. The tables are indexed by the next 16 bits from
     // the stream (or the next eight bits from the stream) and return the symbol the
@@ -636,11 +656,10 @@ void HuffmanTemplate::BuildDecoder(void)
             code = last;
           } else {
             if (lsbsym[qcode] == NULL) {
-              lsbsym[qcode] = (UBYTE *)m_pEnviron->AllocMem(256 * sizeof(UBYTE));
-            }
-            if (lsbsiz[qcode] == NULL) {
-              lsbsiz[qcode] = (UBYTE *)m_pEnviron->AllocMem(256 * sizeof(UBYTE));
-              memset(lsbsiz[qcode],0xff,256 * sizeof(UBYTE));
+              assert(extensions > 0);
+              lsbsym[qcode] = extension;
+              lsbsiz[qcode] = extension + 256 * extensions;
+              extension    += 256;
             }
             // Codespace must still be unused or already reserved for the extension
             assert(sizptr[qcode] == 0 || sizptr[qcode] == MAX_UBYTE);
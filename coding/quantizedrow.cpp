@@ -58,3 +58,70 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ** $Id: quantizedrow.cpp,v 1.10 2014/09/30 08:33:16 thor Exp $
 **
 */
+
+/// Includes
+#include "coding/quantizedrow.hpp"
+#include "std/string.hpp"
+///
+
+/// QuantizedRow::~QuantizedRow
+QuantizedRow::~QuantizedRow(void)
+{
+  if (m_bBorrowed) {
+    // Keep the base class from releasing the blocks.
+    m_pBlocks = NULL;
+    return;
+  }
+  if (m_pCompact) {
+    m_pEnviron->FreeMem(m_pCompact,sizeof(struct CompactBlock) * m_ulWidth);
+  }
+  if (m_pucChanged) {
+    m_pEnviron->FreeMem(m_pucChanged,sizeof(UBYTE) * m_ulWidth);
+  }
+}
+///
+
+/// QuantizedRow::AllocateRow
+// Allocate a row of data, sufficient to hold the indicated number of cofficients.
+// If compact is set, the coefficients are kept in 16 bits. All blocks
+// of a new row count as changed.
+void QuantizedRow::AllocateRow(ULONG coefficients,bool compact)
+{
+  if (m_pBlocks == NULL && m_pCompact == NULL) {
+    if (compact) {
+      m_ulWidth  = (coefficients + 7) >> 3;
+      m_pCompact = (struct CompactBlock *)m_pEnviron->AllocMem(sizeof(struct CompactBlock) * m_ulWidth);
+      memset(m_pCompact,0,sizeof(struct CompactBlock) * m_ulWidth);
+    } else {
+      BlockRow<LONG>::AllocateRow(coefficients);
+    }
+    m_pucChanged = (UBYTE *)m_pEnviron->AllocMem(sizeof(UBYTE) * m_ulWidth);
+    memset(m_pucChanged,1,sizeof(UBYTE) * m_ulWidth);
+    m_bChanged   = true;
+  } else {
+    assert(m_ulWidth == (coefficients + 7) >> 3);
+    assert(compact == (m_pCompact != NULL));
+  }
+}
+///
+
+/// QuantizedRow::AttachRow
+// Use the given memory for the blocks and the change flags of the row
+// instead of allocating it. The memory remains owned by the caller.
+// All blocks of the row count as changed.
+void QuantizedRow::AttachRow(ULONG coefficients,bool compact,APTR blocks,UBYTE *changed)
+{
+  assert(m_pBlocks == NULL && m_pCompact == NULL);
+
+  m_ulWidth = (coefficients + 7) >> 3;
+  if (compact) {
+    m_pCompact = (struct CompactBlock *)blocks;
+  } else {
+    m_pBlocks  = (struct Block *)blocks;
+  }
+  m_pucChanged = changed;
+  memset(m_pucChanged,1,sizeof(UBYTE) * m_ulWidth);
+  m_bChanged   = true;
+  m_bBorrowed  = true;
+}
+///
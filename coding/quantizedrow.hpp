@@ -65,20 +65,164 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /// Includes
 #include "tools/environment.hpp"
 #include "coding/blockrow.hpp"
+#include "std/string.hpp"
 ///
 
 /// class QuantizedRow
 // This class represents one row of quantized data of coefficients, i.e. one
-// row of 8x8 blocks.
+// row of 8x8 blocks. Rows of frames whose coefficients fit into 16 bits
+// may be allocated in a compact representation, then the 32-bit blocks
+// of the base class are not present and blocks must be accessed through
+// FetchBlock and StoreBlock. Each block also carries a flag that is set
+// whenever a scan alters the block, such that a refresh of the display
+// only needs to reconstruct blocks that changed since the last update.
 class QuantizedRow : public BlockRow<LONG> {
-  // Nothing new in it.
+  //
+public:
+  // A block in compact representation.
+  struct CompactBlock {
+    WORD m_Data[64];
+  };
+  //
+private:
+  //
+  // The compact block array, if this row is compact.
+  struct CompactBlock *m_pCompact;
+  //
+  // One flag per block, non-zero if the block has been altered since
+  // it was reconstructed the last time in update mode.
+  UBYTE               *m_pucChanged;
+  //
+  // Set if any of the above flags may be set.
+  bool                 m_bChanged;
+  //
+  // Set if the blocks and flags are borrowed from memory owned
+  // by someone else and thus must not be released here.
+  bool                 m_bBorrowed;
+  //
 public:
   QuantizedRow(class Environ *env)
-    : BlockRow<LONG>(env)
+    : BlockRow<LONG>(env), m_pCompact(NULL), m_pucChanged(NULL), m_bChanged(false),
+      m_bBorrowed(false)
   { }
   //
-  ~QuantizedRow(void)
-  { }
+  ~QuantizedRow(void);
+  //
+  // Allocate a row of data, sufficient to hold the indicated number of cofficients.
+  // If compact is set, the coefficients are kept in 16 bits. This must only
+  // be requested if all coefficients of the frame are known to fit.
+  void AllocateRow(ULONG coefficients,bool compact = false);
+  //
+  // Use the given memory for the blocks and the change flags of the row
+  // instead of allocating it. The blocks must hold the indicated number
+  // of coefficients, in 16 bits if compact is set. The memory remains
+  // owned by the caller and must be zero-initialized.
+  void AttachRow(ULONG coefficients,bool compact,APTR blocks,UBYTE *changed);
+  //
+  // Check whether this row keeps its coefficients in 16 bits.
+  bool isCompact(void) const
+  {
+    return m_pCompact != NULL;
+  }
+  //
+  // Return the n'th block. This is only available for 32-bit rows.
+  struct Block *BlockAt(ULONG pos) const
+  {
+    assert(m_pCompact == NULL);
+    return BlockRow<LONG>::BlockAt(pos);
+  }
+  //
+  // Return the coefficients of the n'th block. For 32-bit rows, this is a
+  // pointer into the row itself, compact rows are expanded into the buffer
+  // which must be able to hold 64 coefficients.
+  LONG *FetchBlock(ULONG pos,LONG *buffer) const
+  {
+    const WORD *src;
+    int k;
+    //
+    if (m_pCompact == NULL)
+      return BlockRow<LONG>::BlockAt(pos)->m_Data;
+    //
+    assert(pos < m_ulWidth);
+    src = m_pCompact[pos].m_Data;
+    for(k = 0;k < 64;k++)
+      buffer[k] = src[k];
+    //
+    return buffer;
+  }
+  //
+  // Return a buffer the coefficients of the n'th block can be written into
+  // without reading them first. For 32-bit rows, this is the row itself,
+  // compact rows return the buffer which is then to be passed into StoreBlock.
+  LONG *TargetBlock(ULONG pos,LONG *buffer) const
+  {
+    if (m_pCompact == NULL)
+      return BlockRow<LONG>::BlockAt(pos)->m_Data;
+    //
+    assert(pos < m_ulWidth);
+    return buffer;
+  }
+  //
+  // Write the coefficients of the n'th block back into the row. This is a no-op if
+  // the data was obtained from FetchBlock on a 32-bit row. Coefficients are
+  // saturated to 16 bits for compact rows.
+  void StoreBlock(ULONG pos,const LONG *data)
+  {
+    WORD *dst;
+    int k;
+    //
+    if (m_pCompact == NULL) {
+      LONG *blk = BlockRow<LONG>::BlockAt(pos)->m_Data;
+      if (blk != data)
+        memcpy(blk,data,sizeof(LONG) * 64);
+      return;
+    }
+    //
+    assert(pos < m_ulWidth);
+    dst = m_pCompact[pos].m_Data;
+    for(k = 0;k < 64;k++) {
+      LONG v = data[k];
+      if (v > MAX_WORD) v = MAX_WORD;
+      if (v < MIN_WORD) v = MIN_WORD;
+      dst[k] = WORD(v);
+    }
+  }
+  //
+  // Mark the n'th block as altered by a scan.
+  void MarkChanged(ULONG pos)
+  {
+    assert(pos < m_ulWidth);
+    m_pucChanged[pos] = 1;
+    m_bChanged        = true;
+  }
+  //
+  // Check whether any block of this row may have changed since the
+  // last update.
+  bool isChanged(void) const
+  {
+    return m_bChanged;
+  }
+  //
+  // Check whether the n'th block changed since the last update.
+  bool isChanged(ULONG pos) const
+  {
+    assert(pos < m_ulWidth);
+    return m_pucChanged[pos] != 0;
+  }
+  //
+  // Reset the change indicator of the n'th block.
+  void ClearChanged(ULONG pos)
+  {
+    assert(pos < m_ulWidth);
+    m_pucChanged[pos] = 0;
+  }
+  //
+  // Reset the change indicators of the full row.
+  void ClearChanged(void)
+  {
+    memset(m_pucChanged,0,sizeof(UBYTE) * m_ulWidth);
+    m_bChanged = false;
+  }
 };
 ///
 
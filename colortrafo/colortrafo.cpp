@@ -64,3 +64,14 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "colortrafo/colortrafo.hpp"
 #include "tools/traits.hpp"
 ///
+
+/// ColorTrafo::YCbCr2RGBMerged
+// Inverse transform a block from YCbCr to RGB, merging the horizontal
+// upsampling of the chroma components by two into the transformation.
+void ColorTrafo::YCbCr2RGBMerged(const RectAngle<LONG> &,const struct ImageBitMap *const *,
+                                 const LONG *,const LONG *const *,const LONG *const *)
+{
+  JPG_THROW(NOT_IMPLEMENTED,"ColorTrafo::YCbCr2RGBMerged",
+            "the color transformation does not support merging with the upsampling");
+}
+///
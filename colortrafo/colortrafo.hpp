@@ -159,6 +159,23 @@ public:
   virtual void YCbCr2RGB(const RectAngle<LONG> &r,const struct ImageBitMap *const *dest,
                          Buffer source,Buffer residual) = 0;
   //
+  // Check whether this transformation can merge the horizontal upsampling
+  // of the chroma components by two into the inverse transformation.
+  virtual bool isMergeable(void) const
+  {
+    return false;
+  }
+  //
+  // Inverse transform a block from YCbCr to RGB, merging the horizontal
+  // upsampling of the chroma components by two into the transformation.
+  // The luma component is an 8x8 block, the chroma components are
+  // given as eight vertically filtered, but not horizontally expanded
+  // lines, indexed by half the horizontal image position plus one.
+  // The block must be aligned to the block grid. Only available if
+  // isMergeable() returns true.
+  virtual void YCbCr2RGBMerged(const RectAngle<LONG> &r,const struct ImageBitMap *const *dest,
+                               const LONG *luma,const LONG *const *cb,const LONG *const *cr);
+  //
   // Return the external pixel type of this trafo.
   virtual UBYTE PixelTypeOf(void) const = 0;
 };
@@ -590,6 +590,11 @@ void YCbCrTrafo<external,count,oc,trafo,rtrafo>::YCbCr2RGB(const RectAngle<LONG>
   LONG ymax   = r.ra_MaxY & 7;
   
   assert(source);
+
+  if (residual && isProfileCKernelApplicable()) {
+    ProfileCYCbCr2RGB(r,dest,source,residual);
+    return;
+  }
   
   if (m_lOutMax > TypeTrait<external>::Max) {
     JPG_THROW(OVERFLOW_PARAMETER,"YCbCrTrafo::YCbCr2RGB",
@@ -847,6 +852,347 @@ void YCbCrTrafo<external,count,oc,trafo,rtrafo>::YCbCr2RGB(const RectAngle<LONG>
 }
 ///
 
+/// YCbCrTrafo::isProfileCKernelApplicable
+// Check whether the profile C kernel can be used. This requires
+// three components, YCbCr as L and R transformation, an identity C
+// transformation, clamping and all L and Q tables.
+template<typename external,int count,UBYTE oc,int trafo,int rtrafo>
+bool YCbCrTrafo<external,count,oc,trafo,rtrafo>::isProfileCKernelApplicable(void) const
+{
+  int i;
+  
+  if (count != 3 || trafo != MergingSpecBox::YCbCr || rtrafo != MergingSpecBox::YCbCr)
+    return false;
+
+  if ((oc & (Residual | Extended | ClampFlag)) != (Residual | Extended | ClampFlag))
+    return false;
+
+  for(i = 0;i < 3;i++) {
+    if (m_plDecodingLUT[i] == NULL || m_plResidualLUT[i] == NULL)
+      return false;
+  }
+  //
+  // The C transformation must be the identity, then the fix point
+  // rounding of FIX_TO_INT is exact and can be skipped.
+  for(i = 0;i < 9;i++) {
+    if (m_lC[i] != ((i % 4 == 0)?(1L << FIX_BITS):(0)))
+      return false;
+  }
+
+  return true;
+}
+///
+
+/// MatrixNormOf
+// Return the maximum absolute row sum of a 3x3 fix point matrix.
+static inline QUAD MatrixNormOf(const LONG *m)
+{
+  QUAD norm = 0;
+  int i;
+
+  for(i = 0;i < 9;i += 3) {
+    QUAD sum = QUAD(labs(m[i])) + labs(m[i + 1]) + labs(m[i + 2]);
+    if (sum > norm)
+      norm = sum;
+  }
+
+  return norm;
+}
+///
+
+/// FitsLong
+// Check whether the product of a 3x3 matrix of the given norm with
+// arguments in the range [min,max], plus a rounding offset, fits into
+// a LONG.
+static inline bool FitsLong(QUAD norm,LONG min,LONG max,LONG round)
+{
+  QUAD bound = (QUAD(max) > -QUAD(min))?(QUAD(max)):(-QUAD(min));
+
+  return bound * norm <= QUAD(MAX_LONG) - round;
+}
+///
+
+/// YCbCrTrafo::ProfileCYCbCr2RGB
+// The inverse transformation for profile C with an identity C
+// transformation. This computes exactly what YCbCr2RGB computes, but
+// runs each step over the entire row of the block before the next one
+// starts such that the gather-free steps, i.e. the L and R
+// transformations, the merging, clamping and output conversion, form
+// simple loops the compiler can vectorize. The matrix products are
+// computed in 32 bits whenever the range of the arguments allows.
+template<typename external,int count,UBYTE oc,int trafo,int rtrafo>
+void YCbCrTrafo<external,count,oc,trafo,rtrafo>::ProfileCYCbCr2RGB(const RectAngle<LONG> &r,
+                                                                   const struct ImageBitMap *const *dest,
+                                                                   Buffer source,Buffer residual)
+{
+  LONG x,y,c;
+  LONG xmin     = r.ra_MinX & 7;
+  LONG ymin     = r.ra_MinY & 7;
+  LONG xmax     = r.ra_MaxX & 7;
+  LONG ymax     = r.ra_MaxY & 7;
+  LONG n        = xmax - xmin + 1;
+  LONG dcshift  = m_lDCShift    << COLOR_BITS;
+  LONG rdshift  = m_lOutDCShift << COLOR_BITS;
+  LONG lmax     = m_lMax;
+  LONG rmax     = ((m_lRMax   + 1) << COLOR_BITS) - 1;
+  LONG omax     = ((m_lOutMax + 1) << COLOR_BITS) - 1;
+  LONG outmax   = m_lOutMax;
+  LONG outshift = m_lOutDCShift;
+  // The half-float representations of +INF and -INF.
+  LONG pinf     = (m_lOutMax >> 1) - (m_lOutMax >> 6) - 1;
+  LONG minf     = INVERT_NEGS(pinf | 0x8000);
+  // The rounding offsets of the L and R transformations.
+  LONG lround   = (1L << (FIX_BITS + COLOR_BITS)) >> 1;
+  LONG rround   = (1L << FIX_BITS) >> 1;
+  LONG l[9],rm[9];
+  QUAD lnorm,rnorm;
+  
+  if (m_lOutMax > TypeTrait<external>::Max) {
+    JPG_THROW(OVERFLOW_PARAMETER,"YCbCrTrafo::YCbCr2RGB",
+              "RGB maximum intensity for pixel type does not fit into the type");
+  }
+  
+  for(c = 0;c < 3;c++) {
+    if (dest[0]->ibm_ucPixelType != dest[c]->ibm_ucPixelType) {
+      JPG_THROW(INVALID_PARAMETER,"YCbCrTrafo::YCbCr2RGB",
+                "pixel types of all three components in a YCbCr to RGB conversion must be identical");
+    }
+  }
+  //
+  // Local copies help the compiler as they cannot alias with the output.
+  memcpy(l ,m_lL,sizeof(l));
+  memcpy(rm,m_lR,sizeof(rm));
+  lnorm = MatrixNormOf(l);
+  rnorm = MatrixNormOf(rm);
+
+  for(y = ymin;y <= ymax;y++) {
+    LONG yv[8],cb[8],cr[8];
+    LONG ldr[3][8],res[3][8];
+    LONG min = 0,max = 0;
+    //
+    // The L-transformation, including the clamping of the table index.
+    {
+      const LONG *ysrc  = source[0] + xmin + (y << 3);
+      const LONG *cbsrc = source[1] + xmin + (y << 3);
+      const LONG *crsrc = source[2] + xmin + (y << 3);
+      for(x = 0;x < n;x++) {
+        yv[x] = ysrc[x];
+        cb[x] = cbsrc[x] - dcshift;
+        cr[x] = crsrc[x] - dcshift;
+        min   = (yv[x] < min)?(yv[x]):(min);
+        max   = (yv[x] > max)?(yv[x]):(max);
+        min   = (cb[x] < min)?(cb[x]):(min);
+        max   = (cb[x] > max)?(cb[x]):(max);
+        min   = (cr[x] < min)?(cr[x]):(min);
+        max   = (cr[x] > max)?(cr[x]):(max);
+      }
+    }
+    if (FitsLong(lnorm,min,max,lround)) {
+      // As FIX_COLOR_TO_INT, but in 32 bits.
+      for(x = 0;x < n;x++) {
+        LONG rv = (yv[x] * l[0] + cb[x] * l[1] + cr[x] * l[2] + lround) >> (FIX_BITS + COLOR_BITS);
+        LONG gv = (yv[x] * l[3] + cb[x] * l[4] + cr[x] * l[5] + lround) >> (FIX_BITS + COLOR_BITS);
+        LONG bv = (yv[x] * l[6] + cb[x] * l[7] + cr[x] * l[8] + lround) >> (FIX_BITS + COLOR_BITS);
+        ldr[0][x] = CLAMP(lmax,rv);
+        ldr[1][x] = CLAMP(lmax,gv);
+        ldr[2][x] = CLAMP(lmax,bv);
+      }
+    } else {
+      for(x = 0;x < n;x++) {
+        LONG rv = FIX_COLOR_TO_INT(QUAD(yv[x]) * l[0] + QUAD(cb[x]) * l[1] + QUAD(cr[x]) * l[2]);
+        LONG gv = FIX_COLOR_TO_INT(QUAD(yv[x]) * l[3] + QUAD(cb[x]) * l[4] + QUAD(cr[x]) * l[5]);
+        LONG bv = FIX_COLOR_TO_INT(QUAD(yv[x]) * l[6] + QUAD(cb[x]) * l[7] + QUAD(cr[x]) * l[8]);
+        ldr[0][x] = CLAMP(lmax,rv);
+        ldr[1][x] = CLAMP(lmax,gv);
+        ldr[2][x] = CLAMP(lmax,bv);
+      }
+    }
+    //
+    // The L and Q tables.
+    for(c = 0;c < 3;c++) {
+      const LONG *lut  = m_plDecodingLUT[c];
+      const LONG *qlut = m_plResidualLUT[c];
+      const LONG *rsrc = residual[c] + xmin + (y << 3);
+      for(x = 0;x < n;x++) {
+        ldr[c][x] = lut[ldr[c][x]];
+        res[c][x] = qlut[CLAMP(rmax,rsrc[x])];
+      }
+    }
+    //
+    // The R-transformation.
+    min = max = 0;
+    for(x = 0;x < n;x++) {
+      yv[x] = res[0][x];
+      cb[x] = res[1][x] - rdshift;
+      cr[x] = res[2][x] - rdshift;
+      min   = (yv[x] < min)?(yv[x]):(min);
+      max   = (yv[x] > max)?(yv[x]):(max);
+      min   = (cb[x] < min)?(cb[x]):(min);
+      max   = (cb[x] > max)?(cb[x]):(max);
+      min   = (cr[x] < min)?(cr[x]):(min);
+      max   = (cr[x] > max)?(cr[x]):(max);
+    }
+    if (FitsLong(rnorm,min,max,rround)) {
+      // As FIX_COLOR_TO_INTCOLOR, but in 32 bits.
+      for(x = 0;x < n;x++) {
+        res[0][x] = (yv[x] * rm[0] + cb[x] * rm[1] + cr[x] * rm[2] + rround) >> FIX_BITS;
+        res[1][x] = (yv[x] * rm[3] + cb[x] * rm[4] + cr[x] * rm[5] + rround) >> FIX_BITS;
+        res[2][x] = (yv[x] * rm[6] + cb[x] * rm[7] + cr[x] * rm[8] + rround) >> FIX_BITS;
+      }
+    } else {
+      for(x = 0;x < n;x++) {
+        res[0][x] = FIX_COLOR_TO_INTCOLOR(QUAD(yv[x]) * rm[0] + QUAD(cb[x]) * rm[1] + QUAD(cr[x]) * rm[2]);
+        res[1][x] = FIX_COLOR_TO_INTCOLOR(QUAD(yv[x]) * rm[3] + QUAD(cb[x]) * rm[4] + QUAD(cr[x]) * rm[5]);
+        res[2][x] = FIX_COLOR_TO_INTCOLOR(QUAD(yv[x]) * rm[6] + QUAD(cb[x]) * rm[7] + QUAD(cr[x]) * rm[8]);
+      }
+    }
+    //
+    // The R tables, if present, merging and output conversion.
+    for(c = 0;c < 3;c++) {
+      const LONG *lut = m_plResidual2LUT[c];
+      external *dst   = (external *)((UBYTE *)(dest[c]->ibm_pData) + 
+                                     (y - ymin) * dest[c]->ibm_lBytesPerRow);
+      UBYTE bpp       = dest[c]->ibm_cBytesPerPixel;
+      LONG out[8];
+      if (lut) {
+        for(x = 0;x < n;x++) {
+          res[c][x] = lut[CLAMP(omax,res[c][x])];
+        }
+      }
+      for(x = 0;x < n;x++) {
+        LONG v = ldr[c][x] + res[c][x] - outshift;
+        if (oc & Float) {
+          v      = (v > pinf)?(pinf):((v < minf)?(minf):(v));
+          out[x] = INVERT_NEGS(v);
+        } else {
+          out[x] = CLAMP(outmax,v);
+        }
+      }
+      for(x = 0;x < n;x++) {
+        *dst = out[x];
+        dst  = (external *)((UBYTE *)(dst) + bpp);
+      }
+    }
+  }
+}
+///
+
+/// YCbCrTrafo::isMergeable
+// Check whether this transformation can merge the horizontal upsampling
+// of the chroma components by two into the inverse transformation. This
+// is the case for three component images without a residual.
+template<typename external,int count,UBYTE oc,int trafo,int rtrafo>
+bool YCbCrTrafo<external,count,oc,trafo,rtrafo>::isMergeable(void) const
+{
+  return count == 3 && trafo == MergingSpecBox::YCbCr &&
+    (oc & (ColorTrafo::Residual | ColorTrafo::Float)) == 0 && (oc & ColorTrafo::ClampFlag);
+}
+///
+
+/// ExpandChroma
+// Expand eight pixels of a vertically filtered chroma line horizontally
+// by two. This is the filter of the block based upsampler, including its
+// use of the already filtered second pixel for the first.
+static inline void ExpandChroma(const LONG *v,LONG *out)
+{
+  out[0] = (v[0] + 3 * v[1] + 2) >> 2;
+  out[2] = (v[1] + 3 * v[2] + 2) >> 2;
+  out[3] = (v[3] + 3 * v[2] + 1) >> 2;
+  out[4] = (v[2] + 3 * v[3] + 2) >> 2;
+  out[5] = (v[4] + 3 * v[3] + 1) >> 2;
+  out[6] = (v[3] + 3 * v[4] + 2) >> 2;
+  out[7] = (v[5] + 3 * v[4] + 1) >> 2;
+  out[1] = (out[2] + 3 * v[1] + 1) >> 2;
+}
+///
+
+/// YCbCrTrafo::YCbCr2RGBMerged
+// Inverse transform a block from YCbCr to RGB, merging the horizontal
+// upsampling of the chroma components by two into the transformation.
+template<typename external,int count,UBYTE oc,int trafo,int rtrafo>
+void YCbCrTrafo<external,count,oc,trafo,rtrafo>::YCbCr2RGBMerged(const RectAngle<LONG> &r,
+                                                                 const struct ImageBitMap *const *dest,
+                                                                 const LONG *luma,
+                                                                 const LONG *const *cblines,
+                                                                 const LONG *const *crlines)
+{
+  LONG x,y;
+  LONG xmax   = r.ra_MaxX & 7;
+  LONG ymax   = r.ra_MaxY & 7;
+  LONG offset = r.ra_MinX >> 1;
+  
+  if (!isMergeable()) {
+    ColorTrafo::YCbCr2RGBMerged(r,dest,luma,cblines,crlines);
+    return;
+  }
+  
+  assert((r.ra_MinX & 7) == 0 && (r.ra_MinY & 7) == 0);
+  
+  if (m_lOutMax > TypeTrait<external>::Max) {
+    JPG_THROW(OVERFLOW_PARAMETER,"YCbCrTrafo::YCbCr2RGBMerged",
+              "RGB maximum intensity for pixel type does not fit into the type");
+  }
+  
+  for(x = 0;x < count;x++) {
+    if (dest[0]->ibm_ucPixelType != dest[x]->ibm_ucPixelType) {
+      JPG_THROW(INVALID_PARAMETER,"YCbCrTrafo::YCbCr2RGBMerged",
+                "pixel types of all three components in a YCbCr to RGB conversion must be identical");
+    }
+  }
+
+  {
+    external *rptr = (external *)(dest[0]->ibm_pData);
+    external *gptr = (external *)(dest[1]->ibm_pData);
+    external *bptr = (external *)(dest[2]->ibm_pData);
+    for(y = 0;y <= ymax;y++) {
+      const LONG *ysrc = luma + (y << 3);
+      external *r = rptr;
+      external *g = gptr;
+      external *b = bptr;
+      LONG cbsrc[8],crsrc[8];
+      //
+      ExpandChroma(cblines[y] + offset,cbsrc);
+      ExpandChroma(crlines[y] + offset,crsrc);
+      //
+      for(x = 0;x <= xmax;x++) {
+        LONG cr = crsrc[x] - (m_lDCShift << COLOR_BITS);
+        LONG cb = cbsrc[x] - (m_lDCShift << COLOR_BITS);
+        LONG yv = ysrc[x];
+        LONG rv = FIX_COLOR_TO_INT(QUAD(yv) * m_lL[0] + QUAD(cb) * m_lL[1] + QUAD(cr) * m_lL[2]);
+        LONG gv = FIX_COLOR_TO_INT(QUAD(yv) * m_lL[3] + QUAD(cb) * m_lL[4] + QUAD(cr) * m_lL[5]);
+        LONG bv = FIX_COLOR_TO_INT(QUAD(yv) * m_lL[6] + QUAD(cb) * m_lL[7] + QUAD(cr) * m_lL[8]);
+        //
+        if (oc & Extended) {
+          // Apply the L-Lut.
+          rv = APPLY_LUT(m_plDecodingLUT[0],m_lMax,rv);
+          gv = APPLY_LUT(m_plDecodingLUT[1],m_lMax,gv);
+          bv = APPLY_LUT(m_plDecodingLUT[2],m_lMax,bv);
+          //
+          // Apply the C-Transformation. Without a residual, this is
+          // already the output.
+          LONG rx = FIX_TO_INT(QUAD(rv) * m_lC[0] + QUAD(gv) * m_lC[1] + QUAD(bv) * m_lC[2]);
+          LONG gx = FIX_TO_INT(QUAD(rv) * m_lC[3] + QUAD(gv) * m_lC[4] + QUAD(bv) * m_lC[5]);
+          LONG bx = FIX_TO_INT(QUAD(rv) * m_lC[6] + QUAD(gv) * m_lC[7] + QUAD(bv) * m_lC[8]);
+          rv = rx;
+          gv = gx;
+          bv = bx;
+        }
+        //
+        *r = CLAMP(m_lOutMax,rv);
+        r  = (external *)((UBYTE *)(r) + dest[0]->ibm_cBytesPerPixel);
+        *g = CLAMP(m_lOutMax,gv);
+        g  = (external *)((UBYTE *)(g) + dest[1]->ibm_cBytesPerPixel);
+        *b = CLAMP(m_lOutMax,bv);
+        b  = (external *)((UBYTE *)(b) + dest[2]->ibm_cBytesPerPixel);
+      }
+      rptr  = (external *)((UBYTE *)(rptr) + dest[0]->ibm_lBytesPerRow);
+      gptr  = (external *)((UBYTE *)(gptr) + dest[1]->ibm_lBytesPerRow);
+      bptr  = (external *)((UBYTE *)(bptr) + dest[2]->ibm_lBytesPerRow);
+    }
+  }
+}
+///
+
 /// Explicit instanciations
 // One component
 template class YCbCrTrafo<UBYTE,1,ColorTrafo::ClampFlag,MergingSpecBox::Identity,MergingSpecBox::Zero>;
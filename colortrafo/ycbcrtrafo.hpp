@@ -79,6 +79,18 @@ class YCbCrTrafo : public IntegerTrafo {
   // A private helper to implement the identity transformation.
   TrivialTrafo<LONG,external,count> m_TrivialHelper;
   //
+  // Check whether the profile C kernel below can be used. This requires
+  // three components, YCbCr as L and R transformation, an identity C
+  // transformation, clamping and all L and Q tables.
+  bool isProfileCKernelApplicable(void) const;
+  //
+  // The inverse transformation for the above case. This runs the steps of
+  // YCbCr2RGB separately over each row of the block such that the
+  // transformations, clamping and output conversion do not interleave
+  // with the table lookups and can be vectorized.
+  void ProfileCYCbCr2RGB(const RectAngle<LONG> &r,const struct ImageBitMap *const *dest,
+                         Buffer source,Buffer residuals);
+  //
 public:
   YCbCrTrafo(class Environ *env,LONG dcshift,LONG max,LONG rdcshift,LONG rmax,LONG outshift,LONG outmax);
   //
@@ -113,6 +125,16 @@ public:
   virtual void YCbCr2RGB(const RectAngle<LONG> &r,const struct ImageBitMap *const *dest,
                          Buffer source,Buffer residuals);
   //
+  // Check whether this transformation can merge the horizontal upsampling
+  // of the chroma components by two into the inverse transformation. This
+  // is the case for three component images without a residual.
+  virtual bool isMergeable(void) const;
+  //
+  // Inverse transform a block from YCbCr to RGB, merging the horizontal
+  // upsampling of the chroma components by two into the transformation.
+  virtual void YCbCr2RGBMerged(const RectAngle<LONG> &r,const struct ImageBitMap *const *dest,
+                               const LONG *luma,const LONG *const *cb,const LONG *const *cr);
+  //
   // Return the pixel type of this transformer.
   virtual UBYTE PixelTypeOf(void) const
   {
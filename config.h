@@ -335,6 +335,9 @@
 # define HAVE_SIGSEGV 1
 # define HAVE_SIGNAL 1
 # define HAS__NULL_TYPE 1
+//
+// Count leading and trailing zero bits.
+# define HAVE_BUILTIN_CLZ 1
 # ifndef NORETURN
 #  define NORETURN       __attribute__ ((noreturn))
 # endif
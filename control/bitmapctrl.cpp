@@ -66,6 +66,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "control/bitmapctrl.hpp"
 #include "interface/bitmaphook.hpp"
 #include "codestream/rectanglerequest.hpp"
+#include "tools/instrumentation.hpp"
 #include "std/string.hpp"
 ///
 
@@ -153,6 +154,8 @@ void BitmapCtrl::ClipToImage(RectAngle<LONG> &rect) const
 // index) is requested.
 void BitmapCtrl::RequestUserData(class BitMapHook *bmh,const RectAngle<LONG> &r,UBYTE comp,bool alpha)
 {
+  StageTimer timer(m_pEnviron,JPGFLAG_STATS_BITMAP_HOOK);
+  
   assert(comp < m_ucCount && bmh);
 
   if (alpha) {
@@ -190,6 +193,8 @@ void BitmapCtrl::RequestUserData(class BitMapHook *bmh,const RectAngle<LONG> &r,
 // Release the user data again through the bitmap hook.
 void BitmapCtrl::ReleaseUserData(class BitMapHook *bmh,const RectAngle<LONG> &r,UBYTE comp,bool alpha)
 {
+  StageTimer timer(m_pEnviron,JPGFLAG_STATS_BITMAP_HOOK);
+  
   assert(comp < 4 && bmh);
   
   // If we have LDR bitmaps, release this one first as it was requested last.
@@ -187,6 +187,12 @@ public:
   // Reconstruct a block, or part of a block
   virtual void ReconstructRegion(const RectAngle<LONG> &region,const struct RectangleRequest *rr) = 0;
   //
+  // Clip the region passed into the last call of ReconstructRegion to the
+  // lines that have actually been written. Controls that do not support
+  // updates always reconstruct the full region.
+  virtual void UpdatedRegionOf(RectAngle<LONG> &) const
+  { }
+  //
   // Return the number of lines available for reconstruction from this scan.
   virtual ULONG BufferedLines(const struct RectangleRequest *rr) const = 0;
   //
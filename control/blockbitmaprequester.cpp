@@ -80,7 +80,219 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "dct/dct.hpp"
 #include "dct/deringing.hpp"
 #include "colortrafo/colortrafo.hpp"
+#include "tools/instrumentation.hpp"
 #include "std/string.hpp"
+#if defined(USE_MULTITHREADING) && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define TRANSFORM_THREADS 1
+#endif
+///
+
+/// class TransformPool
+#ifdef TRANSFORM_THREADS
+// The threads that color transform, forward transform and quantize the
+// blocks of the regions delivered by the bitmap hook on encoding. The
+// threads remain alive between the regions and wait for the next one.
+// Each region is cut into slices, which are parts of block rows, that
+// are handed out to the threads in order.
+class TransformPool : public JKeeper {
+public:
+  //
+  // A single thread of the pool, along with the temporary bitmaps and
+  // color buffers it works on.
+  struct Worker : public JObject {
+    class TransformPool  *w_pPool;
+    pthread_t             w_Thread;
+    //
+    // The region this thread worked on last.
+    ULONG                 w_ulGeneration;
+    //
+    struct ImageBitMap    w_IBM[4];
+    struct ImageBitMap   *w_pIBM[4];
+    LONG                  w_lColorBuffer[4 * 64];
+    LONG                 *w_plCTemp[4];
+    //
+    Worker(class TransformPool *pool)
+      : w_pPool(pool), w_ulGeneration(0)
+    {
+      for(int i = 0;i < 4;i++) {
+        w_pIBM[i]    = w_IBM + i;
+        w_plCTemp[i] = w_lColorBuffer + i * 64;
+      }
+    }
+  };
+  //
+  // The requester whose blocks are transformed.
+  class BlockBitmapRequester *m_pRequester;
+  //
+  // The threads, and the number of them that could be started.
+  struct Worker             **m_ppWorkers;
+  ULONG                       m_ulWorkers;
+  ULONG                       m_ulStarted;
+  //
+  // The quantized rows of the region, one per component and block row,
+  // and the number of entries allocated for them.
+  class QuantizedRow        **m_ppRows;
+  ULONG                       m_ulRows;
+  //
+  // The region currently transformed, and its extent in blocks.
+  const RectAngle<LONG>      *m_pRegion;
+  class ColorTrafo           *m_pTrafo;
+  LONG                        m_lMinX;
+  LONG                        m_lMaxX;
+  LONG                        m_lMinY;
+  //
+  // The slices of the region and the next one to hand out.
+  ULONG                       m_ulSlicesPerRow;
+  ULONG                       m_ulSlices;
+  ULONG                       m_ulNext;
+  //
+  // Counts the regions handed out, and the number of threads
+  // still working on the current one.
+  ULONG                       m_ulGeneration;
+  ULONG                       m_ulBusy;
+  //
+  // Set if the threads shall terminate.
+  bool                        m_bQuit;
+  //
+  pthread_mutex_t             m_Lock;
+  pthread_cond_t              m_Start;
+  pthread_cond_t              m_Done;
+  //
+  TransformPool(class Environ *env,class BlockBitmapRequester *requester)
+    : JKeeper(env), m_pRequester(requester), m_ppWorkers(NULL), m_ulWorkers(0), m_ulStarted(0),
+      m_ppRows(NULL), m_ulRows(0), m_pRegion(NULL), m_pTrafo(NULL), 
+      m_ulSlicesPerRow(0), m_ulSlices(0), m_ulNext(0), m_ulGeneration(0), m_ulBusy(0),
+      m_bQuit(false)
+  {
+    pthread_mutex_init(&m_Lock,NULL);
+    pthread_cond_init(&m_Start,NULL);
+    pthread_cond_init(&m_Done,NULL);
+  }
+  //
+  ~TransformPool(void)
+  {
+    ULONG i;
+    //
+    // Wake up all threads and wait for them to go away.
+    pthread_mutex_lock(&m_Lock);
+    m_bQuit = true;
+    pthread_cond_broadcast(&m_Start);
+    pthread_mutex_unlock(&m_Lock);
+    for(i = 0;i < m_ulStarted;i++) {
+      pthread_join(m_ppWorkers[i]->w_Thread,NULL);
+    }
+    if (m_ppWorkers) {
+      for(i = 0;i < m_ulWorkers;i++)
+        delete m_ppWorkers[i];
+      m_pEnviron->FreeMem(m_ppWorkers,m_ulWorkers * sizeof(struct Worker *));
+    }
+    if (m_ppRows)
+      m_pEnviron->FreeMem(m_ppRows,m_ulRows * sizeof(class QuantizedRow *));
+    pthread_cond_destroy(&m_Done);
+    pthread_cond_destroy(&m_Start);
+    pthread_mutex_destroy(&m_Lock);
+  }
+  //
+  // Make sure that the given number of quantized rows can be kept.
+  void ReserveRows(ULONG rows)
+  {
+    if (rows > m_ulRows) {
+      if (m_ppRows)
+        m_pEnviron->FreeMem(m_ppRows,m_ulRows * sizeof(class QuantizedRow *));
+      m_ppRows = NULL;
+      m_ulRows = 0;
+      m_ppRows = (class QuantizedRow **)m_pEnviron->AllocMem(rows * sizeof(class QuantizedRow *));
+      m_ulRows = rows;
+    }
+  }
+  //
+  // Hand out the given region in blocks to the threads. The first block
+  // of the region is not part of any slice.
+  void Start(const RectAngle<LONG> &region,class ColorTrafo *ctrafo,
+             LONG minx,LONG maxx,LONG miny,LONG maxy)
+  {
+    ULONG rows  = maxy - miny + 1;
+    ULONG width = maxx - minx + 1;
+    ULONG per   = (m_ulStarted + rows) / rows; // threads including the caller per row
+    
+    pthread_mutex_lock(&m_Lock);
+    m_pRegion        = &region;
+    m_pTrafo         = ctrafo;
+    m_lMinX          = minx;
+    m_lMaxX          = maxx;
+    m_lMinY          = miny;
+    m_ulSlicesPerRow = (per < width)?(per):(width);
+    m_ulSlices       = rows * m_ulSlicesPerRow;
+    m_ulNext         = 0;
+    m_ulBusy         = m_ulStarted;
+    m_ulGeneration++;
+    pthread_cond_broadcast(&m_Start);
+    pthread_mutex_unlock(&m_Lock);
+  }
+  //
+  // Wait until all threads are done with the current region.
+  void Wait(void)
+  {
+    pthread_mutex_lock(&m_Lock);
+    while(m_ulBusy)
+      pthread_cond_wait(&m_Done,&m_Lock);
+    pthread_mutex_unlock(&m_Lock);
+  }
+  //
+  // Wait for the next region to work on. Returns false if the
+  // thread shall terminate instead.
+  bool WaitForRegion(struct Worker *worker)
+  {
+    bool run;
+    
+    pthread_mutex_lock(&m_Lock);
+    while(!m_bQuit && worker->w_ulGeneration == m_ulGeneration)
+      pthread_cond_wait(&m_Start,&m_Lock);
+    worker->w_ulGeneration = m_ulGeneration;
+    run                    = !m_bQuit;
+    pthread_mutex_unlock(&m_Lock);
+
+    return run;
+  }
+  //
+  // Indicate that a thread is done with the current region.
+  void Finished(void)
+  {
+    pthread_mutex_lock(&m_Lock);
+    if (--m_ulBusy == 0)
+      pthread_cond_signal(&m_Done);
+    pthread_mutex_unlock(&m_Lock);
+  }
+  //
+  // Return the block row and the columns of the next slice of the
+  // region. Returns false if no slice is left.
+  bool NextSlice(LONG &y,LONG &minx,LONG &maxx)
+  {
+    ULONG next,row,slice,width;
+    
+    pthread_mutex_lock(&m_Lock);
+    next = m_ulNext;
+    if (next < m_ulSlices)
+      m_ulNext++;
+    pthread_mutex_unlock(&m_Lock);
+
+    if (next >= m_ulSlices)
+      return false;
+
+    row   = next / m_ulSlicesPerRow;
+    slice = next % m_ulSlicesPerRow;
+    width = m_lMaxX - m_lMinX + 1;
+    y     = m_lMinY + row;
+    minx  = m_lMinX + (slice * width) / m_ulSlicesPerRow;
+    maxx  = m_lMinX + ((slice + 1) * width) / m_ulSlicesPerRow - 1;
+    if (row == 0 && minx == m_lMinX)
+      minx++; // The first block is done by the calling thread.
+
+    return true;
+  }
+};
+#endif
 ///
 
 /// BlockBitmapRequester::BlockBitmapRequester
@@ -94,7 +306,11 @@ BlockBitmapRequester::BlockBitmapRequester(class Frame *frame)
     m_plResidualColorBuffer(NULL), m_plOriginalColorBuffer(NULL), 
     m_pppQImage(NULL), m_pppRImage(NULL),
     m_pResidualHelper(NULL), m_ppDeRinger(NULL), 
-    m_bSubsampling(false), m_bOpenLoop(false), m_bDeRing(false)
+    m_bSubsampling(false), m_bOpenLoop(false), m_bDeRing(false),
+    m_usThreads(1), m_pTransformPool(NULL),
+    m_lUpdatedMinY(0), m_lUpdatedMaxY(-1),
+    m_pplRetained(NULL), m_pplRetainedResidual(NULL), m_pucRetained(NULL),
+    m_ulRetainedBlocks(0), m_ulRetainedWidth(0), m_ulRetainedHeight(0)
 {  
   m_ucCount       = frame->DepthOf(); 
   m_ulPixelWidth  = frame->WidthOf();
@@ -107,6 +323,11 @@ BlockBitmapRequester::~BlockBitmapRequester(void)
 {
   UBYTE i;
 
+#ifdef TRANSFORM_THREADS
+  // The threads have to go first as they may still access the buffers.
+  delete m_pTransformPool;
+#endif
+
   if (m_ppDTemp)
     m_pEnviron->FreeMem(m_ppDTemp,m_ucCount * sizeof(LONG *));
   
@@ -187,6 +408,24 @@ BlockBitmapRequester::~BlockBitmapRequester(void)
   if (m_ppRTemp)
     m_pEnviron->FreeMem(m_ppRTemp,m_ucCount * sizeof(LONG *));
 
+  if (m_pplRetained) {
+    for(i = 0;i < m_ucCount;i++) {
+      if (m_pplRetained[i])
+        m_pEnviron->FreeMem(m_pplRetained[i],m_ulRetainedWidth * m_ulRetainedHeight * 64 * sizeof(LONG));
+    }
+    m_pEnviron->FreeMem(m_pplRetained,m_ucCount * sizeof(LONG *));
+  }
+
+  if (m_pplRetainedResidual) {
+    for(i = 0;i < m_ucCount;i++) {
+      if (m_pplRetainedResidual[i])
+        m_pEnviron->FreeMem(m_pplRetainedResidual[i],m_ulRetainedWidth * m_ulRetainedHeight * 64 * sizeof(LONG));
+    }
+    m_pEnviron->FreeMem(m_pplRetainedResidual,m_ucCount * sizeof(LONG *));
+  }
+
+  if (m_pucRetained)
+    m_pEnviron->FreeMem(m_pucRetained,m_ulRetainedWidth * m_ulRetainedHeight * sizeof(UBYTE));
 }
 ///
 
@@ -328,6 +567,12 @@ void BlockBitmapRequester::PrepareForDecoding(void)
       }
     }
   }
+  //
+  // If the height of the frame is known, build the complete image
+  // buffer now such that parsing the MCUs no longer allocates.
+  BuildRows(m_pFrame,m_ppQTop,CompactCoefficients(),m_pucQMemory,m_ulQMemory);
+  if (m_pResidualHelper)
+    BuildRows(m_pResidualHelper->ResidualFrameOf(),m_ppRTop,false,m_pucRMemory,m_ulRMemory);
 }
 ///
 
@@ -495,7 +740,8 @@ class QuantizedRow *BlockBitmapRequester::BuildImageRow(class QuantizedRow **qro
     UBYTE subx      = comp->SubXOf();
     ULONG width     = (m_ulPixelWidth  + subx - 1) / subx;
     *qrow = new(m_pEnviron) class QuantizedRow(m_pEnviron);
-    (*qrow)->AllocateRow(width);
+    // Residuals are always kept in 32 bits.
+    (*qrow)->AllocateRow(width,frame == m_pFrame && CompactCoefficients());
   }
   return *qrow;
 }
@@ -507,6 +753,7 @@ void BlockBitmapRequester::AdvanceQRows(void)
 {
   ULONG maxval   = (1UL << m_pFrame->HiddenPrecisionOf()) - 1;
   UBYTE i;
+  class Instrumentation *stats = m_pEnviron->InstrumentationOf();
   // Advance the quantized rows for the non-subsampled components,
   // downsampled components will be advanced later.
   for(i = 0;i < m_ucCount;i++) {
@@ -545,22 +792,33 @@ void BlockBitmapRequester::AdvanceQRows(void)
         class QuantizedRow *qr  = BuildImageRow(m_pppQImage[i],m_pFrame,i);
         for(bx = blocks.ra_MinX;bx <= blocks.ra_MaxX;bx++) {
           LONG src[64]; // temporary buffer, the DCT requires a 8x8 block
-          LONG *dst = (qr)?(qr->BlockAt(bx)->m_Data):NULL;
-          m_ppDownsampler[i]->DownsampleRegion(bx,by,src);
+          LONG buf[64]; // output buffer for compact rows
+          LONG *dst = qr->TargetBlock(bx,buf);
+          {
+            StageTimer timer(stats,JPGFLAG_STATS_DOWNSAMPLING);
+            m_ppDownsampler[i]->DownsampleRegion(bx,by,src);
+          }
           if (m_bDeRing) {
             m_ppDeRinger[i]->DeRing(src,dst,(maxval + 1) >> 1);
           } else {
-            m_ppDCT[i]->TransformBlock(src,dst,(maxval + 1) >> 1);
+            {
+              StageTimer timer(stats,JPGFLAG_STATS_FORWARD_DCT);
+              m_ppDCT[i]->TransformBlock(src,dst,(maxval + 1) >> 1);
+            }
           }
           if (m_bOptimize) {
             m_pFrame->OptimizeDCTBlock(bx,by,i,m_ppDCT[i],dst);
           }
+          qr->StoreBlock(bx,dst);
           //
           // Inversely reconstruct and feed into the upsampler to get the residual signal.
           // For openloop coding, the upsampler already contains the original LDR
           // data.
           if (m_pResidualHelper && m_bOpenLoop == false) {
-            m_ppDCT[i]->InverseTransformBlock(src,dst,(maxval + 1) >> 1);
+            {
+              StageTimer timer(stats,JPGFLAG_STATS_INVERSE_DCT);
+              m_ppDCT[i]->InverseTransformBlock(src,dst,(maxval + 1) >> 1);
+            }
             assert(m_ppUpsampler[i]);
             m_ppUpsampler[i]->DefineRegion(bx,by,src);
           }
@@ -582,6 +840,7 @@ void BlockBitmapRequester::AdvanceRRows(const RectAngle<LONG> &region,class Colo
   LONG maxx,maxy;
   LONG x,y;
   UBYTE i;
+  class Instrumentation *stats = m_pEnviron->InstrumentationOf();
   
   // At this point, the reconstructed image is in the m_ppUpsampler buffer. Let's see
   // how much we have. Note that we must feed the components jointly into the
@@ -632,7 +891,10 @@ void BlockBitmapRequester::AdvanceRRows(const RectAngle<LONG> &region,class Colo
       for(i = 0;i < m_ucCount;i++) {
         // Read the reconstructed data out of the upsampler and push it
         // into D.
-        m_ppUpsampler[i]->UpsampleRegion(r,m_ppDTemp[i]);
+        {
+          StageTimer timer(stats,JPGFLAG_STATS_UPSAMPLING);
+          m_ppUpsampler[i]->UpsampleRegion(r,m_ppDTemp[i]);
+        }
         //
         // And prepare the residual downsampler which is the output.
         if (m_ppResidualDownsampler[i]) {
@@ -643,13 +905,19 @@ void BlockBitmapRequester::AdvanceRRows(const RectAngle<LONG> &region,class Colo
         } 
         //
         // Build the output buffer for the downsampler that stored the original data.
-        m_ppOriginalImage[i]->DownsampleRegion(x,y,(LONG *)(m_ppOriginalIBM[i]->ibm_pData));
+        {
+          StageTimer timer(stats,JPGFLAG_STATS_DOWNSAMPLING);
+          m_ppOriginalImage[i]->DownsampleRegion(x,y,(LONG *)(m_ppOriginalIBM[i]->ibm_pData));
+        }
       }
       // OriginalIBM has now the original image data buffered in the downsampler.
       // ppDTemp contains the upsampled reconstructed data as reference.
       // m_ppRTemp points to the destination buffer where the data is supposed to go.
       // This is either the DCT buffer itself, or the input buffer for the downsampler. 
-      ctrafo->RGB2Residual(r,m_ppOriginalIBM,m_ppDTemp,m_ppRTemp);
+      {
+        StageTimer timer(stats,JPGFLAG_STATS_COLOR_TRANSFORM);
+        ctrafo->RGB2Residual(r,m_ppOriginalIBM,m_ppDTemp,m_ppRTemp);
+      }
       // Residual data is now in m_ppRTemp, which is either the final destination,
       // or the the C-Buffer. If it is in the C-Buffer, but it back into the
       // Downsampler.
@@ -691,7 +959,10 @@ void BlockBitmapRequester::AdvanceRRows(const RectAngle<LONG> &region,class Colo
         class QuantizedRow *qr = BuildImageRow(m_pppRImage[i],m_pResidualHelper->ResidualFrameOf(),i);
         for(bx = blocks.ra_MinX;bx <= blocks.ra_MaxX;bx++) {
           LONG *dst = (qr)?(qr->BlockAt(bx)->m_Data):NULL;
-          m_ppResidualDownsampler[i]->DownsampleRegion(bx,by,dst);
+          {
+            StageTimer timer(stats,JPGFLAG_STATS_DOWNSAMPLING);
+            m_ppResidualDownsampler[i]->DownsampleRegion(bx,by,dst);
+          }
           m_pResidualHelper->QuantizeResidual(NULL,dst,i,bx,by);
         }
         m_ppResidualDownsampler[i]->RemoveBlocks(by);
@@ -716,6 +987,7 @@ void BlockBitmapRequester::PullSourceData(const RectAngle<LONG> &region,class Co
   LONG maxy   = region.ra_MaxY >> 3;
   LONG x,y;
   UBYTE i;
+  class Instrumentation *stats = m_pEnviron->InstrumentationOf();
   //
   // First part: Collect the data from
   // the user and push it into the color transformer buffer.
@@ -762,7 +1034,10 @@ void BlockBitmapRequester::PullSourceData(const RectAngle<LONG> &region,class Co
           ExtractLDRBitmap(m_ppTempIBM[i],r,i);
         }
         
-        ctrafo->LDRRGB2YCbCr(r,m_ppTempIBM,m_ppCTemp); 
+        {
+          StageTimer timer(stats,JPGFLAG_STATS_COLOR_TRANSFORM);
+          ctrafo->LDRRGB2YCbCr(r,m_ppTempIBM,m_ppCTemp); 
+        }
         
         // Extract now the HDR image.
         for(i = 0;i < m_ucCount;i++) {      
@@ -776,7 +1051,10 @@ void BlockBitmapRequester::PullSourceData(const RectAngle<LONG> &region,class Co
         }
         //
         // Run the color transformer.
-        ctrafo->RGB2YCbCr(r,m_ppTempIBM,m_ppCTemp);
+        {
+          StageTimer timer(stats,JPGFLAG_STATS_COLOR_TRANSFORM);
+          ctrafo->RGB2YCbCr(r,m_ppTempIBM,m_ppCTemp);
+        }
       }
       
       // Now push the transformed data into either the downsampler, 
@@ -790,16 +1068,21 @@ void BlockBitmapRequester::PullSourceData(const RectAngle<LONG> &region,class Co
           m_ppDownsampler[i]->DefineRegion(x,y,m_ppCTemp[i]);
         } else { 
           class QuantizedRow *qrow = BuildImageRow(m_pppQImage[i],m_pFrame,i);
-          LONG *dst                = qrow->BlockAt(x)->m_Data;
+          LONG buf[64];
+          LONG *dst                = qrow->TargetBlock(x,buf);
           LONG *src                = m_ppCTemp[i];
           if (m_bDeRing) {
             m_ppDeRinger[i]->DeRing(src,dst,(maxval + 1) >> 1);
           } else {
-            m_ppDCT[i]->TransformBlock(src,dst,(maxval + 1) >> 1);
+            {
+              StageTimer timer(stats,JPGFLAG_STATS_FORWARD_DCT);
+              m_ppDCT[i]->TransformBlock(src,dst,(maxval + 1) >> 1);
+            }
           }
           if (m_bOptimize) {
             m_pFrame->OptimizeDCTBlock(x,y,i,m_ppDCT[i],dst);
           }
+          qrow->StoreBlock(x,dst);
         }
       }
       //
@@ -820,7 +1103,10 @@ void BlockBitmapRequester::PullSourceData(const RectAngle<LONG> &region,class Co
         //
         // Get the original HDR image unaltered, move it to the
         // dummy downsampler to store it there until it is needed.
-        ctrafo->RGB2RGB(r,m_ppTempIBM,m_ppCTemp);
+        {
+          StageTimer timer(stats,JPGFLAG_STATS_COLOR_TRANSFORM);
+          ctrafo->RGB2RGB(r,m_ppTempIBM,m_ppCTemp);
+        }
         //
         for(i = 0;i < m_ucCount;i++) {
           // Get the original image unaltered, move it to the dummy downsampler
@@ -855,6 +1141,7 @@ void BlockBitmapRequester::EncodeUnsampled(const RectAngle<LONG> &region,class C
   ULONG maxy   = region.ra_MaxY >> 3;
   ULONG x,y;
   UBYTE i;
+  class Instrumentation *stats = m_pEnviron->InstrumentationOf();
   
   for(y = miny,r.ra_MinY = region.ra_MinY;y <= maxy;y++,r.ra_MinY = r.ra_MaxY + 1) {
     r.ra_MaxY = (r.ra_MinY & -8) + 7;
@@ -873,7 +1160,10 @@ void BlockBitmapRequester::EncodeUnsampled(const RectAngle<LONG> &region,class C
           ExtractLDRBitmap(m_ppTempIBM[i],r,i);
         }
         
-        ctrafo->LDRRGB2YCbCr(r,m_ppTempIBM,m_ppCTemp); 
+        {
+          StageTimer timer(stats,JPGFLAG_STATS_COLOR_TRANSFORM);
+          ctrafo->LDRRGB2YCbCr(r,m_ppTempIBM,m_ppCTemp); 
+        }
         
         // Extract the HDR image now.
         for(i = 0;i < m_ucCount;i++) {      
@@ -886,22 +1176,30 @@ void BlockBitmapRequester::EncodeUnsampled(const RectAngle<LONG> &region,class C
         
         //if (x == 245 && y == 126 && m_ucCount == 1)
         //printf("gotcha");     
-        ctrafo->RGB2YCbCr(r,m_ppTempIBM,m_ppCTemp);
+        {
+          StageTimer timer(stats,JPGFLAG_STATS_COLOR_TRANSFORM);
+          ctrafo->RGB2YCbCr(r,m_ppTempIBM,m_ppCTemp);
+        }
       }
       
       for(i = 0;i < m_ucCount;i++) {
         class QuantizedRow *qrow = BuildImageRow(m_pppQImage[i],m_pFrame,i);
-        LONG *dst = qrow->BlockAt(x)->m_Data;
+        LONG buf[64];
+        LONG *dst = qrow->TargetBlock(x,buf);
         LONG *src = m_ppCTemp[i];
         
         if (m_bDeRing) {
           m_ppDeRinger[i]->DeRing(src,dst,(maxval + 1) >> 1);
         } else {
-          m_ppDCT[i]->TransformBlock(src,dst,(maxval + 1) >> 1);
+          {
+            StageTimer timer(stats,JPGFLAG_STATS_FORWARD_DCT);
+            m_ppDCT[i]->TransformBlock(src,dst,(maxval + 1) >> 1);
+          }
         }
         if (m_bOptimize) {
           m_pFrame->OptimizeDCTBlock(x,y,i,m_ppDCT[i],dst);
         }
+        qrow->StoreBlock(x,dst);
       }
       //
       // If any residuals are required, compute them now.
@@ -909,20 +1207,27 @@ void BlockBitmapRequester::EncodeUnsampled(const RectAngle<LONG> &region,class C
         for(i = 0;i < m_ucCount;i++) { 
           class QuantizedRow *qrow = *m_pppQImage[i];
           class QuantizedRow *rrow = BuildImageRow(m_pppRImage[i],m_pResidualHelper->ResidualFrameOf(),i);
+          LONG buf[64];
           assert(qrow && rrow);
-          m_ppQTemp[i] = qrow->BlockAt(x)->m_Data;
+          m_ppQTemp[i] = qrow->FetchBlock(x,buf);
           m_ppRTemp[i] = rrow->BlockAt(x)->m_Data;
           if (m_bOpenLoop) {
             memcpy(m_ppDTemp[i],m_ppCTemp[i],64 * sizeof(LONG));
           } else {
-            m_ppDCT[i]->InverseTransformBlock(m_ppDTemp[i],m_ppQTemp[i],(maxval + 1) >> 1);
+            {
+              StageTimer timer(stats,JPGFLAG_STATS_INVERSE_DCT);
+              m_ppDCT[i]->InverseTransformBlock(m_ppDTemp[i],m_ppQTemp[i],(maxval + 1) >> 1);
+            }
           }
         }
         // Step One:
         // Feed now the color transformer with the residual data.
         //if (x == 117 && y == 34)
         //printf("gotcha");
-        ctrafo->RGB2Residual(r,m_ppTempIBM,m_ppDTemp,m_ppRTemp);
+        {
+          StageTimer timer(stats,JPGFLAG_STATS_COLOR_TRANSFORM);
+          ctrafo->RGB2Residual(r,m_ppTempIBM,m_ppDTemp,m_ppRTemp);
+        }
         //
         // Step two: Compute the residuals by means of the color transformer.
         // This also computes the forwards transformation of the residual.
@@ -945,14 +1250,175 @@ void BlockBitmapRequester::EncodeUnsampled(const RectAngle<LONG> &region,class C
 }
 ///
 
+/// BlockBitmapRequester::TransformBlocks
+// Color transform, forward transform and quantize the blocks from column
+// minx to maxx of block row y of the region into the given quantized rows,
+// one per component, using the given temporary bitmaps and buffers.
+void BlockBitmapRequester::TransformBlocks(const RectAngle<LONG> &region,class ColorTrafo *ctrafo,
+                                           class QuantizedRow *const *rows,LONG y,LONG minx,LONG maxx,
+                                           struct ImageBitMap *const *ibm,LONG **ctemp)
+{
+  ULONG maxval = (1UL << m_pFrame->HiddenPrecisionOf()) - 1;
+  RectAngle<LONG> r;
+  LONG x;
+  UBYTE i;
+
+  r.ra_MinY = (region.ra_MinY > (y << 3))?(region.ra_MinY):(y << 3);
+  r.ra_MaxY = (y << 3) + 7;
+  if (r.ra_MaxY > region.ra_MaxY)
+    r.ra_MaxY = region.ra_MaxY;
+
+  for(x = minx;x <= maxx;x++) {
+    r.ra_MinX = (region.ra_MinX > (x << 3))?(region.ra_MinX):(x << 3);
+    r.ra_MaxX = (x << 3) + 7;
+    if (r.ra_MaxX > region.ra_MaxX)
+      r.ra_MaxX = region.ra_MaxX;
+    //
+    if (hasLDRImage()) {
+      for(i = 0;i < m_ucCount;i++) {
+        ExtractLDRBitmap(ibm[i],r,i);
+      }
+      ctrafo->LDRRGB2YCbCr(r,ibm,ctemp);
+    } else {
+      for(i = 0;i < m_ucCount;i++) {
+        ExtractBitmap(ibm[i],r,i);
+      }
+      ctrafo->RGB2YCbCr(r,ibm,ctemp);
+    }
+    //
+    for(i = 0;i < m_ucCount;i++) {
+      LONG buf[64];
+      LONG *dst = rows[i]->TargetBlock(x,buf);
+      
+      m_ppDCT[i]->TransformBlock(ctemp[i],dst,(maxval + 1) >> 1);
+      rows[i]->StoreBlock(x,dst);
+    }
+  }
+}
+///
+
+/// BlockBitmapRequester::TransformSlices
+// Transform the slices of the current region of the pool until none is
+// left, using the given temporary bitmaps and buffers.
+void BlockBitmapRequester::TransformSlices(class TransformPool *pool,struct ImageBitMap *const *ibm,LONG **ctemp)
+{
+#ifdef TRANSFORM_THREADS
+  LONG y,minx,maxx;
+
+  while(pool->NextSlice(y,minx,maxx)) {
+    TransformBlocks(*pool->m_pRegion,pool->m_pTrafo,pool->m_ppRows + (y - pool->m_lMinY) * m_ucCount,
+                    y,minx,maxx,ibm,ctemp);
+  }
+#else
+  NOREF(pool);
+  NOREF(ibm);
+  NOREF(ctemp);
+#endif
+}
+///
+
+/// BlockBitmapRequester::TransformWorker
+#ifdef TRANSFORM_THREADS
+// The thread entry point of the transform pool that transforms the
+// blocks of the regions handed out by the pool.
+void *BlockBitmapRequester::TransformWorker(void *data)
+{
+  struct TransformPool::Worker *worker = (struct TransformPool::Worker *)data;
+  class TransformPool *pool            = worker->w_pPool;
+
+  while(pool->WaitForRegion(worker)) {
+    pool->m_pRequester->TransformSlices(pool,worker->w_pIBM,worker->w_plCTemp);
+    pool->Finished();
+  }
+
+  return NULL;
+}
+#endif
+///
+
+/// BlockBitmapRequester::EncodeUnsampledConcurrently
+// The encoding procedure without subsampling, transforming the blocks
+// on the threads of the transform pool. This is only used if neither
+// residual coding nor deringing nor the R/D optimization is enabled as
+// all of them keep state between the blocks.
+void BlockBitmapRequester::EncodeUnsampledConcurrently(const RectAngle<LONG> &region,class ColorTrafo *ctrafo)
+{
+#ifdef TRANSFORM_THREADS
+  class TransformPool *pool = m_pTransformPool;
+  LONG minx = region.ra_MinX >> 3;
+  LONG maxx = region.ra_MaxX >> 3;
+  LONG miny = region.ra_MinY >> 3;
+  LONG maxy = region.ra_MaxY >> 3;
+  LONG y;
+  UBYTE i;
+
+  assert(m_pResidualHelper == NULL && !m_bDeRing && !m_bOptimize);
+  assert(m_ucCount <= 4);
+  //
+  // Start the threads on first use. The calling thread is one of them.
+  if (pool == NULL) {
+    ULONG threads = m_usThreads - 1;
+    ULONG t;
+    //
+    m_pTransformPool = pool = new(m_pEnviron) class TransformPool(m_pEnviron,this);
+    pool->m_ppWorkers = (struct TransformPool::Worker **)m_pEnviron->AllocMem(threads * 
+                                                                              sizeof(struct TransformPool::Worker *));
+    memset(pool->m_ppWorkers,0,threads * sizeof(struct TransformPool::Worker *));
+    pool->m_ulWorkers = threads;
+    for(t = 0;t < threads;t++) {
+      pool->m_ppWorkers[t] = new(m_pEnviron) struct TransformPool::Worker(pool);
+    }
+    //
+    // If a thread cannot be started, the remaining ones take over its work.
+    while(pool->m_ulStarted < threads) {
+      if (pthread_create(&pool->m_ppWorkers[pool->m_ulStarted]->w_Thread,NULL,
+                         &TransformWorker,pool->m_ppWorkers[pool->m_ulStarted]))
+        break;
+      pool->m_ulStarted++;
+    }
+  }
+  //
+  // Build the quantized rows of the region. This allocates, and hence
+  // happens here.
+  pool->ReserveRows((maxy - miny + 1) * m_ucCount);
+  for(y = miny;y <= maxy;y++) {
+    for(i = 0;i < m_ucCount;i++) {
+      class QuantizedRow *qrow = BuildImageRow(m_pppQImage[i],m_pFrame,i);
+      pool->m_ppRows[(y - miny) * m_ucCount + i] = qrow;
+      m_pppQImage[i]      = &(qrow->NextOf());
+      m_pulReadyLines[i] += 8;
+    }
+  }
+  //
+  // The time of the color transformation is accounted to the DCT here.
+  {
+    StageTimer timer(m_pEnviron,JPGFLAG_STATS_FORWARD_DCT);
+    //
+    // The color transformation checks the consistency of the bitmaps, and
+    // the first block is transformed here such that errors are raised
+    // on the calling thread. All further blocks use identical bitmap
+    // layouts and cannot fail.
+    TransformBlocks(region,ctrafo,pool->m_ppRows,miny,minx,minx,m_ppTempIBM,m_ppCTemp);
+    pool->Start(region,ctrafo,minx,maxx,miny,maxy);
+    TransformSlices(pool,m_ppTempIBM,m_ppCTemp);
+    pool->Wait();
+  }
+#else
+  EncodeUnsampled(region,ctrafo);
+#endif
+}
+///
+
 /// BlockBitmapRequester::CropEncodingRegion
 // First step of a region encoder: Find the region that can be pulled in the next step,
 // from a rectangle request. This potentially shrinks the rectangle, which should be
 // initialized to the full image.
-void BlockBitmapRequester::CropEncodingRegion(RectAngle<LONG> &region,const struct RectangleRequest *)
+void BlockBitmapRequester::CropEncodingRegion(RectAngle<LONG> &region,const struct RectangleRequest *rr)
 {
   int i;
 
+  m_usThreads = rr->rr_usThreads;
+
   ClipToImage(region);
   
   // Find the region to request.
@@ -1002,6 +1468,10 @@ void BlockBitmapRequester::EncodeRegion(const RectAngle<LONG> &region)
     if (m_pResidualHelper) {
       AdvanceRRows(region,ctrafo);
     }
+  } else if (m_usThreads > 1 && m_pResidualHelper == NULL && !m_bDeRing && !m_bOptimize) {
+    // No downsampling and no state carried between the blocks,
+    // the blocks can be transformed concurrently.
+    EncodeUnsampledConcurrently(region,ctrafo);
   } else { 
     // No downsampling required. Much simpler here.
     EncodeUnsampled(region,ctrafo);
@@ -1022,11 +1492,16 @@ void BlockBitmapRequester::ReconstructUnsampled(const struct RectangleRequest *r
   ULONG maxy   = region.ra_MaxY >> 3;
   ULONG x,y;
   UBYTE i;
+  class Instrumentation *stats = m_pEnviron->InstrumentationOf();
+  // Blocks can only be kept if all components are available.
+  bool retain  = m_pucRetained && rr->rr_bRetain && 
+    rr->rr_usFirstComponent == 0 && rr->rr_usLastComponent >= m_ucCount - 1;
   
   if (maxy > maxmcu)
     maxy = maxmcu;
   
   for(y = miny,r.ra_MinY = region.ra_MinY;y <= maxy;y++,r.ra_MinY = r.ra_MaxY + 1) {
+    bool written = false;
     r.ra_MaxY = (r.ra_MinY & -8) + 7;
     if (r.ra_MaxY > region.ra_MaxY)
       r.ra_MaxY = region.ra_MaxY;
@@ -1035,15 +1510,23 @@ void BlockBitmapRequester::ReconstructUnsampled(const struct RectangleRequest *r
       r.ra_MaxX = (r.ra_MinX & -8) + 7;
       if (r.ra_MaxX > region.ra_MaxX)
         r.ra_MaxX = region.ra_MaxX;
+      //
+      // On an update, blocks that did not change remain in the bitmap.
+      if (rr->rr_bUpdate && !isBlockChanged(rr,x))
+        continue;
       
       for(i = 0;i < m_ucCount;i++) {      
         LONG *dst = m_ppCTemp[i];
         if (i >= rr->rr_usFirstComponent && i <= rr->rr_usLastComponent) {
           class QuantizedRow *qrow = *m_pppQImage[i];
-          const LONG *src = (qrow)?(qrow->BlockAt(x)->m_Data):(NULL);
+          LONG buf[64];
+          const LONG *src = (qrow)?(qrow->FetchBlock(x,buf)):(NULL);
           //
           ExtractBitmap(m_ppTempIBM[i],r,i);
-          m_ppDCT[i]->InverseTransformBlock(dst,src,(maxval + 1) >> 1);
+          {
+            StageTimer timer(stats,JPGFLAG_STATS_INVERSE_DCT);
+            m_ppDCT[i]->InverseTransformBlock(dst,src,(maxval + 1) >> 1);
+          }
         } else {
           memset(dst,0,sizeof(LONG) * 64);
         }
@@ -1054,15 +1537,40 @@ void BlockBitmapRequester::ReconstructUnsampled(const struct RectangleRequest *r
       //printf("gotcha");       
       if (m_pResidualHelper) {
         for(i = rr->rr_usFirstComponent; i <= rr->rr_usLastComponent; i++) {
-          class QuantizedRow *rrow = *m_pppRImage[i];
+          class QuantizedRow *rrow = BuildImageRow(m_pppRImage[i],m_pResidualHelper->ResidualFrameOf(),i);
           m_pResidualHelper->DequantizeResidual(m_ppCTemp[i],m_ppDTemp[i],rrow->BlockAt(x)->m_Data,i);
         }
       }
       //
+      if (retain)
+        RetainBlock(x,y);
+      //
       // Otherwise, the residual remains unused.
-      ctrafo->YCbCr2RGB(r,m_ppTempIBM,m_ppCTemp,m_ppDTemp);
+      {
+        StageTimer timer(stats,JPGFLAG_STATS_COLOR_TRANSFORM);
+        ctrafo->YCbCr2RGB(r,m_ppTempIBM,m_ppCTemp,m_ppDTemp);
+      }
+      //
+      // The block is now up to date.
+      if (rr->rr_bUpdate) {
+        for(i = rr->rr_usFirstComponent; i <= rr->rr_usLastComponent; i++) {
+          class QuantizedRow *qrow = *m_pppQImage[i];
+          if (qrow) qrow->ClearChanged(x);
+          if (m_pResidualHelper) {
+            class QuantizedRow *rrow = *m_pppRImage[i];
+            if (rrow) rrow->ClearChanged(x);
+          }
+        }
+      }
+      written = true;
     } // of loop over x
     //
+    if (written) {
+      if (m_lUpdatedMaxY < m_lUpdatedMinY)
+        m_lUpdatedMinY = r.ra_MinY;
+      m_lUpdatedMaxY   = r.ra_MaxY;
+    }
+    //
     // Advance the rows.
     for(i = 0;i < m_ucCount;i++) {
       class QuantizedRow *qrow = *m_pppQImage[i];
@@ -1080,6 +1588,7 @@ void BlockBitmapRequester::PullQData(const struct RectangleRequest *rr,const Rec
 {
   ULONG maxval  = (1UL << m_pFrame->HiddenPrecisionOf()) - 1;
   UBYTE i;
+  class Instrumentation *stats = m_pEnviron->InstrumentationOf();
 
   for(i = rr->rr_usFirstComponent;i <= rr->rr_usLastComponent;i++) {
     class UpsamplerBase *up;  // upsampler
@@ -1096,9 +1605,13 @@ void BlockBitmapRequester::PullQData(const struct RectangleRequest *rr,const Rec
       for(by = blocks.ra_MinY;by <= blocks.ra_MaxY;by++) {
         class QuantizedRow *qrow = *m_pppQImage[i];
         for(bx = blocks.ra_MinX;bx <= blocks.ra_MaxX;bx++) {
-          LONG *src = (qrow)?(qrow->BlockAt(bx)->m_Data):NULL;
+          LONG buf[64];
+          LONG *src = (qrow)?(qrow->FetchBlock(bx,buf)):NULL;
           LONG dst[64];
-          m_ppDCT[i]->InverseTransformBlock(dst,src,(maxval + 1) >> 1);
+          {
+            StageTimer timer(stats,JPGFLAG_STATS_INVERSE_DCT);
+            m_ppDCT[i]->InverseTransformBlock(dst,src,(maxval + 1) >> 1);
+          }
           up->DefineRegion(bx,by,dst);
         }
         if (qrow) m_pppQImage[i] = &(qrow->NextOf());
@@ -1155,6 +1668,19 @@ void BlockBitmapRequester::PushReconstructedData(const struct RectangleRequest *
   ULONG maxy   = region.ra_MaxY >> 3;
   ULONG x,y;
   UBYTE i;
+  class Instrumentation *stats = m_pEnviron->InstrumentationOf();
+  bool skip;
+  // Blocks can only be kept if all components are available.
+  bool retain  = m_pucRetained && rr->rr_bRetain && 
+    rr->rr_usFirstComponent == 0 && rr->rr_usLastComponent >= m_ucCount - 1;
+  // For three components with the chroma expanded horizontally by two,
+  // the horizontal upsampling can be merged into the color transformation,
+  // unless the upsampled chroma blocks are to be kept.
+  bool merge   = !retain && m_pResidualHelper == NULL && m_ucCount == 3 && 
+    rr->rr_usFirstComponent == 0 && rr->rr_usLastComponent == 2 &&
+    m_ppUpsampler[0] == NULL && m_ppUpsampler[1] && m_ppUpsampler[2] &&
+    m_ppUpsampler[1]->isMergeable() && m_ppUpsampler[2]->isMergeable() &&
+    ctrafo->isMergeable();
   
   if (maxy > maxmcu)
     maxy = maxmcu;
@@ -1163,11 +1689,46 @@ void BlockBitmapRequester::PushReconstructedData(const struct RectangleRequest *
     r.ra_MaxY = (r.ra_MinY & -8) + 7;
     if (r.ra_MaxY > region.ra_MaxY)
       r.ra_MaxY = region.ra_MaxY;
+    //
+    // Upsampling spreads the blocks over their neighbours, hence
+    // updates are tracked here in units of block rows. Rows that
+    // did not change remain in the bitmap.
+    skip = rr->rr_bUpdate && !isRowChanged(rr,y);
+    if (!skip) {
+      if (m_lUpdatedMaxY < m_lUpdatedMinY)
+        m_lUpdatedMinY = r.ra_MinY;
+      m_lUpdatedMaxY   = r.ra_MaxY;
+    }
     
-    for(x = minx,r.ra_MinX = region.ra_MinX;x <= maxx;x++,r.ra_MinX = r.ra_MaxX + 1) {
+    for(x = minx,r.ra_MinX = region.ra_MinX;x <= maxx && !skip;x++,r.ra_MinX = r.ra_MaxX + 1) {
       r.ra_MaxX = (r.ra_MinX & -8) + 7;
       if (r.ra_MaxX > region.ra_MaxX)
         r.ra_MaxX = region.ra_MaxX;
+
+      if (merge && (r.ra_MinX & 7) == 0 && (r.ra_MinY & 7) == 0) {
+        class QuantizedRow *qrow = *m_pppQImage[0];
+        const LONG *const *cb,*const *cr;
+        LONG buf[64];
+        LONG *src = (qrow)?(qrow->FetchBlock(x,buf)):NULL;
+        //
+        for(i = 0;i < m_ucCount;i++) {
+          ExtractBitmap(m_ppTempIBM[i],r,i);
+        }
+        {
+          StageTimer timer(stats,JPGFLAG_STATS_INVERSE_DCT);
+          m_ppDCT[0]->InverseTransformBlock(m_ppCTemp[0],src,(maxval + 1) >> 1);
+        }
+        {
+          StageTimer timer(stats,JPGFLAG_STATS_UPSAMPLING);
+          cb = m_ppUpsampler[1]->FilteredLinesOf(y);
+          cr = m_ppUpsampler[2]->FilteredLinesOf(y);
+        }
+        {
+          StageTimer timer(stats,JPGFLAG_STATS_COLOR_TRANSFORM);
+          ctrafo->YCbCr2RGBMerged(r,m_ppTempIBM,m_ppCTemp[0],cb,cr);
+        }
+        continue;
+      }
       
       for(i = 0;i < m_ucCount;i++) {
         if (i >= rr->rr_usFirstComponent && i <= rr->rr_usLastComponent) {
@@ -1175,12 +1736,19 @@ void BlockBitmapRequester::PushReconstructedData(const struct RectangleRequest *
           if (m_ppUpsampler[i]) {
             // Upsampled case, take from the upsampler, transform
             // into the color buffer.
-            m_ppUpsampler[i]->UpsampleRegion(r,m_ppCTemp[i]);
+            {
+              StageTimer timer(stats,JPGFLAG_STATS_UPSAMPLING);
+              m_ppUpsampler[i]->UpsampleRegion(r,m_ppCTemp[i]);
+            }
           } else {
             class QuantizedRow *qrow = *m_pppQImage[i];
-            LONG *src = (qrow)?(qrow->BlockAt(x)->m_Data):NULL;
+            LONG buf[64];
+            LONG *src = (qrow)?(qrow->FetchBlock(x,buf)):NULL;
             // Plain case. Transform directly into the color buffer.
-            m_ppDCT[i]->InverseTransformBlock(m_ppCTemp[i],src,(maxval + 1) >> 1);
+            {
+              StageTimer timer(stats,JPGFLAG_STATS_INVERSE_DCT);
+              m_ppDCT[i]->InverseTransformBlock(m_ppCTemp[i],src,(maxval + 1) >> 1);
+            }
           }
         } else {
           // Not requested, zero the buffer.
@@ -1191,7 +1759,10 @@ void BlockBitmapRequester::PushReconstructedData(const struct RectangleRequest *
         if (m_pResidualHelper) {
           if (i >= rr->rr_usFirstComponent && i <= rr->rr_usLastComponent) {
             if (m_ppResidualUpsampler[i]) {
-              m_ppResidualUpsampler[i]->UpsampleRegion(r,m_ppDTemp[i]);
+              {
+                StageTimer timer(stats,JPGFLAG_STATS_UPSAMPLING);
+                m_ppResidualUpsampler[i]->UpsampleRegion(r,m_ppDTemp[i]);
+              }
             } else {
               class QuantizedRow *rrow = *m_pppRImage[i];
               m_pResidualHelper->DequantizeResidual(NULL,m_ppDTemp[i],rrow->BlockAt(x)->m_Data,i);
@@ -1199,7 +1770,12 @@ void BlockBitmapRequester::PushReconstructedData(const struct RectangleRequest *
           }
         }
       }
-      ctrafo->YCbCr2RGB(r,m_ppTempIBM,m_ppCTemp,m_ppDTemp);
+      if (retain)
+        RetainBlock(x,y);
+      {
+        StageTimer timer(stats,JPGFLAG_STATS_COLOR_TRANSFORM);
+        ctrafo->YCbCr2RGB(r,m_ppTempIBM,m_ppCTemp,m_ppDTemp);
+      }
     }
     //
     // Advance the quantized rows for the non-subsampled components,
@@ -1229,7 +1805,12 @@ void BlockBitmapRequester::RequestUserDataForDecoding(class BitMapHook *bmh,Rect
   
   for(i = rr->rr_usFirstComponent;i <= rr->rr_usLastComponent;i++) {
     RequestUserData(bmh,region,i,alpha);
-    ULONG max = (BitmapOf(i).ibm_ulHeight >> 3) - 1;
+    ULONG height = BitmapOf(i).ibm_ulHeight;
+    // A bitmap that reaches the bottom of the image also takes the last
+    // block row, even if the image height is not divisible by eight.
+    if (m_ulPixelHeight > 0 && height >= m_ulPixelHeight)
+      height = (m_ulPixelHeight + 7) & -8;
+    ULONG max = (height >> 3) - 1;
     if (max < m_ulMaxMCU)
       m_ulMaxMCU = max;
   }
@@ -1242,6 +1823,33 @@ void BlockBitmapRequester::ReconstructRegion(const RectAngle<LONG> &region,const
 {
   class ColorTrafo *ctrafo = ColorTrafoOf(false);
 
+  m_lUpdatedMinY = region.ra_MinY;
+  m_lUpdatedMaxY = region.ra_MinY - 1;
+
+  if (m_pucRetained && m_ulRetainedBlocks == m_ulRetainedWidth * m_ulRetainedHeight) {
+    // All of the image has been kept by a former request, and nothing
+    // changed since then. Only the color transformation is required.
+    ReconstructRetained(rr,region,m_ulMaxMCU,ctrafo);
+    return;
+  }
+
+  if (rr->rr_bRetain && m_pucRetained == NULL && m_ulPixelHeight > 0)
+    BuildRetained();
+  
+  if ((rr->rr_bUpdate || rr->rr_bRetain) && region.ra_MinY == 0) {
+    // An update starting at the top of the image restarts from the first
+    // row, and the data buffered in the upsamplers is outdated. The same
+    // goes for a request that keeps the blocks as the image is probably
+    // displayed again.
+    ResetToStartOfImage();
+    for(UBYTE i = 0;i < m_ucCount;i++) {
+      if (m_ppUpsampler && m_ppUpsampler[i])
+        m_ppUpsampler[i]->ClearBuffer();
+      if (m_ppResidualUpsampler && m_ppResidualUpsampler[i])
+        m_ppResidualUpsampler[i]->ClearBuffer();
+    }
+  }
+
   if (m_bSubsampling) {
     //
     // Feed data into the regular upsampler
@@ -1254,6 +1862,16 @@ void BlockBitmapRequester::ReconstructRegion(const RectAngle<LONG> &region,const
     //
     // Now push blocks into the color transformer from the upsampler.
     PushReconstructedData(rr,region,m_ulMaxMCU,ctrafo);
+    //
+    // Changes are tracked in rows here, and a row may only be considered
+    // as up to date once all rows depending on it have been written,
+    // i.e. once the update covered the full image.
+    if (rr->rr_bUpdate && m_ulPixelHeight > 0 &&
+        region.ra_MinX == 0 && region.ra_MaxX >= LONG(m_ulPixelWidth) - 1 &&
+        region.ra_MaxY >= LONG(m_ulPixelHeight) - 1 && ULONG(region.ra_MaxY >> 3) <= m_ulMaxMCU &&
+        rr->rr_usFirstComponent == 0 && rr->rr_usLastComponent >= m_ucCount - 1) {
+      ClearChangedRows();
+    }
   } else { 
     // direct case, no upsampling required, the easy case.
     ReconstructUnsampled(rr,region,m_ulMaxMCU,ctrafo);
@@ -1261,6 +1879,251 @@ void BlockBitmapRequester::ReconstructRegion(const RectAngle<LONG> &region,const
 }
 ///
 
+/// BlockBitmapRequester::BuildRetained
+// Allocate the planes that keep the input of the color transformation.
+void BlockBitmapRequester::BuildRetained(void)
+{
+  ULONG blocks;
+  UBYTE i;
+
+  assert(m_pucRetained == NULL && m_ulPixelHeight > 0);
+
+  m_ulRetainedWidth  = (m_ulPixelWidth  + 7) >> 3;
+  m_ulRetainedHeight = (m_ulPixelHeight + 7) >> 3;
+  blocks             = m_ulRetainedWidth * m_ulRetainedHeight;
+  if (blocks / m_ulRetainedHeight != m_ulRetainedWidth || blocks > MAX_ULONG / (64 * sizeof(LONG)))
+    JPG_THROW(OVERFLOW_PARAMETER,"BlockBitmapRequester::BuildRetained",
+              "image is too large to keep its reconstruction");
+
+  if (m_pplRetained == NULL) {
+    m_pplRetained = (LONG **)m_pEnviron->AllocMem(m_ucCount * sizeof(LONG *));
+    memset(m_pplRetained,0,m_ucCount * sizeof(LONG *));
+  }
+  for(i = 0;i < m_ucCount;i++) {
+    if (m_pplRetained[i] == NULL)
+      m_pplRetained[i] = (LONG *)m_pEnviron->AllocMem(blocks * 64 * sizeof(LONG));
+  }
+
+  if (m_pResidualHelper) {
+    if (m_pplRetainedResidual == NULL) {
+      m_pplRetainedResidual = (LONG **)m_pEnviron->AllocMem(m_ucCount * sizeof(LONG *));
+      memset(m_pplRetainedResidual,0,m_ucCount * sizeof(LONG *));
+    }
+    for(i = 0;i < m_ucCount;i++) {
+      if (m_pplRetainedResidual[i] == NULL)
+        m_pplRetainedResidual[i] = (LONG *)m_pEnviron->AllocMem(blocks * 64 * sizeof(LONG));
+    }
+  }
+  //
+  // This goes last as it indicates that the planes are ready.
+  m_pucRetained      = (UBYTE *)m_pEnviron->AllocMem(blocks * sizeof(UBYTE));
+  memset(m_pucRetained,0,blocks * sizeof(UBYTE));
+  m_ulRetainedBlocks = 0;
+}
+///
+
+/// BlockBitmapRequester::RetainBlock
+// Keep the input of the color transformation currently in the
+// color buffers as the data of the block at x,y.
+void BlockBitmapRequester::RetainBlock(ULONG x,ULONG y)
+{
+  ULONG idx = x + y * m_ulRetainedWidth;
+  UBYTE i;
+
+  assert(x < m_ulRetainedWidth && y < m_ulRetainedHeight);
+
+  for(i = 0;i < m_ucCount;i++) {
+    memcpy(m_pplRetained[i] + (idx << 6),m_ppCTemp[i],64 * sizeof(LONG));
+    if (m_pplRetainedResidual)
+      memcpy(m_pplRetainedResidual[i] + (idx << 6),m_ppDTemp[i],64 * sizeof(LONG));
+  }
+
+  if (m_pucRetained[idx] == 0) {
+    m_pucRetained[idx] = 1;
+    m_ulRetainedBlocks++;
+  }
+}
+///
+
+/// BlockBitmapRequester::DropRetained
+// Forget all kept blocks as the image is about to change.
+void BlockBitmapRequester::DropRetained(void)
+{
+  if (m_ulRetainedBlocks) {
+    memset(m_pucRetained,0,m_ulRetainedWidth * m_ulRetainedHeight * sizeof(UBYTE));
+    m_ulRetainedBlocks = 0;
+  }
+}
+///
+
+/// BlockBitmapRequester::ReconstructRetained
+// Reconstruct a region from the kept blocks, running only the
+// color transformation.
+void BlockBitmapRequester::ReconstructRetained(const struct RectangleRequest *rr,const RectAngle<LONG> &region,
+                                               ULONG maxmcu,class ColorTrafo *ctrafo)
+{
+  RectAngle<LONG> r;
+  ULONG minx   = region.ra_MinX >> 3;
+  ULONG maxx   = region.ra_MaxX >> 3;
+  ULONG miny   = region.ra_MinY >> 3;
+  ULONG maxy   = region.ra_MaxY >> 3;
+  ULONG x,y;
+  UBYTE i;
+  class Instrumentation *stats = m_pEnviron->InstrumentationOf();
+  
+  if (maxy > maxmcu)
+    maxy = maxmcu;
+  
+  for(y = miny,r.ra_MinY = region.ra_MinY;y <= maxy;y++,r.ra_MinY = r.ra_MaxY + 1) {
+    r.ra_MaxY = (r.ra_MinY & -8) + 7;
+    if (r.ra_MaxY > region.ra_MaxY)
+      r.ra_MaxY = region.ra_MaxY;
+    
+    for(x = minx,r.ra_MinX = region.ra_MinX;x <= maxx;x++,r.ra_MinX = r.ra_MaxX + 1) {
+      ULONG offset = (x + y * m_ulRetainedWidth) << 6;
+      r.ra_MaxX = (r.ra_MinX & -8) + 7;
+      if (r.ra_MaxX > region.ra_MaxX)
+        r.ra_MaxX = region.ra_MaxX;
+      
+      for(i = 0;i < m_ucCount;i++) {
+        if (i >= rr->rr_usFirstComponent && i <= rr->rr_usLastComponent) {
+          ExtractBitmap(m_ppTempIBM[i],r,i);
+          memcpy(m_ppCTemp[i],m_pplRetained[i] + offset,64 * sizeof(LONG));
+          if (m_pplRetainedResidual)
+            memcpy(m_ppDTemp[i],m_pplRetainedResidual[i] + offset,64 * sizeof(LONG));
+        } else {
+          memset(m_ppCTemp[i],0,sizeof(LONG) * 64);
+        }
+      }
+      {
+        StageTimer timer(stats,JPGFLAG_STATS_COLOR_TRANSFORM);
+        ctrafo->YCbCr2RGB(r,m_ppTempIBM,m_ppCTemp,m_ppDTemp);
+      }
+    }
+    //
+    // Blocks are not tracked individually here, all rows are written.
+    if (m_lUpdatedMaxY < m_lUpdatedMinY)
+      m_lUpdatedMinY = r.ra_MinY;
+    m_lUpdatedMaxY   = r.ra_MaxY;
+  }
+}
+///
+
+/// BlockBitmapRequester::StartMCUQuantizerRow
+// Start a MCU scan by initializing the quantized rows for this row
+// in this scan. This also invalidates the kept blocks.
+bool BlockBitmapRequester::StartMCUQuantizerRow(class Scan *scan)
+{
+  DropRetained();
+
+  return BlockBuffer::StartMCUQuantizerRow(scan);
+}
+///
+
+/// BlockBitmapRequester::StartMCUResidualRow
+// Start a MCU scan by initializing the residuals for this row.
+// This also invalidates the kept blocks.
+bool BlockBitmapRequester::StartMCUResidualRow(class Scan *scan)
+{
+  DropRetained();
+
+  return BlockBuffer::StartMCUResidualRow(scan);
+}
+///
+
+/// BlockBitmapRequester::isBlockChanged
+// Check whether any requested component of the block in column x of
+// the current row changed since the last update.
+bool BlockBitmapRequester::isBlockChanged(const struct RectangleRequest *rr,ULONG x) const
+{
+  UBYTE i;
+
+  for(i = rr->rr_usFirstComponent;i <= rr->rr_usLastComponent;i++) {
+    class QuantizedRow *qrow = *m_pppQImage[i];
+    // Rows that are not yet there have not been reconstructed either.
+    if (qrow == NULL || qrow->isChanged(x))
+      return true;
+    if (m_pResidualHelper) {
+      class QuantizedRow *rrow = *m_pppRImage[i];
+      if (rrow == NULL || rrow->isChanged(x))
+        return true;
+    }
+  }
+
+  return false;
+}
+///
+
+/// BlockBitmapRequester::RowsChanged
+// Check whether any row of the row stack of a component subsampled
+// vertically by suby that is required to reconstruct the block row by
+// of the image changed. Missing rows count as changed.
+bool BlockBitmapRequester::RowsChanged(class QuantizedRow *row,LONG by,UBYTE suby) const
+{
+  LONG ry    = (suby > 1)?(1):(0); // one extra line for the upsampling filter
+  LONG first = ((by << 3) / suby - ry) >> 3;
+  LONG last  = (((by << 3) + 7) / suby + ry) >> 3;
+  LONG y;
+  //
+  // Rows beyond the bottom edge of the image do not exist.
+  if (m_ulPixelHeight) {
+    LONG rows = (((m_ulPixelHeight + suby - 1) / suby + 7) >> 3);
+    if (last >= rows)
+      last = rows - 1;
+  }
+  
+  for(y = 0;y <= last;y++) {
+    if (row == NULL)
+      return true;
+    if (y >= first && row->isChanged())
+      return true;
+    row = row->NextOf();
+  }
+
+  return false;
+}
+///
+
+/// BlockBitmapRequester::isRowChanged
+// Check whether any quantized row the block row by of the image
+// depends on changed since the last update, including the rows
+// required by the upsampling filters.
+bool BlockBitmapRequester::isRowChanged(const struct RectangleRequest *rr,LONG by) const
+{
+  UBYTE i;
+
+  for(i = rr->rr_usFirstComponent;i <= rr->rr_usLastComponent;i++) {
+    class Component *comp = m_pFrame->ComponentOf(i);
+    //
+    if (RowsChanged(m_ppQTop[i],by,comp->SubYOf()))
+      return true;
+    if (m_pResidualHelper) {
+      comp = m_pResidualHelper->ResidualFrameOf()->ComponentOf(i);
+      if (RowsChanged(m_ppRTop[i],by,comp->SubYOf()))
+        return true;
+    }
+  }
+
+  return false;
+}
+///
+
+/// BlockBitmapRequester::ClearChangedRows
+// Reset the change indicators of all rows after a complete update.
+void BlockBitmapRequester::ClearChangedRows(void)
+{
+  class QuantizedRow *row;
+  UBYTE i;
+
+  for(i = 0;i < m_ucCount;i++) {
+    for(row = m_ppQTop[i];row;row = row->NextOf())
+      row->ClearChanged();
+    for(row = m_ppRTop[i];row;row = row->NextOf())
+      row->ClearChanged();
+  }
+}
+///
+
 /// BlockBitmapRequester::isNextMCULineReady
 // Return true if the next MCU line is buffered and can be pushed
 // to the encoder.
@@ -1283,6 +2146,87 @@ bool BlockBitmapRequester::isNextMCULineReady(void) const
 }
 ///
 
+/// BlockBitmapRequester::isNextMCURowComplete
+// Return true if all quantized rows of the next MCU row of the given scan
+// have been computed, either in the legacy or in the residual buffer,
+// such that the row can be written while the image is still provided.
+bool BlockBitmapRequester::isNextMCURowComplete(class Scan *scan,bool residual) const
+{
+  UBYTE ccnt = scan->ComponentsInScan();
+
+  for(UBYTE j = 0;j < ccnt;j++) {
+    class Component *comp = scan->ComponentOf(j);
+    UBYTE i               = comp->IndexOf();
+    UBYTE mcuheight       = (ccnt > 1)?(comp->MCUHeightOf()):(1);
+    UBYTE suby            = comp->SubYOf();
+    ULONG height          = (m_ulPixelHeight + suby - 1) / suby;
+    ULONG ymin            = (residual)?(m_pulResidualY[i]):(m_pulY[i]);
+    class QuantizedRow **row  = (residual)?(m_pppRStream[i]):(m_pppQStream[i]);
+    class QuantizedRow **last = (residual)?(m_pppRImage[i]):(m_pppQImage[i]);
+    ULONG rows;
+    //
+    // Nothing left to write for this component? If so, the
+    // scan will detect the end of the image.
+    if (ymin >= height)
+      continue;
+    //
+    rows = (height - ymin + 7) >> 3;
+    if (rows > mcuheight)
+      rows = mcuheight;
+    //
+    // Skip the rows of the MCU row written last, exactly as the
+    // scan does when starting the next row. The row last points to
+    // is the one that is currently computed, and not yet complete.
+    if (row) {
+      for(UBYTE k = 0;k < mcuheight;k++) {
+        if (row == last)
+          return false;
+        row = &((*row)->NextOf());
+      }
+    } else {
+      row = (residual)?(&m_ppRTop[i]):(&m_ppQTop[i]);
+    }
+    //
+    while(rows) {
+      if (row == last)
+        return false;
+      row = &((*row)->NextOf());
+      rows--;
+    }
+  }
+
+  return true;
+}
+///
+
+/// BlockBitmapRequester::ReleaseCodedRows
+// Release all legacy and residual rows that have been written
+// already and that are no longer required for encoding.
+void BlockBitmapRequester::ReleaseCodedRows(void)
+{
+  class QuantizedRow *row;
+  
+  for(UBYTE i = 0;i < m_ucCount;i++) {
+    // The row whose successor pointer the stream keeps holds the
+    // position of the scan, and must therefore remain. All rows
+    // above can go. Encoding is ahead of the stream, thus the
+    // rows under construction are not touched.
+    if (m_pppQStream[i] && m_pppQStream[i] != &m_ppQTop[i]) {
+      while((row = m_ppQTop[i]) && m_pppQStream[i] != &(row->NextOf())) {
+        m_ppQTop[i] = row->NextOf();
+        delete row;
+      }
+    }
+    if (m_pppRStream[i] && m_pppRStream[i] != &m_ppRTop[i]) {
+      while((row = m_ppRTop[i]) && m_pppRStream[i] != &(row->NextOf())) {
+        m_ppRTop[i] = row->NextOf();
+        delete row;
+      }
+    }
+  }
+}
+///
+
 /// BlockBitmapRequester::isImageComplete
 // Return an indicator whether all of the image has been loaded into
 // the image buffer.
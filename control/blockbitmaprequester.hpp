@@ -75,6 +75,7 @@ class ColorTrafo;
 class QuantizedRow;
 class ResidualBlockHelper;
 class DeRinger;
+class TransformPool;
 ///
 
 /// class BlockBitmapRequester
@@ -160,6 +161,31 @@ class BlockBitmapRequester : public BlockBuffer, public BitmapCtrl {
   // If this is true, run the deblocking filter as well.
   bool                       m_bDeRing;
   //
+  // Number of threads the blocks of unsampled images are transformed
+  // on during encoding, and the threads themselves once started.
+  UWORD                      m_usThreads;
+  class TransformPool       *m_pTransformPool;
+  //
+  // The first and last line written into the user bitmap by the
+  // last reconstruction.
+  LONG                       m_lUpdatedMinY;
+  LONG                       m_lUpdatedMaxY;
+  //
+  // The input of the color transformation for all blocks of the image,
+  // i.e. the reconstructed base layer and the residual, one plane per
+  // component. This is kept on request such that the image can be
+  // displayed again by running the color transformation only. The
+  // residual planes only exist if there is a residual.
+  LONG                     **m_pplRetained;
+  LONG                     **m_pplRetainedResidual;
+  //
+  // One flag per block that is set if the block is kept, the number
+  // of blocks kept, and the dimensions of the planes in blocks.
+  UBYTE                     *m_pucRetained;
+  ULONG                      m_ulRetainedBlocks;
+  ULONG                      m_ulRetainedWidth;
+  ULONG                      m_ulRetainedHeight;
+  //
   // Build common structures for encoding and decoding
   void BuildCommon(void);
   //
@@ -180,6 +206,25 @@ class BlockBitmapRequester : public BlockBuffer, public BitmapCtrl {
   // The encoding procedure without subsampling, which is the much simpler case.
   void EncodeUnsampled(const RectAngle<LONG> &region,class ColorTrafo *ctrafo);
   //
+  // Color transform, forward transform and quantize the blocks from column
+  // minx to maxx of block row y of the region into the given quantized rows,
+  // one per component, using the given temporary bitmaps and buffers.
+  void TransformBlocks(const RectAngle<LONG> &region,class ColorTrafo *ctrafo,
+                       class QuantizedRow *const *rows,LONG y,LONG minx,LONG maxx,
+                       struct ImageBitMap *const *ibm,LONG **ctemp);
+  //
+  // The encoding procedure without subsampling, transforming the blocks
+  // on the threads of the transform pool.
+  void EncodeUnsampledConcurrently(const RectAngle<LONG> &region,class ColorTrafo *ctrafo);
+  //
+  // Transform the slices of the current region of the pool until none is
+  // left, using the given temporary bitmaps and buffers.
+  void TransformSlices(class TransformPool *pool,struct ImageBitMap *const *ibm,LONG **ctemp);
+  //
+  // The thread entry point of the transform pool that transforms the
+  // blocks of the regions handed out by the pool.
+  static void *TransformWorker(void *worker);
+  //
   // Reconstruct a region not using any subsampling.
   void ReconstructUnsampled(const struct RectangleRequest *rr,const RectAngle<LONG> &region,
                             ULONG maxmcu,class ColorTrafo *ctrafo);
@@ -195,6 +240,38 @@ class BlockBitmapRequester : public BlockBuffer, public BitmapCtrl {
   void PushReconstructedData(const struct RectangleRequest *rr,const RectAngle<LONG> &region,
                              ULONG maxmcu,class ColorTrafo *ctrafo);
   //
+  // Check whether any requested component of the block in column x of
+  // the current row changed since the last update.
+  bool isBlockChanged(const struct RectangleRequest *rr,ULONG x) const;
+  //
+  // Check whether any quantized row the block row by of the image
+  // depends on changed since the last update, including the rows
+  // required by the upsampling filters.
+  bool isRowChanged(const struct RectangleRequest *rr,LONG by) const;
+  //
+  // Check whether any row of the row stack of a component subsampled
+  // vertically by suby that is required to reconstruct the block row by
+  // of the image changed.
+  bool RowsChanged(class QuantizedRow *row,LONG by,UBYTE suby) const;
+  //
+  // Reset the change indicators of all rows after a complete update.
+  void ClearChangedRows(void);
+  //
+  // Allocate the planes that keep the input of the color transformation.
+  void BuildRetained(void);
+  //
+  // Keep the input of the color transformation currently in the
+  // color buffers as the data of the block at x,y.
+  void RetainBlock(ULONG x,ULONG y);
+  //
+  // Forget all kept blocks as the image is about to change.
+  void DropRetained(void);
+  //
+  // Reconstruct a region from the kept blocks, running only the
+  // color transformation.
+  void ReconstructRetained(const struct RectangleRequest *rr,const RectAngle<LONG> &region,
+                           ULONG maxmcu,class ColorTrafo *ctrafo);
+  //
 public:
   //
   BlockBitmapRequester(class Frame *frame);
@@ -237,10 +314,35 @@ public:
   // Reconstruct a block, or part of a block
   virtual void ReconstructRegion(const RectAngle<LONG> &region,const struct RectangleRequest *rr);
   //
+  // Start a MCU scan by initializing the quantized rows for this row
+  // in this scan. This also invalidates the kept blocks.
+  virtual bool StartMCUQuantizerRow(class Scan *scan);
+  //
+  // Start a MCU scan by initializing the residuals for this row.
+  // This also invalidates the kept blocks.
+  virtual bool StartMCUResidualRow(class Scan *scan);
+  //
+  // Clip the region passed into the last call of ReconstructRegion to the
+  // lines that have actually been written.
+  virtual void UpdatedRegionOf(RectAngle<LONG> &region) const
+  {
+    region.ra_MinY = m_lUpdatedMinY;
+    region.ra_MaxY = m_lUpdatedMaxY;
+  }
+  //
   // Return true if the next MCU line is buffered and can be pushed
   // to the encoder.
   virtual bool isNextMCULineReady(void) const;
   //
+  // Return true if all quantized rows of the next MCU row of the given scan
+  // have been computed, either in the legacy or in the residual buffer,
+  // such that the row can be written while the image is still provided.
+  bool isNextMCURowComplete(class Scan *scan,bool residual) const;
+  //
+  // Release all legacy and residual rows that have been written
+  // already and that are no longer required for encoding.
+  void ReleaseCodedRows(void);
+  //
   // Reset all components on the image side of the control to the
   // start of the image. Required when re-requesting the image
   // for encoding or decoding.
@@ -80,9 +80,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /// BlockBuffer::BlockBuffer
 BlockBuffer::BlockBuffer(class Frame *frame)
   : BlockCtrl(frame->EnvironOf()), m_pFrame(frame), m_pulY(NULL), m_pulCurrentY(NULL), 
+    m_pulResidualY(NULL), m_pulCurrentResidualY(NULL), m_bResidualScan(false),
     m_ppDCT(NULL), 
     m_ppQTop(NULL), m_ppRTop(NULL), 
-    m_pppQStream(NULL), m_pppRStream(NULL)
+    m_pppQStream(NULL), m_pppRStream(NULL),
+    m_pucQMemory(NULL), m_ulQMemory(0), m_pucRMemory(NULL), m_ulRMemory(0)
 {
   m_ucCount       = frame->DepthOf();
   m_ulPixelWidth  = frame->WidthOf();
@@ -109,6 +111,12 @@ BlockBuffer::~BlockBuffer(void)
   if (m_pulCurrentY)
     m_pEnviron->FreeMem(m_pulCurrentY,m_ucCount * sizeof(ULONG));
 
+  if (m_pulResidualY)
+    m_pEnviron->FreeMem(m_pulResidualY,m_ucCount * sizeof(ULONG));
+  
+  if (m_pulCurrentResidualY)
+    m_pEnviron->FreeMem(m_pulCurrentResidualY,m_ucCount * sizeof(ULONG));
+
   if (m_ppQTop) {
     for(i = 0;i < m_ucCount;i++) {
       while((row = m_ppQTop[i])) {
@@ -129,6 +137,13 @@ BlockBuffer::~BlockBuffer(void)
     m_pEnviron->FreeMem(m_ppRTop,m_ucCount * sizeof(class QuantizedRow *));
   }
 
+  // The rows above borrowed from these.
+  if (m_pucQMemory)
+    m_pEnviron->FreeMem(m_pucQMemory,m_ulQMemory);
+
+  if (m_pucRMemory)
+    m_pEnviron->FreeMem(m_pucRMemory,m_ulRMemory);
+
   if (m_pppQStream)
     m_pEnviron->FreeMem(m_pppQStream,m_ucCount * sizeof(class QuantizedRow **));
 
@@ -156,6 +171,16 @@ void BlockBuffer::BuildCommon(void)
     memset(m_pulCurrentY,0,sizeof(ULONG) * m_ucCount);
   }
 
+  if (m_pulResidualY == NULL) {
+    m_pulResidualY        = (ULONG *)m_pEnviron->AllocMem(sizeof(ULONG) * m_ucCount);
+    memset(m_pulResidualY,0,sizeof(ULONG) * m_ucCount);
+  }
+  
+  if (m_pulCurrentResidualY == NULL) {
+    m_pulCurrentResidualY = (ULONG *)m_pEnviron->AllocMem(sizeof(ULONG) * m_ucCount);
+    memset(m_pulCurrentResidualY,0,sizeof(ULONG) * m_ucCount);
+  }
+
   if (m_ppQTop == NULL) {
     m_ppQTop      = (class QuantizedRow **)m_pEnviron->AllocMem(sizeof(class QuantizedRow *) * 
                                                               m_ucCount);
@@ -182,6 +207,76 @@ void BlockBuffer::BuildCommon(void)
 }
 ///
 
+/// BlockBuffer::BuildRows
+// Build all rows of the given frame in one go, starting at the
+// given top rows, such that parsing the MCUs does not need to
+// allocate them. The memory holding the blocks and its size go into
+// the last two arguments. Nothing happens if the frame height is not
+// yet known, rows already exist or the buffer is too large for a
+// single allocation.
+void BlockBuffer::BuildRows(class Frame *frame,class QuantizedRow **top,bool compact,UBYTE *&memory,ULONG &size)
+{
+  size_t blocksize = (compact)?(sizeof(QuantizedRow::CompactBlock)):(sizeof(QuantizedRow::Block));
+  size_t blocks    = 0;
+  UBYTE *flags;
+  UBYTE i;
+  //
+  // Without the height, e.g. if it comes with a DNL marker, the
+  // rows are allocated as the MCUs are parsed.
+  if (memory || m_ulPixelHeight == 0)
+    return;
+
+  for(i = 0;i < m_ucCount;i++) {
+    class Component *comp = frame->ComponentOf(i);
+    ULONG width           = (((m_ulPixelWidth  + comp->SubXOf() - 1) / comp->SubXOf()) + 7) >> 3;
+    ULONG height          = (((m_ulPixelHeight + comp->SubYOf() - 1) / comp->SubYOf()) + 7) >> 3;
+    if (top[i])
+      return;
+    blocks += size_t(width) * height;
+  }
+  //
+  // Images too large for a single allocation keep allocating row by row.
+  if (blocks > MAX_ULONG / (blocksize + 1))
+    return;
+  //
+  // The blocks go first, the flags of all rows behind them.
+  size   = ULONG(blocks * (blocksize + 1));
+  memory = (UBYTE *)m_pEnviron->AllocMem(size);
+  memset(memory,0,blocks * blocksize);
+  flags  = memory + blocks * blocksize;
+  blocks = 0;
+  
+  for(i = 0;i < m_ucCount;i++) {
+    class Component *comp = frame->ComponentOf(i);
+    ULONG coefficients    = (m_ulPixelWidth  + comp->SubXOf() - 1) / comp->SubXOf();
+    ULONG width           = (coefficients + 7) >> 3;
+    ULONG height          = (((m_ulPixelHeight + comp->SubYOf() - 1) / comp->SubYOf()) + 7) >> 3;
+    class QuantizedRow **last = &top[i];
+    ULONG y;
+
+    for(y = 0;y < height;y++) {
+      *last = new(m_pEnviron) class QuantizedRow(m_pEnviron);
+      (*last)->AttachRow(coefficients,compact,memory + blocks * blocksize,flags + blocks);
+      blocks += width;
+      last    = &((*last)->NextOf());
+    }
+  }
+}
+///
+
+/// BlockBuffer::CompactCoefficients
+// Check whether the quantized coefficients of this frame fit into
+// 16 bits such that the quantized rows can be kept compact.
+bool BlockBuffer::CompactCoefficients(void) const
+{
+  // The DCT extends the range of the samples by three bits, and the
+  // differential frames of the hierarchical process by one additional
+  // bit. This leaves room for ten bits of precision, including the
+  // hidden bits. Residuals are always kept in 32 bits.
+  return m_pFrame->HiddenPrecisionOf() <= 10;
+}
+///
+
 /// BlockBuffer::ResetStreamToStartOfScan
 // Make sure to reset the block control to the
 // start of the scan for the indicated components in the scan, 
@@ -200,7 +295,6 @@ void BlockBuffer::ResetToStartOfScan(class Scan *scan)
       m_pulY[idx]           = 0;
       m_pulCurrentY[idx]    = 0;
       m_pppQStream[idx]     = NULL;
-      m_pppRStream[idx]     = NULL;
     }
   } else {
     // All components.
@@ -212,19 +306,40 @@ void BlockBuffer::ResetToStartOfScan(class Scan *scan)
       m_pulY[idx]           = 0;
       m_pulCurrentY[idx]    = 0;
       m_pppQStream[idx]     = NULL;
-      m_pppRStream[idx]     = NULL;
     }
   }
 }
 ///
 
+/// BlockBuffer::ResetToStartOfResidualScan
+// Ditto for the residual scan, resets only the residual
+// rows and leaves the legacy rows alone.
+void BlockBuffer::ResetToStartOfResidualScan(class Scan *scan)
+{
+  UBYTE ccnt = scan->ComponentsInScan();
+  
+  for(UBYTE i = 0;i < ccnt;i++) {
+    class Component *comp = scan->ComponentOf(i);
+    UBYTE idx             = comp->IndexOf(); 
+    if (m_ppDCT[idx] == NULL)
+      m_ppDCT[idx]        = m_pFrame->TablesOf()->BuildDCT(comp,m_ucCount,
+                                                           m_pFrame->HiddenPrecisionOf());
+    m_pulResidualY[idx]        = 0;
+    m_pulCurrentResidualY[idx] = 0;
+    m_pppRStream[idx]          = NULL;
+  }
+  m_bResidualScan = true;
+}
+///
+
 /// BlockBuffer::StartMCUQuantizerRow
 // Start a MCU scan by initializing the quantized rows for this row
 // in this scan.
 bool BlockBuffer::StartMCUQuantizerRow(class Scan *scan)
 {
-  bool more  = true;
-  UBYTE ccnt = scan->ComponentsInScan();
+  bool more    = true;
+  bool compact = CompactCoefficients();
+  UBYTE ccnt   = scan->ComponentsInScan();
   
   for(UBYTE i = 0;i < ccnt;i++) {
     ULONG y,ymin,ymax,width,height;
@@ -262,7 +377,7 @@ bool BlockBuffer::StartMCUQuantizerRow(class Scan *scan)
         if (*last == NULL) {
           *last = new(m_pEnviron) class QuantizedRow(m_pEnviron);
         }
-        (*last)->AllocateRow(width);
+        (*last)->AllocateRow(width,compact);
         if (y == ymin)
           m_pppQStream[idx] = last;
         last = &((*last)->NextOf());
@@ -286,7 +401,12 @@ ULONG BlockBuffer::BufferedLines(const struct RectangleRequest *rr) const
 
   for(i = rr->rr_usFirstComponent;i <= rr->rr_usLastComponent;i++) {
     class Component *comp = m_pFrame->ComponentOf(i);
-    ULONG curline = comp->SubYOf() * (m_pulCurrentY[i] + (comp->MCUHeightOf() << 3));
+    ULONG cury    = m_pulCurrentY[i];
+    // Once the residual is parsed, it is the residual that limits the
+    // data available.
+    if (m_bResidualScan && m_pulCurrentResidualY[i] < cury)
+      cury = m_pulCurrentResidualY[i];
+    ULONG curline = comp->SubYOf() * (cury + (comp->MCUHeightOf() << 3));
     if (curline >= m_ulPixelHeight) { // end of image
       curline = m_ulPixelHeight;
     } else if (curline > 0 && comp->SubYOf() > 1) { // need one extra pixel at the end for subsampling expansion
@@ -318,14 +438,14 @@ bool BlockBuffer::StartMCUResidualRow(class Scan *scan)
     last            = m_pppRStream[i];
     width           = (m_ulPixelWidth  + subx - 1) / subx;
     height          = (m_ulPixelHeight + suby - 1) / suby;
-    ymin            = m_pulY[i];
+    ymin            = m_pulResidualY[i];
     ymax            = ymin + (mcuheight << 3);  
     
     if (m_ulPixelHeight > 0 && ymax > height)
       ymax = height;
 
     if (ymin < ymax) {
-      m_pulCurrentY[i] = m_pulY[i];
+      m_pulCurrentResidualY[i] = m_pulResidualY[i];
 
       if (last) {
         while(mcuheight) {
@@ -349,7 +469,7 @@ bool BlockBuffer::StartMCUResidualRow(class Scan *scan)
     } else {
       more = false;
     }
-    m_pulY[i] = ymax;
+    m_pulResidualY[i] = ymax;
   }
 
   return more;
@@ -99,6 +99,16 @@ protected:
   // quantizer buffer line.
   ULONG                     *m_pulCurrentY;
   //
+  // Ditto for the residual buffer lines. The residual keeps
+  // its own counters such that the legacy and residual scans
+  // can be written concurrently.
+  ULONG                     *m_pulResidualY;
+  ULONG                     *m_pulCurrentResidualY;
+  //
+  // Set as soon as a residual scan has been started. From then
+  // on, the residual also limits the number of buffered lines.
+  bool                       m_bResidualScan;
+  //
   // The DCT for encoding or decoding, together with the quantizer.
   class DCT                **m_ppDCT; 
   //
@@ -120,9 +130,29 @@ protected:
   // Current position in stream parsing for the residual.
   class QuantizedRow      ***m_pppRStream;
   //
+  // If the rows are built in one go, this is the memory
+  // holding their blocks and flags, along with its size
+  // in bytes, for the quantized and the residual rows.
+  UBYTE                     *m_pucQMemory;
+  ULONG                      m_ulQMemory;
+  UBYTE                     *m_pucRMemory;
+  ULONG                      m_ulRMemory;
+  //
   // Build common structures for encoding and decoding
   void BuildCommon(void);
   //
+  // Build all rows of the given frame in one go, starting at the
+  // given top rows, such that parsing the MCUs does not need to
+  // allocate them. The memory holding the blocks and its size go into
+  // the last two arguments. Nothing happens if the frame height is not
+  // yet known, rows already exist or the buffer is too large for a
+  // single allocation.
+  void BuildRows(class Frame *frame,class QuantizedRow **top,bool compact,UBYTE *&memory,ULONG &size);
+  //
+  // Check whether the quantized coefficients of this frame fit into
+  // 16 bits such that the quantized rows can be kept compact.
+  bool CompactCoefficients(void) const;
+  //
   //
 public:
   //
@@ -167,6 +197,10 @@ public:
   // required after collecting the statistics for this scan.
   virtual void ResetToStartOfScan(class Scan *scan);
   //
+  // Ditto for the residual scan, resets only the residual
+  // rows and leaves the legacy rows alone.
+  void ResetToStartOfResidualScan(class Scan *scan);
+  //
   // Return true in case this buffer is organized in lines rather
   // than blocks.
   virtual bool isLineBased(void) const
@@ -70,6 +70,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "dct/dct.hpp"
 #include "tools/line.hpp"
 #include "codestream/tables.hpp"
+#include "tools/instrumentation.hpp"
 #include "std/string.hpp"
 ///
 
@@ -201,24 +202,29 @@ struct Line *BlockLineAdapter::GetNextLine(UBYTE comp)
       out[l] = line;
     }
       
-    for(x = minx;x <= maxx;x++) {
-      LONG dst[64];
-      class QuantizedRow *qrow = *m_pppQImage[comp];
-      const LONG *src = (qrow)?(qrow->BlockAt(x)->m_Data):(NULL);
-      if (src) {
-        m_ppDCT[comp]->InverseTransformBlock(dst,src,(maxval + 1) >> 1);
-        //
-        // Copy now the buffer temporary buffer into the line. The line is always long enough
-        // to cover all pixels, even those outside of the range.
-        for(l = 0; l < 8;l++) {
-          memcpy(out[l]->m_pData + (x << 3),&dst[l << 3],8 * sizeof(LONG));
-        }
-      } else {
-        for(l = 0; l < 8;l++) {
-          memset(out[l]->m_pData + (x << 3),0,8 * sizeof(LONG));
+    {
+      // The timer covers the entire row of blocks rather than the
+      // individual blocks.
+      StageTimer timer(m_pEnviron,JPGFLAG_STATS_INVERSE_DCT);
+      for(x = minx;x <= maxx;x++) {
+        LONG dst[64],buf[64];
+        class QuantizedRow *qrow = *m_pppQImage[comp];
+        const LONG *src = (qrow)?(qrow->FetchBlock(x,buf)):(NULL);
+        if (src) {
+          m_ppDCT[comp]->InverseTransformBlock(dst,src,(maxval + 1) >> 1);
+          //
+          // Copy now the buffer temporary buffer into the line. The line is always long enough
+          // to cover all pixels, even those outside of the range.
+          for(l = 0; l < 8;l++) {
+            memcpy(out[l]->m_pData + (x << 3),&dst[l << 3],8 * sizeof(LONG));
+          }
+        } else {
+          for(l = 0; l < 8;l++) {
+            memset(out[l]->m_pData + (x << 3),0,8 * sizeof(LONG));
+          }
         }
-      }
-    } // of loop over x
+      } // of loop over x
+    }
     //
     // Advance the rows.
     class QuantizedRow *qrow = *m_pppQImage[comp];
@@ -285,25 +291,33 @@ void BlockLineAdapter::PushLine(struct Line *,UBYTE comp)
       }
     }
     
-    for(x = minx;x <= maxx;x++) {
-      struct Line *line = m_ppTop[comp];
-      LONG src[64];
-      //
-      assert(line);
-      // Copy from the line into the temporary buffer.
-      for(l = 0;l < 8;l++) {
-        memcpy(&src[l << 3],line->m_pData + (x << 3),8 * sizeof(LONG));
-        if (line->m_pNext) line = line->m_pNext; // Duplicate the bottom-most line.
-      }
-      //
-      // Create the target if it is not already there.
-      if (*m_pppQImage[comp] == NULL) {
-        *m_pppQImage[comp] = new(m_pEnviron) class QuantizedRow(m_pEnviron);
-        (*m_pppQImage[comp])->AllocateRow(m_pulPixelsPerComponent[comp]);
-      }
-      LONG *dst = (*m_pppQImage[comp])->BlockAt(x)->m_Data;
-      m_ppDCT[comp]->TransformBlock(src,dst,(maxval + 1) >> 1);
-    } /* Of loop over X */
+    //
+    // Create the target if it is not already there.
+    if (*m_pppQImage[comp] == NULL) {
+      *m_pppQImage[comp] = new(m_pEnviron) class QuantizedRow(m_pEnviron);
+      (*m_pppQImage[comp])->AllocateRow(m_pulPixelsPerComponent[comp],CompactCoefficients());
+    }
+    {
+      // The timer covers the entire row of blocks rather than the
+      // individual blocks.
+      StageTimer timer(m_pEnviron,JPGFLAG_STATS_FORWARD_DCT);
+      for(x = minx;x <= maxx;x++) {
+        struct Line *line = m_ppTop[comp];
+        LONG src[64];
+        //
+        assert(line);
+        // Copy from the line into the temporary buffer.
+        for(l = 0;l < 8;l++) {
+          memcpy(&src[l << 3],line->m_pData + (x << 3),8 * sizeof(LONG));
+          if (line->m_pNext) line = line->m_pNext; // Duplicate the bottom-most line.
+        }
+        //
+        LONG buf[64];
+        LONG *dst = (*m_pppQImage[comp])->TargetBlock(x,buf);
+        m_ppDCT[comp]->TransformBlock(src,dst,(maxval + 1) >> 1);
+        (*m_pppQImage[comp])->StoreBlock(x,dst);
+      } /* Of loop over X */
+    }
     //
     // Advance the image pointers.
     {
@@ -75,6 +75,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "tools/line.hpp"
 #include "dct/dct.hpp"
 #include "colortrafo/colortrafo.hpp"
+#include "tools/instrumentation.hpp"
 #include "std/string.hpp"
 ///
 
@@ -347,7 +348,10 @@ void LineBitmapRequester::EncodeRegion(const RectAngle<LONG> &region)
         
         //
         // Run the color transformer.
-        ctrafo->RGB2YCbCr(r,m_ppTempIBM,m_ppCTemp);
+        {
+          StageTimer timer(m_pEnviron,JPGFLAG_STATS_COLOR_TRANSFORM);
+          ctrafo->RGB2YCbCr(r,m_ppTempIBM,m_ppCTemp);
+        }
         
         // Now push the transformed data into either the downsampler, 
         // or the forward DCT block row.
@@ -377,7 +381,10 @@ void LineBitmapRequester::EncodeRegion(const RectAngle<LONG> &region)
             struct Line *row = Start8Lines(i);
             for(bx = blocks.ra_MinX;bx <= blocks.ra_MaxX;bx++) {
               LONG src[64]; // temporary buffer, the DCT requires a 8x8 block
-              m_ppDownsampler[i]->DownsampleRegion(bx,by,src);
+              {
+                StageTimer timer(m_pEnviron,JPGFLAG_STATS_DOWNSAMPLING);
+                m_ppDownsampler[i]->DownsampleRegion(bx,by,src);
+              }
               DefineRegion(bx,row,src,i);
             }
             m_ppDownsampler[i]->RemoveBlocks(by);
@@ -408,7 +415,10 @@ void LineBitmapRequester::EncodeRegion(const RectAngle<LONG> &region)
           ExtractBitmap(m_ppTempIBM[i],r,i);
         }
         
-        ctrafo->RGB2YCbCr(r,m_ppTempIBM,m_ppCTemp);
+        {
+          StageTimer timer(m_pEnviron,JPGFLAG_STATS_COLOR_TRANSFORM);
+          ctrafo->RGB2YCbCr(r,m_ppTempIBM,m_ppCTemp);
+        }
 
         for(i = 0;i < m_ucCount;i++) {
           DefineRegion(x,Start8Lines(i),m_ppCTemp[i],i);
@@ -434,7 +444,12 @@ void LineBitmapRequester::RequestUserDataForDecoding(class BitMapHook *bmh,RectA
   
   for(i = rr->rr_usFirstComponent;i <= rr->rr_usLastComponent;i++) {
     RequestUserData(bmh,region,i,alpha);
-    ULONG max = (BitmapOf(i).ibm_ulHeight >> 3) - 1;
+    ULONG height = BitmapOf(i).ibm_ulHeight;
+    // A bitmap that reaches the bottom of the image also takes the last
+    // block row, even if the image height is not divisible by eight.
+    if (m_ulPixelHeight > 0 && height >= m_ulPixelHeight)
+      height = (m_ulPixelHeight + 7) & -8;
+    ULONG max = (height >> 3) - 1;
     if (max < m_ulMaxMCU)
       m_ulMaxMCU = max;
   }
@@ -514,7 +529,10 @@ void LineBitmapRequester::ReconstructRegion(const RectAngle<LONG> &region,const
               if (m_ppUpsampler[i]) {
                 // Upsampled case, take from the upsampler, transform
                 // into the color buffer.
-                m_ppUpsampler[i]->UpsampleRegion(r,m_ppCTemp[i]);
+                {
+                  StageTimer timer(m_pEnviron,JPGFLAG_STATS_UPSAMPLING);
+                  m_ppUpsampler[i]->UpsampleRegion(r,m_ppCTemp[i]);
+                }
               } else {
                 FetchRegion(x,*m_pppImage[i],m_ppCTemp[i]);
               }
@@ -523,7 +541,10 @@ void LineBitmapRequester::ReconstructRegion(const RectAngle<LONG> &region,const
               memset(m_ppCTemp[i],0,sizeof(LONG) * 64);
             }
           }
-          ctrafo->YCbCr2RGB(r,m_ppTempIBM,m_ppCTemp,NULL);
+          {
+            StageTimer timer(m_pEnviron,JPGFLAG_STATS_COLOR_TRANSFORM);
+            ctrafo->YCbCr2RGB(r,m_ppTempIBM,m_ppCTemp,NULL);
+          }
         }
         //
         // Advance the quantized rows for the non-subsampled components,
@@ -567,7 +588,10 @@ void LineBitmapRequester::ReconstructRegion(const RectAngle<LONG> &region,const
         }
         //
         // Perform the color transformation now.
-        ctrafo->YCbCr2RGB(r,m_ppTempIBM,m_ppCTemp,NULL);
+        {
+          StageTimer timer(m_pEnviron,JPGFLAG_STATS_COLOR_TRANSFORM);
+          ctrafo->YCbCr2RGB(r,m_ppTempIBM,m_ppCTemp,NULL);
+        }
       } // of loop over x
       //
       // Advance the rows.
@@ -75,6 +75,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "colortrafo/colortrafo.hpp"
 #include "codestream/tables.hpp"
 #include "dct/dct.hpp"
+#include "tools/instrumentation.hpp"
 #include "std/string.hpp"
 ///
 
@@ -211,7 +212,10 @@ void ResidualBlockHelper::DequantizeResidual(const LONG *,LONG *target,const LON
   // Depending on the transformation type, either
   // run the DCT or just dequantize.
   if (m_pDCT[i]) {
-    m_pDCT[i]->InverseTransformBlock(target,residual,dcshift);
+    {
+      StageTimer timer(m_pEnviron,JPGFLAG_STATS_INVERSE_DCT);
+      m_pDCT[i]->InverseTransformBlock(target,residual,dcshift);
+    }
   } else {
     UWORD quant     = m_usQuantization[i];
     const LONG *res = residual; // the residual buffer.
@@ -449,7 +453,10 @@ void ResidualBlockHelper::QuantizeResidual(const LONG *legacy,LONG *residual,UBY
   //
   // Finally, DCT transform and quantize, or quantize directly.
   if (m_pDCT[i]) {
-    m_pDCT[i]->TransformBlock(residual,residual,rdcshift);
+    {
+      StageTimer timer(m_pEnviron,JPGFLAG_STATS_FORWARD_DCT);
+      m_pDCT[i]->TransformBlock(residual,residual,rdcshift);
+    }
     if (m_pResidualFrame->TablesOf()->Optimization()) {
       m_pResidualFrame->OptimizeDCTBlock(bx,by,i,m_pDCT[i],residual);
     }
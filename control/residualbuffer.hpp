@@ -147,7 +147,7 @@ public:
   // required after collecting the statistics for this scan.
   virtual void ResetToStartOfScan(class Scan *scan)
   {
-    m_pParent->ResetToStartOfScan(scan);
+    m_pParent->ResetToStartOfResidualScan(scan);
   }
 };
 ///
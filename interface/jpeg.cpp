@@ -76,8 +76,12 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "marker/frame.hpp"
 #include "marker/scan.hpp"
 #include "boxes/mergingspecbox.hpp"
+#include "boxes/outputconversionbox.hpp"
 #include "boxes/checksumbox.hpp"
+#include "boxes/filetypebox.hpp"
+#include "boxes/databox.hpp"
 #include "tools/checksum.hpp"
+#include "tools/instrumentation.hpp"
 #include "io/iostream.hpp"
 #include "std/assert.hpp"
 ///
@@ -120,7 +124,9 @@ void JPEG::doConstruct(class Environ *env)
   m_pImage             = NULL;
   m_pFrame             = NULL;
   m_pScan              = NULL;
+  m_pInstrumentation   = NULL;
   m_bRow               = false;
+  m_bEndOfScan         = false;
   m_bDecoding          = false;
   m_bEncoding          = false;
   m_bHeaderWritten     = false;
@@ -144,6 +150,12 @@ void JPEG::doDestruct(void)
   delete m_pIOStream;
   m_pIOStream = NULL;
 
+  if (m_pInstrumentation) {
+    m_pEnviron->SetInstrumentation(NULL);
+    delete m_pInstrumentation;
+    m_pInstrumentation = NULL;
+  }
+
   m_pEnviron = NULL; // Deleted elsewhere
 }
 ///
@@ -163,6 +175,12 @@ class JPEG *JPEG::Construct(struct JPG_TagItem *tags)
     env    = &(h_jpeg->m_Env);
     *env   = ev; // Copy the temporary environment over.
     h_jpeg->doConstruct(env);
+    //
+    // Install the instrumentation if requested.
+    if (tags && tags->GetTagData(JPGTAG_STATS_ENABLE)) {
+      h_jpeg->m_pInstrumentation = new(env) class Instrumentation();
+      env->SetInstrumentation(h_jpeg->m_pInstrumentation);
+    }
 
   } JPG_CATCH {
     if (h_jpeg) {
@@ -250,6 +268,33 @@ void JPEG::StopDecoding(void)
 }
 ///
 
+/// JPEG::isInputAvailable
+// For a suspending decoder, check whether the next marker segments or
+// the next MCU of the given scan are available. If not, indicate this
+// in the tags and return false.
+bool JPEG::isInputAvailable(class Scan *scan,struct JPG_TagItem *tags)
+{
+  bool avail;
+  
+  if (!m_pIOStream->isSuspendable())
+    return true;
+
+  if (scan) {
+    // Side channels are already completely buffered.
+    if (m_pImage->InputStreamOf(m_pIOStream) != m_pIOStream)
+      return true;
+    avail = m_pIOStream->Prefetch(scan->MaxMCUSizeOf());
+  } else {
+    avail = m_pDecoder->PrefetchMarkerSegments(m_pIOStream);
+  }
+
+  if (!avail)
+    tags->SetTagData(JPGTAG_DECODER_NEEDS_DATA,true);
+
+  return avail;
+}
+///
+
 /// JPEG::ReadInternal
 // Read a file. This takes all of the tags, class Decode takes.
 void JPEG::ReadInternal(struct JPG_TagItem *tags)
@@ -259,12 +304,16 @@ void JPEG::ReadInternal(struct JPG_TagItem *tags)
   if (m_pEncoder)
     JPG_THROW(OBJECT_EXISTS,"JPEG::ReadInternal","encoding in process, cannot start decoding");
 
+  tags->SetTagData(JPGTAG_DECODER_NEEDS_DATA,false);
+
   if (m_pDecoder == NULL) {
     m_pDecoder       = new(m_pEnviron) class Decoder(m_pEnviron);
+    m_pDecoder->ParseTags(tags);
     m_bDecoding      = true; 
     m_pFrame         = NULL;
     m_pScan          = NULL;
     m_bRow           = false;
+    m_bEndOfScan     = false;
     m_bEncoding      = false;
   }
 
@@ -285,6 +334,8 @@ void JPEG::ReadInternal(struct JPG_TagItem *tags)
     // Several iterations may be necessary to parse
     // off the header, each taking one marker of the
     // header.
+    if (!isInputAvailable(NULL,tags))
+      return;
     m_pImage = m_pDecoder->ParseHeaderIncremental(m_pIOStream);
     if (stopflags & JPGFLAG_DECODER_STOP_IMAGE)
       return;
@@ -294,6 +345,8 @@ void JPEG::ReadInternal(struct JPG_TagItem *tags)
 
   while(m_bDecoding) {
     if (m_pFrame == NULL) {
+      if (!isInputAvailable(NULL,tags))
+        return;
       m_pFrame = m_pImage->StartParseFrame(m_pIOStream);
       if (m_pFrame) {
         m_pDecoder->ParseTags(tags);
@@ -303,7 +356,26 @@ void JPEG::ReadInternal(struct JPG_TagItem *tags)
     }
 
     if (m_pFrame) {
+      if (m_bEndOfScan) {
+        // Scan done, advance to the next scan.
+        if (!isInputAvailable(NULL,tags))
+          return;
+        m_bEndOfScan = false;
+        if (!m_pFrame->ParseTrailer(m_pImage->InputStreamOf(m_pIOStream))) {
+          // Frame done, advance to the next frame.
+          m_pFrame = NULL;
+          if (!m_pImage->ParseTrailer(m_pIOStream)) {
+            // Image done, stop decoding, image is now loaded.
+            StopDecoding();
+            return;
+          }
+          continue;
+        }
+      }
+      
       while (m_pScan == NULL) {
+        if (!isInputAvailable(NULL,tags))
+          return;
         m_pScan = m_pFrame->StartParseScan(m_pImage->InputStreamOf(m_pIOStream),m_pImage->ChecksumOf());
         //
         if (m_pScan == NULL) {
@@ -332,31 +404,37 @@ void JPEG::ReadInternal(struct JPG_TagItem *tags)
 
       if (m_pScan) {
         if (m_bRow == false) {
-          m_bRow = m_pScan->StartMCURow();
+          {
+            // Starting a row parses restart markers and sets up the
+            // buffer rows, this is part of the MCU loop.
+            StageTimer timer(m_pEnviron,JPGFLAG_STATS_ENTROPY_DECODE);
+            m_bRow = m_pScan->StartMCURow();
+          }
           if (m_bRow) {
             if (stopflags & JPGFLAG_DECODER_STOP_ROW)
               return;
           } else {
-            // Scan done, advance to the next scan.
+            // Scan done, the trailer is parsed on the next iteration.
             m_pFrame->EndParseScan();
-            m_pScan = NULL;
-            if (!m_pFrame->ParseTrailer(m_pImage->InputStreamOf(m_pIOStream))) {
-              // Frame done, advance to the next frame.
-              m_pFrame = NULL;
-              if (!m_pImage->ParseTrailer(m_pIOStream)) {
-                // Image done, stop decoding, image is now loaded.
-                StopDecoding();
-                return;
-              }
-            }
+            m_pScan      = NULL;
+            m_bEndOfScan = true;
           }
         }
         
         if (m_bRow) {
-          while (m_pScan->ParseMCU()) {
-            if (stopflags & JPGFLAG_DECODER_STOP_MCU)
-              return;
-          } 
+          if ((stopflags & JPGFLAG_DECODER_STOP_MCU) == 0 && !m_pIOStream->isSuspendable()) {
+            // Nothing to check between the MCUs, parse the row at once.
+            m_pScan->ParseMCURow();
+          } else {
+            bool more;
+            do {
+              if (!isInputAvailable(m_pScan,tags))
+                return;
+              more = m_pScan->ParseMCU();
+              if (more && (stopflags & JPGFLAG_DECODER_STOP_MCU))
+                return;
+            } while(more);
+          }
           m_bRow = false;
         }
       }
@@ -386,6 +464,7 @@ JPG_LONG JPEG::Write(struct JPG_TagItem *tags)
 void JPEG::WriteInternal(struct JPG_TagItem *tags)
 { 
   LONG stopflags = tags->GetTagData(JPGTAG_ENCODER_STOP);
+  LONG threads   = tags->GetTagData(JPGTAG_ENCODER_THREADS,1);
 
   if (m_pDecoder)
     JPG_THROW(OBJECT_EXISTS,"JPEG::WriteInternal","decoding in process, cannot start encoding");
@@ -429,6 +508,14 @@ void JPEG::WriteInternal(struct JPG_TagItem *tags)
 
   assert(m_pImage);
 
+  if (m_pImage->isStreaming()) {
+    // The scans have been written while the image was provided.
+    // Only the buffered data remains to be written.
+    m_pImage->WriteStreamedImage(m_pIOStream);
+    m_pIOStream->Flush();
+    m_bEncoding = false;
+    return;
+  }
 
   if (!m_bOptimized) {
     // Run the R/D optimization over the DC part if we have not yet
@@ -474,6 +561,12 @@ void JPEG::WriteInternal(struct JPG_TagItem *tags)
       m_pScan = m_pFrame->StartWriteScan(m_pImage->OutputStreamOf(m_pIOStream),m_pImage->ChecksumOf());
       if (stopflags & JPGFLAG_ENCODER_STOP_SCAN)
         return;
+      //
+      // Code the restart intervals of the scan concurrently if requested
+      // and the caller does not want to regain control within the scan.
+      // Scans that cannot be written this way remain untouched.
+      if (threads > 1 && (stopflags & (JPGFLAG_ENCODER_STOP_ROW | JPGFLAG_ENCODER_STOP_MCU)) == 0)
+        m_pScan->WriteRestartIntervals(threads);
     }
     assert(m_pScan);
 
@@ -723,13 +816,18 @@ void JPEG::InternalDisplayRectangle(struct JPG_TagItem *tags)
 {
   class BitMapHook bmh(tags);
   struct RectangleRequest rr;
+  RectAngle<LONG> updated;
   
   if (m_pImage == NULL)
     JPG_THROW(OBJECT_DOESNT_EXIST,"JPEG::InternalDisplayRectangle","no image loaded that could be displayed");
 
 
   rr.ParseTags(tags,m_pImage);
-  m_pImage->ReconstructRegion(&bmh,&rr);
+  m_pImage->ReconstructRegion(&bmh,&rr,updated);
+  //
+  // Tell the caller which lines have been written.
+  tags->SetTagData(JPGTAG_DECODER_UPDATE_MINY,updated.ra_MinY);
+  tags->SetTagData(JPGTAG_DECODER_UPDATE_MAXY,updated.ra_MaxY);
 }
 ///
 
@@ -801,6 +899,7 @@ void JPEG::InternalProvideImage(struct JPG_TagItem *tags)
     m_pFrame             = NULL;
     m_pScan              = NULL;
     m_bRow               = false;
+    m_bEndOfScan         = false;
     m_bDecoding          = false;
     m_bEncoding          = false;
     m_bHeaderWritten     = false;
@@ -817,17 +916,223 @@ void JPEG::InternalProvideImage(struct JPG_TagItem *tags)
     m_bOptimizeHuffman   = RequiresTwoPassEncoding(tags);
     m_bOptimizeQuantizer = tags->GetTagData(JPGTAG_OPTIMIZE_QUANTIZER,false)?true:false;
     m_pImage             = m_pEncoder->CreateImage(tags);
+    //
+    // Write the image while it comes in? This requires that the
+    // image data is never looked at twice.
+    if (tags->GetTagData(JPGTAG_ENCODER_STREAM)) {
+      if (m_bOptimizeHuffman || m_bOptimizeQuantizer)
+        JPG_THROW(INVALID_PARAMETER,"JPEG::InternalProvideImage",
+                  "streaming cannot be combined with Huffman or quantizer optimization");
+      m_pImage->StartStreaming();
+    }
   }
   
   do {
     rr.ParseTags(tags,m_pImage);
     m_pImage->EncodeRegion(&bmh,&rr);
+    if (m_pImage->isStreaming())
+      m_pImage->StreamCompletedRows();
   } while(!m_pImage->isImageComplete() && loop);
   
   tags->SetTagData(JPGTAG_ENCODER_IMAGE_COMPLETE,m_pImage->isImageComplete());
 }
 ///
 
+/// JPEG::Probe
+// Probe the size bytes of a codestream in memory for the image dimensions,
+// depth, precision and frame type, the restart interval and the JPEG XT
+// profile, and fill them into the tags. This only scans the markers up to
+// the first scan and neither requires a JPEG object nor allocates memory.
+// The precision includes the bits the residual codestream adds to the
+// legacy codestream.
+JPG_LONG JPEG::Probe(const void *buffer,JPG_LONG size,struct JPG_TagItem *tags)
+{
+  const UBYTE *data = (const UBYTE *)buffer;
+  const UBYTE *end;
+  ULONG width       = 0;
+  ULONG height      = 0;
+  UWORD depth       = 0;
+  UBYTE precision   = 0;
+  LONG  frametype   = -1;
+  LONG  restart     = 0;
+  ULONG profile     = 0;
+  UBYTE extrabits   = 0;     // bits on top of the legacy precision.
+  bool  dimensions  = false; // set if the dimensions come from a DHP marker.
+  bool  residual    = false;
+  bool  scan        = false;
+
+  if (data == NULL || size < 4 || data[0] != 0xff || data[1] != 0xd8)
+    return JPG_FALSE;
+
+  end   = data + size;
+  data += 2;
+  //
+  // Run over the marker segments up to the first scan. A segment that
+  // exceeds the buffer also ends the search, but as the segments up to
+  // the scan may still change the result, this fails then.
+  while(!scan && end - data >= 4) {
+    const UBYTE *segment;
+    ULONG length;
+    UBYTE marker;
+    //
+    if (data[0] != 0xff)
+      break;
+    marker = data[1];
+    if (marker == 0xff) {
+      data++; // A filler byte.
+      continue;
+    }
+    if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd8)) {
+      data += 2; // TEM, RSTn and SOI do not have a length field.
+      continue;
+    }
+    if (marker == 0xd9) // EOI
+      break;
+    length  = (data[2] << 8) | data[3];
+    segment = data + 4;
+    if (length < 2 || ULONG(end - segment) < length - 2)
+      break;
+    length -= 2;
+    //
+    switch(marker) {
+    case 0xc0:
+    case 0xc1:
+    case 0xc2:
+    case 0xc3:
+    case 0xc5:
+    case 0xc6:
+    case 0xc7:
+    case 0xc9:
+    case 0xca:
+    case 0xcb:
+    case 0xcd:
+    case 0xce:
+    case 0xcf:
+    case 0xf7: // all start of frame markers, including JPEG LS.
+    case 0xde: // DHP, which defines the dimensions of a hierarchical image.
+      if (length < 6)
+        return JPG_FALSE;
+      if (!dimensions) {
+        precision = segment[0];
+        height    = (segment[1] << 8) | segment[2];
+        width     = (segment[3] << 8) | segment[4];
+        depth     = segment[5];
+      }
+      if (marker == 0xde) {
+        dimensions = true;
+      } else if (frametype < 0) {
+        switch(marker & 0x03) {
+        case 0x00:
+          frametype = (marker == 0xc0)?(JPGFLAG_BASELINE):(JPGFLAG_SEQUENTIAL);
+          break;
+        case 0x01:
+          frametype = JPGFLAG_SEQUENTIAL;
+          break;
+        case 0x02:
+          frametype = JPGFLAG_PROGRESSIVE;
+          break;
+        case 0x03:
+          frametype = (marker == 0xf7)?(JPGFLAG_JPEG_LS):(JPGFLAG_LOSSLESS);
+          break;
+        }
+        if (marker >= 0xc8 && marker != 0xf7)
+          frametype |= JPGFLAG_ARITHMETIC;
+      }
+      break;
+    case 0xdd: // DRI
+      if (length >= 2)
+        restart = (segment[0] << 8) | segment[1];
+      break;
+    case 0xeb: // APP11: Maybe a box.
+      // CI, En, Z, LBox and TBox must be present.
+      if (length >= 2 + 2 + 4 + 4 + 4 && segment[0] == 0x4a && segment[1] == 0x50) {
+        ULONG z       = (segment[4]  << 24) | (segment[5]  << 16) | (segment[6]  << 8) | segment[7];
+        ULONG lbox    = (segment[8]  << 24) | (segment[9]  << 16) | (segment[10] << 8) | segment[11];
+        ULONG tbox    = (segment[12] << 24) | (segment[13] << 16) | (segment[14] << 8) | segment[15];
+        const UBYTE *payload = segment + 16;
+        ULONG bytes   = length - 16;
+        //
+        // Skip the XLBox field if present.
+        if (lbox == 1) {
+          payload += (bytes >= 8)?(8):(bytes);
+          bytes   -= (bytes >= 8)?(8):(bytes);
+        }
+        switch(tbox) {
+        case FileTypeBox::Type:
+          // The compatibility list follows brand and minor version. Only
+          // the first packet of the box is considered, the first XT profile
+          // found is reported.
+          if (z == 1 && bytes >= 4 + 4) {
+            for(payload += 8,bytes -= 8;bytes >= 4 && profile == 0;payload += 4,bytes -= 4) {
+              ULONG compat = (payload[0] << 24) | (payload[1] << 16) | (payload[2] << 8) | payload[3];
+              switch(compat) {
+              case FileTypeBox::XT_IDR:
+              case FileTypeBox::XT_HDR_A:
+              case FileTypeBox::XT_HDR_B:
+              case FileTypeBox::XT_HDR_C:
+              case FileTypeBox::XT_HDR_D:
+              case FileTypeBox::XT_LS:
+                profile = compat;
+                break;
+              }
+            }
+          }
+          break;
+        case MergingSpecBox::SpecType:
+          // The output conversion box within defines the number of bits
+          // the residual adds to the precision of the legacy codestream.
+          if (z == 1) {
+            while(bytes >= 4 + 4) {
+              ULONG sublbox = (payload[0] << 24) | (payload[1] << 16) | (payload[2] << 8) | payload[3];
+              ULONG subtbox = (payload[4] << 24) | (payload[5] << 16) | (payload[6] << 8) | payload[7];
+              if (sublbox < 4 + 4 || sublbox > bytes)
+                break;
+              if (subtbox == OutputConversionBox::Type) {
+                if (sublbox > 4 + 4)
+                  extrabits = payload[8] >> 4;
+                break;
+              }
+              payload += sublbox;
+              bytes   -= sublbox;
+            }
+          }
+          break;
+        case DataBox::ResidualType:
+        case DataBox::ResidualRefinementType:
+          residual = true;
+          break;
+        }
+      }
+      break;
+    case 0xda: // SOS
+      scan = true;
+      break;
+    }
+    data = segment + length;
+  }
+  //
+  if (frametype < 0 || !scan)
+    return JPG_FALSE;
+
+  if (dimensions)
+    frametype |= JPGFLAG_PYRAMIDAL;
+  if (residual)
+    frametype |= JPGFLAG_RESIDUAL_CODING;
+
+  if (tags) {
+    tags->SetTagData(JPGTAG_IMAGE_WIDTH ,width);
+    tags->SetTagData(JPGTAG_IMAGE_HEIGHT,height);
+    tags->SetTagData(JPGTAG_IMAGE_DEPTH ,depth);
+    tags->SetTagData(JPGTAG_IMAGE_PRECISION,precision + extrabits);
+    tags->SetTagData(JPGTAG_IMAGE_FRAMETYPE,frametype);
+    tags->SetTagData(JPGTAG_IMAGE_RESTART_INTERVAL,restart);
+    tags->SetTagData(JPGTAG_PROFILE,profile);
+  }
+
+  return JPG_TRUE;
+}
+///
+
 /// JPEG::GetInformation
 // Request information from the JPEG object.
 JPG_LONG JPEG::GetInformation(struct JPG_TagItem *tags)
@@ -881,6 +1186,13 @@ void JPEG::InternalGetInformation(struct JPG_TagItem *tags)
   struct JPG_TagItem *alphatag  = tags->FindTagItem(JPGTAG_ALPHA_MODE);
   struct JPG_TagItem *alphalist = tags->FindTagItem(JPGTAG_ALPHA_TAGLIST);
 
+  //
+  // The statistics are filled in before the image is checked. Without
+  // an image, the call still fails, but the JPGTAG_STATS tags are valid
+  // nevertheless.
+  if (m_pInstrumentation)
+    m_pInstrumentation->GetInformation(tags);
+
   if (m_pImage == NULL)
     JPG_THROW(OBJECT_DOESNT_EXIST,"JPEG::InternalGetInformation","no image loaded to request information from");
 
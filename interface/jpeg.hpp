@@ -77,11 +77,19 @@ class IOStream;
 class Image;
 class Frame;
 class Scan;
+class Instrumentation;
 ///
 
 /// Class JPEG
 // This is the main entry class for the JPEG encoder and decoder.
 // It is basically a pimpl for the actual codec.
+// The library does not keep any mutable global state except for a cache
+// of lookup tables that is locked internally, or disabled if the platform
+// does not provide POSIX threads: Each JPEG object carries
+// its own environment, memory management and exception stack.
+// Hence, independent JPEG objects may be used concurrently from different
+// threads without locking, provided the supplied hooks are thread-safe.
+// A single object must not be used by more than one thread at a time.
 class JPEG {
   friend struct JPEG_Helper;
   //
@@ -115,9 +123,15 @@ class JPEG {
   // Currently active scan, to be read or to be written.
   class Scan   *m_pScan;
   //
+  // Per-stage timings and counters, if enabled on construction.
+  class Instrumentation *m_pInstrumentation;
+  //
   // Currently in parsing an MCU row?
   bool          m_bRow;
   //
+  // Scan completed, but the frame trailer not yet parsed?
+  bool          m_bEndOfScan;
+  //
   // Currently decoding active?
   bool          m_bDecoding;
   //
@@ -164,6 +178,11 @@ class JPEG {
   // Stop decoding, then return. Also tests the checksum if there is one.
   void StopDecoding(void);
   //
+  // For a suspending decoder, check whether the next marker segments or
+  // the next MCU of the given scan are available. If not, indicate this
+  // in the tags and return false.
+  bool isInputAvailable(class Scan *scan,struct JPG_TagItem *tags);
+  //
   // Check whether any of the scans is optimized Huffman and thus requires a two-pass
   // go over the data.
   bool RequiresTwoPassEncoding(const struct JPG_TagItem *tags) const;
@@ -208,6 +227,17 @@ public:
   // Request information from the JPEG object.
   JPG_LONG GetInformation(struct JPG_TagItem *);
   //
+  // Probe the size bytes of a codestream in memory for the image dimensions,
+  // depth, precision and frame type, the restart interval and the JPEG XT
+  // profile, and fill them into the tags. This only scans the markers up to
+  // the first scan and neither requires a JPEG object nor allocates memory.
+  // The presence of a residual codestream is indicated by the
+  // JPGFLAG_RESIDUAL_CODING bit of the frame type, and the precision is
+  // that of the reconstructed image, as GetInformation() reports it.
+  // Returns JPG_FALSE if the buffer does not contain a frame header, or
+  // ends before the first scan, as the markers up to there are required.
+  static JPG_LONG Probe(const void *buffer,JPG_LONG size,struct JPG_TagItem *tags);
+  //
   // In case reading was interrupted by a JPGTAG_DECODER_STOP mask
   // at some point in the codestream, this call returns the next
   // 16 bits at the current stop position without removing them
@@ -939,6 +939,13 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // This passes the offset, i.e. how many bytes should be skipped
 // or seek'd.
 #define JPGTAG_FIO_OFFSET   (JPGTAG_FIO_BASE + 6)
+
+// On reading, a hook that cannot deliver data yet, but will later,
+// sets the data of this tag to TRUE and returns zero bytes. This
+// distinguishes a stream that is still arriving from the end of
+// the stream. It is only honoured if the decoder is allowed to
+// suspend, see JPGTAG_DECODER_SUSPEND.
+#define JPGTAG_FIO_PENDING  (JPGTAG_FIO_BASE + 8)
 ///
 /// Parameters for passing the various hooks to the library
 #define JPGTAG_HOOK_BASE       (JPGTAG_TAG_USER + 0xb00)
@@ -1067,6 +1074,54 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define JPGFLAG_DECODER_STOP_FRAME  0x08
 // Stop after the header
 #define JPGFLAG_DECODER_STOP_IMAGE  0x10
+//
+// If set, the decoder does not block on input that is not yet available.
+// Instead, Read() returns as soon as the IO hook signals a pending read
+// with JPGTAG_FIO_PENDING, and sets the following tag to TRUE. Decoding
+// then continues at the same MCU on the next call of Read(). In this
+// mode, the IO hook is never asked to seek and a user-supplied buffer
+// is not used.
+#define JPGTAG_DECODER_SUSPEND          (JPGTAG_DECODER_BASE + 0x21)
+//
+// Returned by Read(): TRUE if the decoder suspended because the
+// IO hook had no data yet. The call should be repeated when more
+// data has arrived.
+#define JPGTAG_DECODER_NEEDS_DATA       (JPGTAG_DECODER_BASE + 0x22)
+//
+// If set to TRUE for DisplayRectangle(), only the blocks altered by the
+// scans parsed since the last update are reconstructed and written into
+// the bitmap, which is thus expected to keep the image delivered by the
+// previous update. A request that starts at the top of the image begins
+// a new update. This allows refreshing the display of a progressive
+// image after each scan. Frame types that cannot track alterations
+// reconstruct the full rectangle.
+#define JPGTAG_DECODER_UPDATE           (JPGTAG_DECODER_BASE + 0x23)
+//
+// Returned by DisplayRectangle(): the first and the last pixel line
+// written into the bitmap. If no line was written, the maximum is
+// smaller than the minimum.
+#define JPGTAG_DECODER_UPDATE_MINY      (JPGTAG_DECODER_BASE + 0x24)
+#define JPGTAG_DECODER_UPDATE_MAXY      (JPGTAG_DECODER_BASE + 0x25)
+//
+// If set to TRUE for the first call of Read(), all APP11 marker
+// segments are skipped without looking into the boxes, and only the
+// legacy codestream is decoded. Residual, refinement and alpha layers,
+// tone mapping and merging specifications are then ignored, and the
+// image is reconstructed as a legacy JPEG decoder would, at the cost
+// of such a decoder.
+#define JPGTAG_DECODER_LEGACY_ONLY      (JPGTAG_DECODER_BASE + 0x26)
+//
+// If set to TRUE for DisplayRectangle(), the reconstructed base layer
+// and the residual, i.e. the input of the final color transformation,
+// are kept for all blocks written. Once the full image has been kept,
+// all further calls of DisplayRectangle() only run the color
+// transformation, skipping the inverse DCT, upsampling and residual
+// reconstruction, until more data is read. The bitmap type may change
+// between the calls, but the tone mapping and the output conversion
+// cannot: They are defined by the codestream, and each call merges the
+// kept planes with the same parameters. This requires memory for the
+// full image.
+#define JPGTAG_DECODER_RETAIN           (JPGTAG_DECODER_BASE + 0x27)
 ///
 
 /// Parameters for the encoder
@@ -1097,6 +1152,33 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // Define this to automatically loop in provide image when the image is not
 // yet complete
 #define JPGTAG_ENCODER_LOOP_ON_INCOMPLETE (JPGTAG_ENCODER_BASE + 0x02)
+//
+// If set on the first call of ProvideImage, the image is entropy coded
+// while it is provided, and its quantized data is released as soon as
+// it is written. Only the compressed data remains buffered until Write,
+// as the layout of the codestream requires. This is available for images
+// with a residual image that consist of a single sequential scan, and
+// it cannot be combined with optimized Huffman tables or quantizers.
+#define JPGTAG_ENCODER_STREAM (JPGTAG_ENCODER_BASE + 0x03)
+//
+// If set on Write to a number larger than one, the restart intervals of
+// sequential and progressive Huffman scans are entropy coded concurrently
+// on up to this many threads, and their data is concatenated in order.
+// This requires a restart interval (JPGTAG_IMAGE_RESTART_INTERVAL) and
+// a build with multithreading support, otherwise the scans are written
+// by the calling thread alone.
+// If set on ProvideImage, the color transformation, forward DCT and
+// quantization of the image data delivered by the bitmap hook is run on
+// up to this many threads. This applies to images without subsampling,
+// residual coding, deringing or R/D optimization.
+// If larger than one, the worker threads allocate and release memory,
+// and report warnings and errors, through copies of the environment of
+// the JPEG object, i.e. the allocation, release, exception and warning
+// hooks are then called concurrently from several threads and must be
+// thread-safe. The bitmap and IO hooks are called from the calling
+// thread only, though the workers read the memory the bitmap hook
+// returned concurrently, so it must stay valid until the call returns.
+#define JPGTAG_ENCODER_THREADS (JPGTAG_ENCODER_BASE + 0x04)
 ///
 
 /// Exception related hooks
@@ -1141,6 +1223,64 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // multiple warnings of the same origin.
 #define JPGTAG_EXC_SUPPRESS_IDENTICAL (JPGTAG_EXCEPTION_BASE + 0x30)
 ///
+/// Instrumentation
+// The following tags enable and query the per-stage instrumentation
+// of the codec.
+#define JPGTAG_STATS_BASE (JPGTAG_TAG_USER + 0x2200)
+//
+// If this tag is set to true on construction of the library, the
+// JPEG object keeps track of the time spent in its processing stages
+// and the number of bytes transferred over the IO hook. This costs
+// some performance and is disabled by default. The counters are then
+// returned by JPEG::GetInformation in the tags below.
+#define JPGTAG_STATS_ENABLE (JPGTAG_STATS_BASE + 0x01)
+//
+// If this tag is set to true in the tag list of JPEG::GetInformation,
+// all counters are reset to zero after they have been reported.
+#define JPGTAG_STATS_RESET (JPGTAG_STATS_BASE + 0x02)
+//
+// The number of bytes read from and written to the IO hook.
+#define JPGTAG_STATS_BYTES_READ (JPGTAG_STATS_BASE + 0x03)
+#define JPGTAG_STATS_BYTES_WRITTEN (JPGTAG_STATS_BASE + 0x04)
+//
+// The number of memory allocations made by the JPEG object, either
+// through the allocation hook or the system allocator.
+#define JPGTAG_STATS_ALLOCATIONS (JPGTAG_STATS_BASE + 0x05)
+//
+// The cumulative time in microseconds spent in stage n, and the number
+// of times the stage has been entered. Values that do not fit into the
+// tag data saturate.
+#define JPGTAG_STATS_TIME(n) (JPGTAG_STATS_BASE + 0x10 + (n))
+#define JPGTAG_STATS_COUNT(n) (JPGTAG_STATS_BASE + 0x20 + (n))
+//
+// The number of memory allocations made while stage n was active.
+// Once the height of a frame is known, all its buffers are allocated
+// before the first MCU is parsed, thus this is zero for entropy
+// decoding. Counts are only exact for single-threaded operation.
+#define JPGTAG_STATS_ALLOCATIONS_IN(n) (JPGTAG_STATS_BASE + 0x30 + (n))
+//
+// The stages that are measured.
+//
+// Entropy decoding of MCUs, including reading from the IO hook.
+#define JPGFLAG_STATS_ENTROPY_DECODE 0
+// Entropy encoding of MCUs, including writing to the IO hook.
+#define JPGFLAG_STATS_ENTROPY_ENCODE 1
+// The forward DCT and quantization.
+#define JPGFLAG_STATS_FORWARD_DCT 2
+// Dequantization and the inverse DCT.
+#define JPGFLAG_STATS_INVERSE_DCT 3
+// Upsampling of subsampled components on decoding.
+#define JPGFLAG_STATS_UPSAMPLING 4
+// Downsampling of components on encoding.
+#define JPGFLAG_STATS_DOWNSAMPLING 5
+// The color transformation in either direction.
+#define JPGFLAG_STATS_COLOR_TRANSFORM 6
+// The time spent in the user supplied bitmap hook.
+#define JPGFLAG_STATS_BITMAP_HOOK 7
+// The number of stages.
+#define JPGFLAG_STATS_STAGES 8
+///
+
 /// Application Program Base
 // If your application needs to use custom tags that are passed to the
 // libjpeg, you have to make sure that the libjpeg does not use and will
@@ -74,9 +74,16 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 template<bool bitstuffing>
 class BitStream : public JObject {
   //
-  // The bit-buffer for output.
+  // The bit-buffer for output if bitstuffing.
   UBYTE m_ucB;
   //
+  // The bit-buffer for output on bytestuffing. Bits are shifted in from
+  // the right and written out eight bytes at once.
+  UQUAD m_uqB;
+  //
+  // Number of bits still free in the above accumulator.
+  UBYTE m_ucFree;
+  //
   // The bit-buffer for input.
   ULONG m_ulB;
   //
@@ -106,6 +113,70 @@ class BitStream : public JObject {
   // the error flag.
   void ReportError(void) NORETURN;
   //
+  // Write a single byte of output, including the stuffing of a zero byte
+  // behind a 0xff.
+  void WriteByte(UBYTE b)
+  {
+    m_pIO->Put(b);
+    if (m_pChk)
+      m_pChk->Update(b);
+    if (b == 0xff) {   // stuffing case? 
+      m_pIO->Put(0x00);  // stuff a zero byte
+      if (m_pChk)
+        m_pChk->Update(0x00);
+    }
+  }
+  //
+  // Write a full accumulator of output. Unless one of its bytes is
+  // a 0xff and requires stuffing, all bytes go out at once.
+  void WriteQuad(UQUAD q)
+  {
+    const UQUAD ones = (UQUAD(0x01010101) << 32) | 0x01010101;
+    UQUAD t          = ~q;
+    int i;
+    //
+    // The following is non-zero if and only if any byte of t is zero,
+    // i.e. any byte of q is 0xff.
+    if (likely(((t - ones) & ~t & (ones << 7)) == 0)) {
+      m_pIO->PutQuad(q);
+      if (m_pChk) {
+        for(i = 56;i >= 0;i -= 8)
+          m_pChk->Update(UBYTE(q >> i));
+      }
+    } else {
+      for(i = 56;i >= 0;i -= 8)
+        WriteByte(UBYTE(q >> i));
+    }
+  }
+  //
+  // Put "n" bits into the stream if bitstuffing is enabled. This
+  // works bytewise as the stuffing does not allow any shortcuts.
+  void PutStuffed(UBYTE n,ULONG bitbuffer)
+  {
+    // Do we want to output more bits than
+    // there is room in the buffer?
+    while(n > m_ucBits) {
+      // If so, output all bits we can.
+      n          -= m_ucBits;   // that many bits go away
+      m_ucB |= (bitbuffer>>n) & ((1<<m_ucBits)-1); // place them into buffer
+      // m_ucBits = 0; // superfluous: We've now zero bits space left. 
+      m_pIO->Put(m_ucB);
+      if (m_pChk)
+        m_pChk->Update(m_ucB);
+      m_ucBits = 8;
+      if (m_ucB == 0xff) {  // byte stuffing case?
+        m_ucBits = 7;
+      }
+      m_ucB = 0;
+    }
+
+    // Now, we've more bits space left than we want to put.
+    // This is the easy case:
+    // Here, n <= m_ucBits.
+    m_ucBits   -= n;  // that many bits space left
+    m_ucB |= (bitbuffer & ((1<<n)-1)) << m_ucBits;
+  }
+  //
 public:
   BitStream()
   {
@@ -132,6 +203,8 @@ public:
     m_pChk       = chk;
     m_ucB        = 0;
     m_ucBits     = 8;
+    m_uqB        = 0;
+    m_ucFree     = 64;
     m_bMarker    = false;
     m_bEOF       = false;
   }
@@ -223,29 +296,40 @@ public:
   // coding to ensure that all bits are written out.
   void Flush(void)
   {
-    if (m_ucBits < 8) {
+    if (bitstuffing) {
+      if (m_ucBits < 8) {
+        m_pIO->Put(m_ucB);
+        if (m_pChk)
+          m_pChk->Update(m_ucB);
+        m_ucBits = 8;
+        if (m_ucB == 0xff) {   // stuffing case? 
+          m_pIO->Put(0x00);    // stuff a zero byte
+          if (m_pChk)
+            m_pChk->Update(0x00);
+          // Note that this must also happen if we are bitstuffing to avoid a pseudo-0xffff
+          // marker (JPEG 2000 could have dropped the 0xff here, but we can't).
+          // Actually, such markers are allowable, or rather might be, but
+          // be conservative and avoid writing them.
+        }
+        m_ucB = 0;
+      }
+    } else if (m_ucFree < 64) {
+      UBYTE bits = 64 - m_ucFree;
+      UBYTE fill = (8 - (bits & 7)) & 7;
       // The standard suggests (in an informative note) to fill in
       // remaining bits by 1's, which interestingly creates the likelyhood
       // of a bitstuffing case. Interestingly, the standard also says that
       // a 0xff in front of a marker is a "fill byte" that may be dropped.
       // Conclusion is that we may have a 0xff just in front of a marker without
       // the byte stuffing. Wierd.
-      if (!bitstuffing)
-        m_ucB   |= (1 << m_ucBits) - 1;
-      m_pIO->Put(m_ucB);
-      if (m_pChk)
-        m_pChk->Update(m_ucB);
-      m_ucBits = 8;
-      if (m_ucB == 0xff) {   // stuffing case? 
-        m_pIO->Put(0x00);    // stuff a zero byte
-        if (m_pChk)
-          m_pChk->Update(0x00);
-        // Note that this must also happen if we are bitstuffing to avoid a pseudo-0xffff
-        // marker (JPEG 2000 could have dropped the 0xff here, but we can't).
-        // Actually, such markers are allowable, or rather might be, but
-        // be conservative and avoid writing them.
-      }
-      m_ucB = 0;
+      m_uqB     = (m_uqB << fill) | ((1 << fill) - 1);
+      bits     += fill;
+      do {
+        bits   -= 8;
+        WriteByte(UBYTE(m_uqB >> bits));
+      } while(bits);
+      m_uqB     = 0;
+      m_ucFree  = 64;
     }
   }
   //
@@ -270,72 +354,33 @@ public:
   template<int count>
   void Put(ULONG bitbuffer)
   { 
-    int n = count;
-    assert(n > 0 && n <= 32);
-    
-    // Do we want to output more bits than
-    // there is room in the buffer?
-    while(n > m_ucBits) {
-      // If so, output all bits we can.
-      n     -= m_ucBits;   // that many bits go away
-      m_ucB |= (bitbuffer>>n) & ((1<<m_ucBits)-1); // place them into buffer
-      // m_ucBits = 0; // superfluous: We've now zero bits space left. 
-      m_pIO->Put(m_ucB);
-      if (m_pChk)
-        m_pChk->Update(m_ucB);
-      m_ucBits = 8;
-      if (m_ucB == 0xff) {  // byte stuffing case?
-        if (bitstuffing) {
-          m_ucBits = 7;
-        } else {
-          m_pIO->Put(0x00);    // stuff a zero byte
-          if (m_pChk)
-            m_pChk->Update(0x00);
-        }
-      }
-      m_ucB = 0;
-    }
-
-    // Now, we've more bits space left than we want to put.
-    // This is the easy case:
-    // Here, n <= m_ucBits.
-    m_ucBits   -= n;  // that many bits space left
-    m_ucB |= (bitbuffer & ((1<<n)-1)) << m_ucBits;
+    Put(count,bitbuffer);
   }
   //
   // Put "n" bits into the stream.
   void Put(UBYTE n,ULONG bitbuffer)
   {
     assert(n > 0 && n <= 32);
-    
-    // Do we want to output more bits than
-    // there is room in the buffer?
-    while(n > m_ucBits) {
-      // If so, output all bits we can.
-      n          -= m_ucBits;   // that many bits go away
-      m_ucB |= (bitbuffer>>n) & ((1<<m_ucBits)-1); // place them into buffer
-      // m_ucBits = 0; // superfluous: We've now zero bits space left. 
-      m_pIO->Put(m_ucB);
-      if (m_pChk)
-        m_pChk->Update(m_ucB);
-      m_ucBits = 8;
-      if (m_ucB == 0xff) {  // byte stuffing case?
-        if (bitstuffing) {
-          m_ucBits = 7;
-        } else {
-          m_pIO->Put(0x00);    // stuff a zero byte
-          if (m_pChk)
-            m_pChk->Update(0x00);
-        }
+
+    if (bitstuffing) {
+      PutStuffed(n,bitbuffer);
+    } else {
+      UQUAD bits = bitbuffer & ((UQUAD(1) << n) - 1);
+      //
+      // The accumulator always has at least one free bit, hence the
+      // shifts below never cover its full width.
+      if (likely(n < m_ucFree)) {
+        m_uqB     = (m_uqB << n) | bits;
+        m_ucFree -= n;
+      } else {
+        UBYTE rest = n - m_ucFree;
+        // Fill the accumulator up, write it and keep the rest. Bits
+        // above the rest are shifted out before the next write.
+        WriteQuad((m_uqB << m_ucFree) | (bits >> rest));
+        m_uqB      = bits;
+        m_ucFree   = 64 - rest;
       }
-      m_ucB = 0;
     }
-
-    // Now, we've more bits space left than we want to put.
-    // This is the easy case:
-    // Here, n <= m_ucBits.
-    m_ucBits   -= n;  // that many bits space left
-    m_ucB |= (bitbuffer & ((1<<n)-1)) << m_ucBits;
   }
 };
 ///
@@ -134,10 +134,6 @@ protected:
   // this class.
   virtual void Flush(void) = 0;
   //
-#if CHECK_LEVEL > 2
-  static UBYTE lastbyte;
-#endif
-  //
 public: 
   //
   // A couple of definitions
@@ -227,6 +223,25 @@ public:
     Put(word & 0xff);
   }
   //
+  // Put eight bytes at once over the stream, most significant byte first.
+  void PutQuad(UQUAD quad)
+  {
+    if (likely(m_pucBufEnd - m_pucBufPtr >= 8)) {
+      m_pucBufPtr[0] = UBYTE(quad >> 56);
+      m_pucBufPtr[1] = UBYTE(quad >> 48);
+      m_pucBufPtr[2] = UBYTE(quad >> 40);
+      m_pucBufPtr[3] = UBYTE(quad >> 32);
+      m_pucBufPtr[4] = UBYTE(quad >> 24);
+      m_pucBufPtr[5] = UBYTE(quad >> 16);
+      m_pucBufPtr[6] = UBYTE(quad >>  8);
+      m_pucBufPtr[7] = UBYTE(quad);
+      m_pucBufPtr   += 8;
+    } else {
+      for(int i = 56;i >= 0;i -= 8)
+        Put(UBYTE(quad >> i));
+    }
+  }
+  //
   // Return the last byte that has been read from or put into the buffer.
   // If the last byte is not available, return EOF.
   // Note that the ArthDeco/MQ coder requires this behaivour as in this
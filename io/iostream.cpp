@@ -66,6 +66,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "interface/parameters.hpp"
 #include "interface/tagitem.hpp"
 #include "tools/debug.hpp"
+#include "tools/instrumentation.hpp"
 ///
 
 /// IOStream::IOStream
@@ -74,7 +75,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // (due to the standard problem of exceptions in constructors).
 IOStream::IOStream(class Environ *env,struct JPG_Hook *in,APTR stream,ULONG bufsize,ULONG userdata,UBYTE *buffer)
   : RandomAccessStream(env, bufsize), m_Hook(*in), m_pHandle(stream),
-    m_ulCachedSeek(0), m_lUserData(userdata), m_pSystemBuffer(NULL), m_pUserBuffer(buffer), m_bSeekable(true)
+    m_ulCachedSeek(0), m_lUserData(userdata), m_pSystemBuffer(NULL), m_pUserBuffer(buffer), m_bSeekable(true),
+    m_bSuspendable(false)
 { 
 }
 ///
@@ -83,7 +85,8 @@ IOStream::IOStream(class Environ *env,struct JPG_Hook *in,APTR stream,ULONG bufs
 // The taglist constructor.
 IOStream::IOStream(class Environ *env,const struct JPG_TagItem *tags)
   : RandomAccessStream(env), m_Hook(&DefaultEntry,this), m_pHandle(NULL),
-    m_ulCachedSeek(0), m_lUserData(0), m_pSystemBuffer(NULL), m_pUserBuffer(NULL), m_bSeekable(true)
+    m_ulCachedSeek(0), m_lUserData(0), m_pSystemBuffer(NULL), m_pUserBuffer(NULL), m_bSeekable(true),
+    m_bSuspendable(false)
 {
   
   while(tags) {
@@ -104,9 +107,20 @@ IOStream::IOStream(class Environ *env,const struct JPG_TagItem *tags)
     case JPGTAG_HOOK_BUFFER:
       m_pUserBuffer = tags->ti_Data.ti_pPtr;
       break;
+    case JPGTAG_DECODER_SUSPEND:
+      m_bSuspendable = (tags->ti_Data.ti_lData)?true:false;
+      break;
     }
     tags = tags->NextTagItem();
   }
+  //
+  // A suspending stream keeps the pending data in its own buffer
+  // which grows as required, and must not skip over data that has
+  // not yet arrived.
+  if (m_bSuspendable) {
+    m_pUserBuffer = NULL;
+    m_bSeekable   = false;
+  }
 }
 ///
 
@@ -189,6 +203,7 @@ LONG IOStream::Fill(void)
       JPG_PointerTag(JPGTAG_FIO_HANDLE,m_pHandle),
       JPG_ValueTag(JPGTAG_FIO_ACTION,JPGFLAG_ACTION_READ),
       JPG_ValueTag(JPGTAG_FIO_USERDATA,m_lUserData),
+      JPG_ValueTag(JPGTAG_FIO_PENDING,false),
       JPG_EndTag
     };
     //
@@ -198,10 +213,19 @@ LONG IOStream::Fill(void)
         JPG_THROW_INT(Query(), "IOStream::Fill", 
                       "Client signalled an error on reading from the file hook");
       }
+      //
+      // A suspending decoder makes sure that the data is present before
+      // it starts parsing. If it is still missing here, the stream is
+      // likely corrupt, and the decoder cannot back off anymore.
+      if (bytes == 0 && tags[5].ti_Data.ti_lData)
+        JPG_THROW(UNEXPECTED_EOF,"IOStream::Fill",
+                  "input data is not yet available, but decoding cannot be suspended at this point");
       m_pucBuffer  = (UBYTE *)tags[0].ti_Data.ti_pPtr;  // re-fetch the buffer
       m_pucBufPtr  = m_pucBuffer;              // re-initiate the buffer pointer
       m_pucBufEnd  = m_pucBuffer + bytes;      // re-initiate the buffer end
       m_lUserData  = tags[4].ti_Data.ti_lData;
+      if (m_pEnviron->InstrumentationOf())
+        m_pEnviron->InstrumentationOf()->AddBytesRead(bytes);
       //
       // If we have an EOF or no cached seeks, abort here there's nothing
       // more we could do.
@@ -235,6 +259,89 @@ LONG IOStream::Fill(void)
 }
 ///
 
+/// IOStream::Prefetch
+// Make sure that at least the given number of bytes is buffered
+// ahead of the current read position, growing the buffer if
+// required. Returns false if the hook signalled that the data
+// is still pending. Returns true if the bytes are available or
+// the end of the stream has been reached.
+bool IOStream::Prefetch(ULONG bytes)
+{
+  ULONG avail = m_pucBufEnd - m_pucBufPtr;
+  ULONG back;
+  UBYTE *buf;
+  
+  if (avail >= bytes)
+    return true;
+  //
+  // A blocking hook delivers the data as soon as it is needed.
+  if (!m_bSuspendable)
+    return true;
+  //
+  // Move the available data to the start of the system buffer, but keep
+  // the last byte read such that LastUnDo() continues to work.
+  back = (m_pucBufPtr > m_pucBuffer)?(1):(0);
+  if (m_pSystemBuffer == NULL || back + bytes > m_ulBufSize) {
+    ULONG size = m_ulBufSize;
+    //
+    // Grow generously such that the data need not to be moved
+    // around on every call.
+    if (back + bytes > size)
+      size = (back + bytes) << 1;
+    buf = (UBYTE *)m_pEnviron->AllocMem(size + 1);
+    if (avail + back)
+      memcpy(buf,m_pucBufPtr - back,avail + back);
+    if (m_pSystemBuffer)
+      m_pEnviron->FreeMem(m_pSystemBuffer,m_ulBufSize + 1);
+    m_pSystemBuffer = buf;
+    m_ulBufSize     = size;
+  } else {
+    buf = (UBYTE *)m_pSystemBuffer;
+    if (avail + back)
+      memmove(buf,m_pucBufPtr - back,avail + back);
+  }
+  //
+  // Keep the invariant file position = position of the start of the buffer.
+  if (m_pucBuffer)
+    m_uqCounter += (m_pucBufPtr - back) - m_pucBuffer;
+  m_pucBuffer = buf;
+  m_pucBufPtr = buf + back;
+  m_pucBufEnd = m_pucBufPtr + avail;
+  //
+  while(ULONG(m_pucBufEnd - m_pucBufPtr) < bytes) {
+    LONG read;
+    JPG_TagItem tags[] = {
+      JPG_PointerTag(JPGTAG_FIO_BUFFER,m_pucBufEnd),
+      JPG_ValueTag(JPGTAG_FIO_SIZE,m_pucBuffer + m_ulBufSize - m_pucBufEnd),
+      JPG_PointerTag(JPGTAG_FIO_HANDLE,m_pHandle),
+      JPG_ValueTag(JPGTAG_FIO_ACTION,JPGFLAG_ACTION_READ),
+      JPG_ValueTag(JPGTAG_FIO_USERDATA,m_lUserData),
+      JPG_ValueTag(JPGTAG_FIO_PENDING,false),
+      JPG_EndTag
+    };
+    //
+    if ((read = m_Hook.CallLong(tags)) < 0) {
+      JPG_THROW_INT(Query(), "IOStream::Prefetch", 
+                    "Client signalled an error on reading from the file hook");
+    }
+    m_lUserData = tags[4].ti_Data.ti_lData;
+    if (read == 0) {
+      // Either the end of the stream, or the data is not yet there.
+      return (tags[5].ti_Data.ti_lData)?(false):(true);
+    }
+    //
+    // The hook may have delivered the data in a buffer of its own.
+    if (tags[0].ti_Data.ti_pPtr != m_pucBufEnd)
+      memmove(m_pucBufEnd,tags[0].ti_Data.ti_pPtr,read);
+    m_pucBufEnd += read;
+    if (m_pEnviron->InstrumentationOf())
+      m_pEnviron->InstrumentationOf()->AddBytesRead(read);
+  }
+  
+  return true;
+}
+///
+
 /// IOStream::Flush
 // Write out the contents of the internal buffer
 void IOStream::Flush(void)
@@ -275,6 +382,8 @@ void IOStream::Flush(void)
       bytestowrite -= bytes;
       bufstart     += bytes;
       m_uqCounter  += bytes;
+      if (m_pEnviron->InstrumentationOf())
+        m_pEnviron->InstrumentationOf()->AddBytesWritten(bytes);
     }
     //
     // Re-fetch the buffer and user data.
@@ -115,6 +115,10 @@ class IOStream : public RandomAccessStream {
   // true in case the stream accepts seeks.
   bool            m_bSeekable;    
   //
+  // true in case the hook may signal that data is not yet
+  // available, and the decoder suspends instead of blocking.
+  bool            m_bSuspendable;
+  //
   // Advance the file position on the underlying hook, truely,
   // Skip bytes by first trying to seek over and then by trying to continuously
   // read over the bytes. Returns false in case seeking did not
@@ -178,6 +182,29 @@ public:
   {
     return m_pucBufEnd - m_pucBufPtr;
   }
+  //
+  // Check whether the stream may suspend on input that is not yet
+  // available.
+  bool isSuspendable(void) const
+  {
+    return m_bSuspendable;
+  }
+  //
+  // Make sure that at least the given number of bytes is buffered
+  // ahead of the current read position, growing the buffer if
+  // required. Returns false if the hook signalled that the data
+  // is still pending. Returns true if the bytes are available or
+  // the end of the stream has been reached.
+  bool Prefetch(ULONG bytes);
+  //
+  // Return the byte at the given offset from the current read
+  // position without removing it, or EOF if it is not buffered.
+  LONG PeekAt(ULONG offset) const
+  {
+    if (offset < ULONG(m_pucBufEnd - m_pucBufPtr))
+      return m_pucBufPtr[offset];
+    return EOF;
+  }
 };
 ///
 
@@ -79,6 +79,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "marker/actable.hpp"
 #include "marker/thresholds.hpp"
 #include "control/bitmapctrl.hpp"
+#include "tools/instrumentation.hpp"
 ///
 
 ///
@@ -992,22 +993,93 @@ bool Scan::StartMCURow(void)
 // Parse a single MCU in this scan.
 bool Scan::ParseMCU(void)
 {
+  StageTimer timer(m_pEnviron,JPGFLAG_STATS_ENTROPY_DECODE);
+  
   assert(m_pParser);
 
   return m_pParser->ParseMCU();
 }
 ///
 
+/// Scan::ParseMCURow
+// Parse all remaining MCUs of the current row.
+void Scan::ParseMCURow(void)
+{
+  StageTimer timer(m_pEnviron,JPGFLAG_STATS_ENTROPY_DECODE);
+  
+  assert(m_pParser);
+
+  m_pParser->ParseMCURow();
+}
+///
+
+/// Scan::MaxMCUSizeOf
+// Return an upper bound on the number of bytes a single MCU of this
+// scan may occupy in the codestream, including a restart marker.
+ULONG Scan::MaxMCUSizeOf(void)
+{
+  ULONG blocks = 0;
+  ULONG bytes;
+  UBYTE i;
+
+  if (m_ucCount > 1) {
+    for(i = 0;i < m_ucCount;i++) {
+      class Component *comp = ComponentOf(i);
+      blocks += comp->MCUWidthOf() * comp->MCUHeightOf();
+    }
+  } else {
+    blocks = 1;
+  }
+  //
+  switch(m_pFrame->ScanTypeOf()) {
+  case ACSequential:
+  case ACProgressive:
+  case ACDifferentialSequential:
+  case ACDifferentialProgressive:
+  case ACResidual:
+  case ACResidualProgressive:
+  case ACResidualDCT:
+    // At most 15 bits for each of the decisions of the QM coder,
+    // including byte stuffing.
+    bytes = 16384;
+    break;
+  default:
+    // At most 64 coefficients with 16 bits of code and 16 bits of
+    // magnitude each, doubled for byte stuffing.
+    bytes = 1024;
+    break;
+  }
+  
+  return blocks * bytes + 16;
+}
+///
+
 /// Scan::WriteMCU
 // Write a single MCU in this scan.
 bool Scan::WriteMCU(void)
 {
+  StageTimer timer(m_pEnviron,JPGFLAG_STATS_ENTROPY_ENCODE);
+  
   assert(m_pParser);
 
   return m_pParser->WriteMCU();
 }
 ///
 
+/// Scan::WriteRestartIntervals
+// Write all MCUs of the scan at once, coding its restart intervals
+// on the given number of threads. If the scan cannot be written this
+// way, it remains untouched and has to be written MCU by MCU.
+void Scan::WriteRestartIntervals(ULONG threads)
+{
+  StageTimer timer(m_pEnviron,JPGFLAG_STATS_ENTROPY_ENCODE);
+  
+  assert(m_pParser);
+
+  m_pParser->WriteRestartIntervals(threads);
+}
+///
+
 /// Scan::WriteFrameType
 // Write the scan type marker at the beginning of the
 // file.
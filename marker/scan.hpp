@@ -265,9 +265,21 @@ public:
   // Parse a single MCU in this scan.
   bool ParseMCU(void);
   //
+  // Parse all remaining MCUs of the current row.
+  void ParseMCURow(void);
+  //
+  // Return an upper bound on the number of bytes a single MCU of this
+  // scan may occupy in the codestream, including a restart marker.
+  ULONG MaxMCUSizeOf(void);
+  //
   // Write a single MCU in this scan.
   bool WriteMCU(void);
   //
+  // Write all MCUs of the scan at once, coding its restart intervals
+  // on the given number of threads. If the scan cannot be written this
+  // way, it remains untouched and has to be written MCU by MCU.
+  void WriteRestartIntervals(ULONG threads);
+  //
   // Return the huffman decoder of the DC value for the
   // indicated component.
   class HuffmanDecoder *DCHuffmanDecoderOf(UBYTE idx) const;
@@ -0,0 +1,168 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This test checks that the decoder does not allocate memory while
+** it parses MCUs. All buffers of a frame are allocated once its
+** dimensions are known, and the entropy decoding stage must then
+** run from them alone.
+**
+*/
+
+/// Includes
+#include "test/testhelpers.hpp"
+#include "interface/types.hpp"
+#include "interface/tagitem.hpp"
+#include "interface/parameters.hpp"
+#include "interface/jpeg.hpp"
+#include "std/stdio.hpp"
+///
+
+/// Defines
+// Dimensions of the test image. The height is not a multiple of the
+// MCU height.
+#define ALLOCATIONS_WIDTH  256
+#define ALLOCATIONS_HEIGHT 187
+///
+
+/// Test cases
+static const struct AllocationCase {
+  const char         *ac_pcName;
+  struct JPG_TagItem *ac_pOptions;
+  UBYTE               ac_ucPrecision;
+} Cases[] = {
+  {"baseline 444",        Baseline444,   8},
+  {"baseline 420",        Baseline420,   8},
+  {"progressive 444",     Progressive444,8},
+  {"progressive 420",     Progressive420,8},
+  // The residual rows are built separately from the legacy rows.
+  {"residual 444 12 bits",Residual444,  12},
+  {NULL,NULL,0}
+};
+///
+
+/// RunCase
+// Run the test on one case, return true on success.
+static bool RunCase(const struct AllocationCase *ac)
+{
+  struct TestImage source,decoded;
+  struct MemoryStream stream;
+  struct JPG_TagItem ctags[] = {
+    JPG_ValueTag(JPGTAG_STATS_ENABLE,true),
+    JPG_EndTag
+  };
+  class JPEG *jpeg = NULL;
+  ULONG allocations = 0;
+  ULONG entered     = 0;
+  bool ok           = false;
+
+  source.ti_pData = decoded.ti_pData = NULL;
+  InitMemoryStream(&stream);
+
+  if (CreateTestImage(&source,ALLOCATIONS_WIDTH,ALLOCATIONS_HEIGHT,3,
+                      ac->ac_ucPrecision,1) &&
+      EncodeTestImage(&source,ac->ac_pOptions,&stream) &&
+      (jpeg = JPEG::Construct(ctags)) &&
+      DecodeTestImage(&stream,&decoded,jpeg)) {
+    struct JPG_TagItem itags[] = {
+      JPG_ValueTag(JPGTAG_STATS_COUNT(JPGFLAG_STATS_ENTROPY_DECODE),0),
+      JPG_ValueTag(JPGTAG_STATS_ALLOCATIONS_IN(JPGFLAG_STATS_ENTROPY_DECODE),0),
+      JPG_EndTag
+    };
+
+    if (!jpeg->GetInformation(itags)) {
+      PrintError(jpeg,"requesting the statistics");
+    } else {
+      entered     = itags->GetTagData(JPGTAG_STATS_COUNT(JPGFLAG_STATS_ENTROPY_DECODE));
+      allocations = itags->GetTagData(JPGTAG_STATS_ALLOCATIONS_IN(JPGFLAG_STATS_ENTROPY_DECODE));
+      //
+      // The stage must have been measured at all, otherwise the count
+      // below proves nothing.
+      if (entered == 0) {
+        fprintf(stderr,"allocations: %s: entropy decoding was not instrumented\n",
+                ac->ac_pcName);
+      } else if (allocations != 0) {
+        fprintf(stderr,"allocations: %s: %lu allocations while parsing MCUs\n",
+                ac->ac_pcName,(unsigned long)allocations);
+      } else {
+        ok = true;
+      }
+    }
+  }
+
+  if (jpeg)
+    JPEG::Destruct(jpeg);
+  FreeTestImage(&source);
+  FreeTestImage(&decoded);
+  FreeMemoryStream(&stream);
+
+  printf("allocations: %s, entered %lu times, %lu allocations, %s\n",ac->ac_pcName,
+         (unsigned long)entered,(unsigned long)allocations,(ok)?("ok"):("failed"));
+
+  return ok;
+}
+///
+
+/// main
+int main(int,char **)
+{
+  const struct AllocationCase *ac;
+  int failures = 0;
+
+  for(ac = Cases;ac->ac_pcName;ac++) {
+    if (!RunCase(ac))
+      failures++;
+  }
+
+  return (failures)?(10):(0);
+}
+///
@@ -0,0 +1,291 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This test encodes and decodes a set of images on several threads
+** at once, each thread using its own JPEG objects, and checks that
+** every codestream and every reconstructed image is bit-exact to the
+** result of a serial run.
+**
+** Without thread support, the workers run one after another, which
+** still checks that consecutive JPEG objects do not influence each
+** other.
+**
+** Some cases encode on several threads within the library. Their
+** codestreams must be bit-exact to those of a single-threaded run.
+**
+*/
+
+/// Includes
+#include "test/testhelpers.hpp"
+#include "interface/types.hpp"
+#include "interface/tagitem.hpp"
+#include "interface/parameters.hpp"
+#include "std/stdio.hpp"
+#include "std/stdlib.hpp"
+#include "std/string.hpp"
+#if defined(USE_MULTITHREADING) && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define STRESS_THREADS 1
+#endif
+///
+
+/// Defines
+// The default number of workers.
+#define DEFAULT_WORKERS 4
+// How often each worker runs through all cases.
+#define STRESS_ROUNDS 2
+///
+
+/// Test cases
+static struct JPG_TagItem BaselineGray[] = {
+  JPG_ValueTag(JPGTAG_IMAGE_FRAMETYPE,JPGFLAG_SEQUENTIAL),
+  JPG_ValueTag(JPGTAG_IMAGE_QUALITY,85),
+  // The default residual frame type requires a color transformation.
+  JPG_ValueTag(JPGTAG_RESIDUAL_FRAMETYPE,JPGFLAG_SEQUENTIAL),
+  JPG_EndTag
+};
+// Parallel encoding requires restart intervals.
+static struct JPG_TagItem Restart444[] = {
+  JPG_ValueTag(JPGTAG_IMAGE_RESTART_INTERVAL,2),
+  JPG_Continue(Baseline444)
+};
+static struct JPG_TagItem RestartProgressive420[] = {
+  JPG_ValueTag(JPGTAG_IMAGE_RESTART_INTERVAL,4),
+  JPG_Continue(Progressive420)
+};
+static struct JPG_TagItem Threaded444[] = {
+  JPG_ValueTag(JPGTAG_ENCODER_THREADS,4),
+  JPG_Continue(Restart444)
+};
+static struct JPG_TagItem Threaded420[] = {
+  JPG_ValueTag(JPGTAG_ENCODER_THREADS,4),
+  JPG_Continue(Baseline420)
+};
+static struct JPG_TagItem ThreadedProgressive420[] = {
+  JPG_ValueTag(JPGTAG_ENCODER_THREADS,4),
+  JPG_Continue(RestartProgressive420)
+};
+
+static const struct StressCase {
+  const char         *sc_pcName;
+  struct JPG_TagItem *sc_pOptions;
+  // If non-NULL, the serial run encodes with these options instead,
+  // which must create the same codestream.
+  struct JPG_TagItem *sc_pSerialOptions;
+  ULONG               sc_ulWidth;
+  ULONG               sc_ulHeight;
+  UBYTE               sc_ucDepth;
+  UBYTE               sc_ucPrecision;
+} Cases[] = {
+  {"baseline 444",                 Baseline444,           NULL,                 203,131,3, 8},
+  {"baseline gray",                BaselineGray,          NULL,                 128,100,1, 8},
+  {"baseline 420 optimized rst",   Baseline420,           NULL,                 203,131,3, 8},
+  {"progressive 420",              Progressive420,        NULL,                 203,131,3, 8},
+  {"residual 444 12 bits",         Residual444,           NULL,                 160, 97,3,12},
+  {"baseline 444 rst 4 threads",   Threaded444,           Restart444,           203,131,3, 8},
+  {"baseline 420 rst 4 threads",   Threaded420,           Baseline420,          203,131,3, 8},
+  {"progressive 420 rst 4 threads",ThreadedProgressive420,RestartProgressive420,203,131,3, 8},
+  {NULL,NULL,NULL,0,0,0,0}
+};
+///
+
+/// struct Reference
+// The input and the results of the serial run of a case.
+struct Reference {
+  struct TestImage    r_Source;
+  struct MemoryStream r_Stream;
+  struct TestImage    r_Decoded;
+};
+///
+
+/// struct Worker
+// The state of one worker.
+struct Worker {
+  int                     w_iIndex;
+  const struct Reference *w_pReference;
+  int                     w_iCases;
+  int                     w_iJobs;
+  int                     w_iFailures;
+};
+///
+
+/// RunWorker
+// Encode and decode all cases repeatedly, and compare with the
+// references. Each worker starts with a different case such that
+// the workers run different coding modes at the same time.
+static void *RunWorker(void *arg)
+{
+  struct Worker *worker = (struct Worker *)arg;
+  int round,i;
+
+  for(round = 0;round < STRESS_ROUNDS;round++) {
+    for(i = 0;i < worker->w_iCases;i++) {
+      int c = (i + worker->w_iIndex) % worker->w_iCases;
+      const struct Reference *ref = worker->w_pReference + c;
+      struct MemoryStream stream;
+      struct TestImage decoded;
+      
+      InitMemoryStream(&stream);
+      worker->w_iJobs++;
+      
+      if (!EncodeTestImage(&ref->r_Source,Cases[c].sc_pOptions,&stream)) {
+        worker->w_iFailures++;
+      } else if (stream.ms_ulSize != ref->r_Stream.ms_ulSize ||
+                 memcmp(stream.ms_pucBuffer,ref->r_Stream.ms_pucBuffer,stream.ms_ulSize)) {
+        fprintf(stderr,"worker %d: codestream of %s differs from the serial run\n",
+                worker->w_iIndex,Cases[c].sc_pcName);
+        worker->w_iFailures++;
+      } else if (!DecodeTestImage(&stream,&decoded)) {
+        worker->w_iFailures++;
+      } else {
+        if (memcmp(decoded.ti_pData,ref->r_Decoded.ti_pData,TestImageSize(&decoded))) {
+          fprintf(stderr,"worker %d: reconstruction of %s differs from the serial run\n",
+                  worker->w_iIndex,Cases[c].sc_pcName);
+          worker->w_iFailures++;
+        }
+        FreeTestImage(&decoded);
+      }
+      FreeMemoryStream(&stream);
+    }
+  }
+
+  return NULL;
+}
+///
+
+/// main
+int main(int argc,char **argv)
+{
+  struct Reference *refs;
+  struct Worker *workers;
+  int count    = (argc > 1)?(atoi(argv[1])):(DEFAULT_WORKERS);
+  int cases    = 0;
+  int failures = 0;
+  int jobs     = 0;
+  int i;
+
+  if (count < 1)
+    count = 1;
+
+  while(Cases[cases].sc_pcName)
+    cases++;
+
+  refs    = (struct Reference *)calloc(cases,sizeof(struct Reference));
+  workers = (struct Worker *)calloc(count,sizeof(struct Worker));
+  if (refs == NULL || workers == NULL) {
+    fprintf(stderr,"mtstress: out of memory\n");
+    return 20;
+  }
+
+  // The serial run provides the references.
+  for(i = 0;i < cases;i++) {
+    const struct StressCase *sc = Cases + i;
+    InitMemoryStream(&refs[i].r_Stream);
+    if (!CreateTestImage(&refs[i].r_Source,sc->sc_ulWidth,sc->sc_ulHeight,
+                         sc->sc_ucDepth,sc->sc_ucPrecision,i + 1) ||
+        !EncodeTestImage(&refs[i].r_Source,
+                         (sc->sc_pSerialOptions)?(sc->sc_pSerialOptions):(sc->sc_pOptions),
+                         &refs[i].r_Stream) ||
+        !DecodeTestImage(&refs[i].r_Stream,&refs[i].r_Decoded)) {
+      fprintf(stderr,"mtstress: serial run of %s failed\n",sc->sc_pcName);
+      return 10;
+    }
+  }
+
+  for(i = 0;i < count;i++) {
+    workers[i].w_iIndex     = i;
+    workers[i].w_pReference = refs;
+    workers[i].w_iCases     = cases;
+  }
+
+#ifdef STRESS_THREADS
+  {
+    pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * count);
+    int started        = 0;
+    if (threads) {
+      while(started < count) {
+        if (pthread_create(threads + started,NULL,&RunWorker,workers + started))
+          break;
+        started++;
+      }
+      for(i = 0;i < started;i++)
+        pthread_join(threads[i],NULL);
+      free(threads);
+    }
+    // Run whatever could not be started in this thread.
+    for(i = started;i < count;i++)
+      RunWorker(workers + i);
+  }
+#else
+  for(i = 0;i < count;i++)
+    RunWorker(workers + i);
+#endif
+
+  for(i = 0;i < count;i++) {
+    jobs     += workers[i].w_iJobs;
+    failures += workers[i].w_iFailures;
+  }
+
+  for(i = 0;i < cases;i++) {
+    FreeTestImage(&refs[i].r_Source);
+    FreeTestImage(&refs[i].r_Decoded);
+    FreeMemoryStream(&refs[i].r_Stream);
+  }
+  free(refs);
+  free(workers);
+
+  printf("mtstress: %d workers, %d jobs, %d failed\n",count,jobs,failures);
+
+  return (failures)?(10):(0);
+}
+///
@@ -0,0 +1,276 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This test probes encoded images for their layout without decoding
+** them. The results must match the options the images were encoded
+** with. Every truncated prefix of a codestream must either be rejected
+** or deliver the same results, and probing must never look at data
+** behind the end of the buffer.
+**
+*/
+
+/// Includes
+#include "test/testhelpers.hpp"
+#include "interface/types.hpp"
+#include "interface/tagitem.hpp"
+#include "interface/parameters.hpp"
+#include "interface/jpeg.hpp"
+#include "std/stdio.hpp"
+#include "std/stdlib.hpp"
+#include "std/string.hpp"
+///
+
+/// Defines
+// Dimensions of the test image. The height is neither a multiple
+// of the block nor of the MCU height.
+#define PROBE_WIDTH  203
+#define PROBE_HEIGHT 131
+// The bits of the frame type that define the coding process.
+#define FRAMETYPE_MASK 0x07
+///
+
+/// Test cases
+static const struct ProbeCase {
+  const char         *pc_pcName;
+  struct JPG_TagItem *pc_pOptions;
+  UBYTE               pc_ucPrecision;
+} Cases[] = {
+  {"baseline 444",        Baseline444,   8},
+  {"baseline 420 rst",    Baseline420,   8},
+  {"progressive 444",     Progressive444,8},
+  {"progressive 420",     Progressive420,8},
+  {"residual 444 12 bits",Residual444,  12},
+  {NULL,NULL,0}
+};
+///
+
+/// struct ProbeResult
+// The result of probing a buffer.
+struct ProbeResult {
+  JPG_LONG pr_lResult;
+  JPG_LONG pr_lWidth;
+  JPG_LONG pr_lHeight;
+  JPG_LONG pr_lDepth;
+  JPG_LONG pr_lPrecision;
+  JPG_LONG pr_lFrameType;
+  JPG_LONG pr_lRestartInterval;
+  JPG_LONG pr_lProfile;
+};
+///
+
+/// Probe
+// Probe the given bytes of the buffer and fill in the result.
+static void Probe(const UBYTE *buffer,ULONG size,struct ProbeResult *pr)
+{
+  struct JPG_TagItem tags[] = {
+    JPG_ValueTag(JPGTAG_IMAGE_WIDTH,0),
+    JPG_ValueTag(JPGTAG_IMAGE_HEIGHT,0),
+    JPG_ValueTag(JPGTAG_IMAGE_DEPTH,0),
+    JPG_ValueTag(JPGTAG_IMAGE_PRECISION,0),
+    JPG_ValueTag(JPGTAG_IMAGE_FRAMETYPE,0),
+    JPG_ValueTag(JPGTAG_IMAGE_RESTART_INTERVAL,0),
+    JPG_ValueTag(JPGTAG_PROFILE,0),
+    JPG_EndTag
+  };
+
+  pr->pr_lResult          = JPEG::Probe(buffer,size,tags);
+  pr->pr_lWidth           = tags->GetTagData(JPGTAG_IMAGE_WIDTH);
+  pr->pr_lHeight          = tags->GetTagData(JPGTAG_IMAGE_HEIGHT);
+  pr->pr_lDepth           = tags->GetTagData(JPGTAG_IMAGE_DEPTH);
+  pr->pr_lPrecision       = tags->GetTagData(JPGTAG_IMAGE_PRECISION);
+  pr->pr_lFrameType       = tags->GetTagData(JPGTAG_IMAGE_FRAMETYPE);
+  pr->pr_lRestartInterval = tags->GetTagData(JPGTAG_IMAGE_RESTART_INTERVAL);
+  pr->pr_lProfile         = tags->GetTagData(JPGTAG_PROFILE);
+}
+///
+
+/// isSameResult
+// Check whether two results agree. Only the return code is compared
+// for rejected buffers.
+static bool isSameResult(const struct ProbeResult *a,const struct ProbeResult *b)
+{
+  if (a->pr_lResult != b->pr_lResult)
+    return false;
+
+  if (a->pr_lResult == JPG_FALSE)
+    return true;
+
+  return a->pr_lWidth           == b->pr_lWidth           &&
+         a->pr_lHeight          == b->pr_lHeight          &&
+         a->pr_lDepth           == b->pr_lDepth           &&
+         a->pr_lPrecision       == b->pr_lPrecision       &&
+         a->pr_lFrameType       == b->pr_lFrameType       &&
+         a->pr_lRestartInterval == b->pr_lRestartInterval &&
+         a->pr_lProfile         == b->pr_lProfile;
+}
+///
+
+/// CheckOptions
+// Check the result of probing the complete codestream against the
+// options the image was encoded with.
+static bool CheckOptions(const struct ProbeCase *pc,const struct ProbeResult *pr)
+{
+  JPG_LONG frametype = pc->pc_pOptions->GetTagData(JPGTAG_IMAGE_FRAMETYPE);
+  JPG_LONG restart   = pc->pc_pOptions->GetTagData(JPGTAG_IMAGE_RESTART_INTERVAL,0);
+
+  if (pr->pr_lResult == JPG_FALSE) {
+    fprintf(stderr,"probe: %s: the codestream was rejected\n",pc->pc_pcName);
+    return false;
+  }
+
+  if (pr->pr_lWidth != PROBE_WIDTH || pr->pr_lHeight != PROBE_HEIGHT || pr->pr_lDepth != 3) {
+    fprintf(stderr,"probe: %s: found a %ldx%ld image of %ld components\n",pc->pc_pcName,
+            long(pr->pr_lWidth),long(pr->pr_lHeight),long(pr->pr_lDepth));
+    return false;
+  }
+
+  if (pr->pr_lPrecision != pc->pc_ucPrecision) {
+    fprintf(stderr,"probe: %s: found a precision of %ld bits\n",pc->pc_pcName,
+            long(pr->pr_lPrecision));
+    return false;
+  }
+
+  if ((pr->pr_lFrameType & FRAMETYPE_MASK) != (frametype & FRAMETYPE_MASK) ||
+      (pr->pr_lFrameType & JPGFLAG_RESIDUAL_CODING) != (frametype & JPGFLAG_RESIDUAL_CODING)) {
+    fprintf(stderr,"probe: %s: found frame type 0x%lx instead of 0x%lx\n",pc->pc_pcName,
+            long(pr->pr_lFrameType),long(frametype & (FRAMETYPE_MASK | JPGFLAG_RESIDUAL_CODING)));
+    return false;
+  }
+
+  if (pr->pr_lRestartInterval != restart) {
+    fprintf(stderr,"probe: %s: found a restart interval of %ld\n",pc->pc_pcName,
+            long(pr->pr_lRestartInterval));
+    return false;
+  }
+
+  return true;
+}
+///
+
+/// RunCase
+// Run the test on one case, return true on success.
+static bool RunCase(const struct ProbeCase *pc)
+{
+  struct TestImage source;
+  struct MemoryStream stream;
+  struct ProbeResult full;
+  UBYTE *copy     = NULL;
+  ULONG accepted  = 0;
+  ULONG total     = 0;
+  bool ok         = false;
+
+  source.ti_pData = NULL;
+  InitMemoryStream(&stream);
+
+  if (CreateTestImage(&source,PROBE_WIDTH,PROBE_HEIGHT,3,pc->pc_ucPrecision,1) &&
+      EncodeTestImage(&source,pc->pc_pOptions,&stream)) {
+    total = stream.ms_ulSize;
+    Probe(stream.ms_pucBuffer,total,&full);
+    ok = CheckOptions(pc,&full);
+    //
+    // Probe all truncated prefixes. Once in the stream itself, and once
+    // in a copy whose bytes behind the prefix are overwritten. Both must
+    // agree, otherwise the data behind the prefix was looked at.
+    if (ok && (copy = (UBYTE *)malloc(stream.ms_ulSize)) == NULL) {
+      fprintf(stderr,"probe: out of memory\n");
+      ok = false;
+    }
+    if (ok) {
+      ULONG size;
+      for(size = 0;size < stream.ms_ulSize && ok;size++) {
+        struct ProbeResult prefix,overwritten;
+        memcpy(copy,stream.ms_pucBuffer,size);
+        memset(copy + size,0,stream.ms_ulSize - size);
+        Probe(stream.ms_pucBuffer,size,&prefix);
+        Probe(copy,size,&overwritten);
+        if (!isSameResult(&prefix,&overwritten)) {
+          fprintf(stderr,"probe: %s: probing %lu bytes looked behind the end of the buffer\n",
+                  pc->pc_pcName,(unsigned long)size);
+          ok = false;
+        } else if (prefix.pr_lResult != JPG_FALSE) {
+          if (!isSameResult(&prefix,&full)) {
+            fprintf(stderr,"probe: %s: probing %lu bytes delivered an incorrect result\n",
+                    pc->pc_pcName,(unsigned long)size);
+            ok = false;
+          }
+          accepted++;
+        }
+      }
+    }
+  }
+
+  free(copy);
+  FreeTestImage(&source);
+  FreeMemoryStream(&stream);
+
+  printf("probe: %s, %lu of %lu prefixes accepted, %s\n",pc->pc_pcName,
+         (unsigned long)accepted,(unsigned long)total,(ok)?("ok"):("failed"));
+
+  return ok;
+}
+///
+
+/// main
+int main(int,char **)
+{
+  const struct ProbeCase *pc;
+  int failures = 0;
+
+  for(pc = Cases;pc->pc_pcName;pc++) {
+    if (!RunCase(pc))
+      failures++;
+  }
+
+  return (failures)?(10):(0);
+}
+///
@@ -0,0 +1,236 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This test decodes a progressive image scan by scan and refreshes
+** the reconstruction after each scan in the update mode of the
+** decoder. The image height is not a multiple of the MCU height, and
+** the bitmap ends exactly at the bottom of the image. The final
+** reconstruction must be identical to that of a regular decode, and
+** once the image is complete, a further update must not write any
+** lines.
+**
+*/
+
+/// Includes
+#include "test/testhelpers.hpp"
+#include "interface/types.hpp"
+#include "interface/hooks.hpp"
+#include "interface/tagitem.hpp"
+#include "interface/parameters.hpp"
+#include "interface/jpeg.hpp"
+#include "tools/traits.hpp"
+#include "std/stdio.hpp"
+#include "std/stdlib.hpp"
+#include "std/string.hpp"
+///
+
+/// Defines
+// Dimensions of the test image. The height is neither a multiple
+// of the block nor of the MCU height.
+#define REFRESH_WIDTH  203
+#define REFRESH_HEIGHT 131
+// The number of refreshes. This is more than the number of scans of
+// the test images, the last refreshes find no further scans to read.
+#define REFRESHES      16
+///
+
+/// Test cases
+static const struct RefreshCase {
+  const char         *rc_pcName;
+  struct JPG_TagItem *rc_pOptions;
+} Cases[] = {
+  {"progressive 444",Progressive444},
+  {"progressive 420",Progressive420},
+  {NULL,NULL}
+};
+///
+
+/// ClippedImageHook
+// A bitmap hook for the 8-bit images of this test that clips the last
+// stripe to the height of the image.
+static JPG_LONG ClippedImageHook(struct JPG_Hook *hook,struct JPG_TagItem *tags)
+{
+  struct TestImage *image = (struct TestImage *)(hook->hk_pData);
+  UWORD comp              = tags->GetTagData(JPGTAG_BIO_COMPONENT);
+  ULONG miny              = tags->GetTagData(JPGTAG_BIO_MINY);
+
+  if (tags->GetTagData(JPGTAG_BIO_ACTION) == JPGFLAG_BIO_REQUEST) {
+    tags->SetTagPtr(JPGTAG_BIO_MEMORY        ,(UBYTE *)(image->ti_pData) + comp);
+    tags->SetTagData(JPGTAG_BIO_WIDTH        ,image->ti_ulWidth);
+    tags->SetTagData(JPGTAG_BIO_HEIGHT       ,(miny + 8 < image->ti_ulHeight)?(miny + 8):(image->ti_ulHeight));
+    tags->SetTagData(JPGTAG_BIO_BYTESPERROW  ,image->ti_ulWidth * image->ti_ucDepth);
+    tags->SetTagData(JPGTAG_BIO_BYTESPERPIXEL,image->ti_ucDepth);
+    tags->SetTagData(JPGTAG_BIO_PIXELTYPE    ,CTYP_UBYTE);
+  }
+
+  return 0;
+}
+///
+
+/// Refresh
+// Update the image from the current state of the decoder, and return
+// the number of lines written, or -1 on an error.
+static LONG Refresh(class JPEG *jpeg,struct TestImage *image)
+{
+  struct JPG_Hook bmhook(ClippedImageHook,image);
+  LONG lines = 0;
+  ULONG y;
+
+  // Reconstruct in stripes of eight lines as the hook expects.
+  for(y = 0;y < image->ti_ulHeight;y += 8) {
+    struct JPG_TagItem tags[] = {
+      JPG_PointerTag(JPGTAG_BIH_HOOK,&bmhook),
+      JPG_ValueTag(JPGTAG_DECODER_MINY,y),
+      JPG_ValueTag(JPGTAG_DECODER_MAXY,y + 7),
+      JPG_ValueTag(JPGTAG_DECODER_UPDATE,true),
+      JPG_ValueTag(JPGTAG_DECODER_UPDATE_MINY,0),
+      JPG_ValueTag(JPGTAG_DECODER_UPDATE_MAXY,0),
+      JPG_EndTag
+    };
+    LONG miny,maxy;
+
+    if (!jpeg->DisplayRectangle(tags)) {
+      PrintError(jpeg,"refreshing the image");
+      return -1;
+    }
+    miny = tags->GetTagData(JPGTAG_DECODER_UPDATE_MINY);
+    maxy = tags->GetTagData(JPGTAG_DECODER_UPDATE_MAXY);
+    if (maxy >= miny)
+      lines += maxy - miny + 1;
+  }
+
+  return lines;
+}
+///
+
+/// RunCase
+// Run the test on one case, return true on success.
+static bool RunCase(const struct RefreshCase *rc)
+{
+  struct TestImage source,reference,refreshed;
+  struct MemoryStream stream;
+  class JPEG *jpeg = NULL;
+  bool ok          = false;
+  int refreshes    = 0;
+
+  source.ti_pData = reference.ti_pData = refreshed.ti_pData = NULL;
+  InitMemoryStream(&stream);
+
+  if (CreateTestImage(&source,REFRESH_WIDTH,REFRESH_HEIGHT,3,8,1) &&
+      EncodeTestImage(&source,rc->rc_pOptions,&stream) &&
+      DecodeTestImage(&stream,&reference) &&
+      AllocTestImage(&refreshed,REFRESH_WIDTH,REFRESH_HEIGHT,3,8) &&
+      (jpeg = JPEG::Construct(NULL))) {
+    struct JPG_Hook iohook(MemoryStreamHook,&stream);
+    struct JPG_TagItem tags[] = {
+      JPG_PointerTag(JPGTAG_HOOK_IOHOOK,&iohook),
+      JPG_PointerTag(JPGTAG_HOOK_IOSTREAM,&stream),
+      JPG_ValueTag(JPGTAG_DECODER_STOP,JPGFLAG_DECODER_STOP_SCAN),
+      JPG_EndTag
+    };
+    LONG lines = 0;
+
+    stream.ms_ulPos = 0;
+    ok              = true;
+    //
+    // Refresh after each scan.
+    while(ok && refreshes < REFRESHES) {
+      if (!jpeg->Read(tags)) {
+        PrintError(jpeg,"reading a scan");
+        ok = false;
+      } else if (Refresh(jpeg,&refreshed) < 0) {
+        ok = false;
+      }
+      refreshes++;
+    }
+    //
+    // Now that the image is complete, nothing changes anymore.
+    if (ok && (lines = Refresh(jpeg,&refreshed)) != 0) {
+      fprintf(stderr,"refresh: %s: the final update rewrote %ld lines\n",
+              rc->rc_pcName,long(lines));
+      ok = false;
+    }
+    if (ok && memcmp(refreshed.ti_pData,reference.ti_pData,TestImageSize(&reference))) {
+      fprintf(stderr,"refresh: %s: the refreshed image differs from the decoded image\n",
+              rc->rc_pcName);
+      ok = false;
+    }
+  }
+
+  if (jpeg)
+    JPEG::Destruct(jpeg);
+  FreeTestImage(&source);
+  FreeTestImage(&reference);
+  FreeTestImage(&refreshed);
+  FreeMemoryStream(&stream);
+
+  printf("refresh: %s, %d refreshes, %s\n",rc->rc_pcName,refreshes,(ok)?("ok"):("failed"));
+
+  return ok;
+}
+///
+
+/// main
+int main(int,char **)
+{
+  const struct RefreshCase *rc;
+  int failures = 0;
+
+  for(rc = Cases;rc->rc_pcName;rc++) {
+    if (!RunCase(rc))
+      failures++;
+  }
+
+  return (failures)?(10):(0);
+}
+///
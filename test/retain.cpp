@@ -0,0 +1,389 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This test keeps the input of the color transformation on decoding,
+** and displays the image again from the kept blocks, once completely
+** and once cropped. Both renders must be identical to a regular decode
+** and must not run the inverse DCT again. Reading another scan must
+** drop the kept blocks, and the next render must then reconstruct the
+** image from the new data.
+**
+*/
+
+/// Includes
+#include "test/testhelpers.hpp"
+#include "interface/types.hpp"
+#include "interface/hooks.hpp"
+#include "interface/tagitem.hpp"
+#include "interface/parameters.hpp"
+#include "interface/jpeg.hpp"
+#include "std/stdio.hpp"
+#include "std/stdlib.hpp"
+#include "std/string.hpp"
+///
+
+/// Defines
+// Dimensions of the test image. The height is neither a multiple
+// of the block nor of the MCU height.
+#define RETAIN_WIDTH  203
+#define RETAIN_HEIGHT 131
+// The rectangle of the cropped render. Neither edge is aligned to
+// blocks.
+#define CROP_MINX      37
+#define CROP_MINY      21
+#define CROP_MAXX     150
+#define CROP_MAXY     100
+///
+
+/// Test cases
+static const struct RetainCase {
+  const char         *rc_pcName;
+  struct JPG_TagItem *rc_pOptions;
+  UBYTE               rc_ucPrecision;
+} Cases[] = {
+  {"baseline 444",        Baseline444,   8},
+  {"baseline 420",        Baseline420,   8},
+  {"residual 444 12 bits",Residual444,  12},
+  {NULL,NULL,0}
+};
+///
+
+/// Render
+// Display the given rectangle of the image in stripes of eight lines
+// as the hook expects, and keep the blocks if retain is set. Returns
+// false on an error.
+static bool Render(class JPEG *jpeg,struct TestImage *image,
+                   LONG minx,LONG miny,LONG maxx,LONG maxy,bool retain)
+{
+  struct JPG_Hook bmhook(TestImageHook,image);
+  LONG y;
+
+  for(y = miny;y <= maxy;y = (y & -8) + 8) {
+    struct JPG_TagItem tags[] = {
+      JPG_PointerTag(JPGTAG_BIH_HOOK,&bmhook),
+      JPG_ValueTag(JPGTAG_DECODER_MINX,minx),
+      JPG_ValueTag(JPGTAG_DECODER_MINY,y),
+      JPG_ValueTag(JPGTAG_DECODER_MAXX,maxx),
+      JPG_ValueTag(JPGTAG_DECODER_MAXY,((y | 7) < maxy)?(y | 7):(maxy)),
+      JPG_ValueTag(JPGTAG_DECODER_RETAIN,retain),
+      JPG_EndTag
+    };
+    if (!jpeg->DisplayRectangle(tags)) {
+      PrintError(jpeg,"displaying the image");
+      return false;
+    }
+  }
+
+  return true;
+}
+///
+
+/// InverseDCTCount
+// Return how often the inverse DCT ran so far.
+static ULONG InverseDCTCount(class JPEG *jpeg)
+{
+  struct JPG_TagItem tags[] = {
+    JPG_ValueTag(JPGTAG_STATS_COUNT(JPGFLAG_STATS_INVERSE_DCT),0),
+    JPG_EndTag
+  };
+
+  if (!jpeg->GetInformation(tags)) {
+    PrintError(jpeg,"requesting the statistics");
+    return 0;
+  }
+
+  return tags->GetTagData(JPGTAG_STATS_COUNT(JPGFLAG_STATS_INVERSE_DCT));
+}
+///
+
+/// CompareRectangle
+// Check that the image matches the reference within the rectangle,
+// and that it is still empty outside of it.
+static bool CompareRectangle(const struct TestImage *image,const struct TestImage *reference,
+                             ULONG minx,ULONG miny,ULONG maxx,ULONG maxy)
+{
+  ULONG sample = TestImageSize(image) / (image->ti_ulWidth * image->ti_ulHeight);
+  ULONG row    = image->ti_ulWidth * sample;
+  ULONG y;
+
+  for(y = 0;y < image->ti_ulHeight;y++) {
+    const UBYTE *src = (const UBYTE *)(image->ti_pData) + y * row;
+    const UBYTE *ref = (const UBYTE *)(reference->ti_pData) + y * row;
+    ULONG x;
+
+    for(x = 0;x < row;x++) {
+      ULONG pixel = x / sample;
+      if (y >= miny && y <= maxy && pixel >= minx && pixel <= maxx) {
+        if (src[x] != ref[x])
+          return false;
+      } else if (src[x]) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+///
+
+/// RunCase
+// Decode the image, keep the blocks and display it again, completely
+// and cropped. Return true on success.
+static bool RunCase(const struct RetainCase *rc)
+{
+  struct TestImage source,reference,first,again,cropped;
+  struct MemoryStream stream;
+  struct JPG_TagItem ctags[] = {
+    JPG_ValueTag(JPGTAG_STATS_ENABLE,true),
+    JPG_EndTag
+  };
+  class JPEG *jpeg = NULL;
+  ULONG idct       = 0;
+  bool ok          = false;
+
+  source.ti_pData = reference.ti_pData = first.ti_pData = NULL;
+  again.ti_pData  = cropped.ti_pData   = NULL;
+  InitMemoryStream(&stream);
+
+  if (CreateTestImage(&source,RETAIN_WIDTH,RETAIN_HEIGHT,3,rc->rc_ucPrecision,1) &&
+      EncodeTestImage(&source,rc->rc_pOptions,&stream) &&
+      DecodeTestImage(&stream,&reference) &&
+      AllocTestImage(&first,RETAIN_WIDTH,RETAIN_HEIGHT,3,rc->rc_ucPrecision) &&
+      AllocTestImage(&again,RETAIN_WIDTH,RETAIN_HEIGHT,3,rc->rc_ucPrecision) &&
+      AllocTestImage(&cropped,RETAIN_WIDTH,RETAIN_HEIGHT,3,rc->rc_ucPrecision) &&
+      (jpeg = JPEG::Construct(ctags))) {
+    struct JPG_Hook iohook(MemoryStreamHook,&stream);
+    struct JPG_TagItem tags[] = {
+      JPG_PointerTag(JPGTAG_HOOK_IOHOOK,&iohook),
+      JPG_PointerTag(JPGTAG_HOOK_IOSTREAM,&stream),
+      JPG_EndTag
+    };
+
+    stream.ms_ulPos = 0;
+
+    if (!jpeg->Read(tags)) {
+      PrintError(jpeg,"reading the image");
+    } else if (!Render(jpeg,&first,0,0,RETAIN_WIDTH - 1,RETAIN_HEIGHT - 1,true)) {
+      // Error printed already.
+    } else if (memcmp(first.ti_pData,reference.ti_pData,TestImageSize(&reference))) {
+      fprintf(stderr,"retain: %s: the first render differs from the decoded image\n",
+              rc->rc_pcName);
+    } else if ((idct = InverseDCTCount(jpeg)) == 0) {
+      fprintf(stderr,"retain: %s: the inverse DCT was not instrumented\n",
+              rc->rc_pcName);
+    } else if (!Render(jpeg,&again,0,0,RETAIN_WIDTH - 1,RETAIN_HEIGHT - 1,true)) {
+      // Error printed already.
+    } else if (memcmp(again.ti_pData,reference.ti_pData,TestImageSize(&reference))) {
+      fprintf(stderr,"retain: %s: the repeated render differs from the decoded image\n",
+              rc->rc_pcName);
+    } else if (!Render(jpeg,&cropped,CROP_MINX,CROP_MINY,CROP_MAXX,CROP_MAXY,true)) {
+      // Error printed already.
+    } else if (!CompareRectangle(&cropped,&reference,CROP_MINX,CROP_MINY,CROP_MAXX,CROP_MAXY)) {
+      fprintf(stderr,"retain: %s: the cropped render differs from the decoded image\n",
+              rc->rc_pcName);
+    } else if (InverseDCTCount(jpeg) != idct) {
+      fprintf(stderr,"retain: %s: the inverse DCT ran again on the kept blocks\n",
+              rc->rc_pcName);
+    } else {
+      ok = true;
+    }
+  }
+
+  if (jpeg)
+    JPEG::Destruct(jpeg);
+  FreeTestImage(&source);
+  FreeTestImage(&reference);
+  FreeTestImage(&first);
+  FreeTestImage(&again);
+  FreeTestImage(&cropped);
+  FreeMemoryStream(&stream);
+
+  printf("retain: %s, %s\n",rc->rc_pcName,(ok)?("ok"):("failed"));
+
+  return ok;
+}
+///
+
+/// DecodeScans
+// Decode the first scans of the stream on a new object into the image
+// as a reference. Returns false on an error.
+static bool DecodeScans(const struct MemoryStream *stream,struct TestImage *image,int scans)
+{
+  // The object reads the data from its own position.
+  struct MemoryStream copy = *stream;
+  class JPEG *jpeg         = JPEG::Construct(NULL);
+  bool ok                  = false;
+
+  if (jpeg) {
+    struct JPG_Hook iohook(MemoryStreamHook,&copy);
+    struct JPG_TagItem tags[] = {
+      JPG_PointerTag(JPGTAG_HOOK_IOHOOK,&iohook),
+      JPG_PointerTag(JPGTAG_HOOK_IOSTREAM,&copy),
+      JPG_ValueTag(JPGTAG_DECODER_STOP,JPGFLAG_DECODER_STOP_SCAN),
+      JPG_EndTag
+    };
+
+    copy.ms_ulPos = 0;
+    ok            = true;
+    while(ok && scans-- > 0) {
+      if (!jpeg->Read(tags)) {
+        PrintError(jpeg,"reading a scan");
+        ok = false;
+      }
+    }
+    if (ok)
+      ok = Render(jpeg,image,0,0,image->ti_ulWidth - 1,image->ti_ulHeight - 1,false);
+    JPEG::Destruct(jpeg);
+  }
+
+  return ok;
+}
+///
+
+/// RunDropCase
+// Read a progressive image scan by scan, and render it after each
+// scan keeping the blocks. Reading a scan must invalidate the kept
+// blocks such that each render matches a regular decode of the
+// scans read so far. Return true on success.
+static bool RunDropCase(void)
+{
+  struct TestImage source,kept,fresh,former;
+  struct MemoryStream stream;
+  struct JPG_TagItem ctags[] = {
+    JPG_ValueTag(JPGTAG_STATS_ENABLE,true),
+    JPG_EndTag
+  };
+  class JPEG *jpeg = NULL;
+  bool ok          = false;
+  int scans        = 0;
+
+  source.ti_pData = kept.ti_pData = fresh.ti_pData = former.ti_pData = NULL;
+  InitMemoryStream(&stream);
+
+  if (CreateTestImage(&source,RETAIN_WIDTH,RETAIN_HEIGHT,3,8,1) &&
+      EncodeTestImage(&source,Progressive444,&stream) &&
+      AllocTestImage(&kept,RETAIN_WIDTH,RETAIN_HEIGHT,3,8) &&
+      AllocTestImage(&fresh,RETAIN_WIDTH,RETAIN_HEIGHT,3,8) &&
+      AllocTestImage(&former,RETAIN_WIDTH,RETAIN_HEIGHT,3,8) &&
+      (jpeg = JPEG::Construct(ctags))) {
+    struct JPG_Hook iohook(MemoryStreamHook,&stream);
+    struct JPG_TagItem tags[] = {
+      JPG_PointerTag(JPGTAG_HOOK_IOHOOK,&iohook),
+      JPG_PointerTag(JPGTAG_HOOK_IOSTREAM,&stream),
+      JPG_ValueTag(JPGTAG_DECODER_STOP,JPGFLAG_DECODER_STOP_SCAN),
+      JPG_EndTag
+    };
+    ULONG idct = 0;
+
+    stream.ms_ulPos = 0;
+    ok              = true;
+    //
+    // Two scans are sufficient, the first render keeps the blocks of
+    // the first scan, the second must not use them.
+    while(ok && scans < 2) {
+      memcpy(former.ti_pData,kept.ti_pData,TestImageSize(&kept));
+      if (!jpeg->Read(tags)) {
+        PrintError(jpeg,"reading a scan");
+        ok = false;
+      } else if (!DecodeScans(&stream,&fresh,scans + 1) ||
+                 !Render(jpeg,&kept,0,0,RETAIN_WIDTH - 1,RETAIN_HEIGHT - 1,true)) {
+        ok = false;
+      } else if (scans > 0 && InverseDCTCount(jpeg) == idct) {
+        fprintf(stderr,"retain: progressive 444: the blocks were not reconstructed "
+                "after reading scan %d\n",scans + 1);
+        ok = false;
+      } else if (memcmp(kept.ti_pData,fresh.ti_pData,TestImageSize(&fresh))) {
+        fprintf(stderr,"retain: progressive 444: the render after scan %d differs "
+                "from the decoded image\n",scans + 1);
+        ok = false;
+      } else if (scans > 0 && !memcmp(kept.ti_pData,former.ti_pData,TestImageSize(&kept))) {
+        fprintf(stderr,"retain: progressive 444: scan %d did not change the image\n",
+                scans + 1);
+        ok = false;
+      }
+      idct = InverseDCTCount(jpeg);
+      scans++;
+    }
+  }
+
+  if (jpeg)
+    JPEG::Destruct(jpeg);
+  FreeTestImage(&source);
+  FreeTestImage(&kept);
+  FreeTestImage(&fresh);
+  FreeTestImage(&former);
+  FreeMemoryStream(&stream);
+
+  printf("retain: progressive 444, dropped after %d scans, %s\n",scans,(ok)?("ok"):("failed"));
+
+  return ok;
+}
+///
+
+/// main
+int main(int,char **)
+{
+  const struct RetainCase *rc;
+  int failures = 0;
+
+  for(rc = Cases;rc->rc_pcName;rc++) {
+    if (!RunCase(rc))
+      failures++;
+  }
+
+  if (!RunDropCase())
+    failures++;
+
+  return (failures)?(10):(0);
+}
+///
@@ -0,0 +1,194 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This test decodes images from a stream that arrives in small chunks.
+** The decoder may suspend whenever the stream has no data yet, and
+** must continue where it stopped once more data arrived. The result
+** must be identical to that of decoding the complete stream at once.
+**
+*/
+
+/// Includes
+#include "test/testhelpers.hpp"
+#include "interface/types.hpp"
+#include "interface/hooks.hpp"
+#include "interface/tagitem.hpp"
+#include "interface/parameters.hpp"
+#include "interface/jpeg.hpp"
+#include "std/stdio.hpp"
+#include "std/string.hpp"
+///
+
+/// Defines
+// Dimensions of the test image. The height is neither a multiple
+// of the block nor of the MCU height.
+#define SUSPEND_WIDTH  203
+#define SUSPEND_HEIGHT 131
+///
+
+/// Test cases
+static const struct SuspendCase {
+  const char         *sc_pcName;
+  struct JPG_TagItem *sc_pOptions;
+  // The number of bytes that arrive at once.
+  ULONG               sc_ulChunk;
+} Cases[] = {
+  {"baseline 444",              Baseline444,     1},
+  {"baseline 444",              Baseline444,    97},
+  {"baseline 420 optimized rst",Baseline420,     1},
+  {"baseline 420 optimized rst",Baseline420,    61},
+  {"progressive 444",           Progressive444, 13},
+  {"progressive 420",           Progressive420,  1},
+  {"progressive 420",           Progressive420,256},
+  {NULL,NULL,0}
+};
+///
+
+/// RunCase
+// Run the test on one case, return true on success.
+static bool RunCase(const struct SuspendCase *sc)
+{
+  struct TestImage source,reference,decoded;
+  struct MemoryStream stream;
+  class JPEG *jpeg = NULL;
+  ULONG suspends   = 0;
+  bool ok          = false;
+
+  source.ti_pData = reference.ti_pData = decoded.ti_pData = NULL;
+  InitMemoryStream(&stream);
+
+  if (CreateTestImage(&source,SUSPEND_WIDTH,SUSPEND_HEIGHT,3,8,1) &&
+      EncodeTestImage(&source,sc->sc_pOptions,&stream) &&
+      DecodeTestImage(&stream,&reference) &&
+      (jpeg = JPEG::Construct(NULL))) {
+    struct JPG_Hook iohook(MemoryStreamHook,&stream);
+    struct JPG_TagItem tags[] = {
+      JPG_PointerTag(JPGTAG_HOOK_IOHOOK,&iohook),
+      JPG_PointerTag(JPGTAG_HOOK_IOSTREAM,&stream),
+      JPG_ValueTag(JPGTAG_DECODER_SUSPEND,true),
+      JPG_ValueTag(JPGTAG_DECODER_NEEDS_DATA,false),
+      JPG_EndTag
+    };
+
+    stream.ms_ulPos   = 0;
+    stream.ms_ulLimit = sc->sc_ulChunk;
+    ok                = true;
+    //
+    // Deliver the next chunk whenever the decoder runs out of data.
+    for(;;) {
+      if (!jpeg->Read(tags)) {
+        PrintError(jpeg,"reading the image");
+        ok = false;
+        break;
+      }
+      if (!tags->GetTagData(JPGTAG_DECODER_NEEDS_DATA))
+        break;
+      if (stream.ms_ulLimit >= stream.ms_ulSize) {
+        fprintf(stderr,"suspend: %s: the decoder waits for data behind the end of the stream\n",
+                sc->sc_pcName);
+        ok = false;
+        break;
+      }
+      stream.ms_ulLimit += sc->sc_ulChunk;
+      suspends++;
+    }
+    //
+    // The complete stream must have been consumed.
+    if (ok && stream.ms_ulLimit < stream.ms_ulSize) {
+      fprintf(stderr,"suspend: %s: decoding completed with data still pending\n",
+              sc->sc_pcName);
+      ok = false;
+    }
+    if (ok && suspends == 0) {
+      fprintf(stderr,"suspend: %s: the decoder never suspended\n",sc->sc_pcName);
+      ok = false;
+    }
+    if (ok && !DisplayTestImage(jpeg,&decoded)) {
+      PrintError(jpeg,"displaying the image");
+      ok = false;
+    }
+    if (ok && memcmp(decoded.ti_pData,reference.ti_pData,TestImageSize(&reference))) {
+      fprintf(stderr,"suspend: %s: the image differs from the decoded image\n",
+              sc->sc_pcName);
+      ok = false;
+    }
+  }
+
+  if (jpeg)
+    JPEG::Destruct(jpeg);
+  FreeTestImage(&source);
+  FreeTestImage(&reference);
+  FreeTestImage(&decoded);
+  FreeMemoryStream(&stream);
+
+  printf("suspend: %s, chunks of %lu bytes, %lu suspensions, %s\n",sc->sc_pcName,
+         (unsigned long)sc->sc_ulChunk,(unsigned long)suspends,(ok)?("ok"):("failed"));
+
+  return ok;
+}
+///
+
+/// main
+int main(int,char **)
+{
+  const struct SuspendCase *sc;
+  int failures = 0;
+
+  for(sc = Cases;sc->sc_pcName;sc++) {
+    if (!RunCase(sc))
+      failures++;
+  }
+
+  return (failures)?(10):(0);
+}
+///
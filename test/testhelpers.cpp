@@ -0,0 +1,543 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This file provides the support functions shared by the self-tests
+** of the library: Synthetic test images, an IO hook that reads from
+** and writes to memory, and encoding and decoding of complete images
+** through the public interface.
+**
+*/
+
+/// Includes
+#include "test/testhelpers.hpp"
+#include "interface/types.hpp"
+#include "interface/hooks.hpp"
+#include "interface/tagitem.hpp"
+#include "interface/parameters.hpp"
+#include "interface/jpeg.hpp"
+#include "tools/traits.hpp"
+#include "std/stdio.hpp"
+#include "std/stdlib.hpp"
+#include "std/string.hpp"
+///
+
+/// Progressive scans
+// The standard scan pattern of the command line tool.
+static struct JPG_TagItem pscan1[] = {
+  JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_START,0),
+  JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_STOP,0),
+  JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_LO,1),
+  JPG_EndTag
+};
+static struct JPG_TagItem pscan2[] = {
+  JPG_ValueTag(JPGTAG_SCAN_COMPONENT0,0),
+  JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_START,1),
+  JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_STOP,5),
+  JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_LO,2),
+  JPG_EndTag
+};
+static struct JPG_TagItem pscan3[] = {
+  JPG_ValueTag(JPGTAG_SCAN_COMPONENTS_CHROMA,0),
+  JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_START,1),
+  JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_STOP,63),
+  JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_LO,1),
+  JPG_EndTag
+};
+static struct JPG_TagItem pscan4[] = {
+  JPG_ValueTag(JPGTAG_SCAN_COMPONENT0,0),
+  JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_START,6),
+  JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_STOP,63),
+  JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_LO,2),
+  JPG_EndTag
+};
+static struct JPG_TagItem pscan5[] = {
+  JPG_ValueTag(JPGTAG_SCAN_COMPONENT0,0),
+  JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_START,1),
+  JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_STOP,63),
+  JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_LO,1),
+  JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_HI,2),
+  JPG_EndTag
+};
+static struct JPG_TagItem pscan6[] = {
+  JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_START,0),
+  JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_STOP,0),
+  JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_LO,0),
+  JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_HI,1),
+  JPG_EndTag
+};
+static struct JPG_TagItem pscan7[] = {
+  JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_START,1),
+  JPG_ValueTag(JPGTAG_SCAN_SPECTRUM_STOP,63),
+  JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_LO,0),
+  JPG_ValueTag(JPGTAG_SCAN_APPROXIMATION_HI,1),
+  JPG_EndTag
+};
+
+struct JPG_TagItem ProgressiveScans[] = {
+  JPG_PointerTag(JPGTAG_IMAGE_SCAN,pscan1),
+  JPG_PointerTag(JPGTAG_IMAGE_SCAN,pscan2),
+  JPG_PointerTag(JPGTAG_IMAGE_SCAN,pscan3),
+  JPG_PointerTag(JPGTAG_IMAGE_SCAN,pscan4),
+  JPG_PointerTag(JPGTAG_IMAGE_SCAN,pscan5),
+  JPG_PointerTag(JPGTAG_IMAGE_SCAN,pscan6),
+  JPG_PointerTag(JPGTAG_IMAGE_SCAN,pscan7),
+  JPG_EndTag
+};
+///
+
+/// Subsampling factors
+UBYTE Sub420[] = {1,2,2};
+///
+
+/// Encoder options
+struct JPG_TagItem Baseline444[] = {
+  JPG_ValueTag(JPGTAG_IMAGE_FRAMETYPE,JPGFLAG_SEQUENTIAL),
+  JPG_ValueTag(JPGTAG_IMAGE_QUALITY,85),
+  JPG_EndTag
+};
+struct JPG_TagItem Baseline420[] = {
+  JPG_ValueTag(JPGTAG_IMAGE_FRAMETYPE,JPGFLAG_SEQUENTIAL | JPGFLAG_OPTIMIZE_HUFFMAN),
+  JPG_ValueTag(JPGTAG_IMAGE_QUALITY,75),
+  JPG_ValueTag(JPGTAG_IMAGE_RESTART_INTERVAL,4),
+  JPG_PointerTag(JPGTAG_IMAGE_SUBX,Sub420),
+  JPG_PointerTag(JPGTAG_IMAGE_SUBY,Sub420),
+  JPG_EndTag
+};
+struct JPG_TagItem Progressive444[] = {
+  JPG_ValueTag(JPGTAG_IMAGE_FRAMETYPE,JPGFLAG_PROGRESSIVE | JPGFLAG_OPTIMIZE_HUFFMAN),
+  JPG_ValueTag(JPGTAG_IMAGE_QUALITY,80),
+  JPG_Continue(ProgressiveScans)
+};
+struct JPG_TagItem Progressive420[] = {
+  JPG_ValueTag(JPGTAG_IMAGE_FRAMETYPE,JPGFLAG_PROGRESSIVE | JPGFLAG_OPTIMIZE_HUFFMAN),
+  JPG_ValueTag(JPGTAG_IMAGE_QUALITY,80),
+  JPG_PointerTag(JPGTAG_IMAGE_SUBX,Sub420),
+  JPG_PointerTag(JPGTAG_IMAGE_SUBY,Sub420),
+  JPG_Continue(ProgressiveScans)
+};
+struct JPG_TagItem Residual444[] = {
+  JPG_ValueTag(JPGTAG_IMAGE_FRAMETYPE,JPGFLAG_SEQUENTIAL | JPGFLAG_RESIDUAL_CODING),
+  JPG_ValueTag(JPGTAG_RESIDUAL_FRAMETYPE,JPGFLAG_SEQUENTIAL),
+  JPG_ValueTag(JPGTAG_IMAGE_QUALITY,85),
+  JPG_ValueTag(JPGTAG_RESIDUAL_QUALITY,90),
+  JPG_EndTag
+};
+///
+
+/// SampleSize
+// Return the number of bytes per sample for the given precision.
+static ULONG SampleSize(UBYTE precision)
+{
+  return (precision > 8)?(sizeof(UWORD)):(sizeof(UBYTE));
+}
+///
+
+/// TestImageSize
+// Return the number of bytes the samples of an image take.
+ULONG TestImageSize(const struct TestImage *image)
+{
+  return image->ti_ulWidth * image->ti_ulHeight * image->ti_ucDepth * 
+    SampleSize(image->ti_ucPrecision);
+}
+///
+
+/// AllocTestImage
+// Allocate an image of the given dimensions with all samples zero.
+bool AllocTestImage(struct TestImage *image,ULONG width,ULONG height,
+                    UBYTE depth,UBYTE precision)
+{
+  image->ti_ulWidth     = width;
+  image->ti_ulHeight    = height;
+  image->ti_ucDepth     = depth;
+  image->ti_ucPrecision = precision;
+  image->ti_pData       = calloc(TestImageSize(image),1);
+
+  return image->ti_pData != NULL;
+}
+///
+
+/// CreateTestImage
+// Allocate and fill an image with deterministic content that neither
+// the DCT nor the entropy coder find trivial: Smooth gradients, hard
+// edges and some noise.
+bool CreateTestImage(struct TestImage *image,ULONG width,ULONG height,
+                     UBYTE depth,UBYTE precision,ULONG seed)
+{
+  ULONG max = (1UL << precision) - 1;
+  ULONG x,y;
+  UBYTE c;
+
+  if (!AllocTestImage(image,width,height,depth,precision))
+    return false;
+
+  for(y = 0;y < height;y++) {
+    for(x = 0;x < width;x++) {
+      bool tile = (((x << 3) / width) ^ ((y << 3) / height)) & 1;
+      for(c = 0;c < depth;c++) {
+        ULONG i = (y * width + x) * depth + c;
+        ULONG v;
+        seed = seed * 1103515245UL + 12345UL;
+        // A gradient whose direction depends on the component.
+        v    = ((x * (c + 1) + y * (depth - c)) * max) / (width + height) / (depth + 1);
+        v   += (seed >> 16) & (max >> 4);
+        if (tile)
+          v  = max - v;
+        if (v > max)
+          v  = max;
+        if (precision > 8) {
+          ((UWORD *)image->ti_pData)[i] = UWORD(v);
+        } else {
+          ((UBYTE *)image->ti_pData)[i] = UBYTE(v);
+        }
+      }
+    }
+  }
+
+  return true;
+}
+///
+
+/// FreeTestImage
+// Release the samples of an image.
+void FreeTestImage(struct TestImage *image)
+{
+  free(image->ti_pData);
+  image->ti_pData = NULL;
+}
+///
+
+/// MaxImageDifference
+// Return the largest absolute difference between two images of
+// the same layout.
+ULONG MaxImageDifference(const struct TestImage *a,const struct TestImage *b)
+{
+  ULONG count = a->ti_ulWidth * a->ti_ulHeight * a->ti_ucDepth;
+  ULONG max   = 0;
+  ULONG i;
+
+  for(i = 0;i < count;i++) {
+    LONG d;
+    if (a->ti_ucPrecision > 8) {
+      d = LONG(((const UWORD *)a->ti_pData)[i]) - LONG(((const UWORD *)b->ti_pData)[i]);
+    } else {
+      d = LONG(((const UBYTE *)a->ti_pData)[i]) - LONG(((const UBYTE *)b->ti_pData)[i]);
+    }
+    if (d < 0)
+      d = -d;
+    if (ULONG(d) > max)
+      max = d;
+  }
+
+  return max;
+}
+///
+
+/// InitMemoryStream
+// Initialize an empty memory stream.
+void InitMemoryStream(struct MemoryStream *stream)
+{
+  stream->ms_pucBuffer   = NULL;
+  stream->ms_ulSize      = 0;
+  stream->ms_ulAllocated = 0;
+  stream->ms_ulPos       = 0;
+  stream->ms_ulLimit     = 0;
+}
+///
+
+/// FreeMemoryStream
+// Release the buffer of a memory stream.
+void FreeMemoryStream(struct MemoryStream *stream)
+{
+  free(stream->ms_pucBuffer);
+  InitMemoryStream(stream);
+}
+///
+
+/// MemoryStreamHook
+// The IO hook for memory streams. The hook data is the stream.
+JPG_LONG MemoryStreamHook(struct JPG_Hook *hook,struct JPG_TagItem *tags)
+{
+  struct MemoryStream *stream = (struct MemoryStream *)(hook->hk_pData);
+  UBYTE *buffer               = (UBYTE *)tags->GetTagPtr(JPGTAG_FIO_BUFFER);
+  ULONG  size                 = (ULONG  )tags->GetTagData(JPGTAG_FIO_SIZE);
+
+  switch(tags->GetTagData(JPGTAG_FIO_ACTION)) {
+  case JPGFLAG_ACTION_READ:
+    {
+      ULONG end = (stream->ms_ulLimit)?(stream->ms_ulLimit):(stream->ms_ulSize);
+      if (end > stream->ms_ulSize)
+        end = stream->ms_ulSize;
+      if (stream->ms_ulPos >= end) {
+        // More data arrives later unless the end is reached.
+        if (end < stream->ms_ulSize)
+          tags->SetTagData(JPGTAG_FIO_PENDING,true);
+        return 0;
+      }
+      if (size > end - stream->ms_ulPos)
+        size = end - stream->ms_ulPos;
+      memcpy(buffer,stream->ms_pucBuffer + stream->ms_ulPos,size);
+      stream->ms_ulPos += size;
+      return size;
+    }
+  case JPGFLAG_ACTION_WRITE:
+    {
+      if (stream->ms_ulPos + size > stream->ms_ulAllocated) {
+        ULONG  allocated = (stream->ms_ulAllocated)?(stream->ms_ulAllocated):(4096);
+        UBYTE *grown;
+        while(stream->ms_ulPos + size > allocated)
+          allocated <<= 1;
+        grown = (UBYTE *)realloc(stream->ms_pucBuffer,allocated);
+        if (grown == NULL)
+          return -1;
+        stream->ms_pucBuffer   = grown;
+        stream->ms_ulAllocated = allocated;
+      }
+      memcpy(stream->ms_pucBuffer + stream->ms_ulPos,buffer,size);
+      stream->ms_ulPos += size;
+      if (stream->ms_ulPos > stream->ms_ulSize)
+        stream->ms_ulSize = stream->ms_ulPos;
+      return size;
+    }
+  case JPGFLAG_ACTION_SEEK:
+    {
+      LONG mode   = tags->GetTagData(JPGTAG_FIO_SEEKMODE);
+      LONG offset = tags->GetTagData(JPGTAG_FIO_OFFSET);
+      LONG base;
+
+      switch(mode) {
+      case JPGFLAG_OFFSET_CURRENT:
+        base = stream->ms_ulPos;
+        break;
+      case JPGFLAG_OFFSET_BEGINNING:
+        base = 0;
+        break;
+      case JPGFLAG_OFFSET_END:
+        base = stream->ms_ulSize;
+        break;
+      default:
+        return -1;
+      }
+      if (base + offset < 0 || ULONG(base + offset) > stream->ms_ulSize)
+        return -1;
+      stream->ms_ulPos = base + offset;
+      return 0;
+    }
+  case JPGFLAG_ACTION_QUERY:
+    return 0;
+  }
+  return -1;
+}
+///
+
+/// TestImageHook
+// The bitmap hook for images in memory, for encoding and decoding.
+// The hook data is the image. As the complete image is available,
+// the library may address all rows directly. As the command line
+// tool does, only a stripe of eight lines is made available at once
+// since the encoder consumes all lines it is offered. The stripe is
+// always reported as complete, even at the bottom of the image, as
+// the decoder does not reconstruct a partial block row otherwise. The
+// library clips the stripe to the image.
+JPG_LONG TestImageHook(struct JPG_Hook *hook,struct JPG_TagItem *tags)
+{
+  struct TestImage *image = (struct TestImage *)(hook->hk_pData);
+  UWORD comp              = tags->GetTagData(JPGTAG_BIO_COMPONENT);
+  ULONG miny              = tags->GetTagData(JPGTAG_BIO_MINY);
+  ULONG sample            = SampleSize(image->ti_ucPrecision);
+
+  if (tags->GetTagData(JPGTAG_BIO_ACTION) == JPGFLAG_BIO_REQUEST) {
+    tags->SetTagPtr(JPGTAG_BIO_MEMORY        ,(UBYTE *)(image->ti_pData) + comp * sample);
+    tags->SetTagData(JPGTAG_BIO_WIDTH        ,image->ti_ulWidth);
+    tags->SetTagData(JPGTAG_BIO_HEIGHT       ,miny + 8);
+    tags->SetTagData(JPGTAG_BIO_BYTESPERROW  ,image->ti_ulWidth * image->ti_ucDepth * sample);
+    tags->SetTagData(JPGTAG_BIO_BYTESPERPIXEL,image->ti_ucDepth * sample);
+    tags->SetTagData(JPGTAG_BIO_PIXELTYPE    ,(sample > 1)?(CTYP_UWORD):(CTYP_UBYTE));
+  }
+
+  return 0;
+}
+///
+
+/// PrintError
+// Print the last error of the JPEG object.
+void PrintError(class JPEG *jpeg,const char *what)
+{
+  const char *error;
+  int code = jpeg->LastError(error);
+
+  fprintf(stderr,"%s failed, error %d - %s\n",what,code,error);
+}
+///
+
+/// EncodeTestImage
+// Encode the image with the given options into the stream. Returns
+// false and prints the error on failure.
+bool EncodeTestImage(const struct TestImage *image,const struct JPG_TagItem *options,
+                     struct MemoryStream *stream)
+{
+  class JPEG *jpeg = JPEG::Construct(NULL);
+  bool ok          = false;
+
+  if (jpeg) {
+    struct JPG_Hook bmhook(TestImageHook,const_cast<struct TestImage *>(image));
+    struct JPG_Hook iohook(MemoryStreamHook,stream);
+    struct JPG_TagItem tags[] = {
+      JPG_PointerTag(JPGTAG_BIH_HOOK,&bmhook),
+      JPG_ValueTag(JPGTAG_ENCODER_LOOP_ON_INCOMPLETE,true),
+      JPG_ValueTag(JPGTAG_IMAGE_WIDTH,image->ti_ulWidth),
+      JPG_ValueTag(JPGTAG_IMAGE_HEIGHT,image->ti_ulHeight),
+      JPG_ValueTag(JPGTAG_IMAGE_DEPTH,image->ti_ucDepth),
+      JPG_ValueTag(JPGTAG_IMAGE_PRECISION,image->ti_ucPrecision),
+      JPG_Continue(options)
+    };
+    // The threads are requested on writing as well.
+    struct JPG_TagItem iotags[] = {
+      JPG_PointerTag(JPGTAG_HOOK_IOHOOK,&iohook),
+      JPG_PointerTag(JPGTAG_HOOK_IOSTREAM,stream),
+      JPG_ValueTag(JPGTAG_ENCODER_THREADS,options->GetTagData(JPGTAG_ENCODER_THREADS,1)),
+      JPG_EndTag
+    };
+
+    stream->ms_ulSize = 0;
+    stream->ms_ulPos  = 0;
+
+    if (jpeg->ProvideImage(tags) && jpeg->Write(iotags)) {
+      ok = true;
+    } else {
+      PrintError(jpeg,"encoding the test image");
+    }
+    JPEG::Destruct(jpeg);
+  }
+
+  return ok;
+}
+///
+
+/// DisplayTestImage
+// Reconstruct the image the JPEG object has read completely into the
+// image, which is allocated here. Returns false on failure, the error
+// is then pending in the JPEG object.
+bool DisplayTestImage(class JPEG *jpeg,struct TestImage *image)
+{
+  struct JPG_TagItem itags[] = {
+    JPG_ValueTag(JPGTAG_IMAGE_WIDTH,0),
+    JPG_ValueTag(JPGTAG_IMAGE_HEIGHT,0),
+    JPG_ValueTag(JPGTAG_IMAGE_DEPTH,0),
+    JPG_ValueTag(JPGTAG_IMAGE_PRECISION,0),
+    JPG_EndTag
+  };
+  bool ok = false;
+
+  image->ti_pData = NULL;
+
+  if (jpeg->GetInformation(itags) &&
+      AllocTestImage(image,
+                     itags->GetTagData(JPGTAG_IMAGE_WIDTH),
+                     itags->GetTagData(JPGTAG_IMAGE_HEIGHT),
+                     itags->GetTagData(JPGTAG_IMAGE_DEPTH),
+                     itags->GetTagData(JPGTAG_IMAGE_PRECISION))) {
+    ULONG y;
+    ok = true;
+    // Reconstruct in stripes of eight lines as the hook expects.
+    for(y = 0;y < image->ti_ulHeight && ok;y += 8) {
+      struct JPG_Hook bmhook(TestImageHook,image);
+      struct JPG_TagItem dtags[] = {
+        JPG_PointerTag(JPGTAG_BIH_HOOK,&bmhook),
+        JPG_ValueTag(JPGTAG_DECODER_MINY,y),
+        JPG_ValueTag(JPGTAG_DECODER_MAXY,y + 7),
+        JPG_EndTag
+      };
+      ok = jpeg->DisplayRectangle(dtags)?true:false;
+    }
+    if (!ok)
+      FreeTestImage(image);
+  }
+
+  return ok;
+}
+///
+
+/// DecodeTestImage
+// Decode the complete stream into the image, which is allocated here.
+// If jpeg is non-NULL, use this object instead of a temporary one.
+bool DecodeTestImage(struct MemoryStream *stream,struct TestImage *image,class JPEG *jpeg)
+{
+  class JPEG *own = NULL;
+  bool ok         = false;
+
+  image->ti_pData = NULL;
+
+  if (jpeg == NULL)
+    jpeg = own = JPEG::Construct(NULL);
+
+  if (jpeg) {
+    struct JPG_Hook iohook(MemoryStreamHook,stream);
+    struct JPG_TagItem tags[] = {
+      JPG_PointerTag(JPGTAG_HOOK_IOHOOK,&iohook),
+      JPG_PointerTag(JPGTAG_HOOK_IOSTREAM,stream),
+      JPG_EndTag
+    };
+
+    stream->ms_ulPos = 0;
+
+    if (jpeg->Read(tags))
+      ok = DisplayTestImage(jpeg,image);
+    if (!ok)
+      PrintError(jpeg,"decoding the test image");
+    if (own)
+      JPEG::Destruct(own);
+  }
+
+  return ok;
+}
+///
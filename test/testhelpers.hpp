@@ -0,0 +1,173 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This header provides the support functions shared by the self-tests
+** of the library: Synthetic test images, an IO hook that reads from
+** and writes to memory, and encoding and decoding of complete images
+** through the public interface.
+**
+*/
+
+#ifndef TEST_TESTHELPERS_HPP
+#define TEST_TESTHELPERS_HPP
+
+/// Includes
+#include "interface/types.hpp"
+///
+
+/// Forwards
+struct JPG_Hook;
+struct JPG_TagItem;
+class JPEG;
+///
+
+/// struct TestImage
+// An interleaved image in memory.
+struct TestImage {
+  // The samples, either UBYTE or UWORD depending on the precision.
+  APTR  ti_pData;
+  ULONG ti_ulWidth;
+  ULONG ti_ulHeight;
+  UBYTE ti_ucDepth;
+  UBYTE ti_ucPrecision;
+};
+///
+
+/// struct MemoryStream
+// A growing buffer that receives the codestream on encoding and
+// delivers it on decoding.
+struct MemoryStream {
+  UBYTE *ms_pucBuffer;
+  // Number of valid bytes in the buffer.
+  ULONG  ms_ulSize;
+  // Number of allocated bytes.
+  ULONG  ms_ulAllocated;
+  // The read or write position.
+  ULONG  ms_ulPos;
+  // If non-zero, reading stops here, and the hook reports the data
+  // behind it as pending. This simulates a stream that is still
+  // arriving.
+  ULONG  ms_ulLimit;
+};
+///
+
+/// Progressive scans
+// A tag list that defines a spectral selection and successive
+// approximation scan pattern for three-component progressive images.
+// Chain this into the encoder options by JPG_Continue.
+extern struct JPG_TagItem ProgressiveScans[];
+///
+
+/// Subsampling factors
+// Subsampling factors for 4:2:0 of three-component images.
+extern UBYTE Sub420[];
+///
+
+/// Encoder options
+// Encoder options shared by the tests. Baseline with 4:4:4 and with
+// 4:2:0 subsampling, restart intervals and optimized Huffman tables,
+// progressive with 4:4:4 and 4:2:0 subsampling and the above scan
+// pattern, and sequential with residual coding for images of more
+// than eight bits.
+extern struct JPG_TagItem Baseline444[];
+extern struct JPG_TagItem Baseline420[];
+extern struct JPG_TagItem Progressive444[];
+extern struct JPG_TagItem Progressive420[];
+extern struct JPG_TagItem Residual444[];
+///
+
+/// Prototypes
+// Allocate and fill an image with deterministic content that neither
+// the DCT nor the entropy coder find trivial.
+extern bool CreateTestImage(struct TestImage *image,ULONG width,ULONG height,
+                            UBYTE depth,UBYTE precision,ULONG seed);
+// Allocate an image of the given dimensions with all samples zero.
+extern bool AllocTestImage(struct TestImage *image,ULONG width,ULONG height,
+                           UBYTE depth,UBYTE precision);
+// Release the samples of an image.
+extern void FreeTestImage(struct TestImage *image);
+// Return the number of bytes the samples of an image take.
+extern ULONG TestImageSize(const struct TestImage *image);
+//
+// Initialize an empty memory stream.
+extern void InitMemoryStream(struct MemoryStream *stream);
+// Release the buffer of a memory stream.
+extern void FreeMemoryStream(struct MemoryStream *stream);
+// The IO hook for memory streams. The hook data is the stream.
+extern JPG_LONG MemoryStreamHook(struct JPG_Hook *hook,struct JPG_TagItem *tags);
+// The bitmap hook for images in memory, for encoding and decoding.
+// The hook data is the image.
+extern JPG_LONG TestImageHook(struct JPG_Hook *hook,struct JPG_TagItem *tags);
+//
+// Encode the image with the given options into the stream. Returns
+// false and prints the error on failure. JPGTAG_ENCODER_THREADS in the
+// options applies to providing and writing the image.
+extern bool EncodeTestImage(const struct TestImage *image,const struct JPG_TagItem *options,
+                            struct MemoryStream *stream);
+// Reconstruct the image the JPEG object has read completely into the
+// image, which is allocated here. Returns false on failure, the error
+// is then pending in the JPEG object.
+extern bool DisplayTestImage(class JPEG *jpeg,struct TestImage *image);
+// Decode the complete stream into the image, which is allocated here.
+// If jpeg is non-NULL, use this object instead of a temporary one.
+extern bool DecodeTestImage(struct MemoryStream *stream,struct TestImage *image,
+                            class JPEG *jpeg = NULL);
+// Return the largest absolute difference between two images of
+// the same layout.
+extern ULONG MaxImageDifference(const struct TestImage *a,const struct TestImage *b);
+// Print the last error of the JPEG object.
+extern void PrintError(class JPEG *jpeg,const char *what);
+///
+
+///
+#endif
@@ -69,6 +69,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "std/stddef.hpp"
 #include "std/string.hpp"
 #include "tools/debug.hpp"
+#include "tools/instrumentation.hpp"
 ///
 
 /// Defines
@@ -94,6 +95,20 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 static ULONG totalmem    = 0;
 static ULONG maxmem      = 0;
 ULONG malloccount        = 0;
+// Number of root environments, i.e. JPEG objects, currently alive.
+// The final memory check is only meaningful if the last one goes away.
+static ULONG liveroots   = 0;
+//
+// The above counters are shared by all JPEG objects, which may run
+// concurrently on different threads. Hence, update them atomically
+// if possible.
+#if HAVE_ATOMIC_ADDSUB
+#define COUNTER_ADD(c,v) __sync_add_and_fetch(&(c),(v))
+#define COUNTER_SUB(c,v) __sync_sub_and_fetch(&(c),(v))
+#else
+#define COUNTER_ADD(c,v) ((c) += (v))
+#define COUNTER_SUB(c,v) ((c) -= (v))
+#endif
 #endif
 
 #ifdef HIST
@@ -198,6 +213,9 @@ Environ::Environ(struct JPG_TagItem *tags)
     m_bSuppressMultiple = true;
   }
   //
+  // Instrumentation is installed by the JPEG object if requested.
+  m_pInstrumentation    = NULL;
+  //
   //
   // Now fill in the tags for the allocator
   m_AllocationTags[0].ti_Tag = JPGTAG_MIO_SIZE;
@@ -236,6 +254,10 @@ Environ::Environ(struct JPG_TagItem *tags)
   //
   //
   CleanWarnQueue();
+  //
+#if CHECK_LEVEL > 0
+  COUNTER_ADD(liveroots,1);
+#endif
 }
 ///
 
@@ -272,6 +294,7 @@ class Environ &Environ::operator=(class Environ &env)
   //
   m_pExceptionHook           = env.m_pExceptionHook;
   m_pWarningHook             = env.m_pWarningHook;
+  m_pInstrumentation         = env.m_pInstrumentation;
   //
   // Now fill in the tags for the allocator
   m_AllocationTags[0].ti_Tag = JPGTAG_MIO_SIZE;
@@ -338,6 +361,10 @@ Environ::Environ(class Environ *env)
   //
   m_bSuppressMultiple        = env->m_bSuppressMultiple;
   //
+  // Side-threads do not account to the instrumentation, the
+  // counters are not protected against concurrent updates.
+  m_pInstrumentation         = NULL;
+  //
   // Now fill in the tags for the allocator
   m_AllocationTags[0].ti_Tag = JPGTAG_MIO_SIZE;
   m_AllocationTags[1].ti_Tag = JPGTAG_MIO_TYPE;
@@ -409,20 +436,24 @@ Environ::~Environ(void)
     //
     //
 #if CHECK_LEVEL > 0
-    // Check only on the final destruction.
-    printf("\n%ld bytes memory not yet released.\n"
-           "\n%ld bytes maximal required.\n"
-           "\n%ld allocations performed.\n",
-           long(totalmem),long(maxmem),long(malloccount));
+    // Check only on the final destruction. Other JPEG objects may
+    // still be alive on other threads, then their memory is still
+    // in use and the check has to wait for the last one.
+    if (COUNTER_SUB(liveroots,1) == 0) {
+      printf("\n%ld bytes memory not yet released.\n"
+             "\n%ld bytes maximal required.\n"
+             "\n%ld allocations performed.\n",
+             long(totalmem),long(maxmem),long(malloccount));
 # ifndef USE_VALGRIND
-    // All memory released?
+      // All memory released?
 #  if defined(HAVE_ATOMIC_ADDSUB) || defined(USE_I386_XADD) || defined(USE_INTERLOCKED)
-    assert(totalmem == 0);
+      assert(totalmem == 0);
 #  else
-    printf("\nFinal memory check skipped,\n"
-           "unreliable due to missing locking primitive\n");
+      printf("\nFinal memory check skipped,\n"
+             "unreliable due to missing locking primitive\n");
 #  endif
 # endif
+    }
 #endif
   }
 }
@@ -661,6 +692,9 @@ inline void *Environ::CoreAllocMem(ULONG bytesize,ULONG reqments)
     RecordMemAlloc(bytesize);
 #endif
     //
+    if (m_pInstrumentation)
+      m_pInstrumentation->AddAllocation();
+    //
 #ifdef MUNGE_MEM
     bytesize += 2 * sizeof(Align);
 #endif
@@ -675,7 +709,7 @@ inline void *Environ::CoreAllocMem(ULONG bytesize,ULONG reqments)
 #ifdef HAVE_MALLOC
       mem = malloc(bytesize);
 #if CHECK_LEVEL > 0
-      malloccount++;
+      COUNTER_ADD(malloccount,1);
 #endif
 #else
       mem = NULL;
@@ -690,9 +724,17 @@ inline void *Environ::CoreAllocMem(ULONG bytesize,ULONG reqments)
     }
     //
 #ifdef MUNGE_MEM
-    totalmem += bytesize; 
-    if (totalmem > maxmem)
-      maxmem = totalmem;
+    {
+      ULONG total = COUNTER_ADD(totalmem,bytesize);
+#if HAVE_ATOMIC_COMPARE_AND_SWAP
+      ULONG max;
+      while((max = maxmem) < total && __sync_val_compare_and_swap(&maxmem,max,total) != max) {
+      }
+#else
+      if (total > maxmem)
+        maxmem = total;
+#endif
+    }
     {
       ULONG  s = bytesize;
       ULONG *p = (ULONG *)mem;
@@ -737,7 +779,7 @@ inline void Environ::CoreFreeMem(void *mem,ULONG bytesize)
     //
     // Allocation and release size match?
     assert(bytesize == *(ULONG *)mem);
-    totalmem -= bytesize;
+    COUNTER_SUB(totalmem,bytesize);
     //
     // Munge memory again
     {
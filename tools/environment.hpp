@@ -81,6 +81,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /// Forward declarations
 class Environ;
 class ExceptionRoot;
+class Instrumentation;
 ///
 
 /// Exception
@@ -543,6 +544,10 @@ private:
   struct JPG_Hook       *m_pThreadHook;
   struct JPG_Hook       *m_pMutexHook;
   //
+  // The instrumentation of the JPEG object this environment belongs
+  // to, or NULL if instrumentation is disabled. Not owned.
+  class Instrumentation *m_pInstrumentation;
+  //
   // For optimal performance, we pre-build the tag lists for
   // the allocation and release hooks:
   //
@@ -618,6 +623,19 @@ public:
     return m_Root.m_pActive;
   }
   //
+  // Return the instrumentation of this environment, or NULL if
+  // instrumentation is disabled.
+  class Instrumentation *InstrumentationOf(void) const
+  {
+    return m_pInstrumentation;
+  }
+  //
+  // Install the instrumentation, or remove it with NULL.
+  void SetInstrumentation(class Instrumentation *stats)
+  {
+    m_pInstrumentation = stats;
+  }
+  //
   // Clean the warn queue/history, thus report all warnings from this
   // point on again.
   void CleanWarnQueue(void);
@@ -0,0 +1,144 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This class collects the time spent in the individual stages of
+** the codec and the number of bytes transferred, if instrumentation
+** is enabled on construction of the JPEG object.
+**
+*/
+
+/// Includes
+#include "tools/instrumentation.hpp"
+#include "interface/tagitem.hpp"
+#include "std/string.hpp"
+#include "std/unistd.hpp"
+#if defined(_POSIX_TIMERS) && _POSIX_TIMERS > 0 && defined(_POSIX_MONOTONIC_CLOCK)
+#include <time.h>
+#define USE_CLOCK_GETTIME 1
+#elif defined(HAVE_GETTIMEOFDAY) && defined(HAVE_SYS_TIME_H)
+#include <sys/time.h>
+#define USE_GETTIMEOFDAY 1
+#else
+#include <time.h>
+#endif
+///
+
+/// Instrumentation::Reset
+// Reset all counters to zero.
+void Instrumentation::Reset(void)
+{
+  memset(m_uqTime ,0,sizeof(m_uqTime));
+  memset(m_uqCount,0,sizeof(m_uqCount));
+  memset(m_uqAllocations,0,sizeof(m_uqAllocations));
+  m_uqBytesRead        = 0;
+  m_uqBytesWritten     = 0;
+  m_uqTotalAllocations = 0;
+}
+///
+
+/// Instrumentation::Now
+// Return a time stamp in nanoseconds, relative to some arbitrary
+// origin.
+UQUAD Instrumentation::Now(void)
+{
+#if defined(USE_CLOCK_GETTIME)
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+
+  return UQUAD(ts.tv_sec) * 1000000000 + UQUAD(ts.tv_nsec);
+#elif defined(USE_GETTIMEOFDAY)
+  struct timeval tv;
+
+  gettimeofday(&tv,NULL);
+
+  return UQUAD(tv.tv_sec) * 1000000000 + UQUAD(tv.tv_usec) * 1000;
+#else
+  return UQUAD(clock()) * (1000000000 / CLOCKS_PER_SEC);
+#endif
+}
+///
+
+/// ClampToLong
+// Tag data is only 32 bits wide, saturate larger values.
+static JPG_LONG ClampToLong(UQUAD v)
+{
+  if (v > MAX_LONG)
+    return MAX_LONG;
+
+  return JPG_LONG(v);
+}
+///
+
+/// Instrumentation::GetInformation
+// Fill in the JPGTAG_STATS tags of the tag list, and reset the
+// counters if requested.
+void Instrumentation::GetInformation(struct JPG_TagItem *tags)
+{
+  int i;
+
+  tags->SetTagData(JPGTAG_STATS_BYTES_READ   ,ClampToLong(m_uqBytesRead));
+  tags->SetTagData(JPGTAG_STATS_BYTES_WRITTEN,ClampToLong(m_uqBytesWritten));
+  tags->SetTagData(JPGTAG_STATS_ALLOCATIONS  ,ClampToLong(m_uqTotalAllocations));
+
+  for(i = 0;i < JPGFLAG_STATS_STAGES;i++) {
+    // Report the time in microseconds.
+    tags->SetTagData(JPGTAG_STATS_TIME(i) ,ClampToLong((m_uqTime[i] + 500) / 1000));
+    tags->SetTagData(JPGTAG_STATS_COUNT(i),ClampToLong(m_uqCount[i]));
+    tags->SetTagData(JPGTAG_STATS_ALLOCATIONS_IN(i),ClampToLong(m_uqAllocations[i]));
+  }
+
+  if (tags->GetTagData(JPGTAG_STATS_RESET))
+    Reset();
+}
+///
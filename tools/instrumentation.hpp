@@ -0,0 +1,195 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This class collects the time spent in the individual stages of
+** the codec and the number of bytes transferred, if instrumentation
+** is enabled on construction of the JPEG object.
+**
+*/
+
+#ifndef TOOLS_INSTRUMENTATION_HPP
+#define TOOLS_INSTRUMENTATION_HPP
+
+/// Includes
+#include "interface/types.hpp"
+#include "interface/parameters.hpp"
+#include "tools/environment.hpp"
+///
+
+/// Forwards
+struct JPG_TagItem;
+///
+
+/// class Instrumentation
+// This class keeps cumulative timings and counters of the processing
+// stages. There is at most one of them per JPEG object, and it is
+// reachable from the environment.
+class Instrumentation : public JObject {
+  //
+  // Cumulative time spent in each stage in nanoseconds.
+  UQUAD m_uqTime[JPGFLAG_STATS_STAGES];
+  //
+  // Number of times each stage was entered.
+  UQUAD m_uqCount[JPGFLAG_STATS_STAGES];
+  //
+  // Number of allocations made while each stage was active.
+  UQUAD m_uqAllocations[JPGFLAG_STATS_STAGES];
+  //
+  // Bytes read from and written to the IO hook.
+  UQUAD m_uqBytesRead;
+  UQUAD m_uqBytesWritten;
+  //
+  // Total number of allocations.
+  UQUAD m_uqTotalAllocations;
+  //
+public:
+  Instrumentation(void)
+  {
+    Reset();
+  }
+  //
+  // Reset all counters to zero.
+  void Reset(void);
+  //
+  // Return a time stamp in nanoseconds, relative to some arbitrary
+  // origin.
+  static UQUAD Now(void);
+  //
+  // Account the given time and number of allocations to a stage.
+  void AddTime(int stage,UQUAD ns,UQUAD allocations)
+  {
+    m_uqTime[stage]        += ns;
+    m_uqAllocations[stage] += allocations;
+    m_uqCount[stage]++;
+  }
+  //
+  // Count an allocation.
+  void AddAllocation(void)
+  {
+    m_uqTotalAllocations++;
+  }
+  //
+  // Return the number of allocations so far.
+  UQUAD AllocationsOf(void) const
+  {
+    return m_uqTotalAllocations;
+  }
+  //
+  // Account the given number of bytes read from the IO hook.
+  void AddBytesRead(ULONG bytes)
+  {
+    m_uqBytesRead    += bytes;
+  }
+  //
+  // Account the given number of bytes written to the IO hook.
+  void AddBytesWritten(ULONG bytes)
+  {
+    m_uqBytesWritten += bytes;
+  }
+  //
+  // Fill in the JPGTAG_STATS tags of the tag list, and reset the
+  // counters if requested.
+  void GetInformation(struct JPG_TagItem *tags);
+};
+///
+
+/// class StageTimer
+// Measures the time spent in its scope and accounts it to the given
+// stage, provided instrumentation is enabled. Otherwise, this only
+// costs a test of the instrumentation pointer. Code that runs a timer
+// per block should fetch the instrumentation once outside of its loops
+// and construct the timer from it, such that the test remains in a
+// register.
+class StageTimer {
+  //
+  // The instrumentation to account to, or NULL.
+  class Instrumentation *m_pInstrumentation;
+  //
+  // The stage.
+  int                    m_iStage;
+  //
+  // Start of the measurement, and the allocations made before.
+  UQUAD                  m_uqStart;
+  UQUAD                  m_uqAllocations;
+  //
+public:
+  StageTimer(class Environ *env,int stage)
+    : m_pInstrumentation(env->InstrumentationOf()), m_iStage(stage)
+  {
+    if (m_pInstrumentation) {
+      m_uqAllocations = m_pInstrumentation->AllocationsOf();
+      m_uqStart       = Instrumentation::Now();
+    }
+  }
+  //
+  // Account to the given instrumentation, which may be NULL.
+  StageTimer(class Instrumentation *stats,int stage)
+    : m_pInstrumentation(stats), m_iStage(stage)
+  {
+    if (m_pInstrumentation) {
+      m_uqAllocations = m_pInstrumentation->AllocationsOf();
+      m_uqStart       = Instrumentation::Now();
+    }
+  }
+  //
+  ~StageTimer(void)
+  {
+    if (m_pInstrumentation)
+      m_pInstrumentation->AddTime(m_iStage,Instrumentation::Now() - m_uqStart,
+                                  m_pInstrumentation->AllocationsOf() - m_uqAllocations);
+  }
+};
+///
+
+///
+#endif
@@ -83,6 +83,42 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define INT_TO_COLOR(x) ((x) << (COLOR_BITS))
 ///
 
+/// Bit scanning
+// Return the number of bits required to represent the given value,
+// i.e. the position of the highest set bit plus one. Zero for zero.
+inline UBYTE BitLength(ULONG v)
+{
+#ifdef HAVE_BUILTIN_CLZ
+  return (v)?(UBYTE(32 - __builtin_clz(v))):(0);
+#else
+  UBYTE len = 0;
+  while(v) {
+    v >>= 1;
+    len++;
+  }
+  return len;
+#endif
+}
+// Return the position of the lowest set bit of a non-zero value.
+inline UBYTE LowestBit(UQUAD v)
+{
+#ifdef HAVE_BUILTIN_CLZ
+  return UBYTE(__builtin_ctzll(v));
+#else
+  UBYTE pos = 0;
+  if ((v & 0xffffffffUL) == 0) {
+    v  >>= 32;
+    pos  = 32;
+  }
+  while((v & 1) == 0) {
+    v >>= 1;
+    pos++;
+  }
+  return pos;
+#endif
+}
+///
+
 /// Endian-independent IEEE converters
 // Convert an encoded big-endian IEEE number into a FLOAT.
 FLOAT  IEEEDecode(ULONG bits);
@@ -0,0 +1,184 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This class keeps lookup tables that depend only on a small set of
+** parameters, such as the tables of the parametric tone mapping curves,
+** such that they can be shared by all JPEG objects of a process.
+**
+*/
+
+/// Includes
+#include "tools/tablecache.hpp"
+#include "std/stdlib.hpp"
+#include "std/string.hpp"
+// The cache is shared by all JPEG objects, and these may run on
+// threads of the application even if the library itself does not
+// use threads, hence lock whenever POSIX threads are available.
+#if defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define TABLECACHE_LOCKING 1
+#endif
+///
+
+/// struct TableCache::Entry
+// A single cached table. The key and the table data follow the
+// structure in the same allocation.
+struct TableCache::Entry {
+  struct Entry *m_pNext;
+  ULONG         m_ulKeySize;
+  ULONG         m_ulTableSize;
+  //
+  // Return the key of this entry.
+  const void *KeyOf(void) const
+  {
+    return this + 1;
+  }
+  //
+  // Return the table data of this entry, which is aligned to
+  // the larger of the two basic types.
+  const void *TableOf(void) const
+  {
+    return ((const UBYTE *)(this + 1)) + AlignedKeySize(m_ulKeySize);
+  }
+  //
+  // Return the size of the key rounded up to keep the table aligned.
+  static ULONG AlignedKeySize(ULONG keysize)
+  {
+    return (keysize + sizeof(DOUBLE) - 1) & ~ULONG(sizeof(DOUBLE) - 1);
+  }
+};
+///
+
+/// Statics
+struct TableCache::Entry *TableCache::m_pCacheList  = NULL;
+ULONG                     TableCache::m_ulCacheSize = 0;
+#ifdef TABLECACHE_LOCKING
+static pthread_mutex_t CacheLock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_CACHE   pthread_mutex_lock(&CacheLock)
+#define UNLOCK_CACHE pthread_mutex_unlock(&CacheLock)
+#define CACHE_LIMIT  ULONG(MaxCacheSize)
+#else
+// Without a lock, the cache cannot be shared safely. It then stays
+// empty, and each caller keeps its own copy of the table.
+#define LOCK_CACHE
+#define UNLOCK_CACHE
+#define CACHE_LIMIT  0
+#endif
+///
+
+/// TableCache::FindEntry
+// Find the entry for the given key, or return NULL. The cache must
+// be locked.
+const struct TableCache::Entry *TableCache::FindEntry(const void *key,ULONG keysize)
+{
+  const struct Entry *entry;
+
+  for(entry = m_pCacheList;entry;entry = entry->m_pNext) {
+    if (entry->m_ulKeySize == keysize && memcmp(entry->KeyOf(),key,keysize) == 0)
+      return entry;
+  }
+
+  return NULL;
+}
+///
+
+/// TableCache::Find
+// Find the table for the given key of the given size in bytes. Returns
+// NULL if the table is not cached.
+const void *TableCache::Find(const void *key,ULONG keysize)
+{
+  const struct Entry *entry;
+
+  LOCK_CACHE;
+  entry = FindEntry(key,keysize);
+  UNLOCK_CACHE;
+
+  return (entry)?(entry->TableOf()):NULL;
+}
+///
+
+/// TableCache::Insert
+// Enter a table of the given size in bytes under the given key into
+// the cache. Returns the cached copy, which may be that of a
+// concurrent caller that entered the same table first, or NULL if
+// the cache is full.
+const void *TableCache::Insert(const void *key,ULONG keysize,const void *table,ULONG tablesize)
+{
+  const struct Entry *entry;
+  ULONG size = sizeof(struct Entry) + Entry::AlignedKeySize(keysize) + tablesize;
+  
+  LOCK_CACHE;
+  entry = FindEntry(key,keysize);
+  if (entry == NULL && m_ulCacheSize + size <= CACHE_LIMIT) {
+#ifdef HAVE_MALLOC
+    struct Entry *alloc = (struct Entry *)malloc(size);
+#else
+    struct Entry *alloc = NULL;
+#endif
+    if (alloc) {
+      UBYTE *data          = (UBYTE *)(alloc + 1);
+      alloc->m_pNext       = m_pCacheList;
+      alloc->m_ulKeySize   = keysize;
+      alloc->m_ulTableSize = tablesize;
+      memcpy(data,key,keysize);
+      memcpy(data + Entry::AlignedKeySize(keysize),table,tablesize);
+      m_pCacheList         = alloc;
+      m_ulCacheSize       += size;
+      entry                = alloc;
+    }
+  }
+  UNLOCK_CACHE;
+
+  return (entry)?(entry->TableOf()):NULL;
+}
+///
@@ -0,0 +1,112 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This class keeps lookup tables that depend only on a small set of
+** parameters, such as the tables of the parametric tone mapping curves,
+** such that they can be shared by all JPEG objects of a process.
+**
+*/
+
+#ifndef TOOLS_TABLECACHE_HPP
+#define TOOLS_TABLECACHE_HPP
+
+/// Includes
+#include "interface/types.hpp"
+///
+
+/// class TableCache
+// A process-wide cache of lookup tables. Tables are identified by an
+// opaque key, typically a plain structure holding all parameters the
+// table has been computed from. Tables entered here are copied into
+// memory owned by the cache and remain valid until the end of the
+// process, hence must not be released by the caller. The total size of
+// the cache is limited; if it is exhausted, tables are simply not
+// cached and the caller keeps its own copy.
+//
+// The cache is protected by a lock if POSIX threads are available,
+// otherwise it is disabled and never holds any tables. The lock is
+// never held while the caller computes a table, as table computation
+// may throw.
+class TableCache {
+  //
+  // Maximum number of bytes kept in the cache.
+  enum {
+    MaxCacheSize = 16UL << 20
+  };
+  //
+  // A single cached table.
+  struct Entry;
+  //
+  // The list of cached tables and the number of bytes they occupy.
+  static struct Entry *m_pCacheList;
+  static ULONG         m_ulCacheSize;
+  //
+  // Find the entry for the given key, or return NULL. The cache must
+  // be locked.
+  static const struct Entry *FindEntry(const void *key,ULONG keysize);
+  //
+public:
+  // Find the table for the given key of the given size in bytes. Returns
+  // NULL if the table is not cached.
+  static const void *Find(const void *key,ULONG keysize);
+  //
+  // Enter a table of the given size in bytes under the given key into
+  // the cache. Returns the cached copy, which may be that of a
+  // concurrent caller that entered the same table first, or NULL if
+  // the cache is full.
+  static const void *Insert(const void *key,ULONG keysize,const void *table,ULONG tablesize);
+};
+///
+
+///
+#endif
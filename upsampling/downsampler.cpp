@@ -86,7 +86,7 @@ Downsampler<sx,sy>::~Downsampler(void)
 // block domain the block indices. Requires an output buffer that
 // will keep the downsampled data.
 template<int sx,int sy>
-void Downsampler<sx,sy>::DownsampleRegion(LONG bx,LONG by,LONG *buffer) const
+void Downsampler<sx,sy>::DownsampleRegion(LONG bx,LONG by,LONG *buffer)
 {
   LONG ofs = (bx * sx) << 3; // first pixel in the buffer.
   LONG yfs = (by * sy) << 3; // first line.
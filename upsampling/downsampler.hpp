@@ -81,7 +81,7 @@ public:
   // classes inheriting from this. Coordinates are in the downsampled
   // block domain the block indices. Requires an output buffer that
   // will keep the downsampled data.
-  virtual void DownsampleRegion(LONG bx,LONG by,LONG *buffer) const;
+  virtual void DownsampleRegion(LONG bx,LONG by,LONG *buffer);
   //
 };
 ///
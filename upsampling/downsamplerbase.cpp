@@ -64,6 +64,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "tools/rectangle.hpp"
 #include "upsampling/downsamplerbase.hpp"
 #include "upsampling/downsampler.hpp"
+#include "upsampling/rowdownsampler.hpp"
 #include "std/string.hpp"
 ///
 
@@ -188,6 +189,8 @@ void DownsamplerBase::DefineRegion(LONG x,LONG y,const LONG *data)
       data += 8;
     } while(--cnt && line);
   }
+
+  DefineLines(x,topy,topy + 7 - cnt);
 }
 ///
 
@@ -253,7 +256,7 @@ class DownsamplerBase *DownsamplerBase::CreateDownsampler(class Environ *env,int
       return new(env) Downsampler<1,1>(env,width,height);
       break;
     case 2:
-      return new(env) Downsampler<2,1>(env,width,height);
+      return new(env) RowDownsampler<1>(env,width,height);
       break;
     case 3:
       return new(env) Downsampler<3,1>(env,width,height);
@@ -269,7 +272,7 @@ class DownsamplerBase *DownsamplerBase::CreateDownsampler(class Environ *env,int
       return new(env) Downsampler<1,2>(env,width,height);
       break;
     case 2:
-      return new(env) Downsampler<2,2>(env,width,height);
+      return new(env) RowDownsampler<2>(env,width,height);
       break;
     case 3:
       return new(env) Downsampler<3,2>(env,width,height);
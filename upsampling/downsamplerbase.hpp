@@ -96,6 +96,13 @@ protected:
   // of the upsampling filter.
   struct Line        *m_pInputBuffer;
   //
+  // Notify the implementation that the block column x of the buffered
+  // lines from first to last, inclusive and in image coordinates, has
+  // been defined or altered. This is only of interest for downsamplers
+  // that cache their output.
+  virtual void DefineLines(LONG,LONG,LONG)
+  { }
+  //
 private:
   //
   // The last row of the buffer.
@@ -113,7 +120,7 @@ public:
   // classes inheriting from this. Coordinates are in the downsampled
   // block domain the block indices. Requires an output buffer that
   // will keep the downsampled data.
-  virtual void DownsampleRegion(LONG bx,LONG by,LONG *buffer) const = 0;
+  virtual void DownsampleRegion(LONG bx,LONG by,LONG *buffer) = 0;
   //
   // Define the region to be buffered, clipping off what has been applied
   // here before. This extends the internal buffer to hold at least
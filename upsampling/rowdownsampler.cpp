@@ -0,0 +1,204 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This file defines a downsampler for the common 2x1 and 2x2 subsampling
+** factors that filters complete rows of blocks at once.
+**
+*/
+
+/// Includes
+#include "upsampling/rowdownsampler.hpp"
+#include "std/string.hpp"
+///
+
+/// RowDownsampler::RowDownsampler
+template<int sy>
+RowDownsampler<sy>::RowDownsampler(class Environ *env,ULONG width,ULONG height)
+  : Downsampler<2,sy>(env,width,height), m_plRow(NULL), m_lCachedRow(-1), m_lCompleteLines(0)
+{
+  m_ulRowWidth = (((width + 1) >> 1) + 7) & -8;
+}
+///
+
+/// RowDownsampler::~RowDownsampler
+template<int sy>
+RowDownsampler<sy>::~RowDownsampler(void)
+{
+  if (m_plRow)
+    this->m_pEnviron->FreeMem(m_plRow,m_ulRowWidth * 8 * sizeof(LONG));
+}
+///
+
+/// RowDownsampler::DefineLines
+// Drop the cached row if it depends on the given lines, and keep
+// track of the completely defined lines. Blocks are defined from left
+// to right, thus the lines are complete once the rightmost block is
+// there.
+template<int sy>
+void RowDownsampler<sy>::DefineLines(LONG x,LONG first,LONG last)
+{
+  if (m_lCachedRow >= 0 &&
+      last >= ((m_lCachedRow * sy) << 3) && first < (((m_lCachedRow + 1) * sy) << 3))
+    m_lCachedRow = -1;
+
+  if (((x + 1) << 3) >= LONG(this->m_ulWidth) && first <= m_lCompleteLines && last >= m_lCompleteLines)
+    m_lCompleteLines = last + 1;
+}
+///
+
+/// FilterLine
+// Average pairs of horizontally adjacent pixels of a into dst.
+static void FilterLine(LONG *dst,const LONG *a,ULONG width)
+{
+  ULONG i;
+
+  for(i = 0;i < width;i++,a += 2) {
+    dst[i] = (a[0] + a[1]) / 2;
+  }
+}
+///
+
+/// FilterLines
+// Average 2x2 groups of pixels of a and the line b below into dst.
+static void FilterLines(LONG *dst,const LONG *a,const LONG *b,ULONG width)
+{
+  ULONG i;
+
+  for(i = 0;i < width;i++,a += 2,b += 2) {
+    dst[i] = (a[0] + a[1] + b[0] + b[1]) / 4;
+  }
+}
+///
+
+/// RowDownsampler::FilterRow
+// Filter the indicated row of blocks into the row buffer.
+template<int sy>
+void RowDownsampler<sy>::FilterRow(LONG by)
+{
+  struct Line *line = this->m_pInputBuffer;
+  LONG yfs          = (by * sy) << 3; // first line.
+  LONG y            = this->m_lY;
+  ULONG width       = m_ulRowWidth;
+  LONG *dst;
+  int l;
+
+  assert(yfs >= this->m_lY && yfs < this->m_lY + this->m_lHeight);
+
+  if (m_plRow == NULL)
+    m_plRow = (LONG *)this->m_pEnviron->AllocMem(width * 8 * sizeof(LONG));
+  
+  while(y < yfs) {
+    line = line->m_pNext;
+    y++;
+  }
+  assert(line);
+
+  for(l = 0,dst = m_plRow;l < 8;l++,dst += width) {
+    if (line == NULL) {
+      // Beyond the end of the image, the block based filter leaves the
+      // lines empty.
+      memset(dst,0,width * sizeof(LONG));
+    } else if (sy == 1 || line->m_pNext == NULL) {
+      FilterLine(dst,line->m_pData,width);
+      line = line->m_pNext;
+    } else {
+      FilterLines(dst,line->m_pData,line->m_pNext->m_pData,width);
+      line = line->m_pNext->m_pNext;
+    }
+  }
+
+  m_lCachedRow = by;
+}
+///
+
+/// RowDownsampler::DownsampleRegion
+// The actual downsampling process. Coordinates are in the downsampled
+// block domain the block indices. Requires an output buffer that
+// will keep the downsampled data.
+template<int sy>
+void RowDownsampler<sy>::DownsampleRegion(LONG bx,LONG by,LONG *buffer)
+{
+  const LONG *src;
+  int l;
+
+  assert(ULONG(bx << 3) < m_ulRowWidth);
+  
+  if (m_lCachedRow != by) {
+    LONG end = ((by + 1) * sy) << 3; // first line below the row.
+    //
+    // Lines that are not buffered are not filtered at all.
+    if (end > this->m_lY + this->m_lHeight)
+      end = this->m_lY + this->m_lHeight;
+    //
+    // If the row is not yet complete, filtering all of it would read
+    // undefined data. Filter only the requested block then.
+    if (m_lCompleteLines < end) {
+      Downsampler<2,sy>::DownsampleRegion(bx,by,buffer);
+      return;
+    }
+    FilterRow(by);
+  }
+
+  src = m_plRow + (bx << 3);
+  for(l = 0;l < 8;l++) {
+    memcpy(buffer,src,8 * sizeof(LONG));
+    buffer += 8;
+    src    += m_ulRowWidth;
+  }
+}
+///
+
+/// Explicit instanciations
+template class RowDownsampler<1>;
+template class RowDownsampler<2>;
+///
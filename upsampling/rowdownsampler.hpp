@@ -0,0 +1,118 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This file defines a downsampler for the common 2x1 and 2x2 subsampling
+** factors that filters complete rows of blocks at once.
+**
+*/
+
+#ifndef UPSAMPLING_ROWDOWNSAMPLER_HPP
+#define UPSAMPLING_ROWDOWNSAMPLER_HPP
+
+/// Includes
+#include "tools/environment.hpp"
+#include "tools/rectangle.hpp"
+#include "upsampling/downsampler.hpp"
+///
+
+/// Class RowDownsampler
+// This class performs the downsampling process for horizontal subsampling
+// by two and vertical subsampling by sy, which is either one or two.
+// Instead of collecting each 8x8 block from the line buffer separately,
+// it filters a complete row of blocks into a contiguous buffer on the
+// first request, in simple loops over complete lines the compiler can
+// vectorize, and serves the following blocks of the same row from
+// there. This requires that all lines of the row are defined up to the
+// right edge of the image; blocks of rows that are not yet complete are
+// filtered one by one by the block-based downsampler. The results are
+// identical to that of the block-based downsampler.
+template<int sy>
+class RowDownsampler : public Downsampler<2,sy> {
+  //
+  // The downsampled output lines of the currently cached row of blocks.
+  // This holds eight lines of m_ulRowWidth pixels each.
+  LONG               *m_plRow;
+  //
+  // Width of a line of the row buffer, the downsampled width rounded
+  // up to a multiple of eight.
+  ULONG               m_ulRowWidth;
+  //
+  // The block row in the output buffer, or -1 if the buffer is invalid.
+  LONG                m_lCachedRow;
+  //
+  // All lines above this line have been defined up to the right edge
+  // of the image.
+  LONG                m_lCompleteLines;
+  //
+  // Filter the indicated row of blocks into the row buffer.
+  void FilterRow(LONG by);
+  //
+  // Drop the cached row if it depends on the given lines, and keep
+  // track of the completely defined lines.
+  virtual void DefineLines(LONG x,LONG first,LONG last);
+  //
+public:
+  RowDownsampler(class Environ *env,ULONG width,ULONG height);
+  //
+  virtual ~RowDownsampler(void);
+  //
+  // The actual downsampling process. Coordinates are in the downsampled
+  // block domain the block indices. Requires an output buffer that
+  // will keep the downsampled data.
+  virtual void DownsampleRegion(LONG bx,LONG by,LONG *buffer);
+  //
+};
+///
+
+///
+#endif
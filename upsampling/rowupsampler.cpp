@@ -0,0 +1,238 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This file defines an upsampler for the common 2x1 and 2x2 subsampling
+** factors that filters complete rows of blocks at once.
+**
+*/
+
+/// Includes
+#include "upsampling/rowupsampler.hpp"
+#include "std/string.hpp"
+///
+
+/// RowUpsampler::RowUpsampler
+template<int sy>
+RowUpsampler<sy>::RowUpsampler(class Environ *env,ULONG width,ULONG height)
+  : Upsampler<2,sy>(env,width,height), m_plRow(NULL), m_plVertical(NULL),
+    m_lFilteredRow(-1), m_lCachedRow(-1), m_lCachedY(0), m_lCachedHeight(0)
+{
+  m_ulRowWidth = (width + 7) & -8;
+}
+///
+
+/// RowUpsampler::~RowUpsampler
+template<int sy>
+RowUpsampler<sy>::~RowUpsampler(void)
+{
+  if (m_plRow)
+    this->m_pEnviron->FreeMem(m_plRow,m_ulRowWidth * 8 * sizeof(LONG));
+
+  if (m_plVertical)
+    this->m_pEnviron->FreeMem(m_plVertical,((m_ulRowWidth >> 1) + 2) * 8 * sizeof(LONG));
+}
+///
+
+/// RowUpsampler::InvalidateLines
+// Drop the cached rows if they depend on the given lines.
+template<int sy>
+void RowUpsampler<sy>::InvalidateLines(LONG first,LONG last)
+{
+  if (m_lFilteredRow >= 0 && 
+      last >= FirstLineOf(m_lFilteredRow) && first <= LastLineOf(m_lFilteredRow)) {
+    m_lFilteredRow = -1;
+    m_lCachedRow   = -1;
+  }
+}
+///
+
+/// RowUpsampler::FilterVertically
+// Filter the indicated row of blocks vertically.
+template<int sy>
+void RowUpsampler<sy>::FilterVertically(LONG by) const
+{
+  struct Line *lines[8 / sy + 2];
+  struct Line *line = this->m_pInputBuffer;
+  LONG first        = FirstLineOf(by);
+  LONG last         = LastLineOf(by);
+  LONG ymax         = this->m_lY + this->m_lHeight - 1;
+  LONG y            = this->m_lY;
+  LONG stride       = (m_ulRowWidth >> 1) + 2;
+  LONG k,l;
+
+  assert(line);
+  //
+  // Collect the source lines, replicating the edges of the buffer
+  // as the block based filter does.
+  for(k = first;k <= last;k++) {
+    LONG c = k;
+    if (c < this->m_lY) c = this->m_lY;
+    if (c > ymax)       c = ymax;
+    while(y < c) {
+      line = line->m_pNext;
+      y++;
+    }
+    lines[k - first] = line;
+  }
+  //
+  if (sy > 1 && m_plVertical == NULL)
+    m_plVertical = (LONG *)this->m_pEnviron->AllocMem(stride * 8 * sizeof(LONG));
+  //
+  for(l = 0;l < 8;l++) {
+    if (sy > 1) {
+      // The vertical filter. Line zero of the line buffer is the
+      // replicated pixel left of the image, the rounding alternates
+      // with the position in the line buffer.
+      const LONG *c = lines[(l >> 1) + 1]->m_pData;
+      const LONG *o = lines[(l & 1)?((l >> 1) + 2):(l >> 1)]->m_pData;
+      LONG r0       = (l & 1)?(1):(2);
+      LONG r1       = 3 - r0;
+      LONG *t       = m_plVertical + l * stride;
+      LONG d;
+      for(d = 0;d < stride;d += 2) {
+        t[d]     = (o[d]     + 3 * c[d]     + r0) >> 2;
+        t[d + 1] = (o[d + 1] + 3 * c[d + 1] + r1) >> 2;
+      }
+      m_pplFiltered[l] = t;
+    } else {
+      m_pplFiltered[l] = lines[l]->m_pData;
+    }
+  }
+  //
+  m_lFilteredRow  = by;
+  m_lCachedRow    = -1;
+  m_lCachedY      = this->m_lY;
+  m_lCachedHeight = this->m_lHeight;
+}
+///
+
+/// RowUpsampler::FilterHorizontally
+// Expand the vertically filtered lines horizontally into the row buffer.
+template<int sy>
+void RowUpsampler<sy>::FilterHorizontally(void) const
+{
+  LONG half = m_ulRowWidth >> 1;
+  LONG l;
+
+  if (m_plRow == NULL)
+    m_plRow = (LONG *)this->m_pEnviron->AllocMem(m_ulRowWidth * 8 * sizeof(LONG));
+  
+  for(l = 0;l < 8;l++) {
+    const LONG *v = m_pplFiltered[l];
+    LONG *out     = m_plRow + l * m_ulRowWidth;
+    LONG m;
+    //
+    for(m = 0;m < half;m++) {
+      out[2 * m]     = (v[m]     + 3 * v[m + 1] + 2) >> 2;
+      out[2 * m + 1] = (v[m + 2] + 3 * v[m + 1] + 1) >> 2;
+    }
+    //
+    // The block based filter works in place and picks up the already
+    // filtered second pixel of each block for the first. Do the same
+    // to remain compatible.
+    for(m = 0;m < half;m += 4) {
+      out[2 * m + 1] = (out[2 * m + 2] + 3 * v[m + 1] + 1) >> 2;
+    }
+  }
+  //
+  m_lCachedRow = m_lFilteredRow;
+}
+///
+
+/// RowUpsampler::FilteredLinesOf
+// Return the eight vertically filtered lines of the given row of blocks,
+// not yet expanded horizontally.
+template<int sy>
+const LONG *const *RowUpsampler<sy>::FilteredLinesOf(LONG by) const
+{
+  if (by != m_lFilteredRow || this->m_lY != m_lCachedY || this->m_lHeight != m_lCachedHeight)
+    FilterVertically(by);
+
+  return m_pplFiltered;
+}
+///
+
+/// RowUpsampler::UpsampleRegion
+// The actual upsampling process.
+template<int sy>
+void RowUpsampler<sy>::UpsampleRegion(const RectAngle<LONG> &r,LONG *buffer) const
+{
+  const LONG *src;
+  LONG by = r.ra_MinY >> 3;
+  int l;
+  
+  if ((r.ra_MinX & 7) || (r.ra_MinY & 7)) {
+    // Not aligned to the block grid, use the block based filter.
+    Upsampler<2,sy>::UpsampleRegion(r,buffer);
+    return;
+  }
+
+  assert(ULONG(r.ra_MinX + 8) <= m_ulRowWidth);
+  
+  FilteredLinesOf(by);
+  if (m_lCachedRow != by)
+    FilterHorizontally();
+
+  src = m_plRow + r.ra_MinX;
+  for(l = 0;l < 8;l++) {
+    memcpy(buffer,src,8 * sizeof(LONG));
+    buffer += 8;
+    src    += m_ulRowWidth;
+  }
+}
+///
+
+/// Explicit instanciations
+template class RowUpsampler<1>;
+template class RowUpsampler<2>;
+///
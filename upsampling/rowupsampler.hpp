@@ -0,0 +1,154 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software - thor@math.tu-berlin.de)   **
+** Sponsored by Accusoft Corporation, Tampa, FL and                     **
+** the Computing Center of the University of Stuttgart                  **
+**************************************************************************
+
+The copyright in this software is being made available under the
+license included below. This software may be subject to other third
+party and contributor rights, including patent rights, and no such
+rights are granted under this license.
+ 
+Copyright (c) 2013-2017, ISO
+All rights reserved.
+
+This software module was originally contributed by the parties as
+listed below in the course of development of the ISO/IEC 18477 (JPEG
+XT) standard for validation and reference purposes:
+
+- University of Stuttgart
+- Accusoft
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the University of Stuttgart or Accusoft nor
+    the names of its contributors may be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+  * Redistributed products derived from this software must conform to
+    ISO/IEC 18477 (JPEG XT) except that non-commercial redistribution
+    for research and for furtherance of ISO/IEC standards is permitted.
+    Otherwise, contact the contributing parties for any other
+    redistribution rights for products derived from this software.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*************************************************************************/
+/*
+** This file defines an upsampler for the common 2x1 and 2x2 subsampling
+** factors that filters complete rows of blocks at once.
+**
+*/
+
+#ifndef UPSAMPLING_ROWUPSAMPLER_HPP
+#define UPSAMPLING_ROWUPSAMPLER_HPP
+
+/// Includes
+#include "tools/environment.hpp"
+#include "tools/rectangle.hpp"
+#include "upsampling/upsampler.hpp"
+///
+
+/// Class RowUpsampler
+// This class performs the upsampling process for horizontal subsampling
+// by two and vertical subsampling by sy, which is either one or two.
+// Instead of filtering each 8x8 block from the line buffer separately,
+// it filters a complete row of blocks into a contiguous buffer on the
+// first request and serves the following blocks of the same row from
+// there. The results are identical to that of the block-based
+// upsampler, which is used for blocks not aligned to the block grid.
+// The vertically filtered lines are also available separately such
+// that the horizontal expansion can be merged into the color
+// transformation.
+template<int sy>
+class RowUpsampler : public Upsampler<2,sy> {
+  //
+  // The upsampled output lines of the currently cached row of blocks.
+  // This holds eight lines of m_ulRowWidth pixels each.
+  mutable LONG       *m_plRow;
+  //
+  // The vertically filtered lines, not yet horizontally expanded.
+  // This holds eight lines of half the row width plus two pixels
+  // each. Only required for vertical subsampling.
+  mutable LONG       *m_plVertical;
+  //
+  // Pointers to the vertically filtered lines of the current row,
+  // either into the above buffer or into the line buffer.
+  mutable const LONG *m_pplFiltered[8];
+  //
+  // Width of a line of the row buffer, the pixel width rounded up to
+  // a multiple of eight.
+  ULONG               m_ulRowWidth;
+  //
+  // The block row whose lines are vertically filtered, or -1 if none.
+  mutable LONG        m_lFilteredRow;
+  //
+  // The block row in the output buffer, or -1 if the buffer is invalid.
+  mutable LONG        m_lCachedRow;
+  //
+  // The position and height of the line buffer at the time the lines
+  // were filtered. Lines at the edge of the buffer are replicated, hence
+  // the filtered lines depend on them.
+  mutable LONG        m_lCachedY;
+  mutable LONG        m_lCachedHeight;
+  //
+  // Return the first and last subsampled line the given row of blocks
+  // depends on.
+  static LONG FirstLineOf(LONG by)
+  {
+    return (by << 3) / sy - ((sy > 1)?(1):(0));
+  }
+  //
+  static LONG LastLineOf(LONG by)
+  {
+    return ((by << 3) + 7) / sy + ((sy > 1)?(1):(0));
+  }
+  //
+  // Filter the indicated row of blocks vertically.
+  void FilterVertically(LONG by) const;
+  //
+  // Expand the vertically filtered lines horizontally into the row buffer.
+  void FilterHorizontally(void) const;
+  //
+  // Drop the cached rows if they depend on the given lines.
+  virtual void InvalidateLines(LONG first,LONG last);
+  //
+public:
+  RowUpsampler(class Environ *env,ULONG width,ULONG height);
+  //
+  virtual ~RowUpsampler(void);
+  //
+  // The actual upsampling process.
+  virtual void UpsampleRegion(const RectAngle<LONG> &r,LONG *buffer) const;
+  //
+  // This upsampler provides its vertically filtered lines.
+  virtual bool isMergeable(void) const
+  {
+    return true;
+  }
+  //
+  // Return the eight vertically filtered lines of the given row of blocks,
+  // not yet expanded horizontally.
+  virtual const LONG *const *FilteredLinesOf(LONG by) const;
+  //
+};
+///
+
+///
+#endif
@@ -65,6 +65,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "upsampling/upsamplerbase.hpp"
 #include "coding/quantizedrow.hpp"
 #include "upsampling/upsampler.hpp"
+#include "upsampling/rowupsampler.hpp"
 #include "std/string.hpp"
 ///
 
@@ -104,6 +105,23 @@ UpsamplerBase::~UpsamplerBase(void)
 }
 ///
 
+/// UpsamplerBase::ClearBuffer
+// Drop all buffered lines such that all blocks have to be defined
+// again, as required when the coefficients changed.
+void UpsamplerBase::ClearBuffer(void)
+{
+  if (m_pInputBuffer) {
+    assert(m_pLastRow);
+    m_pLastRow->m_pNext = m_pFree;
+    m_pFree             = m_pInputBuffer;
+    m_pInputBuffer      = NULL;
+    m_pLastRow          = NULL;
+  }
+  m_lY      = 0;
+  m_lHeight = 0;
+}
+///
+
 /// UpsamplerBase::GetCollectedBlocks
 // Return a rectangle of block coordinates in the image domain
 // that is ready for output.
@@ -262,6 +280,8 @@ void UpsamplerBase::ExtendBufferedRegion(const RectAngle<LONG> &region)
     if (alloc) {
       alloc->m_pData = (LONG *)m_pEnviron->AllocMem((m_ulWidth + 2 + 8) * sizeof(LONG));
     }
+    // The contents of a recycled line are stale.
+    InvalidateLines(m_lY + m_lHeight,m_lY + m_lHeight);
     m_lHeight++;
   }
 }
@@ -321,6 +341,7 @@ void UpsamplerBase::DefineRegion(LONG bx,LONG by,const LONG *data)
     y++;
   }
   assert(line);
+  InvalidateLines(by,by + 7);
   
   do {
     LONG *dest = line->m_pData + 1;
@@ -335,9 +356,22 @@ void UpsamplerBase::DefineRegion(LONG bx,LONG by,const LONG *data)
 }
 ///
 
+/// UpsamplerBase::FilteredLinesOf
+// Return the eight vertically filtered lines of the given row of blocks,
+// not yet expanded horizontally. Only available if isMergeable()
+// returns true.
+const LONG *const *UpsamplerBase::FilteredLinesOf(LONG) const
+{
+  JPG_THROW(NOT_IMPLEMENTED,"UpsamplerBase::FilteredLinesOf",
+            "the upsampler does not support merging with the color transformation");
+  return NULL; // code never goes here.
+}
+///
+
 /// UpsamplerBase::CreateUpsampler
 // Create an upsampler for the given upsampling factors. Currently, only
-// factors from 1x1 to 4x4 are supported.
+// factors from 1x1 to 4x4 are supported. The common 2x1 and 2x2 cases
+// are handled by row-based upsamplers.
 class UpsamplerBase *UpsamplerBase::CreateUpsampler(class Environ *env,int sx,int sy,ULONG width,ULONG height)
 {
   switch(sy) {
@@ -347,7 +381,7 @@ class UpsamplerBase *UpsamplerBase::CreateUpsampler(class Environ *env,int sx,in
       return new(env) Upsampler<1,1>(env,width,height);
       break;
     case 2:
-      return new(env) Upsampler<2,1>(env,width,height);
+      return new(env) RowUpsampler<1>(env,width,height);
       break;
     case 3:
       return new(env) Upsampler<3,1>(env,width,height);
@@ -363,7 +397,7 @@ class UpsamplerBase *UpsamplerBase::CreateUpsampler(class Environ *env,int sx,in
       return new(env) Upsampler<1,2>(env,width,height);
       break;
     case 2:
-      return new(env) Upsampler<2,2>(env,width,height);
+      return new(env) RowUpsampler<2>(env,width,height);
       break;
     case 3:
       return new(env) Upsampler<3,2>(env,width,height);
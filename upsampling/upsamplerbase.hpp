@@ -108,6 +108,12 @@ protected:
   static void VerticalFilterCore(int ymod,struct Line *top,struct Line *cur,struct Line *bot,
                                  LONG offset,LONG *target);
   //
+  // Notify the implementation that the buffered lines from first to last,
+  // inclusive and in subsampled coordinates, have been altered. This is
+  // only of interest for upsamplers that cache their output.
+  virtual void InvalidateLines(LONG,LONG)
+  { }
+  //
 private:
   //
   // The last row of the buffer.
@@ -125,6 +131,20 @@ public:
   // classes inheriting from this.
   virtual void UpsampleRegion(const RectAngle<LONG> &r,LONG *buffer) const = 0;
   //
+  // Check whether this upsampler expands horizontally by two and provides
+  // its vertically filtered lines such that the horizontal expansion can
+  // be merged into the color transformation.
+  virtual bool isMergeable(void) const
+  {
+    return false;
+  }
+  //
+  // Return the eight vertically filtered lines of the given row of blocks,
+  // not yet expanded horizontally. Entry zero of each line is the
+  // replicated pixel left of the image. Only available if isMergeable()
+  // returns true.
+  virtual const LONG *const *FilteredLinesOf(LONG by) const;
+  //
   // Define the region to be buffered, clipping off what has been buffered
   // here before. Modifies the rectangle to contain only what is needed
   // in addition to what is here already. The rectangle is in block indices.
@@ -146,6 +166,10 @@ public:
   // block coordinates.
   void RemoveBlocks(ULONG by);
   //
+  // Drop all buffered lines such that all blocks have to be defined
+  // again, as required when the coefficients changed.
+  void ClearBuffer(void);
+  //
   // Return a rectangle of block coordinates in the image domain
   // that is ready for output.
   void GetCollectedBlocks(RectAngle<LONG> &rect) const;